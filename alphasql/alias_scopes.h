@@ -0,0 +1,195 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_ALIAS_SCOPES_H_
+#define ALPHASQL_ALIAS_SCOPES_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/string_view.h"
+
+namespace alphasql {
+
+// Aliases visible at a point of a query, kept as a stack of scopes instead of
+// copied sets.
+//
+// Aliases are interned case-insensitively, and each id keeps the stack
+// positions it was added at, so checking whether an alias is visible is a
+// hash lookup, and opening or closing a scope only costs the aliases added
+// to it. Scopes can also be hidden for a while, e.g. the FROM clause a
+// table subquery is part of, which can not see the aliases it introduces.
+class AliasScopes {
+public:
+  // Opens a scope on top of the others on construction and closes it on
+  // destruction.
+  class Scope {
+  public:
+    explicit Scope(AliasScopes *scopes)
+        : scopes_(scopes), index_(scopes->Open()) {}
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+    ~Scope() { scopes_->Close(index_, merge_into_parent_); }
+
+    size_t index() const { return index_; }
+
+    // Keeps the aliases added to the scope visible in the scope below it once
+    // closed, instead of dropping them.
+    void MergeIntoParentOnClose() { merge_into_parent_ = true; }
+
+  private:
+    AliasScopes *const scopes_; // Not owned.
+    const size_t index_;
+    bool merge_into_parent_ = false;
+  };
+
+  // Hides the scopes from <first> to the top while alive. Scopes opened in
+  // the meantime stay visible.
+  class Hidden {
+  public:
+    Hidden(AliasScopes *scopes, size_t first)
+        : scopes_(scopes), first_(first), last_(scopes->Hide(first)) {}
+    Hidden(const Hidden &) = delete;
+    Hidden &operator=(const Hidden &) = delete;
+    ~Hidden() { scopes_->Unhide(first_, last_); }
+
+  private:
+    AliasScopes *const scopes_; // Not owned.
+    const size_t first_;
+    const size_t last_;
+  };
+
+  AliasScopes() = default;
+  AliasScopes(const AliasScopes &) = delete;
+  AliasScopes &operator=(const AliasScopes &) = delete;
+
+  // Adds <alias> to the top scope, which must exist.
+  void Add(absl::string_view alias) {
+    auto it = ids_.find(alias);
+    if (it == ids_.end()) {
+      it = ids_.emplace(std::string(alias), positions_.size()).first;
+      positions_.emplace_back();
+    }
+    positions_[it->second].push_back(entries_.size());
+    entries_.push_back({it->second, frames_.size() - 1});
+  }
+
+  // Whether <alias> was added to a scope that is open and not hidden,
+  // ignoring case.
+  bool Contains(absl::string_view alias) const {
+    const auto it = ids_.find(alias);
+    if (it == ids_.end()) {
+      return false;
+    }
+    // Usually only the last position needs to be looked at, as the same
+    // alias is rarely added to several open scopes.
+    const std::vector<size_t> &positions = positions_[it->second];
+    for (auto position = positions.rbegin(); position != positions.rend();
+         ++position) {
+      if (frames_[entries_[*position].frame].hidden == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Whether no alias is visible or hidden.
+  bool empty() const { return entries_.empty(); }
+
+  // Same as Scope and Hidden, for scopes that can not be tied to the lifetime
+  // of an object, e.g. when traversing with an explicit stack.
+
+  // Opens a scope on top of the others and returns its index.
+  size_t Open() {
+    frames_.push_back({entries_.size(), /*hidden=*/0});
+    return frames_.size() - 1;
+  }
+
+  // Closes the top scope, whose index must be <index>.
+  void Close(size_t index, bool merge_into_parent = false) {
+    if (merge_into_parent && index > 0) {
+      for (size_t i = frames_[index].first_entry; i < entries_.size(); ++i) {
+        entries_[i].frame = index - 1;
+      }
+    } else {
+      while (entries_.size() > frames_[index].first_entry) {
+        positions_[entries_.back().id].pop_back();
+        entries_.pop_back();
+      }
+    }
+    frames_.pop_back();
+  }
+
+  // Hides the scopes from <first> to the top and returns the end of the
+  // hidden range, to be passed to Unhide.
+  size_t Hide(size_t first) {
+    for (size_t i = first; i < frames_.size(); ++i) {
+      ++frames_[i].hidden;
+    }
+    return frames_.size();
+  }
+
+  void Unhide(size_t first, size_t last) {
+    for (size_t i = first; i < last; ++i) {
+      --frames_[i].hidden;
+    }
+  }
+
+private:
+  struct CaseInsensitiveHash {
+    using is_transparent = void;
+    size_t operator()(absl::string_view alias) const {
+      size_t hash = 0;
+      for (const char c : alias) {
+        hash = hash * 31 + static_cast<unsigned char>(absl::ascii_tolower(c));
+      }
+      return hash;
+    }
+  };
+
+  struct CaseInsensitiveEqual {
+    using is_transparent = void;
+    bool operator()(absl::string_view a, absl::string_view b) const {
+      return absl::EqualsIgnoreCase(a, b);
+    }
+  };
+
+  struct Frame {
+    size_t first_entry;
+    int hidden;
+  };
+
+  struct Entry {
+    size_t id;
+    size_t frame;
+  };
+
+  absl::flat_hash_map<std::string, size_t, CaseInsensitiveHash,
+                      CaseInsensitiveEqual>
+      ids_;
+  // Positions in <entries_> of each id, in increasing order.
+  std::vector<std::vector<size_t>> positions_;
+  std::vector<Entry> entries_;
+  std::vector<Frame> frames_;
+};
+
+} // namespace alphasql
+
+#endif // ALPHASQL_ALIAS_SCOPES_H_
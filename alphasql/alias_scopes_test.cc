@@ -0,0 +1,86 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/alias_scopes.h"
+
+#include "gtest/gtest.h"
+
+namespace alphasql {
+namespace {
+
+TEST(AliasScopes, ClosingScopeDropsItsAliases) {
+  AliasScopes scopes;
+  AliasScopes::Scope outer(&scopes);
+  scopes.Add("Outer");
+  {
+    AliasScopes::Scope inner(&scopes);
+    scopes.Add("inner");
+    ASSERT_TRUE(scopes.Contains("outer"));
+    ASSERT_TRUE(scopes.Contains("INNER"));
+  }
+  ASSERT_TRUE(scopes.Contains("OUTER"));
+  ASSERT_FALSE(scopes.Contains("inner"));
+}
+
+TEST(AliasScopes, HiddenScopes) {
+  AliasScopes scopes;
+  AliasScopes::Scope external(&scopes);
+  scopes.Add("external");
+  AliasScopes::Scope from(&scopes);
+  scopes.Add("local");
+  {
+    AliasScopes::Hidden hidden(&scopes, from.index());
+    ASSERT_TRUE(scopes.Contains("external"));
+    ASSERT_FALSE(scopes.Contains("local"));
+    AliasScopes::Scope subquery(&scopes);
+    scopes.Add("local");
+    ASSERT_TRUE(scopes.Contains("local"));
+  }
+  ASSERT_TRUE(scopes.Contains("local"));
+}
+
+TEST(AliasScopes, MergeIntoParent) {
+  AliasScopes scopes;
+  AliasScopes::Scope from(&scopes);
+  {
+    AliasScopes::Hidden hidden(&scopes, from.index());
+    AliasScopes::Scope parenthesized(&scopes);
+    parenthesized.MergeIntoParentOnClose();
+    scopes.Add("joined");
+  }
+  ASSERT_TRUE(scopes.Contains("joined"));
+  {
+    AliasScopes::Hidden hidden(&scopes, from.index());
+    ASSERT_FALSE(scopes.Contains("joined"));
+  }
+}
+
+TEST(AliasScopes, ExplicitOpenAndHide) {
+  AliasScopes scopes;
+  const size_t from = scopes.Open();
+  scopes.Add("t");
+  const size_t last = scopes.Hide(from);
+  const size_t subquery = scopes.Open();
+  ASSERT_FALSE(scopes.Contains("t"));
+  scopes.Close(subquery);
+  scopes.Unhide(from, last);
+  ASSERT_TRUE(scopes.Contains("t"));
+  scopes.Close(from);
+  ASSERT_TRUE(scopes.empty());
+}
+
+} // namespace
+} // namespace alphasql
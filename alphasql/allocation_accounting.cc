@@ -0,0 +1,150 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/allocation_accounting.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+
+#include "absl/flags/flag.h"
+#include "alphasql/diagnostics.h"
+
+ABSL_FLAG(bool, allocation_report, false,
+          "Print the allocations and bytes allocated by phase and the peak of "
+          "allocated bytes to stderr at exit. Takes a build with "
+          "--config=allocation_accounting.");
+
+namespace alphasql {
+
+namespace {
+
+// Constant initialized, so that allocations made before main are counted.
+std::atomic<int> current_phase{static_cast<int>(AllocationPhase::kOther)};
+std::atomic<int64_t> allocations[kNumAllocationPhases];
+std::atomic<int64_t> bytes[kNumAllocationPhases];
+std::atomic<int64_t> allocated_bytes{0};
+std::atomic<int64_t> peak_allocated_bytes{0};
+
+void PrintAllocationReportToStderr() { PrintAllocationReport(std::cerr); }
+
+} // namespace
+
+const char *AllocationPhaseName(AllocationPhase phase) {
+  switch (phase) {
+  case AllocationPhase::kOther:
+    return "other";
+  case AllocationPhase::kDiscovery:
+    return "discovery";
+  case AllocationPhase::kParse:
+    return "parse";
+  case AllocationPhase::kResolve:
+    return "resolve";
+  case AllocationPhase::kGraph:
+    return "graph";
+  case AllocationPhase::kOutput:
+    return "output";
+  case AllocationPhase::kSchemaLoad:
+    return "schema load";
+  case AllocationPhase::kCheck:
+    return "check";
+  }
+  return "other";
+}
+
+ScopedAllocationPhase::ScopedAllocationPhase(AllocationPhase phase)
+    : previous_(static_cast<AllocationPhase>(
+          current_phase.exchange(static_cast<int>(phase)))) {}
+
+ScopedAllocationPhase::~ScopedAllocationPhase() {
+  current_phase.store(static_cast<int>(previous_));
+}
+
+bool AllocationAccountingEnabled() {
+  // The hooks count allocations made before main.
+  return GetTotalAllocationStats().allocations > 0;
+}
+
+AllocationStats GetAllocationStats(AllocationPhase phase) {
+  const int i = static_cast<int>(phase);
+  return {allocations[i].load(), bytes[i].load()};
+}
+
+AllocationStats GetTotalAllocationStats() {
+  AllocationStats total;
+  for (int i = 0; i < kNumAllocationPhases; ++i) {
+    total.allocations += allocations[i].load();
+    total.bytes += bytes[i].load();
+  }
+  return total;
+}
+
+int64_t GetPeakAllocatedBytes() { return peak_allocated_bytes.load(); }
+
+void PrintAllocationReport(std::ostream &out) {
+  if (!AllocationAccountingEnabled()) {
+    Report({Severity::kWarning,
+            "allocations are not counted without "
+            "--config=allocation_accounting"},
+           "WARNING: allocations are not counted without "
+           "--config=allocation_accounting",
+           out);
+    return;
+  }
+  out << "Allocations:\n";
+  for (int i = 0; i < kNumAllocationPhases; ++i) {
+    const AllocationPhase phase = static_cast<AllocationPhase>(i);
+    const AllocationStats stats = GetAllocationStats(phase);
+    if (stats.allocations == 0) {
+      continue;
+    }
+    out << "\t" << AllocationPhaseName(phase) << ": " << stats.allocations
+        << " allocations, " << stats.bytes << " bytes\n";
+  }
+  const AllocationStats total = GetTotalAllocationStats();
+  out << "\ttotal: " << total.allocations << " allocations, " << total.bytes
+      << " bytes\n";
+  out << "\tpeak: " << GetPeakAllocatedBytes() << " bytes\n";
+}
+
+void InitAllocationReport() {
+  if (absl::GetFlag(FLAGS_allocation_report)) {
+    std::atexit(PrintAllocationReportToStderr);
+  }
+}
+
+namespace internal {
+
+void RecordAllocation(size_t size) {
+  const int phase = current_phase.load(std::memory_order_relaxed);
+  allocations[phase].fetch_add(1, std::memory_order_relaxed);
+  bytes[phase].fetch_add(size, std::memory_order_relaxed);
+  const int64_t allocated =
+      allocated_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  int64_t peak = peak_allocated_bytes.load(std::memory_order_relaxed);
+  while (allocated > peak &&
+         !peak_allocated_bytes.compare_exchange_weak(
+             peak, allocated, std::memory_order_relaxed)) {
+  }
+}
+
+void RecordDeallocation(size_t size) {
+  allocated_bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+} // namespace internal
+
+} // namespace alphasql
@@ -0,0 +1,96 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_ALLOCATION_ACCOUNTING_H_
+#define ALPHASQL_ALLOCATION_ACCOUNTING_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#include "absl/flags/declare.h"
+
+ABSL_DECLARE_FLAG(bool, allocation_report);
+
+namespace alphasql {
+
+// What the tools are doing when memory is allocated.
+enum class AllocationPhase {
+  kOther,
+  // Listing SQL files and reading the DAG.
+  kDiscovery,
+  // Reading and parsing SQL files.
+  kParse,
+  // Extracting identifiers, including parsing streamed statements.
+  kResolve,
+  kGraph,
+  kOutput,
+  kSchemaLoad,
+  kCheck,
+};
+constexpr int kNumAllocationPhases = 8;
+
+const char *AllocationPhaseName(AllocationPhase phase);
+
+struct AllocationStats {
+  int64_t allocations = 0;
+  int64_t bytes = 0;
+};
+
+// Sets the phase allocations are counted in until destroyed, for every
+// thread, since phases do not overlap.
+class ScopedAllocationPhase {
+public:
+  explicit ScopedAllocationPhase(AllocationPhase phase);
+  ScopedAllocationPhase(const ScopedAllocationPhase &) = delete;
+  ScopedAllocationPhase &operator=(const ScopedAllocationPhase &) = delete;
+  ~ScopedAllocationPhase();
+
+private:
+  const AllocationPhase previous_;
+};
+
+// Whether allocations are counted, which takes the allocation_hooks library
+// linked in, as by building with --config=allocation_accounting.
+bool AllocationAccountingEnabled();
+
+// What was allocated in <phase> so far.
+AllocationStats GetAllocationStats(AllocationPhase phase);
+
+// What was allocated in all phases so far.
+AllocationStats GetTotalAllocationStats();
+
+// Largest number of bytes allocated and not freed yet at any time.
+int64_t GetPeakAllocatedBytes();
+
+// Writes the allocations and bytes of each phase, their totals and the peak.
+void PrintAllocationReport(std::ostream &out);
+
+// With --allocation_report, prints the report to stderr at exit. Must be
+// called once flags are parsed.
+void InitAllocationReport();
+
+namespace internal {
+
+// Called by the allocation hooks, so they must not allocate.
+void RecordAllocation(size_t size);
+void RecordDeallocation(size_t size);
+
+} // namespace internal
+
+} // namespace alphasql
+
+#endif // ALPHASQL_ALLOCATION_ACCOUNTING_H_
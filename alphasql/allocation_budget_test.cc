@@ -0,0 +1,130 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/strings/str_cat.h"
+#include "alphasql/allocation_accounting.h"
+#include "alphasql/alphacheck_lib.h"
+#include "alphasql/dag_lib.h"
+#include "alphasql/diagnostics.h"
+#include "alphasql/execution_plan.h"
+#include "gtest/gtest.h"
+
+namespace alphasql {
+namespace {
+
+// Upper bounds on the bytes each phase allocates for any one of the samples,
+// of which samples/sample is the largest, with modest headroom so that a
+// realistic regression fails. The bytes each run allocates are recorded as
+// test properties; lower the bounds along with changes that allocate less.
+struct Budget {
+  AllocationPhase phase;
+  int64_t bytes;
+};
+constexpr int64_t kMiB = 1 << 20;
+constexpr Budget kBudgets[] = {
+    {AllocationPhase::kDiscovery, 2 * kMiB},
+    {AllocationPhase::kParse, 8 * kMiB},
+    {AllocationPhase::kResolve, 8 * kMiB},
+    {AllocationPhase::kGraph, 1 * kMiB},
+    {AllocationPhase::kSchemaLoad, 2 * kMiB},
+    {AllocationPhase::kCheck, 64 * kMiB},
+};
+constexpr int64_t kPeakBudget = 128 * kMiB;
+
+// A sample directory and whether its files pass the type check, as in its
+// alphacheck_stderr.txt.
+struct Sample {
+  const char *path;
+  bool passes;
+};
+
+class AllocationBudget : public ::testing::TestWithParam<Sample> {};
+
+TEST_P(AllocationBudget, StaysWithinBudget) {
+  const Sample &sample = GetParam();
+  ASSERT_TRUE(AllocationAccountingEnabled());
+  absl::SetFlag(&FLAGS_quiet, true);
+  absl::SetFlag(&FLAGS_json_schema_path, "samples/sample-schema.json");
+  std::vector<AllocationStats> before;
+  for (const Budget &budget : kBudgets) {
+    before.push_back(GetAllocationStats(budget.phase));
+  }
+
+  std::map<std::string, table_queries> table_queries_map;
+  std::map<std::string, function_queries> function_queries_map;
+  std::set<std::string> vertices;
+  std::map<std::string, std::unique_ptr<SQLFile>> sql_files;
+  std::string path = sample.path;
+  ASSERT_TRUE(UpdateIdentifierQueriesMapsAndVerticesFromPaths(
+                  {path.data()}, table_queries_map, function_queries_map,
+                  vertices, &sql_files)
+                  .ok());
+  DAGGraph g;
+  std::vector<std::string> external_required_tables;
+  BuildDependencyGraph(table_queries_map, function_queries_map, vertices,
+                       /*with_tables=*/false, /*with_functions=*/false,
+                       /*side_effect_first=*/false, &g,
+                       &external_required_tables);
+  // Files of a cyclic graph are never checked.
+  const bool checked = !HasCycle(g);
+  if (checked) {
+    std::vector<std::string> execution_plan;
+    std::vector<std::vector<size_t>> upstreams;
+    GetExecutionPlan(g, &execution_plan, &upstreams);
+    EXPECT_EQ(CheckExecutionPlan(execution_plan, upstreams, &sql_files),
+              sample.passes ? 0 : 1);
+  }
+
+  for (size_t i = 0; i < before.size(); ++i) {
+    const Budget &budget = kBudgets[i];
+    const AllocationStats stats = GetAllocationStats(budget.phase);
+    const int64_t bytes = stats.bytes - before[i].bytes;
+    RecordProperty(absl::StrCat(AllocationPhaseName(budget.phase), " bytes"),
+                   bytes);
+    if (checked || (budget.phase != AllocationPhase::kSchemaLoad &&
+                    budget.phase != AllocationPhase::kCheck)) {
+      EXPECT_GT(stats.allocations, before[i].allocations)
+          << AllocationPhaseName(budget.phase);
+    }
+    EXPECT_LE(bytes, budget.bytes) << AllocationPhaseName(budget.phase);
+  }
+  EXPECT_LE(GetPeakAllocatedBytes(), kPeakBudget);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Samples, AllocationBudget,
+    ::testing::Values(
+        Sample{"samples/create-temp-table-test", true},
+        Sample{"samples/drop-test", true}, Sample{"samples/ml", false},
+        Sample{"samples/mutasions-and-query", true},
+        Sample{"samples/sample", true}, Sample{"samples/sample-any-type", true},
+        Sample{"samples/sample-arbitrary-dependency-graph-with-drop-statement",
+               true},
+        Sample{"samples/sample-ci", false}, Sample{"samples/sample-cycle", true},
+        Sample{"samples/sample-function-dependency", true},
+        Sample{"samples/sample-undefined", true},
+        Sample{"samples/scripting", true}, Sample{"samples/tvf", true}));
+
+} // namespace
+} // namespace alphasql
@@ -0,0 +1,81 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Replaces the global operator new and delete to count allocations by phase
+// for alphasql/allocation_accounting.h. Each block is prefixed by its size,
+// so that the bytes freed are known without sized deallocation. Only linked
+// with --config=allocation_accounting, since it makes every allocation
+// slower.
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#include "alphasql/allocation_accounting.h"
+
+namespace {
+
+// Keeps the blocks returned aligned as malloc aligns them.
+constexpr size_t kHeaderSize = alignof(std::max_align_t);
+
+void *Allocate(size_t size) noexcept {
+  void *block = std::malloc(size + kHeaderSize);
+  if (block == nullptr) {
+    return nullptr;
+  }
+  *static_cast<size_t *>(block) = size;
+  alphasql::internal::RecordAllocation(size);
+  return static_cast<char *>(block) + kHeaderSize;
+}
+
+void Deallocate(void *ptr) noexcept {
+  if (ptr == nullptr) {
+    return;
+  }
+  void *block = static_cast<char *>(ptr) - kHeaderSize;
+  alphasql::internal::RecordDeallocation(*static_cast<size_t *>(block));
+  std::free(block);
+}
+
+void *AllocateOrThrow(size_t size) {
+  void *ptr = Allocate(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+} // namespace
+
+void *operator new(size_t size) { return AllocateOrThrow(size); }
+void *operator new[](size_t size) { return AllocateOrThrow(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return Allocate(size);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return Allocate(size);
+}
+
+void operator delete(void *ptr) noexcept { Deallocate(ptr); }
+void operator delete[](void *ptr) noexcept { Deallocate(ptr); }
+void operator delete(void *ptr, size_t) noexcept { Deallocate(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { Deallocate(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+  Deallocate(ptr);
+}
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+  Deallocate(ptr);
+}
@@ -0,0 +1,1051 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <algorithm>
+
+#include "absl/flags/flag.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/cord.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+#include "absl/types/optional.h"
+#include "google/protobuf/descriptor.h"
+#include "zetasql/base/logging.h"
+#include "zetasql/public/analyzer.h"
+#include "zetasql/public/catalog.h"
+#include "zetasql/public/error_helpers.h"
+#include "zetasql/public/evaluator.h"
+#include "zetasql/public/evaluator_table_iterator.h"
+#include "zetasql/public/language_options.h"
+#include "zetasql/public/parse_location.h"
+#include "zetasql/public/parse_resume_location.h"
+#include "zetasql/public/simple_catalog.h"
+#include "zetasql/public/type.h"
+#include "zetasql/public/value.h"
+#include "zetasql/public/templated_sql_function.h"
+#include "zetasql/public/templated_sql_tvf.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+
+#include "alphasql/alphacheck_lib.h"
+#include "alphasql/allocation_accounting.h"
+#include "alphasql/check_cache.h"
+#include "alphasql/column_lineage.h"
+#include "alphasql/cost_estimator.h"
+#include "alphasql/dead_code_finder.h"
+#include "alphasql/diagnostics.h"
+#include "alphasql/duplicate_subquery_finder.h"
+#include "alphasql/identifier_resolver.h"
+#include "alphasql/common_lib.h"
+#include "alphasql/dag_scheduler.h"
+#include "alphasql/executor.h"
+#include "alphasql/fixture_reader.h"
+#include "alphasql/json_schema_reader.h"
+#include "alphasql/layered_catalog.h"
+#include "alphasql/lint.h"
+#include "alphasql/procedure_cache.h"
+#include "alphasql/sql_file.h"
+#include "alphasql/statement_profiler.h"
+#include "alphasql/table_evictor.h"
+#include "alphasql/templated_function_cache.h"
+#include "zetasql/base/status.h"
+#include "zetasql/base/status_macros.h"
+#include "zetasql/base/statusor.h"
+
+ABSL_FLAG(std::string, json_schema_path, "", "Schema file in JSON format.");
+ABSL_FLAG(int, jobs, 1,
+          "Number of files checked concurrently. A file is checked as soon as "
+          "all of its upstream files passed.");
+ABSL_FLAG(bool, keep_going, false,
+          "Keep checking files that do not depend on a failed file.");
+ABSL_FLAG(bool, evict_tables, false,
+          "Free the tables created by a file once all of its downstream files "
+          "finished, so that memory is bounded by the width of the dependency "
+          "graph instead of its size. The graph must link every file reading "
+          "a table to the file creating it, as alphadag does.");
+ABSL_FLAG(std::string, cache_dir, "",
+          "Directory to cache analysis results in. Files whose content and "
+          "upstream schemas did not change since the last successful check "
+          "are not analyzed again.");
+ABSL_FLAG(std::string, column_lineage_output_path, "",
+          "Output path for the column-level lineage graph in DOT. Cached "
+          "results are not used, since files have to be analyzed to extract "
+          "their lineage.");
+ABSL_FLAG(std::string, table_stats_path, "",
+          "Statistics of external tables in JSON, to estimate the bytes each "
+          "file scans. Cached results are not used when it is given.");
+ABSL_FLAG(std::string, lint_rules, "",
+          "Comma separated performance lint rules to run on every statement, "
+          "or \"all\": select_star_on_wide_table, missing_partition_filter, "
+          "unbounded_cross_join, order_by_without_limit, "
+          "count_distinct_on_huge_input and repeated_scalar_subquery. "
+          "Findings are warnings unless --warning_as_error is given. Cached "
+          "results are not used when it is given.");
+ABSL_FLAG(bool, duplicate_subqueries, false,
+          "Report joins, aggregations and other queries that more than one "
+          "file computes, as candidates to materialize once in a shared "
+          "table. Cached results are not used when it is given.");
+ABSL_FLAG(bool, dead_code, false,
+          "Report tables created by the pipeline that no later statement "
+          "reads, and columns of tables created by CREATE TABLE AS SELECT "
+          "that no later statement references, with their estimated size if "
+          "--table_stats_path is given. Cached results are not used when it "
+          "is given.");
+ABSL_FLAG(bool, profile, false,
+          "Time the parse and the analysis of every statement, count its "
+          "resolved nodes and the analyzer arena it used, and report the "
+          "slowest statements. Cached results are not used when it is given.");
+ABSL_FLAG(int, profile_top_n, 10,
+          "Number of the slowest statements reported by --profile.");
+ABSL_FLAG(std::string, profile_output_path, "",
+          "Output path for the profile of every statement in CSV, which "
+          "implies --profile.");
+ABSL_FLAG(bool, cache_templated_functions, false,
+          "Resolve the bodies of functions and table functions with ANY TYPE "
+          "or ANY TABLE arguments once per combination of argument types, "
+          "instead of at every call. Errors in the body of a function are "
+          "then reported at the call with their line and column in the "
+          "body, and calls do not carry the resolved body, so tables read in "
+          "the body would be missing from --column_lineage_output_path, "
+          "--table_stats_path, --lint_rules, --duplicate_subqueries and "
+          "--dead_code, which can not be combined with it.");
+ABSL_FLAG(bool, execute, false,
+          "Execute the files with the reference evaluator instead of only "
+          "checking them, reading external tables from --fixture_dir. "
+          "Statements that can not be executed locally are skipped with a "
+          "warning, or fail their file with --warning_as_error.");
+ABSL_FLAG(std::string, fixture_dir, "",
+          "Directory of <table name>.csv or <table name>.json files holding "
+          "the rows of external tables for --execute. Tables without a "
+          "fixture are empty.");
+
+namespace alphasql {
+
+using namespace zetasql;
+
+SimpleCatalog *ConstructCatalog(const google::protobuf::DescriptorPool *pool,
+                                TypeFactory *type_factory) {
+  auto catalog = new zetasql::SimpleCatalog("catalog", type_factory);
+  catalog->AddZetaSQLFunctions();
+  catalog->SetDescriptorPool(pool);
+  return catalog;
+}
+
+// Reports <status> as an error, located by its payload.
+void ReportError(const absl::Status &status) {
+  Report(MakeDiagnostic(Severity::kError, std::string(status.message()),
+                        status),
+         absl::StrCat("ERROR: ", status.ToString()), std::cerr);
+}
+
+// Reports that the file at <path> was not run since an upstream file failed.
+void ReportSkipped(const std::string &path) {
+  Report({Severity::kNote, "depends on a file that failed", path},
+         absl::StrCat("SKIPPED: ", path, " depends on a file that failed"),
+         std::cerr);
+}
+
+// Optional passes over every analyzed statement, null if disabled.
+struct StatementPasses {
+  ColumnLineage *lineage;
+  CostEstimator *estimator;
+  LintEngine *lint;
+  DuplicateSubqueryFinder *duplicates;
+  DeadCodeFinder *dead_code;
+  StatementProfiler *profiler;
+
+  // Cached files are not analyzed, so the cache can not be used with passes.
+  bool enabled() const {
+    return lineage != nullptr || estimator != nullptr || lint != nullptr ||
+           duplicates != nullptr || dead_code != nullptr ||
+           profiler != nullptr;
+  }
+};
+
+// State shared by the statements checked for one file.
+struct CheckContext {
+  const AnalyzerOptions &options;
+  LayeredCatalog *catalog;
+  std::ostream &out;
+  CheckCache *cache; // Not owned, null if caching is disabled.
+  const StatementPasses &passes;
+  const std::string path;
+  std::vector<std::string> temp_function_names;
+  std::vector<std::string> temp_table_names;
+  // DDL of the persistent functions, TVFs and procedures created.
+  std::vector<std::string> definitions;
+  // Time taken to parse the top-level statement being checked, if it was
+  // parsed on its own, for the profiler.
+  absl::Duration parse_time;
+};
+
+// Records the DDL of a definition, which is all a cache hit needs to replay
+// it.
+void AddDefinition(const std::string &sql, const ASTStatement *statement,
+                   LayeredCatalog::ObjectKind kind,
+                   const std::vector<std::string> &name_path, bool is_temp,
+                   CheckContext *context) {
+  if (context->cache == nullptr) {
+    return;
+  }
+  const auto range = statement->GetParseLocationRange();
+  const std::string ddl =
+      sql.substr(range.start().GetByteOffset(),
+                 range.end().GetByteOffset() - range.start().GetByteOffset());
+  context->cache->AddDefinition(kind, name_path, ddl, context->catalog);
+  if (!is_temp) {
+    context->definitions.push_back(ddl);
+  }
+}
+
+// Line and column where <statement> of <sql> starts, 1:1 if unknown.
+std::pair<int, int> StatementStart(const std::string &sql,
+                                   const ASTStatement *statement) {
+  const auto line_and_column =
+      ParseLocationTranslator(sql).GetLineAndColumnAfterTabExpansion(
+          statement->GetParseLocationRange().start());
+  if (!line_and_column.ok()) {
+    return {1, 1};
+  }
+  return line_and_column.value();
+}
+
+absl::Status check(const std::string &sql, const ASTStatement *statement,
+                   CheckContext *context) {
+  std::unique_ptr<const AnalyzerOutput> output;
+  const AnalyzerOptions &options = context->options;
+  LayeredCatalog *catalog = context->catalog;
+  std::ostream &out = context->out;
+
+  if (statement->node_kind() == AST_BEGIN_END_BLOCK) {
+    const ASTBeginEndBlock *stmt = statement->GetAs<ASTBeginEndBlock>();
+    for (const auto &body : stmt->statement_list_node()->statement_list()) {
+      ZETASQL_RETURN_IF_ERROR(check(sql, body, context));
+    }
+    if (stmt->handler_list() == nullptr) {
+      return absl::OkStatus();
+    }
+    for (const ASTExceptionHandler *handler :
+         stmt->handler_list()->exception_handler_list()) {
+      auto exception_handlers = handler->statement_list()->statement_list();
+      for (const auto &handler : exception_handlers) {
+        ZETASQL_RETURN_IF_ERROR(check(sql, handler, context));
+      }
+    }
+    return absl::OkStatus();
+  }
+
+  const StatementPasses &passes = context->passes;
+  const absl::Time start = absl::Now();
+  const int arena_blocks = options.arena()->block_count();
+  const auto status = AnalyzeStatementFromParserAST(
+      *statement, options, sql, catalog, catalog->type_factory(), &output);
+  if (passes.profiler != nullptr) {
+    const absl::Duration analysis_time = absl::Now() - start;
+    const auto [line, column] = StatementStart(sql, statement);
+    passes.profiler->AddStatement(
+        {context->path, line, column, statement->GetNodeKindString(),
+         context->parse_time, analysis_time,
+         status.ok() ? StatementProfiler::CountResolvedNodes(
+                           output->resolved_statement())
+                     : 0,
+         static_cast<int64_t>(options.arena()->block_count() -
+                              arena_blocks) *
+             static_cast<int64_t>(options.arena()->block_size())});
+    // Statements of blocks were parsed along with the block.
+    context->parse_time = absl::ZeroDuration();
+  }
+  if (!status.ok()) {
+    if (status.message().find("Statement not supported") == std::string::npos) {
+      return status;
+    }
+    Report(MakeDiagnostic(
+               Severity::kWarning,
+               absl::StrCat("check skipped with the error: ", status.message()),
+               status, context->path),
+           absl::StrCat("WARNING: check skipped with the error: ",
+                        status.ToString()),
+           out);
+    return absl::OkStatus();
+  }
+
+  auto resolved_statement = output->resolved_statement();
+  if (passes.lint != nullptr) {
+    std::vector<LintFinding> findings;
+    ZETASQL_RETURN_IF_ERROR(
+        passes.lint->Lint(sql, *statement, *resolved_statement, &findings));
+    for (const LintFinding &finding : findings) {
+      Report(MakeDiagnostic(Severity::kWarning,
+                            absl::StrCat("[", finding.rule, "] ",
+                                         finding.message),
+                            sql, finding.location, context->path),
+             absl::StrCat("WARNING: ",
+                          FormatLintFinding(finding, sql, context->path)),
+             out);
+    }
+    if (!findings.empty() && absl::GetFlag(FLAGS_warning_as_error)) {
+      return absl::InvalidArgumentError(
+          FormatLintFinding(findings.front(), sql, context->path));
+    }
+  }
+  if (passes.lineage != nullptr) {
+    ZETASQL_RETURN_IF_ERROR(
+        passes.lineage->AddStatement(context->path, resolved_statement));
+  }
+  if (passes.estimator != nullptr) {
+    ZETASQL_RETURN_IF_ERROR(
+        passes.estimator->AddStatement(context->path, resolved_statement));
+  }
+  if (passes.duplicates != nullptr) {
+    ZETASQL_RETURN_IF_ERROR(passes.duplicates->AddStatement(
+        context->path, sql, statement->GetParseLocationRange().start(),
+        resolved_statement));
+  }
+  if (passes.dead_code != nullptr) {
+    ZETASQL_RETURN_IF_ERROR(
+        passes.dead_code->AddStatement(context->path, resolved_statement));
+  }
+  switch (resolved_statement->node_kind()) {
+  case RESOLVED_CREATE_TABLE_STMT:
+  case RESOLVED_CREATE_TABLE_AS_SELECT_STMT: {
+    auto *create_table_stmt =
+        resolved_statement->GetAs<ResolvedCreateTableStmt>();
+    if (ShowProgress()) {
+      out << "DDL analyzed, adding table to catalog...\n";
+    }
+    std::string table_name = absl::StrJoin(create_table_stmt->name_path(), ".");
+    std::unique_ptr<zetasql::SimpleTable> table(
+        new zetasql::SimpleTable(table_name));
+    for (const auto &column_definition :
+         create_table_stmt->column_definition_list()) {
+      std::unique_ptr<zetasql::SimpleColumn> column(new SimpleColumn(
+          table_name, column_definition->column().name_id().ToString(),
+          column_definition->column().type()));
+      ZETASQL_RETURN_IF_ERROR(table->AddColumn(column.release(), false));
+    }
+    // Replaces the table if it already exists in json schema
+    catalog->AddOwnedTable(table.release());
+    if (create_table_stmt->create_scope() ==
+        ResolvedCreateStatement::CREATE_TEMP) {
+      context->temp_table_names.push_back(table_name);
+    }
+    break;
+  }
+  case RESOLVED_CREATE_FUNCTION_STMT: {
+    auto *create_function_stmt =
+        resolved_statement->GetAs<ResolvedCreateFunctionStmt>();
+    if (ShowProgress()) {
+      out << "Create Function Statement analyzed, adding function to "
+             "catalog...\n";
+    }
+    std::string function_name =
+        absl::StrJoin(create_function_stmt->name_path(), ".");
+    if (create_function_stmt->signature().IsTemplated() &&
+        absl::GetFlag(FLAGS_cache_templated_functions) &&
+        !create_function_stmt->is_aggregate()) {
+      catalog->AddOwnedFunction(new CachingTemplatedSQLFunction(
+          function_name, create_function_stmt->signature(),
+          create_function_stmt->argument_name_list(),
+          create_function_stmt->code()));
+    } else if (create_function_stmt->signature().IsTemplated()) {
+      TemplatedSQLFunction *function;
+      function = new TemplatedSQLFunction(
+        create_function_stmt->name_path(),
+        create_function_stmt->signature(),
+        create_function_stmt->argument_name_list(),
+        ParseResumeLocation::FromString(create_function_stmt->code()));
+      catalog->AddOwnedFunction(function);
+    } else {
+      Function *function = new Function(function_name, "group", Function::SCALAR);
+      function->AddSignature(create_function_stmt->signature());
+      catalog->AddOwnedFunction(function);
+    }
+    const bool is_temp = create_function_stmt->create_scope() ==
+                         ResolvedCreateStatement::CREATE_TEMP;
+    if (is_temp) {
+      context->temp_function_names.push_back(function_name);
+    }
+    AddDefinition(sql, statement, LayeredCatalog::ObjectKind::kFunction,
+                  create_function_stmt->name_path(), is_temp, context);
+    break;
+  }
+  case RESOLVED_CREATE_TABLE_FUNCTION_STMT: {
+    auto *create_table_function_stmt =
+        resolved_statement->GetAs<ResolvedCreateTableFunctionStmt>();
+    if (ShowProgress()) {
+      out << "Create Table Function Statement analyzed, adding function to "
+             "catalog...\n";
+    }
+    if (absl::GetFlag(FLAGS_cache_templated_functions)) {
+      catalog->AddOwnedTableValuedFunction(new CachingTemplatedSQLTVF(
+          create_table_function_stmt->name_path(),
+          create_table_function_stmt->signature(),
+          create_table_function_stmt->argument_name_list(),
+          ParseResumeLocation::FromString(create_table_function_stmt->code())));
+    } else {
+      catalog->AddOwnedTableValuedFunction(new TemplatedSQLTVF(
+        create_table_function_stmt->name_path(),
+        create_table_function_stmt->signature(),
+        create_table_function_stmt->argument_name_list(),
+        ParseResumeLocation::FromString(create_table_function_stmt->code())));
+    }
+    AddDefinition(sql, statement,
+                  LayeredCatalog::ObjectKind::kTableValuedFunction,
+                  create_table_function_stmt->name_path(),
+                  create_table_function_stmt->create_scope() ==
+                      ResolvedCreateStatement::CREATE_TEMP,
+                  context);
+    break;
+  }
+  // Procedures stay in the catalog once created, since DROP statements only
+  // drop tables.
+  case RESOLVED_CREATE_PROCEDURE_STMT: {
+    auto *create_procedure_stmt =
+        resolved_statement->GetAs<ResolvedCreateProcedureStmt>();
+    if (ShowProgress()) {
+      out << "Create Procedure Statement analyzed, adding function to "
+             "catalog...\n";
+    }
+    catalog->AddOwnedProcedure(new SQLProcedure(
+        create_procedure_stmt->name_path(), create_procedure_stmt->signature(),
+        create_procedure_stmt->procedure_body()));
+    AddDefinition(sql, statement, LayeredCatalog::ObjectKind::kProcedure,
+                  create_procedure_stmt->name_path(), /*is_temp=*/false,
+                  context);
+    // BigQuery has no temporary procedures, so the procedure outlives the
+    // file.
+    break;
+  }
+  case RESOLVED_CALL_STMT: {
+    auto *call_stmt =
+        resolved_statement->GetAs<ResolvedCallStmt>();
+    if (ShowProgress()) {
+      out << "Call Procedure Statement analyzed, checking body...\n";
+    }
+    const ProcedureBody *body = SQLProcedure::BodyOf(call_stmt->procedure());
+    if (body == nullptr) {
+      break;
+    }
+    // Parsed once per procedure, however many times it is called.
+    const ASTScript *script;
+    ZETASQL_RETURN_IF_ERROR(body->GetScript(
+          options.language(), options.error_message_mode(), &script));
+    for (const auto *statement : script->statement_list_node()->statement_list()) {
+      ZETASQL_RETURN_IF_ERROR(check(
+          body->sql(),
+          statement,
+          context
+      ));
+    }
+    break;
+  }
+  case RESOLVED_DROP_STMT: {
+    auto *drop_stmt = resolved_statement->GetAs<ResolvedDropStmt>();
+    if (ShowProgress()) {
+      out << "Drop Statement analyzed, dropping table from catalog...\n";
+    }
+    std::string table_name = absl::StrJoin(drop_stmt->name_path(), ".");
+    ZETASQL_RETURN_IF_ERROR(
+        catalog->DropTable(table_name, drop_stmt->is_if_exists()));
+    break;
+  }
+  }
+
+  return absl::OkStatus();
+}
+
+// Replays the catalog updates of a cache entry instead of analyzing the file.
+absl::Status Replay(const CheckCacheEntry &entry, CheckContext *context) {
+  LayeredCatalog *catalog = context->catalog;
+  for (const CachedTable &cached_table : entry.tables()) {
+    if (cached_table.dropped()) {
+      ZETASQL_RETURN_IF_ERROR(
+          catalog->DropTable(cached_table.name(), /*if_exists=*/true));
+      continue;
+    }
+    std::unique_ptr<zetasql::SimpleTable> table(
+        new zetasql::SimpleTable(cached_table.name()));
+    for (const CachedColumn &cached_column : cached_table.columns()) {
+      const Type *type;
+      ZETASQL_RETURN_IF_ERROR(AnalyzeType(cached_column.type(), context->options,
+                                          catalog, catalog->type_factory(),
+                                          &type));
+      std::unique_ptr<zetasql::SimpleColumn> column(new SimpleColumn(
+          cached_table.name(), cached_column.name(), type));
+      ZETASQL_RETURN_IF_ERROR(table->AddColumn(column.release(), false));
+    }
+    catalog->AddOwnedTable(table.release());
+  }
+  // Only the definitions themselves are analyzed again.
+  for (const std::string &definition : entry.definitions()) {
+    std::unique_ptr<ParserOutput> parser_output;
+    ZETASQL_RETURN_IF_ERROR(zetasql::ParseScript(
+        definition, context->options.GetParserOptions(),
+        context->options.error_message_mode(), &parser_output));
+    for (const ASTStatement *statement :
+         parser_output->script()->statement_list_node()->statement_list()) {
+      ZETASQL_RETURN_IF_ERROR(check(definition, statement, context));
+    }
+  }
+  for (const std::string &function_name : entry.dropped_functions()) {
+    const Function *function;
+    if (catalog->FindFunction({function_name}, &function).ok()) {
+      ZETASQL_RETURN_IF_ERROR(catalog->DropFunction(function_name));
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Runs the tool.
+absl::Status Run(const std::string &sql_file_path, SQLFile *sql_file,
+                 const AnalyzerOptions &options, LayeredCatalog *catalog,
+                 CheckCache *cache, const StatementPasses &passes,
+                 std::ostream &out) {
+  std::filesystem::path file_path(sql_file_path);
+  if (ShowProgress()) {
+    out << "Analyzing " << file_path << '\n';
+  }
+  SQLFile read_file;
+  if (sql_file == nullptr) {
+    ReadSQLFile(sql_file_path, &read_file);
+    sql_file = &read_file;
+  }
+  const std::string &sql = sql_file->sql;
+
+  CheckContext context{options, catalog, out, cache, passes, sql_file_path};
+  CheckCache::Dependencies dependencies;
+  if (cache != nullptr) {
+    CheckCacheEntry entry;
+    if (!passes.enabled() &&
+        cache->Lookup(sql_file_path, sql, catalog->parent(), &entry)) {
+      if (ShowProgress()) {
+        out << "Cached analysis is up to date, replaying catalog updates...\n";
+      }
+      return Replay(entry, &context);
+    }
+    catalog->set_miss_listener(
+        [&dependencies](LayeredCatalog::ObjectKind kind,
+                        const std::string &key) {
+          dependencies.emplace(kind, key);
+        });
+  }
+
+  if (!absl::GetFlag(FLAGS_stream_statements) &&
+      sql_file->parser_output == nullptr) {
+    const absl::Time start = absl::Now();
+    ZETASQL_RETURN_IF_ERROR(ParseSQLFile(options, sql_file));
+    if (passes.profiler != nullptr) {
+      passes.profiler->AddScriptParse(sql_file_path, absl::Now() - start);
+    }
+  }
+  // Statements streamed one at a time are parsed between two callbacks.
+  const bool streamed = sql_file->parser_output == nullptr;
+  absl::Time parse_start = absl::Now();
+  ZETASQL_RETURN_IF_ERROR(ForEachStatement(
+      options, *sql_file,
+      [&sql, &context, streamed, &parse_start](const ASTStatement *statement) {
+        if (streamed && context.passes.profiler != nullptr) {
+          context.parse_time = absl::Now() - parse_start;
+        }
+        const absl::Status status = check(sql, statement, &context);
+        parse_start = absl::Now();
+        return status;
+      }));
+
+  for (const auto &table_name : context.temp_table_names) {
+    if (ShowProgress()) {
+      out << "Removing temporary table " << table_name << '\n';
+    }
+    ZETASQL_RETURN_IF_ERROR(catalog->DropTable(table_name, /*if_exists=*/true));
+  }
+
+  for (const auto &function_name : context.temp_function_names) {
+    if (ShowProgress()) {
+      out << "Removing temporary function " << function_name << '\n';
+    }
+    ZETASQL_RETURN_IF_ERROR(catalog->DropFunction(function_name));
+  }
+
+  if (cache != nullptr) {
+    catalog->set_miss_listener(nullptr);
+    const auto status =
+        cache->Store(sql_file_path, sql, dependencies, *catalog,
+                     context.definitions, context.temp_function_names);
+    if (!status.ok()) {
+      Report(MakeDiagnostic(Severity::kWarning,
+                            absl::StrCat("analysis cache not updated: ",
+                                         status.message()),
+                            absl::OkStatus(), sql_file_path),
+             absl::StrCat("WARNING: analysis cache not updated: ",
+                          status.ToString()),
+             out);
+    }
+  }
+
+  return absl::OkStatus();
+}
+
+// Options of the analyzer shared by checked and executed files.
+zetasql::AnalyzerOptions MakeAnalyzerOptions() {
+  zetasql::LanguageOptions language_options;
+  language_options.EnableMaximumLanguageFeaturesForDevelopment();
+  language_options.SetEnabledLanguageFeatures(
+      {zetasql::FEATURE_V_1_3_ALLOW_DASHES_IN_TABLE_NAME});
+  language_options.SetSupportsAllStatementKinds();
+  zetasql::AnalyzerOptions options(language_options);
+  options.mutable_language()->EnableMaximumLanguageFeaturesForDevelopment();
+  return options;
+}
+
+// Arenas are not thread-safe, so every file gets its own.
+zetasql::AnalyzerOptions
+FileAnalyzerOptions(const zetasql::AnalyzerOptions &options) {
+  zetasql::AnalyzerOptions file_options = options;
+  file_options.set_arena(nullptr);
+  file_options.set_id_string_pool(nullptr);
+  file_options.CreateDefaultArenasIfNotSet();
+  return file_options;
+}
+
+SQLFile *FindSQLFile(std::map<std::string, std::unique_ptr<SQLFile>> *sql_files,
+                     const std::string &sql_file_path) {
+  if (sql_files == nullptr) {
+    return nullptr;
+  }
+  const auto it = sql_files->find(sql_file_path);
+  return it != sql_files->end() ? it->second.get() : nullptr;
+}
+
+int CheckExecutionPlan(
+    const std::vector<std::string> &execution_plan,
+    const std::vector<std::vector<size_t>> &upstreams,
+    std::map<std::string, std::unique_ptr<SQLFile>> *sql_files) {
+  ScopedAllocationPhase check_phase(AllocationPhase::kCheck);
+  const google::protobuf::DescriptorPool &pool =
+      *google::protobuf::DescriptorPool::generated_pool();
+  zetasql::TypeFactory type_factory;
+  auto catalog = ConstructCatalog(&pool, &type_factory);
+  // External tables live in their own layer, and tables and functions created
+  // by checked files are published to layers above it, one per file, so that
+  // each file only sees what its upstream files created.
+  LayeredCatalog schema_layer("catalog", catalog, &type_factory);
+  const std::string json_schema_path = absl::GetFlag(FLAGS_json_schema_path);
+  if (!json_schema_path.empty()) {
+    ScopedAllocationPhase schema_load_phase(AllocationPhase::kSchemaLoad);
+    UpdateCatalogFromJSON(json_schema_path, &schema_layer, &type_factory);
+  }
+  UpstreamLayers published_layers(upstreams, &schema_layer);
+
+  zetasql::AnalyzerOptions options = MakeAnalyzerOptions();
+
+  const int jobs = absl::GetFlag(FLAGS_jobs);
+  const bool keep_going = absl::GetFlag(FLAGS_keep_going);
+  std::unique_ptr<CheckCache> cache;
+  const std::string cache_dir = absl::GetFlag(FLAGS_cache_dir);
+  if (!cache_dir.empty()) {
+    cache = absl::make_unique<CheckCache>(cache_dir);
+  }
+  std::unique_ptr<ColumnLineage> lineage;
+  const std::string column_lineage_output_path =
+      absl::GetFlag(FLAGS_column_lineage_output_path);
+  if (!column_lineage_output_path.empty()) {
+    lineage = absl::make_unique<ColumnLineage>();
+  }
+  std::unique_ptr<CostEstimator> estimator;
+  const std::string table_stats_path = absl::GetFlag(FLAGS_table_stats_path);
+  if (!table_stats_path.empty()) {
+    estimator = absl::make_unique<CostEstimator>();
+    const absl::Status status = estimator->ReadStats(table_stats_path);
+    if (!status.ok()) {
+      ReportError(status);
+      return 1;
+    }
+  }
+  std::unique_ptr<LintEngine> lint;
+  const std::string lint_rules = absl::GetFlag(FLAGS_lint_rules);
+  if (!lint_rules.empty()) {
+    std::vector<std::unique_ptr<LintRule>> rules;
+    const absl::Status status = MakeLintRules(lint_rules, &rules);
+    if (!status.ok()) {
+      ReportError(status);
+      return 1;
+    }
+    lint = absl::make_unique<LintEngine>(estimator.get());
+    for (auto &rule : rules) {
+      lint->AddRule(std::move(rule));
+    }
+  }
+  std::unique_ptr<DuplicateSubqueryFinder> duplicates;
+  if (absl::GetFlag(FLAGS_duplicate_subqueries)) {
+    duplicates = absl::make_unique<DuplicateSubqueryFinder>(estimator.get());
+  }
+  std::unique_ptr<DeadCodeFinder> dead_code;
+  if (absl::GetFlag(FLAGS_dead_code)) {
+    dead_code = absl::make_unique<DeadCodeFinder>(estimator.get());
+  }
+  std::unique_ptr<StatementProfiler> profiler;
+  const std::string profile_output_path =
+      absl::GetFlag(FLAGS_profile_output_path);
+  if (absl::GetFlag(FLAGS_profile) || !profile_output_path.empty()) {
+    profiler = absl::make_unique<StatementProfiler>();
+  }
+  if (absl::GetFlag(FLAGS_cache_templated_functions) &&
+      (lineage != nullptr || estimator != nullptr || lint != nullptr ||
+       duplicates != nullptr || dead_code != nullptr)) {
+    // Calls only carry the tables read in function bodies when the bodies
+    // are resolved for each call, and these passes would miss them.
+    ReportError(absl::InvalidArgumentError(
+        "--cache_templated_functions can not be combined with "
+        "--column_lineage_output_path, --table_stats_path, --lint_rules, "
+        "--duplicate_subqueries or --dead_code"));
+    return 1;
+  }
+  const StatementPasses passes{lineage.get(),   estimator.get(),
+                               lint.get(),      duplicates.get(),
+                               dead_code.get(), profiler.get()};
+  if (estimator != nullptr || lint != nullptr || dead_code != nullptr) {
+    // Only referenced columns are billed, and rules and dead code look at
+    // what is read.
+    options.set_prune_unused_columns(true);
+  }
+  if (duplicates != nullptr) {
+    // Duplicates are reported where each fragment is written.
+    options.set_record_parse_locations(true);
+  }
+
+  std::unique_ptr<TableEvictor> evictor;
+  if (absl::GetFlag(FLAGS_evict_tables)) {
+    evictor = absl::make_unique<TableEvictor>(upstreams, &published_layers);
+  }
+
+  // Each file is checked in its own layer, which is committed to the
+  // published layer of the file once the file passed.
+  std::mutex output_mutex;
+  auto check_file = [&](size_t i) {
+    const std::string &sql_file_path = execution_plan[i];
+    const zetasql::AnalyzerOptions file_options = FileAnalyzerOptions(options);
+    LayeredCatalog file_layer(published_layers.layer(i));
+
+    // With a single job output is streamed as before, otherwise the output of
+    // each file is flushed at once so that files do not interleave.
+    std::ostringstream buffer;
+    std::ostream &out = jobs > 1 ? buffer : std::cout;
+    SQLFile *sql_file = FindSQLFile(sql_files, sql_file_path);
+    absl::Status status =
+        Run(sql_file_path, sql_file, file_options, &file_layer, cache.get(),
+            passes, out);
+
+    std::lock_guard<std::mutex> lock(output_mutex);
+    if (status.ok()) {
+      if (evictor != nullptr) {
+        evictor->AddFile(i, file_layer);
+      }
+      file_layer.Commit();
+      published_layers.Publish(i);
+      if (evictor != nullptr) {
+        evictor->FinishFile(i);
+      }
+      if (ShowProgress()) {
+        out << "SUCCESS: analysis finished!\n";
+      }
+      std::cout << buffer.str();
+      return true;
+    }
+    status = zetasql::UpdateErrorLocationPayloadWithFilenameIfNotPresent(
+        status, sql_file_path);
+    ReportError(status);
+    out << "tables:\n";
+    // For deterministic output
+    auto table_names = file_layer.table_names();
+    std::sort(table_names.begin(), table_names.end());
+    for (const std::string &table_name : table_names) {
+      out << "\t" << table_name << '\n';
+    }
+    // Too many outputs
+    /* auto function_names = catalog->function_names(); */
+    /* std::sort(function_names.begin(), function_names.end()); */
+    /* for (const std::string &function_name : function_names) { */
+    /*   std::cout << "\t" << function_name << '\n'; */
+    /* } */
+    out << "tvfs:\n";
+    auto table_function_names = file_layer.table_valued_function_names();
+    std::sort(table_function_names.begin(), table_function_names.end());
+    for (const std::string &table_function_name : table_function_names) {
+      out << "\t" << table_function_name << '\n';
+    }
+    if (evictor != nullptr) {
+      evictor->FinishFile(i);
+    }
+    std::cout << buffer.str();
+    return false;
+  };
+
+  const auto states =
+      RunDAG(upstreams, check_file, jobs, keep_going);
+
+  bool failed = false;
+  for (size_t i = 0; i < states.size(); ++i) {
+    if (states[i] == TaskState::kFailed) {
+      failed = true;
+    } else if (states[i] == TaskState::kSkipped) {
+      ReportSkipped(execution_plan[i]);
+    }
+  }
+  if (failed) {
+    return 1;
+  }
+
+  ScopedAllocationPhase output_phase(AllocationPhase::kOutput);
+  if (lineage != nullptr && !lineage->WriteGraph(column_lineage_output_path)) {
+    Report({Severity::kError, "can not write column lineage",
+            column_lineage_output_path},
+           absl::StrCat("ERROR: can not write column lineage to ",
+                        column_lineage_output_path),
+           std::cerr);
+    return 1;
+  }
+
+  if (estimator != nullptr) {
+    std::cout << "Estimated bytes scanned:\n";
+    int64_t total_bytes = 0;
+    std::set<std::string> unknown_tables;
+    for (const std::string &sql_file_path : execution_plan) {
+      const CostEstimate estimate = estimator->Estimate(sql_file_path);
+      std::cout << "\t" << sql_file_path << ": " << estimate.bytes_scanned
+                << " bytes\n";
+      total_bytes += estimate.bytes_scanned;
+      unknown_tables.insert(estimate.unknown_tables.begin(),
+                            estimate.unknown_tables.end());
+    }
+    std::cout << "\ttotal: " << total_bytes << " bytes\n";
+    if (!unknown_tables.empty()) {
+      const std::string message =
+          absl::StrCat("no statistics for ",
+                       absl::StrJoin(unknown_tables, ", "),
+                       ", counted as empty");
+      Report({Severity::kWarning, message, table_stats_path},
+             absl::StrCat("WARNING: ", message), std::cout);
+    }
+  }
+
+  if (duplicates != nullptr) {
+    std::cout << "Duplicate subqueries:\n";
+    for (const DuplicateFragment &duplicate : duplicates->Duplicates()) {
+      std::cout << "\t" << duplicate.occurrences.size() << " occurrences in "
+                << duplicate.files << " files, " << duplicate.bytes_scanned
+                << " bytes scanned, " << duplicate.size << " nodes:\n";
+      for (const FragmentOccurrence &occurrence : duplicate.occurrences) {
+        std::cout << "\t\t" << occurrence.path << ":" << occurrence.line
+                  << ":" << occurrence.column << '\n';
+      }
+    }
+  }
+
+  if (dead_code != nullptr) {
+    auto print_dead_code = [](const DeadCode &dead) {
+      std::cout << "\t" << dead.table_name;
+      if (!dead.column_name.empty()) {
+        std::cout << "." << dead.column_name;
+      }
+      std::cout << " created by " << dead.path;
+      if (dead.bytes >= 0) {
+        std::cout << ": " << dead.bytes << " bytes";
+      }
+      std::cout << '\n';
+    };
+    std::cout << "Dead tables:\n";
+    for (const DeadCode &dead : dead_code->DeadTables()) {
+      print_dead_code(dead);
+    }
+    std::cout << "Dead columns:\n";
+    for (const DeadCode &dead : dead_code->DeadColumns()) {
+      print_dead_code(dead);
+    }
+  }
+
+  if (profiler != nullptr) {
+    const ProfileSummary summary = profiler->Summary();
+    std::cout << "Profile: " << summary.statements << " statements, parse "
+              << absl::ToInt64Milliseconds(summary.parse_time)
+              << " ms, analysis "
+              << absl::ToInt64Milliseconds(summary.analysis_time) << " ms\n";
+    std::cout << "Slowest statements:\n";
+    for (const StatementProfile &statement :
+         profiler->Slowest(std::max(absl::GetFlag(FLAGS_profile_top_n), 0))) {
+      std::cout << "\t" << statement.path << ":" << statement.line << ":"
+                << statement.column << " " << statement.kind << ": "
+                << absl::ToDoubleMilliseconds(statement.parse_time +
+                                              statement.analysis_time)
+                << " ms (parse "
+                << absl::ToDoubleMilliseconds(statement.parse_time)
+                << " ms), " << statement.resolved_nodes
+                << " resolved nodes, " << statement.arena_bytes
+                << " arena bytes\n";
+    }
+    if (!profile_output_path.empty() &&
+        !profiler->WriteCSV(profile_output_path)) {
+      Report({Severity::kError, "can not write profile", profile_output_path},
+             absl::StrCat("ERROR: can not write profile to ",
+                          profile_output_path),
+             std::cerr);
+      return 1;
+    }
+  }
+
+  std::cout << "Successfully finished type check!\n";
+  return 0;
+}
+
+int ExecuteExecutionPlan(
+    const std::vector<std::string> &execution_plan,
+    const std::vector<std::vector<size_t>> &upstreams,
+    std::map<std::string, std::unique_ptr<SQLFile>> *sql_files) {
+  ScopedAllocationPhase check_phase(AllocationPhase::kCheck);
+  const google::protobuf::DescriptorPool &pool =
+      *google::protobuf::DescriptorPool::generated_pool();
+  zetasql::TypeFactory type_factory;
+  auto catalog = ConstructCatalog(&pool, &type_factory);
+  const zetasql::AnalyzerOptions options = MakeAnalyzerOptions();
+  LayeredCatalog schema_layer("catalog", catalog, &type_factory);
+  const std::string json_schema_path = absl::GetFlag(FLAGS_json_schema_path);
+  absl::Status fixture_status;
+  {
+    ScopedAllocationPhase schema_load_phase(AllocationPhase::kSchemaLoad);
+    if (!json_schema_path.empty()) {
+      UpdateCatalogFromJSON(json_schema_path, &schema_layer, &type_factory);
+    }
+    fixture_status = LoadFixtures(absl::GetFlag(FLAGS_fixture_dir),
+                                  options.language(), &schema_layer);
+  }
+  if (!fixture_status.ok()) {
+    ReportError(fixture_status);
+    return 1;
+  }
+  UpstreamLayers published_layers(upstreams, &schema_layer);
+  std::unique_ptr<TableEvictor> evictor;
+  if (absl::GetFlag(FLAGS_evict_tables)) {
+    evictor = absl::make_unique<TableEvictor>(upstreams, &published_layers);
+  }
+
+  const int jobs = absl::GetFlag(FLAGS_jobs);
+  std::vector<ExecutionStats> stats(execution_plan.size());
+  std::mutex output_mutex;
+  auto execute_file = [&](size_t i) {
+    const std::string &sql_file_path = execution_plan[i];
+    const zetasql::AnalyzerOptions file_options = FileAnalyzerOptions(options);
+    LayeredCatalog file_layer(published_layers.layer(i));
+
+    std::ostringstream buffer;
+    std::ostream &out = jobs > 1 ? buffer : std::cout;
+    if (ShowProgress()) {
+      out << "Executing " << std::filesystem::path(sql_file_path) << '\n';
+    }
+    SQLFile read_file;
+    SQLFile *sql_file = FindSQLFile(sql_files, sql_file_path);
+    if (sql_file == nullptr) {
+      ReadSQLFile(sql_file_path, &read_file);
+      sql_file = &read_file;
+    }
+    const absl::Time start = absl::Now();
+    absl::Status status = ParseSQLFile(file_options, sql_file);
+    if (status.ok()) {
+      status = ExecuteScript(sql_file_path, sql_file->sql,
+                             *sql_file->parser_output->script(), file_options,
+                             absl::GetFlag(FLAGS_warning_as_error),
+                             &file_layer, out, &stats[i]);
+    }
+    stats[i].runtime = absl::Now() - start;
+
+    std::lock_guard<std::mutex> lock(output_mutex);
+    if (status.ok()) {
+      if (evictor != nullptr) {
+        evictor->AddFile(i, file_layer);
+      }
+      file_layer.Commit();
+      published_layers.Publish(i);
+      if (evictor != nullptr) {
+        evictor->FinishFile(i);
+      }
+      if (ShowProgress()) {
+        out << "SUCCESS: execution finished in "
+            << absl::ToInt64Milliseconds(stats[i].runtime) << " ms!\n";
+      }
+      std::cout << buffer.str();
+      return true;
+    }
+    status = zetasql::UpdateErrorLocationPayloadWithFilenameIfNotPresent(
+        status, sql_file_path);
+    ReportError(status);
+    if (evictor != nullptr) {
+      evictor->FinishFile(i);
+    }
+    std::cout << buffer.str();
+    return false;
+  };
+
+  const auto states =
+      RunDAG(upstreams, execute_file, jobs, absl::GetFlag(FLAGS_keep_going));
+
+  ScopedAllocationPhase output_phase(AllocationPhase::kOutput);
+  std::cout << "Execution summary:\n";
+  bool failed = false;
+  for (size_t i = 0; i < states.size(); ++i) {
+    switch (states[i]) {
+    case TaskState::kSucceeded:
+      std::cout << "\t" << execution_plan[i] << ": "
+                << absl::ToInt64Milliseconds(stats[i].runtime) << " ms, "
+                << stats[i].rows_returned << " rows returned, "
+                << stats[i].rows_written << " rows written";
+      if (stats[i].statements_skipped > 0) {
+        std::cout << ", " << stats[i].statements_skipped
+                  << " statements skipped";
+      }
+      std::cout << '\n';
+      break;
+    case TaskState::kFailed:
+      failed = true;
+      std::cout << "\t" << execution_plan[i] << ": failed\n";
+      break;
+    case TaskState::kSkipped:
+      ReportSkipped(execution_plan[i]);
+      break;
+    case TaskState::kNotRun:
+      break;
+    }
+  }
+  if (failed) {
+    return 1;
+  }
+
+  std::cout << "Successfully finished execution!\n";
+  return 0;
+}
+
+} // namespace alphasql
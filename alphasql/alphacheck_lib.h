@@ -0,0 +1,74 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_ALPHACHECK_LIB_H_
+#define ALPHASQL_ALPHACHECK_LIB_H_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/flags/declare.h"
+#include "alphasql/sql_file.h"
+#include "google/protobuf/descriptor.h"
+#include "zetasql/public/simple_catalog.h"
+#include "zetasql/public/types/type_factory.h"
+
+ABSL_DECLARE_FLAG(std::string, json_schema_path);
+ABSL_DECLARE_FLAG(int, jobs);
+ABSL_DECLARE_FLAG(bool, keep_going);
+ABSL_DECLARE_FLAG(bool, evict_tables);
+ABSL_DECLARE_FLAG(std::string, cache_dir);
+ABSL_DECLARE_FLAG(std::string, column_lineage_output_path);
+ABSL_DECLARE_FLAG(std::string, table_stats_path);
+ABSL_DECLARE_FLAG(std::string, lint_rules);
+ABSL_DECLARE_FLAG(bool, duplicate_subqueries);
+ABSL_DECLARE_FLAG(bool, dead_code);
+ABSL_DECLARE_FLAG(bool, profile);
+ABSL_DECLARE_FLAG(int, profile_top_n);
+ABSL_DECLARE_FLAG(std::string, profile_output_path);
+ABSL_DECLARE_FLAG(bool, cache_templated_functions);
+ABSL_DECLARE_FLAG(bool, execute);
+ABSL_DECLARE_FLAG(std::string, fixture_dir);
+
+namespace alphasql {
+
+// Constructs the base catalog holding builtin functions and proto types.
+zetasql::SimpleCatalog *
+ConstructCatalog(const google::protobuf::DescriptorPool *pool,
+                 zetasql::TypeFactory *type_factory);
+
+// Type checks the files of <execution_plan>, each after its <upstreams>
+// passed, printing the progress, and returns the exit code of alphacheck.
+// Files found in <sql_files> are checked without reading and parsing them
+// again; others are read from disk. <sql_files> may be null.
+int CheckExecutionPlan(
+    const std::vector<std::string> &execution_plan,
+    const std::vector<std::vector<size_t>> &upstreams,
+    std::map<std::string, std::unique_ptr<SQLFile>> *sql_files);
+
+// Like CheckExecutionPlan, but executes the files with the reference
+// evaluator over the fixtures in --fixture_dir, and prints the runtime and
+// row counts of each file at the end.
+int ExecuteExecutionPlan(
+    const std::vector<std::string> &execution_plan,
+    const std::vector<std::vector<size_t>> &upstreams,
+    std::map<std::string, std::unique_ptr<SQLFile>> *sql_files);
+
+} // namespace alphasql
+
+#endif // ALPHASQL_ALPHACHECK_LIB_H_
@@ -0,0 +1,87 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "alphasql/alphacheck_lib.h"
+#include "alphasql/dag_lib.h"
+#include "alphasql/execution_plan.h"
+
+// Extracts the DAG from SQL files and type checks them in one process, so
+// that each file is read and parsed only once and no DOT file is needed in
+// between. The DAG and external required tables are still written when their
+// output paths are given.
+int main(int argc, char *argv[]) {
+  const char kUsage[] =
+      "Usage: alphasql [--with_tables] [--with_functions] "
+      "[--side_effect_first] [--external_required_tables_output_path "
+      "<filename>] [--output_path <filename>] "
+      "[--json_schema_path=<path_to.json>] [--jobs=<n>] [--keep_going] "
+      "[--evict_tables] [--stream_statements] "
+      "[--statement_cache_dir=<dir>] [--cache_dir=<dir>] [--quiet] "
+      "[--diagnostics_format=text|json|sarif] [--allocation_report] "
+      "[--column_lineage_output_path=<path>] "
+      "[--table_stats_path=<path_to.json>] [--lint_rules=<all or rules>] "
+      "[--duplicate_subqueries] [--dead_code] "
+      "[--profile [--profile_top_n=<n>]] "
+      "[--profile_output_path=<path>] [--cache_templated_functions] "
+      "[--execute [--fixture_dir=<dir>]] "
+      "<directory or file paths of sql...>\n";
+  std::vector<char *> args = absl::ParseCommandLine(argc, argv);
+  if (argc <= 1) {
+    std::cerr << kUsage;
+    return 1;
+  }
+  if (const absl::Status status = alphasql::InitDiagnostics("alphasql");
+      !status.ok()) {
+    std::cerr << status << std::endl;
+    return 1;
+  }
+  alphasql::InitAllocationReport();
+  std::vector<char *> remaining_args(args.begin() + 1, args.end());
+
+  // Unlike alphadag, nothing is printed unless asked for.
+  alphasql::DAGGraph g;
+  std::map<std::string, std::unique_ptr<alphasql::SQLFile>> sql_files;
+  if (const int code = alphasql::ExtractDAG(
+          remaining_args, /*write_to_stdout=*/false, &g, &sql_files);
+      code != 0) {
+    return code;
+  }
+
+  if (alphasql::HasCycle(g)) {
+    alphasql::Report({alphasql::Severity::kError, "cycle detected"},
+                     "ERROR: cycle detected!", std::cerr);
+    return 1;
+  }
+
+  std::vector<std::string> execution_plan;
+  std::vector<std::vector<size_t>> upstreams;
+  {
+    alphasql::ScopedAllocationPhase phase(alphasql::AllocationPhase::kGraph);
+    alphasql::GetExecutionPlan(g, &execution_plan, &upstreams);
+  }
+  if (absl::GetFlag(FLAGS_execute)) {
+    return alphasql::ExecuteExecutionPlan(execution_plan, upstreams,
+                                          &sql_files);
+  }
+  return alphasql::CheckExecutionPlan(execution_plan, upstreams, &sql_files);
+}
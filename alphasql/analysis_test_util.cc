@@ -0,0 +1,67 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "alphasql/analysis_test_util.h"
+
+#include "zetasql/public/parse_resume_location.h"
+#include "zetasql/public/templated_sql_function.h"
+#include "zetasql/public/templated_sql_tvf.h"
+
+namespace alphasql {
+
+using namespace zetasql;
+
+AnalysisTest::AnalysisTest() : catalog_("catalog", &type_factory_) {
+  catalog_.AddZetaSQLFunctions();
+  options_.mutable_language()->EnableMaximumLanguageFeaturesForDevelopment();
+  options_.mutable_language()->SetSupportsAllStatementKinds();
+  options_.set_prune_unused_columns(true);
+  AddTable("a", {"x", "y"});
+  AddTable("b", {"x", "y"});
+}
+
+void AnalysisTest::AddTable(const std::string &name,
+                            const std::vector<std::string> &column_names) {
+  std::vector<SimpleTable::NameAndType> columns;
+  for (const std::string &column_name : column_names) {
+    columns.emplace_back(column_name, type_factory_.get_int64());
+  }
+  catalog_.AddOwnedTable(new SimpleTable(name, columns));
+}
+
+std::unique_ptr<const AnalyzerOutput>
+AnalysisTest::Analyze(const std::string &sql) {
+  std::unique_ptr<const AnalyzerOutput> output;
+  const absl::Status status =
+      AnalyzeStatement(sql, options_, &catalog_, &type_factory_, &output);
+  EXPECT_TRUE(status.ok()) << status;
+  return output;
+}
+
+void AnalysisTest::AddFunction(const ResolvedStatement *statement) {
+  if (statement->node_kind() == RESOLVED_CREATE_FUNCTION_STMT) {
+    const auto *stmt = statement->GetAs<ResolvedCreateFunctionStmt>();
+    catalog_.AddOwnedFunction(new TemplatedSQLFunction(
+        stmt->name_path(), stmt->signature(), stmt->argument_name_list(),
+        ParseResumeLocation::FromString(stmt->code())));
+  } else if (statement->node_kind() == RESOLVED_CREATE_TABLE_FUNCTION_STMT) {
+    const auto *stmt = statement->GetAs<ResolvedCreateTableFunctionStmt>();
+    catalog_.AddOwnedTableValuedFunction(new TemplatedSQLTVF(
+        stmt->name_path(), stmt->signature(), stmt->argument_name_list(),
+        ParseResumeLocation::FromString(stmt->code())));
+  }
+}
+
+} // namespace alphasql
@@ -0,0 +1,60 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef ALPHASQL_ANALYSIS_TEST_UTIL_H_
+#define ALPHASQL_ANALYSIS_TEST_UTIL_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "zetasql/public/analyzer.h"
+#include "zetasql/public/simple_catalog.h"
+#include "zetasql/public/types/type_factory.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+
+namespace alphasql {
+
+// Fixture for tests of the analyses alphacheck runs over resolved statements.
+// Statements are analyzed as alphacheck analyzes them for lineage, cost, lint
+// rules, --dead_code and --duplicate_subqueries: with all language features
+// and unused columns pruned, so that scans list only referenced columns. The
+// catalog has the ZetaSQL functions and tables a and b with INT64 columns x
+// and y.
+class AnalysisTest : public ::testing::Test {
+protected:
+  AnalysisTest();
+
+  // Adds a table named <name> with INT64 columns named <column_names>.
+  void AddTable(const std::string &name,
+                const std::vector<std::string> &column_names);
+
+  // Analyzes <sql>, failing the test and returning nullptr if it is invalid.
+  std::unique_ptr<const zetasql::AnalyzerOutput>
+  Analyze(const std::string &sql);
+
+  // Registers the function or table function created by <statement> as
+  // alphacheck does. Other statements are ignored.
+  void AddFunction(const zetasql::ResolvedStatement *statement);
+
+  zetasql::TypeFactory type_factory_;
+  zetasql::SimpleCatalog catalog_;
+  zetasql::AnalyzerOptions options_;
+};
+
+} // namespace alphasql
+
+#endif // ALPHASQL_ANALYSIS_TEST_UTIL_H_
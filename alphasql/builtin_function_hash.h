@@ -0,0 +1,51 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#ifndef ALPHASQL_BUILTIN_FUNCTION_HASH_H_
+#define ALPHASQL_BUILTIN_FUNCTION_HASH_H_
+
+#include <cstdint>
+#include <string>
+
+#include "absl/strings/ascii.h"
+#include "absl/types/span.h"
+
+namespace alphasql {
+
+// The hash functions of the builtin function table generated for
+// IsBuiltinFunction: FNV-1a over the lowercased <path> joined with dots,
+// starting from a state derived from <seed>, then mixed.
+inline uint64_t BuiltinFunctionHash(absl::Span<const std::string> path,
+                                    uint64_t seed) {
+  uint64_t hash = 14695981039346656037ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+  for (size_t i = 0; i < path.size(); ++i) {
+    if (i > 0) {
+      hash ^= '.';
+      hash *= 1099511628211ULL;
+    }
+    for (const char c : path[i]) {
+      hash ^= static_cast<unsigned char>(absl::ascii_tolower(c));
+      hash *= 1099511628211ULL;
+    }
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+} // namespace alphasql
+
+#endif // ALPHASQL_BUILTIN_FUNCTION_HASH_H_
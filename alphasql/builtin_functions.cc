@@ -0,0 +1,65 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/builtin_functions.h"
+
+#include <cstddef>
+
+#include "absl/strings/match.h"
+#include "absl/strings/string_view.h"
+#include "alphasql/builtin_function_hash.h"
+
+namespace alphasql {
+
+namespace {
+
+// Defines kNumBuckets, kBucketSeeds, kNumSlots and kSlots.
+#include "alphasql/builtin_function_table.inc"
+
+// Whether <name>, lowercase, is <path> joined with dots, ignoring case.
+bool EqualsPath(absl::string_view name, absl::Span<const std::string> path) {
+  for (size_t i = 0; i < path.size(); ++i) {
+    if (i > 0) {
+      if (name.empty() || name.front() != '.') {
+        return false;
+      }
+      name.remove_prefix(1);
+    }
+    if (!absl::StartsWithIgnoreCase(name, path[i])) {
+      return false;
+    }
+    name.remove_prefix(path[i].size());
+  }
+  return name.empty();
+}
+
+} // namespace
+
+bool IsBuiltinFunction(absl::Span<const std::string> path) {
+  // SAFE.<function> is the builtin returning NULL instead of an error.
+  if (path.size() > 1 && absl::EqualsIgnoreCase(path[0], "safe")) {
+    path.remove_prefix(1);
+  }
+  if (path.empty()) {
+    return false;
+  }
+  const uint64_t seed =
+      kBucketSeeds[BuiltinFunctionHash(path, /*seed=*/0) % kNumBuckets];
+  const char *name = kSlots[BuiltinFunctionHash(path, seed) % kNumSlots];
+  return name != nullptr && EqualsPath(name, path);
+}
+
+} // namespace alphasql
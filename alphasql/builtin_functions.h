@@ -0,0 +1,34 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_BUILTIN_FUNCTIONS_H_
+#define ALPHASQL_BUILTIN_FUNCTIONS_H_
+
+#include <string>
+
+#include "absl/types/span.h"
+
+namespace alphasql {
+
+// Whether <path> names a ZetaSQL builtin function, e.g. COUNT, NET.HOST or
+// SAFE.SUBSTR, ignoring case. Builtins are looked up in a perfect hash table
+// generated from the ZetaSQL function registry at build time, so a lookup
+// costs one hash and one comparison.
+bool IsBuiltinFunction(absl::Span<const std::string> path);
+
+} // namespace alphasql
+
+#endif // ALPHASQL_BUILTIN_FUNCTIONS_H_
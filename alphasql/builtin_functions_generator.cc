@@ -0,0 +1,134 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Prints the perfect hash table of ZetaSQL builtin function names included by
+// builtin_functions.cc, using the hash and displace scheme: names are split
+// into buckets by a first hash, and each bucket, largest first, gets the
+// first seed of the second hash that puts all of its names in free slots.
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_split.h"
+#include "alphasql/builtin_function_hash.h"
+#include "zetasql/public/builtin_function.h"
+#include "zetasql/public/function.h"
+#include "zetasql/public/language_options.h"
+#include "zetasql/public/types/type_factory.h"
+
+namespace {
+
+using namespace zetasql;
+
+// Builtins available with the language options of alphasql.
+std::set<std::string> BuiltinFunctionNames() {
+  LanguageOptions language_options;
+  language_options.EnableMaximumLanguageFeaturesForDevelopment();
+  TypeFactory type_factory;
+  std::map<std::string, std::unique_ptr<Function>> functions;
+  GetZetaSQLFunctions(&type_factory,
+                      ZetaSQLBuiltinFunctionOptions(language_options),
+                      &functions);
+  std::set<std::string> names;
+  for (const auto &[name, function] : functions) {
+    // Operators and other internal functions can not be called by name.
+    if (absl::StartsWith(name, "$")) {
+      continue;
+    }
+    names.insert(absl::AsciiStrToLower(name));
+  }
+  return names;
+}
+
+} // namespace
+
+int main() {
+  std::vector<std::vector<std::string>> paths;
+  std::vector<std::string> names;
+  for (const std::string &name : BuiltinFunctionNames()) {
+    paths.push_back(absl::StrSplit(name, '.'));
+    names.push_back(name);
+  }
+
+  const size_t num_buckets = std::max<size_t>(1, paths.size() / 4);
+  const size_t num_slots = paths.size() + paths.size() / 4 + 1;
+  std::vector<std::vector<size_t>> buckets(num_buckets);
+  for (size_t i = 0; i < paths.size(); ++i) {
+    buckets[alphasql::BuiltinFunctionHash(paths[i], /*seed=*/0) % num_buckets]
+        .push_back(i);
+  }
+  std::vector<size_t> order(num_buckets);
+  for (size_t i = 0; i < num_buckets; ++i) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return buckets[a].size() > buckets[b].size();
+  });
+
+  std::vector<uint64_t> seeds(num_buckets, 0);
+  std::vector<int> slots(num_slots, -1);
+  for (const size_t bucket : order) {
+    if (buckets[bucket].empty()) {
+      break;
+    }
+    for (uint64_t seed = 1;; ++seed) {
+      std::vector<size_t> taken;
+      for (const size_t i : buckets[bucket]) {
+        const size_t slot =
+            alphasql::BuiltinFunctionHash(paths[i], seed) % num_slots;
+        if (slots[slot] != -1 ||
+            std::find(taken.begin(), taken.end(), slot) != taken.end()) {
+          break;
+        }
+        taken.push_back(slot);
+      }
+      if (taken.size() == buckets[bucket].size()) {
+        for (size_t j = 0; j < taken.size(); ++j) {
+          slots[taken[j]] = buckets[bucket][j];
+        }
+        seeds[bucket] = seed;
+        break;
+      }
+    }
+  }
+
+  std::cout << "// Generated by builtin_functions_generator. Do not edit.\n\n";
+  std::cout << "constexpr size_t kNumBuckets = " << num_buckets << ";\n";
+  std::cout << "constexpr uint64_t kBucketSeeds[kNumBuckets] = {\n";
+  for (const uint64_t seed : seeds) {
+    std::cout << "    " << seed << "ULL,\n";
+  }
+  std::cout << "};\n\n";
+  std::cout << "constexpr size_t kNumSlots = " << num_slots << ";\n";
+  std::cout << "constexpr const char *kSlots[kNumSlots] = {\n";
+  for (const int slot : slots) {
+    if (slot == -1) {
+      std::cout << "    nullptr,\n";
+    } else {
+      std::cout << "    \"" << names[slot] << "\",\n";
+    }
+  }
+  std::cout << "};" << std::endl;
+  return 0;
+}
@@ -0,0 +1,45 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/builtin_functions.h"
+
+#include "gtest/gtest.h"
+
+namespace alphasql {
+namespace {
+
+TEST(IsBuiltinFunction, FindsBuiltinsIgnoringCase) {
+  EXPECT_TRUE(IsBuiltinFunction({"COUNT"}));
+  EXPECT_TRUE(IsBuiltinFunction({"concat"}));
+  EXPECT_TRUE(IsBuiltinFunction({"Net", "Host"}));
+}
+
+TEST(IsBuiltinFunction, FindsSafeCalls) {
+  EXPECT_TRUE(IsBuiltinFunction({"SAFE", "SUBSTR"}));
+  EXPECT_TRUE(IsBuiltinFunction({"safe", "net", "host"}));
+  EXPECT_FALSE(IsBuiltinFunction({"safe"}));
+}
+
+TEST(IsBuiltinFunction, IgnoresUserDefinedFunctions) {
+  EXPECT_FALSE(IsBuiltinFunction({"my_udf"}));
+  EXPECT_FALSE(IsBuiltinFunction({"dataset", "count"}));
+  EXPECT_FALSE(IsBuiltinFunction({"net"}));
+  EXPECT_FALSE(IsBuiltinFunction({"count", "x"}));
+  EXPECT_FALSE(IsBuiltinFunction({}));
+}
+
+} // namespace
+} // namespace alphasql
@@ -0,0 +1,231 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/check_cache.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "zetasql/public/function.h"
+#include "zetasql/public/procedure.h"
+#include "zetasql/public/table_valued_function.h"
+
+namespace alphasql {
+
+using namespace zetasql;
+
+namespace {
+
+// Bump when the meaning of entries changes.
+constexpr int kVersion = 1;
+
+std::string TableDescription(const Table *table) {
+  std::string description;
+  for (int i = 0; i < table->NumColumns(); ++i) {
+    const zetasql::Column *column = table->GetColumn(i);
+    absl::StrAppend(&description, column->Name(), " ",
+                    column->GetType()->TypeName(PRODUCT_EXTERNAL), ",");
+  }
+  return description;
+}
+
+// The object <key> resolves to in <catalog>, or null, and its description.
+const void *FindObject(LayeredCatalog::ObjectKind kind, const std::string &key,
+                       Catalog *catalog, std::string *description) {
+  switch (kind) {
+  case LayeredCatalog::ObjectKind::kTable: {
+    const Table *table;
+    if (!catalog->FindTable({key}, &table).ok()) {
+      return nullptr;
+    }
+    // Tables are fully described by their columns.
+    *description = absl::StrCat("table ", TableDescription(table));
+    return table;
+  }
+  case LayeredCatalog::ObjectKind::kFunction: {
+    const Function *function;
+    if (!catalog->FindFunction({key}, &function).ok()) {
+      return nullptr;
+    }
+    *description = function->DebugString(/*verbose=*/true);
+    return function;
+  }
+  case LayeredCatalog::ObjectKind::kTableValuedFunction: {
+    const TableValuedFunction *function;
+    if (!catalog->FindTableValuedFunction({key}, &function).ok()) {
+      return nullptr;
+    }
+    *description = function->DebugString();
+    return function;
+  }
+  case LayeredCatalog::ObjectKind::kProcedure: {
+    const Procedure *procedure;
+    if (!catalog->FindProcedure({key}, &procedure).ok()) {
+      return nullptr;
+    }
+    *description = procedure->signature().DebugString(procedure->FullName());
+    return procedure;
+  }
+  }
+  return nullptr;
+}
+
+} // namespace
+
+uint64_t Fingerprint(absl::string_view data) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (const char c : data) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+absl::Status WriteCacheFile(const std::string &directory,
+                            const std::string &file_name,
+                            const google::protobuf::Message &message) {
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  if (error) {
+    return absl::InternalError(
+        absl::StrCat("Can not create ", directory, ": ", error.message()));
+  }
+  const std::string path =
+      (std::filesystem::path(directory) / file_name).string();
+  const std::string temp_path = absl::StrCat(path, ".tmp");
+  {
+    std::ofstream file(temp_path,
+                       std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!file || !message.SerializeToOstream(&file)) {
+      return absl::InternalError(absl::StrCat("Can not write ", temp_path));
+    }
+  }
+  std::filesystem::rename(temp_path, path, error);
+  if (error) {
+    return absl::InternalError(
+        absl::StrCat("Can not write ", path, ": ", error.message()));
+  }
+  return absl::OkStatus();
+}
+
+CheckCache::CheckCache(const std::string &directory) : directory_(directory) {}
+
+void CheckCache::AddDefinition(ObjectKind kind,
+                               const absl::Span<const std::string> &path,
+                               const std::string &ddl, Catalog *catalog) {
+  std::string description;
+  const void *object =
+      FindObject(kind, LayeredCatalog::Key(path), catalog, &description);
+  if (object == nullptr) {
+    return;
+  }
+  absl::MutexLock l(&mutex_);
+  definitions_[object] = Fingerprint(ddl);
+}
+
+uint64_t CheckCache::ObjectFingerprint(ObjectKind kind, const std::string &key,
+                                       Catalog *catalog) const {
+  std::string description;
+  const void *object = FindObject(kind, key, catalog, &description);
+  if (object == nullptr) {
+    return 0;
+  }
+  if (kind == ObjectKind::kTable) {
+    return Fingerprint(description);
+  }
+  {
+    absl::MutexLock l(&mutex_);
+    const auto it = definitions_.find(object);
+    if (it != definitions_.end()) {
+      return it->second;
+    }
+  }
+  // Builtins, which only change with the binary.
+  return Fingerprint(absl::StrCat("builtin ", description));
+}
+
+std::string CheckCache::EntryFileName(const std::string &path) const {
+  return absl::StrCat(absl::Hex(Fingerprint(path), absl::kZeroPad16), ".pb");
+}
+
+bool CheckCache::Lookup(const std::string &path, const std::string &sql,
+                        Catalog *upstream, CheckCacheEntry *entry) const {
+  std::ifstream file(
+      (std::filesystem::path(directory_) / EntryFileName(path)).string(),
+      std::ios::in | std::ios::binary);
+  if (!file || !entry->ParseFromIstream(&file)) {
+    return false;
+  }
+  if (entry->version() != kVersion || entry->path() != path ||
+      entry->content_fingerprint() != Fingerprint(sql)) {
+    return false;
+  }
+  for (const CachedDependency &dependency : entry->dependencies()) {
+    if (ObjectFingerprint(static_cast<ObjectKind>(dependency.kind()),
+                          dependency.key(),
+                          upstream) != dependency.fingerprint()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+absl::Status
+CheckCache::Store(const std::string &path, const std::string &sql,
+                  const Dependencies &dependencies, const LayeredCatalog &layer,
+                  const std::vector<std::string> &definitions,
+                  const std::vector<std::string> &dropped_functions) const {
+  CheckCacheEntry entry;
+  entry.set_version(kVersion);
+  entry.set_path(path);
+  entry.set_content_fingerprint(Fingerprint(sql));
+  LayeredCatalog *upstream = layer.parent();
+  for (const auto &[kind, key] : dependencies) {
+    CachedDependency *dependency = entry.add_dependencies();
+    dependency->set_kind(static_cast<int>(kind));
+    dependency->set_key(key);
+    dependency->set_fingerprint(ObjectFingerprint(kind, key, upstream));
+  }
+  for (const auto &[key, table] : layer.layer_tables()) {
+    CachedTable *cached_table = entry.add_tables();
+    if (table == nullptr) {
+      cached_table->set_name(key);
+      cached_table->set_dropped(true);
+      continue;
+    }
+    cached_table->set_name(table->Name());
+    for (int i = 0; i < table->NumColumns(); ++i) {
+      CachedColumn *column = cached_table->add_columns();
+      column->set_name(table->GetColumn(i)->Name());
+      column->set_type(
+          table->GetColumn(i)->GetType()->TypeName(PRODUCT_EXTERNAL));
+    }
+  }
+  for (const std::string &definition : definitions) {
+    entry.add_definitions(definition);
+  }
+  for (const std::string &function_name : dropped_functions) {
+    entry.add_dropped_functions(function_name);
+  }
+
+  return WriteCacheFile(directory_, EntryFileName(path), entry);
+}
+
+} // namespace alphasql
@@ -0,0 +1,104 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_CHECK_CACHE_H_
+#define ALPHASQL_CHECK_CACHE_H_
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "alphasql/layered_catalog.h"
+#include "alphasql/proto/alphasql_service.pb.h"
+#include "google/protobuf/message.h"
+#include "zetasql/base/status.h"
+#include "zetasql/public/catalog.h"
+
+namespace alphasql {
+
+// Stable 64-bit FNV-1a hash, so that fingerprints survive across runs.
+uint64_t Fingerprint(absl::string_view data);
+
+// Writes <message> to <file_name> in <directory>, creating the directory if
+// needed. The file is written aside and renamed, so that readers never see a
+// partial one.
+absl::Status WriteCacheFile(const std::string &directory,
+                            const std::string &file_name,
+                            const google::protobuf::Message &message);
+
+// A persistent cache of the catalog updates made by files that passed
+// alphacheck, with one entry per file in a directory.
+//
+// An entry records the fingerprint of the file content and of every upstream
+// object the file resolved against, along with the tables the file left in
+// its layer and the DDL of the functions, TVFs and procedures it created. It
+// stays valid while none of them change, so the updates can be replayed
+// instead of analyzing the file again. This class is thread-safe.
+class CheckCache {
+public:
+  using ObjectKind = LayeredCatalog::ObjectKind;
+  using Dependencies = std::set<std::pair<ObjectKind, std::string>>;
+
+  explicit CheckCache(const std::string &directory);
+
+  // Remembers <ddl> as the definition of the function, TVF or procedure
+  // <path> resolves to in <catalog>, since templated bodies can not be
+  // recovered from the catalog.
+  void AddDefinition(ObjectKind kind, const absl::Span<const std::string> &path,
+                     const std::string &ddl, zetasql::Catalog *catalog);
+
+  // Fingerprint of what <key> resolves to in <catalog>, 0 if nothing.
+  uint64_t ObjectFingerprint(ObjectKind kind, const std::string &key,
+                             zetasql::Catalog *catalog) const;
+
+  // Returns true and sets <entry> if the file at <path> with content <sql>
+  // has an entry whose dependencies resolve the same way in <upstream>.
+  bool Lookup(const std::string &path, const std::string &sql,
+              zetasql::Catalog *upstream, CheckCacheEntry *entry) const;
+
+  // Stores the updates <layer> holds for the file at <path>, resolving
+  // <dependencies> against the parent of <layer>, which must not be null.
+  absl::Status Store(const std::string &path, const std::string &sql,
+                     const Dependencies &dependencies,
+                     const LayeredCatalog &layer,
+                     const std::vector<std::string> &definitions,
+                     const std::vector<std::string> &dropped_functions) const;
+
+private:
+  std::string EntryFileName(const std::string &path) const;
+
+  const std::string directory_;
+
+  mutable absl::Mutex mutex_;
+  // Fingerprints of the definitions added to this cache, keyed by the object
+  // they created rather than by name, so that a file only sees the
+  // definitions its catalog resolves to, not those of unrelated files
+  // creating the same name. Every function, TVF and procedure alphacheck
+  // creates is added, so the key of a freed object is overwritten before
+  // its address can be found again.
+  absl::flat_hash_map<const void *, uint64_t> definitions_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+} // namespace alphasql
+
+#endif // ALPHASQL_CHECK_CACHE_H_
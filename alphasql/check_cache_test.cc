@@ -0,0 +1,160 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "alphasql/check_cache.h"
+
+#include <string>
+
+#include "gtest/gtest.h"
+#include "zetasql/public/function.h"
+#include "zetasql/public/simple_catalog.h"
+#include "zetasql/public/types/type_factory.h"
+
+namespace alphasql {
+namespace {
+
+using namespace zetasql;
+
+class CheckCacheTest : public ::testing::Test {
+protected:
+  CheckCacheTest()
+      : base_("base", &type_factory_),
+        schema_layer_("catalog", &base_, &type_factory_),
+        cache_(testing::TempDir() + "/check_cache_" +
+               ::testing::UnitTest::GetInstance()->current_test_info()->name()) {
+    schema_layer_.AddOwnedTable(
+        new SimpleTable("a", {{"x", type_factory_.get_int64()}}));
+  }
+
+  // Checks a file that reads table a and creates table t from it, and stores
+  // the result.
+  void CheckAndStore(const std::string &sql) {
+    LayeredCatalog file_layer(&schema_layer_);
+    CheckCache::Dependencies dependencies;
+    file_layer.set_miss_listener(
+        [&dependencies](LayeredCatalog::ObjectKind kind,
+                        const std::string &key) {
+          dependencies.emplace(kind, key);
+        });
+    const Table *table;
+    ASSERT_TRUE(file_layer.FindTable({"a"}, &table).ok());
+    file_layer.AddOwnedTable(
+        new SimpleTable("t", {{"x", type_factory_.get_int64()}}));
+    const absl::Status status =
+        cache_.Store("file.sql", sql, dependencies, file_layer,
+                     /*definitions=*/{}, /*dropped_functions=*/{});
+    ASSERT_TRUE(status.ok()) << status;
+  }
+
+  bool Lookup(const std::string &sql, CheckCacheEntry *entry) {
+    LayeredCatalog file_layer(&schema_layer_);
+    return cache_.Lookup("file.sql", sql, file_layer.parent(), entry);
+  }
+
+  TypeFactory type_factory_;
+  SimpleCatalog base_;
+  LayeredCatalog schema_layer_;
+  CheckCache cache_;
+};
+
+TEST_F(CheckCacheTest, HitReplaysTheTablesOfTheFile) {
+  CheckAndStore("CREATE TABLE t AS SELECT x FROM a");
+  CheckCacheEntry entry;
+  ASSERT_TRUE(Lookup("CREATE TABLE t AS SELECT x FROM a", &entry));
+  ASSERT_EQ(entry.tables_size(), 1);
+  EXPECT_EQ(entry.tables(0).name(), "t");
+  EXPECT_FALSE(entry.tables(0).dropped());
+  ASSERT_EQ(entry.tables(0).columns_size(), 1);
+  EXPECT_EQ(entry.tables(0).columns(0).name(), "x");
+  EXPECT_EQ(entry.tables(0).columns(0).type(), "INT64");
+}
+
+TEST_F(CheckCacheTest, MissesWithoutAnEntryOrAfterTheFileChanged) {
+  CheckCacheEntry entry;
+  EXPECT_FALSE(Lookup("CREATE TABLE t AS SELECT x FROM a", &entry));
+  CheckAndStore("CREATE TABLE t AS SELECT x FROM a");
+  EXPECT_FALSE(Lookup("CREATE TABLE t AS SELECT x + 1 AS x FROM a", &entry));
+}
+
+TEST_F(CheckCacheTest, UpstreamChangesInvalidateEntries) {
+  CheckAndStore("CREATE TABLE t AS SELECT x FROM a");
+  schema_layer_.AddOwnedTable(
+      new SimpleTable("a", {{"x", type_factory_.get_string()}}));
+  CheckCacheEntry entry;
+  EXPECT_FALSE(Lookup("CREATE TABLE t AS SELECT x FROM a", &entry));
+
+  // Back to the original definition.
+  schema_layer_.AddOwnedTable(
+      new SimpleTable("a", {{"x", type_factory_.get_int64()}}));
+  EXPECT_TRUE(Lookup("CREATE TABLE t AS SELECT x FROM a", &entry));
+}
+
+TEST_F(CheckCacheTest, DroppedUpstreamTablesInvalidateEntries) {
+  CheckAndStore("CREATE TABLE t AS SELECT x FROM a");
+  ASSERT_TRUE(schema_layer_.DropTable("a", /*if_exists=*/false).ok());
+  CheckCacheEntry entry;
+  EXPECT_FALSE(Lookup("CREATE TABLE t AS SELECT x FROM a", &entry));
+}
+
+TEST_F(CheckCacheTest, TablesDroppedByTheFileAreStored) {
+  LayeredCatalog file_layer(&schema_layer_);
+  ASSERT_TRUE(file_layer.DropTable("a", /*if_exists=*/false).ok());
+  ASSERT_TRUE(cache_
+                  .Store("file.sql", "DROP TABLE a", /*dependencies=*/{},
+                         file_layer, /*definitions=*/{},
+                         /*dropped_functions=*/{})
+                  .ok());
+  CheckCacheEntry entry;
+  ASSERT_TRUE(Lookup("DROP TABLE a", &entry));
+  ASSERT_EQ(entry.tables_size(), 1);
+  EXPECT_EQ(entry.tables(0).name(), "a");
+  EXPECT_TRUE(entry.tables(0).dropped());
+}
+
+TEST_F(CheckCacheTest, DefinitionsAreKeptPerObject) {
+  // Two files creating functions of the same name, neither upstream of the
+  // other.
+  LayeredCatalog layer1(&schema_layer_);
+  LayeredCatalog layer2(&schema_layer_);
+  layer1.AddOwnedFunction(new Function("f", "group", Function::SCALAR));
+  cache_.AddDefinition(LayeredCatalog::ObjectKind::kFunction, {"f"},
+                       "CREATE FUNCTION f() AS (1)", &layer1);
+  layer2.AddOwnedFunction(new Function("f", "group", Function::SCALAR));
+  cache_.AddDefinition(LayeredCatalog::ObjectKind::kFunction, {"f"},
+                       "CREATE FUNCTION f() AS (2)", &layer2);
+
+  EXPECT_EQ(cache_.ObjectFingerprint(LayeredCatalog::ObjectKind::kFunction,
+                                     "f", &layer1),
+            Fingerprint("CREATE FUNCTION f() AS (1)"));
+  EXPECT_EQ(cache_.ObjectFingerprint(LayeredCatalog::ObjectKind::kFunction,
+                                     "f", &layer2),
+            Fingerprint("CREATE FUNCTION f() AS (2)"));
+  EXPECT_EQ(cache_.ObjectFingerprint(LayeredCatalog::ObjectKind::kFunction,
+                                     "f", &schema_layer_),
+            0u);
+}
+
+TEST_F(CheckCacheTest, BuiltinsAreFingerprintedByTheirSignatures) {
+  base_.AddOwnedFunction(new Function("g", "group", Function::SCALAR));
+  const uint64_t fingerprint = cache_.ObjectFingerprint(
+      LayeredCatalog::ObjectKind::kFunction, "g", &schema_layer_);
+  EXPECT_NE(fingerprint, 0u);
+  EXPECT_EQ(fingerprint,
+            cache_.ObjectFingerprint(LayeredCatalog::ObjectKind::kFunction,
+                                     "g", &schema_layer_));
+}
+
+} // namespace
+} // namespace alphasql
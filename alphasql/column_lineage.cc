@@ -0,0 +1,431 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/column_lineage.h"
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "boost/graph/adjacency_list.hpp"
+#include "boost/graph/graphviz.hpp"
+#include "zetasql/base/status_macros.h"
+#include "zetasql/resolved_ast/resolved_ast_visitor.h"
+
+namespace alphasql {
+
+using namespace zetasql;
+
+namespace {
+
+// Collects the columns an expression refers to. The value of a subquery is
+// computed from its output columns, which are resolved like any other.
+class ColumnRefCollector : public ResolvedASTVisitor {
+public:
+  explicit ColumnRefCollector(std::vector<int> *column_ids)
+      : column_ids_(column_ids) {}
+
+  absl::Status VisitResolvedColumnRef(const ResolvedColumnRef *node) override {
+    column_ids_->push_back(node->column().column_id());
+    return DefaultVisit(node);
+  }
+
+  absl::Status
+  VisitResolvedSubqueryExpr(const ResolvedSubqueryExpr *node) override {
+    for (const ResolvedColumn &column : node->subquery()->column_list()) {
+      column_ids_->push_back(column.column_id());
+    }
+    return DefaultVisit(node);
+  }
+
+private:
+  std::vector<int> *column_ids_; // Not owned.
+};
+
+absl::Status CollectColumnRefs(const ResolvedNode *node,
+                               std::vector<int> *column_ids) {
+  if (node == nullptr) {
+    return absl::OkStatus();
+  }
+  ColumnRefCollector collector(column_ids);
+  return node->Accept(&collector);
+}
+
+// Records, for every column defined in a statement, the columns it is
+// directly computed from, and the columns of scanned tables, which are the
+// sources all lineage resolves to.
+class LineageVisitor : public ResolvedASTVisitor {
+public:
+  // Table columns <column_id> is computed from, looking through the columns
+  // it is computed from.
+  const Sources &Resolve(int column_id) {
+    const auto it = resolved_.find(column_id);
+    if (it != resolved_.end()) {
+      return it->second;
+    }
+    // Inserted first, so that cycles through recursive definitions end. The
+    // reference stays valid since <resolved_> is a std::map.
+    Sources &sources = resolved_[column_id];
+    const auto table_column = table_columns_.find(column_id);
+    if (table_column != table_columns_.end()) {
+      sources.insert(table_column->second);
+    }
+    const auto dependencies = dependencies_.find(column_id);
+    if (dependencies != dependencies_.end()) {
+      for (const int upstream : dependencies->second) {
+        const Sources &upstream_sources = Resolve(upstream);
+        if (&upstream_sources != &sources) {
+          sources.insert(upstream_sources.begin(), upstream_sources.end());
+        }
+      }
+    }
+    return sources;
+  }
+
+  Sources ResolveAll(const std::vector<int> &column_ids) {
+    Sources sources;
+    for (const int column_id : column_ids) {
+      const Sources &column_sources = Resolve(column_id);
+      sources.insert(column_sources.begin(), column_sources.end());
+    }
+    return sources;
+  }
+
+  Sources ResolveFilters() { return ResolveAll(filters_); }
+
+  absl::Status VisitResolvedTableScan(const ResolvedTableScan *node) override {
+    for (int i = 0; i < node->column_list_size(); ++i) {
+      std::string column_name = node->column_list(i).name();
+      if (i < node->column_index_list_size()) {
+        column_name =
+            node->table()->GetColumn(node->column_index_list(i))->Name();
+      }
+      table_columns_[node->column_list(i).column_id()] =
+          absl::StrCat(node->table()->Name(), ".", column_name);
+    }
+    return DefaultVisit(node);
+  }
+
+  absl::Status
+  VisitResolvedComputedColumn(const ResolvedComputedColumn *node) override {
+    ZETASQL_RETURN_IF_ERROR(CollectColumnRefs(
+        node->expr(), &dependencies_[node->column().column_id()]));
+    return DefaultVisit(node);
+  }
+
+  absl::Status
+  VisitResolvedFilterScan(const ResolvedFilterScan *node) override {
+    ZETASQL_RETURN_IF_ERROR(CollectColumnRefs(node->filter_expr(), &filters_));
+    return DefaultVisit(node);
+  }
+
+  absl::Status VisitResolvedJoinScan(const ResolvedJoinScan *node) override {
+    ZETASQL_RETURN_IF_ERROR(CollectColumnRefs(node->join_expr(), &filters_));
+    return DefaultVisit(node);
+  }
+
+  absl::Status VisitResolvedArrayScan(const ResolvedArrayScan *node) override {
+    std::vector<int> array_refs;
+    ZETASQL_RETURN_IF_ERROR(CollectColumnRefs(node->array_expr(), &array_refs));
+    AddDependencies(node->element_column().column_id(), array_refs);
+    if (node->array_offset_column() != nullptr) {
+      AddDependencies(node->array_offset_column()->column().column_id(),
+                      array_refs);
+    }
+    ZETASQL_RETURN_IF_ERROR(CollectColumnRefs(node->join_expr(), &filters_));
+    return DefaultVisit(node);
+  }
+
+  absl::Status
+  VisitResolvedSetOperationScan(const ResolvedSetOperationScan *node) override {
+    for (const auto &item : node->input_item_list()) {
+      for (int i = 0; i < node->column_list_size() &&
+                      i < item->output_column_list_size();
+           ++i) {
+        dependencies_[node->column_list(i).column_id()].push_back(
+            item->output_column_list(i).column_id());
+      }
+    }
+    return DefaultVisit(node);
+  }
+
+  absl::Status VisitResolvedWithScan(const ResolvedWithScan *node) override {
+    for (const auto &entry : node->with_entry_list()) {
+      with_queries_[entry->with_query_name()] = entry->with_subquery();
+    }
+    return DefaultVisit(node);
+  }
+
+  absl::Status
+  VisitResolvedWithRefScan(const ResolvedWithRefScan *node) override {
+    const auto it = with_queries_.find(node->with_query_name());
+    if (it != with_queries_.end()) {
+      const ResolvedScan *with_query = it->second;
+      for (int i = 0; i < node->column_list_size() &&
+                      i < with_query->column_list_size();
+           ++i) {
+        dependencies_[node->column_list(i).column_id()].push_back(
+            with_query->column_list(i).column_id());
+      }
+    }
+    return DefaultVisit(node);
+  }
+
+  absl::Status
+  VisitResolvedAnalyticScan(const ResolvedAnalyticScan *node) override {
+    // Window functions are also computed from their partitioning and
+    // ordering.
+    for (const auto &group : node->function_group_list()) {
+      std::vector<int> window_refs;
+      ZETASQL_RETURN_IF_ERROR(
+          CollectColumnRefs(group->partition_by(), &window_refs));
+      ZETASQL_RETURN_IF_ERROR(CollectColumnRefs(group->order_by(), &window_refs));
+      for (const auto &function : group->analytic_function_list()) {
+        AddDependencies(function->column().column_id(), window_refs);
+      }
+    }
+    return DefaultVisit(node);
+  }
+
+  absl::Status VisitResolvedTVFScan(const ResolvedTVFScan *node) override {
+    // The body of the function is opaque here, so every output column may be
+    // computed from every argument.
+    std::vector<int> argument_refs;
+    for (const auto &argument : node->argument_list()) {
+      ZETASQL_RETURN_IF_ERROR(CollectColumnRefs(argument.get(), &argument_refs));
+    }
+    for (const ResolvedColumn &column : node->column_list()) {
+      AddDependencies(column.column_id(), argument_refs);
+    }
+    return DefaultVisit(node);
+  }
+
+private:
+  void AddDependencies(int column_id, const std::vector<int> &upstreams) {
+    std::vector<int> &dependencies = dependencies_[column_id];
+    dependencies.insert(dependencies.end(), upstreams.begin(), upstreams.end());
+  }
+
+  absl::flat_hash_map<int, std::string> table_columns_;
+  absl::flat_hash_map<int, std::vector<int>> dependencies_;
+  std::vector<int> filters_;
+  std::map<std::string, const ResolvedScan *> with_queries_;
+  std::map<int, Sources> resolved_;
+};
+
+// A written column and the columns its value is computed from.
+struct WrittenColumn {
+  std::string name;
+  const Type *type;
+  std::vector<int> column_ids;
+};
+
+// Columns written by <statement> and the name of what they are written to,
+// which is empty for query results.
+absl::Status WrittenColumns(const ResolvedStatement *statement,
+                            std::string *target,
+                            std::vector<WrittenColumn> *columns) {
+  auto add_output_columns = [columns](const auto &output_column_list) {
+    for (const auto &output_column : output_column_list) {
+      columns->push_back({output_column->name(),
+                          output_column->column().type(),
+                          {output_column->column().column_id()}});
+    }
+  };
+  switch (statement->node_kind()) {
+  case RESOLVED_QUERY_STMT:
+    add_output_columns(
+        statement->GetAs<ResolvedQueryStmt>()->output_column_list());
+    break;
+  case RESOLVED_CREATE_TABLE_AS_SELECT_STMT: {
+    auto *stmt = statement->GetAs<ResolvedCreateTableAsSelectStmt>();
+    *target = absl::StrJoin(stmt->name_path(), ".");
+    add_output_columns(stmt->output_column_list());
+    break;
+  }
+  case RESOLVED_CREATE_VIEW_STMT: {
+    auto *stmt = statement->GetAs<ResolvedCreateViewStmt>();
+    *target = absl::StrJoin(stmt->name_path(), ".");
+    add_output_columns(stmt->output_column_list());
+    break;
+  }
+  case RESOLVED_INSERT_STMT: {
+    auto *stmt = statement->GetAs<ResolvedInsertStmt>();
+    *target = stmt->table_scan()->table()->Name();
+    for (int i = 0; i < stmt->insert_column_list_size(); ++i) {
+      WrittenColumn column{stmt->insert_column_list(i).name(),
+                           stmt->insert_column_list(i).type()};
+      if (stmt->query() != nullptr) {
+        if (i < stmt->query_output_column_list_size()) {
+          column.column_ids.push_back(
+              stmt->query_output_column_list(i).column_id());
+        }
+      } else {
+        for (const auto &row : stmt->row_list()) {
+          if (i < row->value_list_size()) {
+            ZETASQL_RETURN_IF_ERROR(CollectColumnRefs(
+                row->value_list(i)->value(), &column.column_ids));
+          }
+        }
+      }
+      columns->push_back(std::move(column));
+    }
+    break;
+  }
+  case RESOLVED_UPDATE_STMT: {
+    auto *stmt = statement->GetAs<ResolvedUpdateStmt>();
+    *target = stmt->table_scan()->table()->Name();
+    for (const auto &item : stmt->update_item_list()) {
+      if (item->target()->node_kind() != RESOLVED_COLUMN_REF ||
+          item->set_value() == nullptr) {
+        continue;
+      }
+      const ResolvedColumn &target_column =
+          item->target()->GetAs<ResolvedColumnRef>()->column();
+      WrittenColumn column{target_column.name(), target_column.type()};
+      ZETASQL_RETURN_IF_ERROR(
+          CollectColumnRefs(item->set_value()->value(), &column.column_ids));
+      columns->push_back(std::move(column));
+    }
+    break;
+  }
+  default:
+    break;
+  }
+  return absl::OkStatus();
+}
+
+struct LineageVertex {
+  std::string label;
+  std::string shape;
+  // "column" or "query".
+  std::string type;
+};
+
+struct LineageEdge {
+  // The file writing the target.
+  std::string label;
+  // "value" or "filter".
+  std::string type;
+};
+
+typedef boost::adjacency_list<boost::vecS, boost::vecS, boost::directedS,
+                              LineageVertex, LineageEdge>
+    LineageGraph;
+
+} // namespace
+
+absl::Status GetStatementLineage(const ResolvedStatement *statement,
+                                 StatementLineage *lineage) {
+  std::vector<WrittenColumn> columns;
+  ZETASQL_RETURN_IF_ERROR(WrittenColumns(statement, &lineage->target, &columns));
+  if (columns.empty()) {
+    return absl::OkStatus();
+  }
+  LineageVisitor visitor;
+  ZETASQL_RETURN_IF_ERROR(statement->Accept(&visitor));
+  lineage->filters = visitor.ResolveFilters();
+  for (const WrittenColumn &column : columns) {
+    lineage->columns.push_back(
+        {column.name, column.type, visitor.ResolveAll(column.column_ids)});
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ColumnLineage::AddStatement(const std::string &path,
+                                         const ResolvedStatement *statement) {
+  StatementLineage lineage;
+  ZETASQL_RETURN_IF_ERROR(GetStatementLineage(statement, &lineage));
+  if (lineage.columns.empty()) {
+    return absl::OkStatus();
+  }
+  std::set<Edge> edges;
+  for (const ColumnSources &column : lineage.columns) {
+    const std::string written =
+        lineage.target.empty() ? path
+                               : absl::StrCat(lineage.target, ".", column.name);
+    for (const std::string &source : column.sources) {
+      edges.emplace(source, written, path, /*is_filter=*/false);
+    }
+    for (const std::string &source : lineage.filters) {
+      edges.emplace(source, written, path, /*is_filter=*/true);
+    }
+  }
+  absl::MutexLock l(&mutex_);
+  edges_.insert(edges.begin(), edges.end());
+  if (lineage.target.empty()) {
+    files_.insert(path);
+  }
+  return absl::OkStatus();
+}
+
+bool ColumnLineage::WriteGraph(const std::string &output_path) const {
+  LineageGraph g;
+  std::map<std::string, LineageGraph::vertex_descriptor> vertices;
+  absl::MutexLock l(&mutex_);
+  auto vertex = [&](const std::string &label) {
+    const auto it = vertices.find(label);
+    if (it != vertices.end()) {
+      return it->second;
+    }
+    const auto v = boost::add_vertex(g);
+    g[v].label = label;
+    if (files_.count(label) > 0) {
+      g[v].type = "query";
+    } else {
+      g[v].type = "column";
+      g[v].shape = "box";
+    }
+    vertices.emplace(label, v);
+    return v;
+  };
+  for (const auto &[source, target, file, is_filter] : edges_) {
+    const auto e = boost::add_edge(vertex(source), vertex(target), g).first;
+    g[e].label = file;
+    g[e].type = is_filter ? "filter" : "value";
+  }
+
+  boost::dynamic_properties dp;
+  dp.property("label", get(&LineageVertex::label, g));
+  dp.property("shape", get(&LineageVertex::shape, g));
+  dp.property("type", get(&LineageVertex::type, g));
+  dp.property("label", get(&LineageEdge::label, g));
+  dp.property("type", get(&LineageEdge::type, g));
+  dp.property("node_id", get(boost::vertex_index, g));
+
+  const std::filesystem::path parent =
+      std::filesystem::path(output_path).parent_path();
+  if (!parent.empty() && !std::filesystem::is_directory(parent)) {
+    std::error_code ec;
+    std::filesystem::create_directories(parent, ec);
+  }
+  std::ofstream out(output_path);
+  if (!out) {
+    return false;
+  }
+  write_graphviz_dp(out, g, dp);
+  return static_cast<bool>(out);
+}
+
+} // namespace alphasql
@@ -0,0 +1,93 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_COLUMN_LINEAGE_H_
+#define ALPHASQL_COLUMN_LINEAGE_H_
+
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "zetasql/base/status.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+
+namespace alphasql {
+
+// Table columns, as "<table>.<column>".
+typedef std::set<std::string> Sources;
+
+// A column written by a statement and the table columns its value is computed
+// from.
+struct ColumnSources {
+  std::string name;
+  const zetasql::Type *type;
+  Sources sources;
+};
+
+// The columns written by one statement.
+struct StatementLineage {
+  // The table or view written, empty for the result of a query.
+  std::string target;
+  std::vector<ColumnSources> columns;
+  // Table columns used to filter or join the rows.
+  Sources filters;
+};
+
+// Fills <lineage> for <statement>, leaving its columns empty if the statement
+// writes no columns. See ColumnLineage for what is tracked.
+absl::Status GetStatementLineage(const zetasql::ResolvedStatement *statement,
+                                 StatementLineage *lineage);
+
+// Column-level lineage of the statements of a pipeline.
+//
+// For every table column written by CREATE TABLE AS SELECT, CREATE VIEW,
+// INSERT or UPDATE, and for every column of the result of a query, records
+// the columns of scanned tables its value is computed from, looking through
+// subqueries, WITH clauses, set operations and aggregations. Columns used to
+// filter or join the rows, e.g. in WHERE, ON or HAVING, are recorded
+// separately as filters of every written column, since they affect which
+// rows are written rather than their values, even where they only filter a
+// subquery computing some of them. Table functions are opaque: their output
+// columns are computed from every column of their arguments, and the tables
+// read in their bodies are not followed. Query results are attributed to the
+// file of the query. This class is thread-safe.
+class ColumnLineage {
+public:
+  // Records the lineage of <statement> from the file at <path>. Statements
+  // that write no columns are ignored.
+  absl::Status AddStatement(const std::string &path,
+                            const zetasql::ResolvedStatement *statement);
+
+  // Writes the lineage in DOT to <output_path>. Vertices are columns, labeled
+  // "<table>.<column>", and query files, and edges go from source columns
+  // with the file writing them as label and "value" or "filter" as type.
+  // Returns false if <output_path> can not be written.
+  bool WriteGraph(const std::string &output_path) const;
+
+private:
+  // Source, target, file and whether the source is a filter.
+  typedef std::tuple<std::string, std::string, std::string, bool> Edge;
+
+  mutable absl::Mutex mutex_;
+  std::set<Edge> edges_ ABSL_GUARDED_BY(mutex_);
+  std::set<std::string> files_ ABSL_GUARDED_BY(mutex_);
+};
+
+} // namespace alphasql
+
+#endif // ALPHASQL_COLUMN_LINEAGE_H_
@@ -0,0 +1,161 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "alphasql/column_lineage.h"
+
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "alphasql/analysis_test_util.h"
+#include "gtest/gtest.h"
+
+namespace alphasql {
+namespace {
+
+using namespace zetasql;
+
+class ColumnLineageTest : public AnalysisTest {
+protected:
+  StatementLineage Lineage(const std::string &sql) {
+    StatementLineage lineage;
+    const auto output = Analyze(sql);
+    if (output == nullptr) {
+      return lineage;
+    }
+    const absl::Status status =
+        GetStatementLineage(output->resolved_statement(), &lineage);
+    EXPECT_TRUE(status.ok()) << status;
+    return lineage;
+  }
+
+  // Registers the table function created by <sql> as alphacheck does.
+  void AddTableFunction(const std::string &sql) {
+    const auto output = Analyze(sql);
+    ASSERT_NE(output, nullptr);
+    AddFunction(output->resolved_statement());
+  }
+};
+
+TEST_F(ColumnLineageTest, CreateTableAsSelect) {
+  const StatementLineage lineage =
+      Lineage("CREATE TABLE t AS SELECT x + y AS s, x FROM a");
+  EXPECT_EQ(lineage.target, "t");
+  ASSERT_EQ(lineage.columns.size(), 2);
+  EXPECT_EQ(lineage.columns[0].name, "s");
+  EXPECT_EQ(lineage.columns[0].sources, Sources({"a.x", "a.y"}));
+  EXPECT_EQ(lineage.columns[1].name, "x");
+  EXPECT_EQ(lineage.columns[1].sources, Sources({"a.x"}));
+  EXPECT_TRUE(lineage.filters.empty());
+}
+
+TEST_F(ColumnLineageTest, LooksThroughWithClausesAndAggregations) {
+  const StatementLineage lineage =
+      Lineage("CREATE TABLE t AS WITH w AS (SELECT x, y FROM a) "
+              "SELECT x, SUM(y) AS s FROM w GROUP BY x");
+  ASSERT_EQ(lineage.columns.size(), 2);
+  EXPECT_EQ(lineage.columns[0].sources, Sources({"a.x"}));
+  EXPECT_EQ(lineage.columns[1].sources, Sources({"a.y"}));
+}
+
+TEST_F(ColumnLineageTest, InsertSelect) {
+  const StatementLineage lineage =
+      Lineage("INSERT INTO b (x, y) SELECT y, x FROM a");
+  EXPECT_EQ(lineage.target, "b");
+  ASSERT_EQ(lineage.columns.size(), 2);
+  EXPECT_EQ(lineage.columns[0].name, "x");
+  EXPECT_EQ(lineage.columns[0].sources, Sources({"a.y"}));
+  EXPECT_EQ(lineage.columns[1].name, "y");
+  EXPECT_EQ(lineage.columns[1].sources, Sources({"a.x"}));
+}
+
+TEST_F(ColumnLineageTest, InsertValues) {
+  const StatementLineage lineage =
+      Lineage("INSERT INTO b (x) VALUES (1), ((SELECT MAX(y) FROM a))");
+  EXPECT_EQ(lineage.target, "b");
+  ASSERT_EQ(lineage.columns.size(), 1);
+  EXPECT_EQ(lineage.columns[0].sources, Sources({"a.y"}));
+}
+
+TEST_F(ColumnLineageTest, JoinConditionsAreFilters) {
+  const StatementLineage lineage =
+      Lineage("SELECT a.y AS a_y, b.y AS b_y FROM a JOIN b ON a.x = b.x");
+  EXPECT_EQ(lineage.target, "");
+  ASSERT_EQ(lineage.columns.size(), 2);
+  EXPECT_EQ(lineage.columns[0].sources, Sources({"a.y"}));
+  EXPECT_EQ(lineage.columns[1].sources, Sources({"b.y"}));
+  EXPECT_EQ(lineage.filters, Sources({"a.x", "b.x"}));
+}
+
+TEST_F(ColumnLineageTest, FiltersApplyToEveryWrittenColumn) {
+  const StatementLineage lineage =
+      Lineage("CREATE TABLE t AS SELECT x, (SELECT MAX(y) FROM b WHERE x > 0) "
+              "AS m FROM a WHERE y > 0");
+  ASSERT_EQ(lineage.columns.size(), 2);
+  EXPECT_EQ(lineage.columns[0].sources, Sources({"a.x"}));
+  EXPECT_EQ(lineage.columns[1].sources, Sources({"b.y"}));
+  // Filters of the subquery are not told apart from those of the query.
+  EXPECT_EQ(lineage.filters, Sources({"a.y", "b.x"}));
+}
+
+TEST_F(ColumnLineageTest, UnionMergesTheSourcesOfEachColumn) {
+  const StatementLineage lineage =
+      Lineage("CREATE TABLE t AS SELECT x FROM a UNION ALL SELECT y FROM b");
+  ASSERT_EQ(lineage.columns.size(), 1);
+  EXPECT_EQ(lineage.columns[0].sources, Sources({"a.x", "b.y"}));
+}
+
+TEST_F(ColumnLineageTest, TableFunctionsAreOpaque) {
+  AddTableFunction("CREATE TABLE FUNCTION f(n INT64) AS "
+                   "SELECT x + n AS x FROM a");
+  const StatementLineage lineage =
+      Lineage("CREATE TABLE t AS SELECT x FROM f((SELECT MAX(y) FROM b))");
+  ASSERT_EQ(lineage.columns.size(), 1);
+  // Computed from the argument, not from the tables read in the body.
+  EXPECT_EQ(lineage.columns[0].sources, Sources({"b.y"}));
+}
+
+TEST_F(ColumnLineageTest, StatementsWritingNoColumnsAreIgnored) {
+  const StatementLineage lineage = Lineage("DELETE FROM a WHERE x > 0");
+  EXPECT_TRUE(lineage.columns.empty());
+}
+
+TEST_F(ColumnLineageTest, WriteGraph) {
+  ColumnLineage column_lineage;
+  auto output = Analyze("CREATE TABLE t AS SELECT x FROM a WHERE y > 0");
+  ASSERT_NE(output, nullptr);
+  ASSERT_TRUE(
+      column_lineage.AddStatement("t.sql", output->resolved_statement()).ok());
+  output = Analyze("SELECT y FROM b");
+  ASSERT_NE(output, nullptr);
+  ASSERT_TRUE(
+      column_lineage.AddStatement("q.sql", output->resolved_statement()).ok());
+
+  const std::string path = testing::TempDir() + "/lineage.dot";
+  ASSERT_TRUE(column_lineage.WriteGraph(path));
+  std::ifstream in(path);
+  std::stringstream dot;
+  dot << in.rdbuf();
+  for (const std::string label :
+       {"a.x", "a.y", "t.x", "b.y", "t.sql", "q.sql"}) {
+    EXPECT_NE(dot.str().find(label), std::string::npos) << label;
+  }
+  EXPECT_NE(dot.str().find("filter"), std::string::npos);
+  EXPECT_NE(dot.str().find("value"), std::string::npos);
+}
+
+} // namespace
+} // namespace alphasql
@@ -14,6 +14,9 @@
 // limitations under the License.
 //
 
+#ifndef ALPHASQL_COMMON_LIB_H_
+#define ALPHASQL_COMMON_LIB_H_
+
 #include "zetasql/parser/bison_parser.h"
 #include "zetasql/parser/bison_parser_mode.h"
 #include "zetasql/parser/parse_tree.h"
@@ -25,11 +28,11 @@ using namespace zetasql::parser;
 using zetasql::parser::BisonParser;
 using zetasql::parser::BisonParserMode;
 
-absl::Status ParseScript(absl::string_view script_string,
-                         const ParserOptions &parser_options_in,
-                         ErrorMessageMode error_message_mode,
-                         std::unique_ptr<ParserOutput> *output,
-                         const std::string &filename) {
+inline absl::Status ParseScript(absl::string_view script_string,
+                                const ParserOptions &parser_options_in,
+                                ErrorMessageMode error_message_mode,
+                                std::unique_ptr<ParserOutput> *output,
+                                const std::string &filename) {
   ParserOptions parser_options = parser_options_in;
   parser_options.CreateDefaultArenasIfNotSet();
 
@@ -58,3 +61,5 @@ absl::Status ParseScript(absl::string_view script_string,
 }
 
 } // namespace alphasql
+
+#endif // ALPHASQL_COMMON_LIB_H_
@@ -0,0 +1,312 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/cost_estimator.h"
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <utility>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "alphasql/column_lineage.h"
+#include "boost/property_tree/json_parser.hpp"
+#include "boost/property_tree/ptree.hpp"
+#include "zetasql/base/status_macros.h"
+#include "zetasql/resolved_ast/resolved_ast_visitor.h"
+
+namespace alphasql {
+
+using namespace zetasql;
+
+namespace {
+
+// Bytes assumed for values of variable length without statistics.
+constexpr int64_t kDefaultVariableLengthBytes = 32;
+// Elements assumed for arrays without statistics.
+constexpr int64_t kDefaultArrayLength = 4;
+
+// Logical size of a value of <type> as BigQuery defines it, assuming default
+// lengths for strings, bytes and arrays.
+int64_t DefaultValueBytes(const Type *type) {
+  switch (type->kind()) {
+  case TYPE_BOOL:
+    return 1;
+  case TYPE_NUMERIC:
+    return 16;
+  case TYPE_STRING:
+  case TYPE_BYTES:
+    return 2 + kDefaultVariableLengthBytes;
+  case TYPE_GEOGRAPHY:
+    return 16 + 24 * kDefaultArrayLength;
+  case TYPE_ARRAY:
+    return kDefaultArrayLength *
+           DefaultValueBytes(type->AsArray()->element_type());
+  case TYPE_STRUCT: {
+    int64_t bytes = 0;
+    for (const StructField &field : type->AsStruct()->fields()) {
+      bytes += DefaultValueBytes(field.type);
+    }
+    return bytes;
+  }
+  default:
+    return 8;
+  }
+}
+
+// Splits "<table>.<column>" at the last dot, since only table names contain
+// dots.
+std::pair<std::string, std::string> SplitSource(const std::string &source) {
+  const size_t dot = source.rfind('.');
+  return {absl::AsciiStrToLower(source.substr(0, dot)),
+          absl::AsciiStrToLower(source.substr(dot + 1))};
+}
+
+// Collects the columns scanned from each table, keyed by lowercased names,
+// skipping the scan of the table a statement only writes to.
+class ScanCollector : public ResolvedASTVisitor {
+public:
+  explicit ScanCollector(const ResolvedTableScan *target = nullptr)
+      : target_(target) {}
+
+  absl::Status VisitResolvedTableScan(const ResolvedTableScan *node) override {
+    if (node == target_) {
+      return DefaultVisit(node);
+    }
+    std::set<std::string> &columns =
+        scanned_[absl::AsciiStrToLower(node->table()->Name())];
+    for (int i = 0; i < node->column_list_size(); ++i) {
+      std::string column_name = node->column_list(i).name();
+      if (i < node->column_index_list_size()) {
+        column_name =
+            node->table()->GetColumn(node->column_index_list(i))->Name();
+      }
+      columns.insert(absl::AsciiStrToLower(column_name));
+    }
+    return DefaultVisit(node);
+  }
+
+  const std::map<std::string, std::set<std::string>> &scanned() const {
+    return scanned_;
+  }
+
+private:
+  const ResolvedTableScan *target_;
+  std::map<std::string, std::set<std::string>> scanned_;
+};
+
+// Returns the scan of the table <statement> writes to without being charged
+// for it, or nullptr. UPDATE, DELETE and MERGE are charged for the columns of
+// the target they reference, so their scans are kept.
+const ResolvedTableScan *TargetScan(const ResolvedStatement *statement) {
+  switch (statement->node_kind()) {
+  case RESOLVED_INSERT_STMT:
+    return statement->GetAs<ResolvedInsertStmt>()->table_scan();
+  case RESOLVED_TRUNCATE_STMT:
+    return statement->GetAs<ResolvedTruncateStmt>()->table_scan();
+  default:
+    return nullptr;
+  }
+}
+
+} // namespace
+
+absl::Status CostEstimator::ReadStats(const std::string &path) {
+  using namespace boost;
+  property_tree::ptree pt;
+  absl::flat_hash_map<std::string, TableStats> tables;
+  try {
+    property_tree::read_json(path, pt);
+    for (const auto &[table_name, table] : pt) {
+      TableStats &stats = tables[absl::AsciiStrToLower(table_name)];
+      stats.rows = table.get<int64_t>("rows", 0);
+      const auto columns = table.get_child_optional("columns");
+      if (!columns) {
+        continue;
+      }
+      for (const auto &[column_name, bytes] : *columns) {
+        stats.column_bytes[absl::AsciiStrToLower(column_name)] =
+            bytes.get_value<int64_t>();
+      }
+    }
+  } catch (const property_tree::ptree_error &error) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Invalid table statistics: ", error.what(), " [at ", path, ":1:1]"));
+  }
+  absl::MutexLock l(&mutex_);
+  for (auto &[table_name, stats] : tables) {
+    tables_[table_name] = std::move(stats);
+  }
+  return absl::OkStatus();
+}
+
+absl::Status
+CostEstimator::AddStatement(const std::string &path,
+                            const ResolvedStatement *statement) {
+  ScanCollector scans(TargetScan(statement));
+  ZETASQL_RETURN_IF_ERROR(statement->Accept(&scans));
+  StatementLineage lineage;
+  ZETASQL_RETURN_IF_ERROR(GetStatementLineage(statement, &lineage));
+
+  absl::MutexLock l(&mutex_);
+  CostEstimate &estimate = estimates_[path];
+  int64_t rows = 0;
+  for (const auto &[table_name, columns] : scans.scanned()) {
+    const auto it = tables_.find(table_name);
+    if (it == tables_.end()) {
+      estimate.unknown_tables.insert(table_name);
+      continue;
+    }
+    rows = std::max(rows, it->second.rows);
+    for (const std::string &column : columns) {
+      const auto bytes = it->second.column_bytes.find(column);
+      if (bytes != it->second.column_bytes.end()) {
+        estimate.bytes_scanned += bytes->second;
+      }
+    }
+  }
+
+  const auto kind = statement->node_kind();
+  if (kind != RESOLVED_CREATE_TABLE_STMT &&
+      kind != RESOLVED_CREATE_TABLE_AS_SELECT_STMT &&
+      kind != RESOLVED_INSERT_STMT) {
+    return absl::OkStatus();
+  }
+  if (kind == RESOLVED_CREATE_TABLE_STMT) {
+    // Created empty.
+    tables_[absl::AsciiStrToLower(
+        absl::StrJoin(statement->GetAs<ResolvedCreateTableStmt>()->name_path(),
+                      "."))] = TableStats();
+    return absl::OkStatus();
+  }
+  if (scans.scanned().empty()) {
+    // Literal rows only.
+    rows = kind == RESOLVED_INSERT_STMT
+               ? statement->GetAs<ResolvedInsertStmt>()->row_list_size()
+               : 1;
+  }
+  TableStats written;
+  written.rows = rows;
+  for (const ColumnSources &column : lineage.columns) {
+    // The widest source is taken as the size of the values computed from it.
+    int64_t bytes_per_row = 0;
+    bool known = false;
+    for (const std::string &source : column.sources) {
+      const auto [table_name, column_name] = SplitSource(source);
+      const auto table = tables_.find(table_name);
+      if (table == tables_.end() || table->second.rows == 0) {
+        continue;
+      }
+      const auto bytes = table->second.column_bytes.find(column_name);
+      if (bytes == table->second.column_bytes.end()) {
+        continue;
+      }
+      bytes_per_row =
+          std::max(bytes_per_row, bytes->second / table->second.rows);
+      known = true;
+    }
+    if (!known) {
+      bytes_per_row = DefaultValueBytes(column.type);
+    }
+    written.column_bytes[absl::AsciiStrToLower(column.name)] =
+        bytes_per_row * rows;
+  }
+
+  TableStats &target = tables_[absl::AsciiStrToLower(lineage.target)];
+  if (kind == RESOLVED_CREATE_TABLE_AS_SELECT_STMT) {
+    target = std::move(written);
+    return absl::OkStatus();
+  }
+  target.rows += written.rows;
+  for (const auto &[column_name, bytes] : written.column_bytes) {
+    target.column_bytes[column_name] += bytes;
+  }
+  return absl::OkStatus();
+}
+
+CostEstimate CostEstimator::Estimate(const std::string &path) const {
+  absl::MutexLock l(&mutex_);
+  const auto it = estimates_.find(path);
+  return it != estimates_.end() ? it->second : CostEstimate();
+}
+
+bool CostEstimator::EstimatedRows(const std::string &table_name,
+                                  int64_t *rows) const {
+  absl::MutexLock l(&mutex_);
+  const auto it = tables_.find(absl::AsciiStrToLower(table_name));
+  if (it == tables_.end()) {
+    return false;
+  }
+  *rows = it->second.rows;
+  return true;
+}
+
+bool CostEstimator::EstimatedBytes(const std::string &table_name,
+                                   int64_t *bytes) const {
+  absl::MutexLock l(&mutex_);
+  const auto it = tables_.find(absl::AsciiStrToLower(table_name));
+  if (it == tables_.end()) {
+    return false;
+  }
+  *bytes = 0;
+  for (const auto &[column_name, column_bytes] : it->second.column_bytes) {
+    *bytes += column_bytes;
+  }
+  return true;
+}
+
+bool CostEstimator::EstimatedBytes(const std::string &table_name,
+                                   const std::string &column_name,
+                                   int64_t *bytes) const {
+  absl::MutexLock l(&mutex_);
+  const auto it = tables_.find(absl::AsciiStrToLower(table_name));
+  if (it == tables_.end()) {
+    return false;
+  }
+  const auto column =
+      it->second.column_bytes.find(absl::AsciiStrToLower(column_name));
+  if (column == it->second.column_bytes.end()) {
+    return false;
+  }
+  *bytes = column->second;
+  return true;
+}
+
+int64_t CostEstimator::ScanBytes(const ResolvedNode *node) const {
+  ScanCollector scans;
+  if (!node->Accept(&scans).ok()) {
+    return 0;
+  }
+  absl::MutexLock l(&mutex_);
+  int64_t bytes_scanned = 0;
+  for (const auto &[table_name, columns] : scans.scanned()) {
+    const auto it = tables_.find(table_name);
+    if (it == tables_.end()) {
+      continue;
+    }
+    for (const std::string &column : columns) {
+      const auto bytes = it->second.column_bytes.find(column);
+      if (bytes != it->second.column_bytes.end()) {
+        bytes_scanned += bytes->second;
+      }
+    }
+  }
+  return bytes_scanned;
+}
+
+} // namespace alphasql
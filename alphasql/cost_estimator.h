@@ -0,0 +1,95 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_COST_ESTIMATOR_H_
+#define ALPHASQL_COST_ESTIMATOR_H_
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "zetasql/base/status.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+
+namespace alphasql {
+
+// Size of a table, as given in a statistics file or estimated for tables
+// created in the pipeline.
+struct TableStats {
+  int64_t rows = 0;
+  // Total bytes of each column keyed by lowercased name.
+  absl::flat_hash_map<std::string, int64_t> column_bytes;
+};
+
+// Estimated cost of a file.
+struct CostEstimate {
+  int64_t bytes_scanned = 0;
+  // Scanned tables without statistics, which count as empty.
+  std::set<std::string> unknown_tables;
+};
+
+// Estimates the bytes BigQuery would bill for scanning, offline.
+//
+// Like BigQuery, a statement is charged for every column it references of
+// every table it scans, except the table INSERT writes to, so the resolved
+// statements must be analyzed with unused columns pruned. Sizes of tables
+// created by CREATE TABLE AS SELECT and appended to by INSERT are estimated
+// from the columns their values are computed from, taking the row count of
+// the largest scanned table, so that downstream statements can be charged for
+// them too. Statements must be added in an order where upstream files come
+// first. This class is thread-safe.
+class CostEstimator {
+public:
+  // Reads the statistics of source tables from the JSON file at <path>, a map
+  // keyed by table name of objects with the number of "rows" and a "columns"
+  // map of total bytes keyed by column name.
+  absl::Status ReadStats(const std::string &path);
+
+  // Charges the scans of <statement> to the file at <path> and estimates the
+  // size of the table it writes, if any.
+  absl::Status AddStatement(const std::string &path,
+                            const zetasql::ResolvedStatement *statement);
+
+  // The estimate of the file at <path>, empty if it scanned nothing.
+  CostEstimate Estimate(const std::string &path) const;
+
+  // Sets <rows> to the known or estimated number of rows of <table_name>.
+  // Returns false if there are no statistics for it.
+  bool EstimatedRows(const std::string &table_name, int64_t *rows) const;
+
+  // Sets <bytes> to the known or estimated size of <table_name>, or of its
+  // column <column_name>. Returns false if there are no statistics for it.
+  bool EstimatedBytes(const std::string &table_name, int64_t *bytes) const;
+  bool EstimatedBytes(const std::string &table_name,
+                      const std::string &column_name, int64_t *bytes) const;
+
+  // Bytes the table scans under <node> read, counting tables without
+  // statistics as empty.
+  int64_t ScanBytes(const zetasql::ResolvedNode *node) const;
+
+private:
+  mutable absl::Mutex mutex_;
+  // Keyed by lowercased table name.
+  absl::flat_hash_map<std::string, TableStats> tables_ ABSL_GUARDED_BY(mutex_);
+  std::map<std::string, CostEstimate> estimates_ ABSL_GUARDED_BY(mutex_);
+};
+
+} // namespace alphasql
+
+#endif // ALPHASQL_COST_ESTIMATOR_H_
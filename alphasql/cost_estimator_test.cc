@@ -0,0 +1,171 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "alphasql/cost_estimator.h"
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <string>
+
+#include "alphasql/analysis_test_util.h"
+#include "gtest/gtest.h"
+
+namespace alphasql {
+namespace {
+
+using namespace zetasql;
+
+// Writes <content> to a file in the test directory and returns its path.
+std::string WriteStats(const std::string &name, const std::string &content) {
+  const std::string path = testing::TempDir() + "/" + name;
+  std::ofstream(path) << content;
+  return path;
+}
+
+class CostEstimatorTest : public AnalysisTest {
+protected:
+  CostEstimatorTest() {
+    AddTable("t", {"x", "z"});
+    const absl::Status status = estimator_.ReadStats(WriteStats(
+        "stats.json",
+        R"({"A": {"rows": 100, "columns": {"X": 800, "y": 1600}}})"));
+    EXPECT_TRUE(status.ok()) << status;
+  }
+
+  void Add(const std::string &path, const std::string &sql) {
+    const auto output = Analyze(sql);
+    ASSERT_NE(output, nullptr);
+    const absl::Status status =
+        estimator_.AddStatement(path, output->resolved_statement());
+    ASSERT_TRUE(status.ok()) << status;
+  }
+
+  int64_t Rows(const std::string &table_name) {
+    int64_t rows = -1;
+    EXPECT_TRUE(estimator_.EstimatedRows(table_name, &rows)) << table_name;
+    return rows;
+  }
+
+  int64_t Bytes(const std::string &table_name,
+                const std::string &column_name = "") {
+    int64_t bytes = -1;
+    if (column_name.empty()) {
+      EXPECT_TRUE(estimator_.EstimatedBytes(table_name, &bytes));
+    } else {
+      EXPECT_TRUE(estimator_.EstimatedBytes(table_name, column_name, &bytes));
+    }
+    return bytes;
+  }
+
+  CostEstimator estimator_;
+};
+
+TEST_F(CostEstimatorTest, ReadStats) {
+  EXPECT_EQ(Rows("a"), 100);
+  EXPECT_EQ(Bytes("a"), 2400);
+  EXPECT_EQ(Bytes("A", "x"), 800);
+  EXPECT_EQ(Bytes("a", "Y"), 1600);
+  int64_t bytes;
+  EXPECT_FALSE(estimator_.EstimatedBytes("b", &bytes));
+  EXPECT_FALSE(estimator_.EstimatedBytes("a", "z", &bytes));
+}
+
+TEST_F(CostEstimatorTest, ReadStatsReplacesTablesAndKeepsOthers) {
+  ASSERT_TRUE(estimator_
+                  .ReadStats(WriteStats(
+                      "more_stats.json",
+                      R"({"b": {"rows": 10}, "a": {"rows": 1}})"))
+                  .ok());
+  EXPECT_EQ(Rows("a"), 1);
+  EXPECT_EQ(Bytes("a"), 0);
+  EXPECT_EQ(Rows("b"), 10);
+}
+
+TEST_F(CostEstimatorTest, ReadStatsRejectsInvalidFiles) {
+  const std::string path = WriteStats("invalid.json", "{");
+  const absl::Status status = estimator_.ReadStats(path);
+  EXPECT_EQ(status.code(), absl::StatusCode::kInvalidArgument);
+  EXPECT_NE(status.message().find(path), std::string::npos) << status;
+  // Statistics read before are kept.
+  EXPECT_EQ(Rows("a"), 100);
+}
+
+TEST_F(CostEstimatorTest, ChargesReferencedColumns) {
+  Add("q.sql", "SELECT x FROM a WHERE x > 0");
+  const CostEstimate estimate = estimator_.Estimate("q.sql");
+  EXPECT_EQ(estimate.bytes_scanned, 800);
+  EXPECT_TRUE(estimate.unknown_tables.empty());
+  EXPECT_EQ(estimator_.Estimate("other.sql").bytes_scanned, 0);
+}
+
+TEST_F(CostEstimatorTest, TablesWithoutStatsCountAsEmpty) {
+  Add("q.sql", "SELECT a.y, b.y FROM a JOIN b USING (x)");
+  const CostEstimate estimate = estimator_.Estimate("q.sql");
+  EXPECT_EQ(estimate.bytes_scanned, 2400);
+  EXPECT_EQ(estimate.unknown_tables, std::set<std::string>({"b"}));
+}
+
+TEST_F(CostEstimatorTest, EstimatesAreSummedPerFile) {
+  Add("q.sql", "SELECT x FROM a");
+  Add("q.sql", "SELECT y FROM a");
+  EXPECT_EQ(estimator_.Estimate("q.sql").bytes_scanned, 2400);
+}
+
+TEST_F(CostEstimatorTest, PropagatesSizesThroughCreateTableAsSelect) {
+  Add("t.sql", "CREATE TABLE t AS SELECT x, y * 2 AS z FROM a");
+  EXPECT_EQ(Rows("t"), 100);
+  EXPECT_EQ(Bytes("t", "x"), 800);
+  EXPECT_EQ(Bytes("t", "z"), 1600);
+
+  Add("q.sql", "SELECT z FROM t");
+  EXPECT_EQ(estimator_.Estimate("q.sql").bytes_scanned, 1600);
+}
+
+TEST_F(CostEstimatorTest, InsertAppendsToTheTarget) {
+  Add("t.sql", "CREATE TABLE t (x INT64, z INT64)");
+  EXPECT_EQ(Rows("t"), 0);
+  Add("t.sql", "INSERT INTO t (x, z) VALUES (1, 2), (3, 4)");
+  EXPECT_EQ(Rows("t"), 2);
+  // Values without statistics take the size of their type.
+  EXPECT_EQ(Bytes("t", "x"), 16);
+  Add("t.sql", "INSERT INTO t (x, z) SELECT x, y FROM a");
+  EXPECT_EQ(Rows("t"), 102);
+  EXPECT_EQ(Bytes("t", "x"), 816);
+  EXPECT_EQ(Bytes("t", "z"), 1616);
+}
+
+TEST_F(CostEstimatorTest, InsertIsNotChargedForItsTarget) {
+  ASSERT_TRUE(estimator_
+                  .ReadStats(WriteStats(
+                      "b_stats.json",
+                      R"({"b": {"rows": 10, "columns": {"x": 80, "y": 80}}})"))
+                  .ok());
+  Add("q.sql", "INSERT INTO a (x, y) SELECT x, y FROM b");
+  const CostEstimate estimate = estimator_.Estimate("q.sql");
+  EXPECT_EQ(estimate.bytes_scanned, 160);
+  EXPECT_TRUE(estimate.unknown_tables.empty());
+  EXPECT_EQ(Rows("a"), 110);
+}
+
+TEST_F(CostEstimatorTest, ScanBytes) {
+  const auto output = Analyze("SELECT a.y FROM a, b");
+  ASSERT_NE(output, nullptr);
+  EXPECT_EQ(estimator_.ScanBytes(output->resolved_statement()), 1600);
+}
+
+} // namespace
+} // namespace alphasql
@@ -15,26 +15,43 @@
 //
 
 #include <filesystem>
+#include <regex>
+#include <system_error>
 
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
 #include "absl/strings/str_join.h"
+#include "alphasql/allocation_accounting.h"
+#include "alphasql/diagnostics.h"
+#include "alphasql/execution_plan.h"
 #include "alphasql/identifier_resolver.h"
+#include "alphasql/sql_file.h"
 #include "boost/graph/depth_first_search.hpp"
 #include "boost/graph/graphviz.hpp"
 #include "zetasql/base/logging.h"
 #include "zetasql/base/status.h"
 #include "zetasql/base/statusor.h"
 #include "zetasql/public/analyzer.h"
+#include "zetasql/public/error_helpers.h"
 #include "zetasql/resolved_ast/resolved_ast.h"
 
 typedef std::pair<std::string, std::string> Edge;
 
+std::regex DEFAULT_EXCLUDES(".*(.git/.*|.hg/.*|.svn/.*)");
+
 ABSL_FLAG(std::string, output_path, "", "Output path for DAG.");
 ABSL_FLAG(std::string, external_required_tables_output_path, "",
           "Output path for external required tables.");
 
+ABSL_FLAG(bool, with_tables, false, "Show DAG with tables.");
+
+ABSL_FLAG(bool, with_functions, false, "Show DAG with functions.");
+
+ABSL_FLAG(bool, side_effect_first, false,
+          "Resolve side effects before references.");
+
 struct table_queries {
   std::string create;
   std::string drop;
@@ -53,18 +70,39 @@ namespace alphasql {
 
 using namespace zetasql;
 
+bool IsSQLFile(const std::filesystem::path &file_path) {
+  return file_path.extension() == ".bq" || file_path.extension() == ".sql";
+}
+
+// <parsed_file> is the file at <file_path> as read, and possibly parsed, while
+// indexing procedures, null for files that are not SQL. CALL statements are
+// resolved against <procedures>, which must index the procedures of every
+// file. If <sql_file> is not null, the file read and parsed is moved into it,
+// so that later stages do not have to read and parse it again. It is left null
+// for files that are not SQL.
 absl::Status UpdateIdentifierQueriesMapsAndVertices(
     const std::filesystem::path &file_path,
+    std::unique_ptr<SQLFile> parsed_file,
+    const identifier_resolver::ProcedureIndex &procedures,
     std::map<std::string, table_queries> &table_queries_map,
     std::map<std::string, function_queries> &function_queries_map,
-    std::set<std::string> &vertices) {
-  if (file_path.extension() != ".bq" && file_path.extension() != ".sql") {
+    std::set<std::string> &vertices,
+    std::unique_ptr<SQLFile> *sql_file = nullptr) {
+  if (!IsSQLFile(file_path)) {
     return absl::OkStatus();
   }
-  std::cout << "Reading " << file_path << std::endl;
+  if (ShowProgress()) {
+    std::cout << "Reading " << file_path << '\n';
+  }
 
+  if (identifier_resolver::ParsesWholeFiles()) {
+    ScopedAllocationPhase phase(AllocationPhase::kParse);
+    ZETASQL_RETURN_IF_ERROR(
+        ParseSQLFile(GetAnalyzerOptions(), parsed_file.get()));
+  }
+  ScopedAllocationPhase phase(AllocationPhase::kResolve);
   const auto identifier_information_or_status =
-      identifier_resolver::GetIdentifierInformation(file_path.string());
+      identifier_resolver::GetIdentifierInformation(*parsed_file, procedures);
   if (!identifier_information_or_status.ok()) {
     return identifier_information_or_status.status();
   }
@@ -165,6 +203,103 @@ absl::Status UpdateIdentifierQueriesMapsAndVertices(
   // Add the file as a vertice.
   vertices.insert(file_path);
 
+  if (sql_file != nullptr) {
+    *sql_file = std::move(parsed_file);
+  }
+  return absl::OkStatus();
+}
+
+// Calls UpdateIdentifierQueriesMapsAndVertices for every file at <paths>,
+// walking directories recursively in sorted order, once the procedures of all
+// of them are indexed. Parsed files are kept in <sql_files> keyed by path if
+// it is not null; otherwise each file is freed once resolved.
+absl::Status UpdateIdentifierQueriesMapsAndVerticesFromPaths(
+    const std::vector<char *> &paths,
+    std::map<std::string, table_queries> &table_queries_map,
+    std::map<std::string, function_queries> &function_queries_map,
+    std::set<std::string> &vertices,
+    std::map<std::string, std::unique_ptr<SQLFile>> *sql_files = nullptr) {
+  ScopedAllocationPhase discovery_phase(AllocationPhase::kDiscovery);
+  std::smatch m;
+  // Files along with the path they were found at.
+  std::vector<std::pair<std::filesystem::path, const char *>> files;
+  for (const auto &path : paths) {
+    if (std::filesystem::is_regular_file(path)) {
+      std::filesystem::path file_path(path);
+      std::string path_str = file_path.string();
+      if (regex_match(path_str, m, DEFAULT_EXCLUDES)) {
+        continue;
+      }
+      files.emplace_back(file_path, path);
+      continue;
+    }
+    std::vector<std::filesystem::path> files_in_directory;
+    std::copy(std::filesystem::recursive_directory_iterator(path, std::filesystem::directory_options::skip_permission_denied), std::filesystem::recursive_directory_iterator(), std::back_inserter(files_in_directory));
+    std::sort(files_in_directory.begin(), files_in_directory.end());
+    std::error_code err;
+    for (const std::filesystem::path & file_path : files_in_directory) {
+      std::string path_str = file_path.string();
+      if (regex_match(path_str, m, DEFAULT_EXCLUDES)) {
+        continue;
+      }
+      if (err) {
+        Report(MakeDiagnostic(Severity::kWarning, err.message(),
+                              absl::OkStatus(), path_str),
+               absl::StrCat("WARNING: ", err.category().name(), ":",
+                            err.value()),
+               std::cout);
+      }
+      files.emplace_back(file_path, path);
+    }
+  }
+
+  // Procedures are indexed in a first pass, so that memory stays bounded by
+  // the largest file rather than the whole repository. Only the few files
+  // that may define procedures are kept, parsed, for the second pass when
+  // files are parsed whole anyway; the others are read again there.
+  identifier_resolver::ProcedureIndex procedures;
+  std::vector<std::unique_ptr<SQLFile>> kept_files(files.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (!IsSQLFile(files[i].first)) {
+      continue;
+    }
+    auto sql_file = absl::make_unique<SQLFile>();
+    ReadSQLFile(files[i].first.string(), sql_file.get());
+    if (!identifier_resolver::MayDefineProcedures(*sql_file)) {
+      continue;
+    }
+    ScopedAllocationPhase parse_phase(AllocationPhase::kParse);
+    // Errors are reported in order when the file itself is resolved below.
+    if (identifier_resolver::ParsesWholeFiles()) {
+      ParseSQLFile(GetAnalyzerOptions(), sql_file.get()).IgnoreError();
+      kept_files[i] = std::move(sql_file);
+      identifier_resolver::IndexProcedures(*kept_files[i], &procedures)
+          .IgnoreError();
+    } else {
+      identifier_resolver::IndexProcedures(*sql_file, &procedures)
+          .IgnoreError();
+    }
+  }
+
+  for (size_t i = 0; i < files.size(); ++i) {
+    const auto &[file_path, path] = files[i];
+    std::unique_ptr<SQLFile> read_file = std::move(kept_files[i]);
+    if (read_file == nullptr && IsSQLFile(file_path)) {
+      read_file = absl::make_unique<SQLFile>();
+      ReadSQLFile(file_path.string(), read_file.get());
+    }
+    std::unique_ptr<SQLFile> sql_file;
+    absl::Status status = UpdateIdentifierQueriesMapsAndVertices(
+        file_path, std::move(read_file), procedures, table_queries_map,
+        function_queries_map, vertices,
+        sql_files != nullptr ? &sql_file : nullptr);
+    if (!status.ok()) {
+      return UpdateErrorLocationPayloadWithFilenameIfNotPresent(status, path);
+    }
+    if (sql_file != nullptr) {
+      (*sql_files)[file_path.string()] = std::move(sql_file);
+    }
+  }
   return absl::OkStatus();
 }
 
@@ -176,15 +311,258 @@ void UpdateEdges(std::vector<Edge> &depends_on,
     depends_on.push_back(std::make_pair(dep, parent));
   }
 }
-} // namespace alphasql
 
-struct cycle_detector : public boost::dfs_visitor<> {
-  cycle_detector(bool &has_cycle) : _has_cycle(has_cycle) {}
+// Builds the dependency graph of the files read into the maps, in which edges
+// point from each file to the files that depend on it. Tables that no file
+// creates are added to <external_required_tables>.
+void BuildDependencyGraph(
+    std::map<std::string, table_queries> &table_queries_map,
+    const std::map<std::string, function_queries> &function_queries_map,
+    const std::set<std::string> &vertices, bool with_tables,
+    bool with_functions, bool side_effect_first, DAGGraph *graph,
+    std::vector<std::string> *external_required_tables) {
+  ScopedAllocationPhase phase(AllocationPhase::kGraph);
+  std::vector<Edge> depends_on;
+  std::set<std::string> table_vertices;
+  for (auto &[table_name, table_queries] : table_queries_map) {
+    if (side_effect_first) {
+      // Prevent self reference
+      auto inserts_it = table_queries.inserts.begin();
+      while (inserts_it != table_queries.inserts.end()) {
+        auto others_it = table_queries.others.begin();
+        while (others_it != table_queries.others.end()) {
+          if (*others_it == *inserts_it) {
+            others_it = table_queries.others.erase(others_it);
+          } else {
+            ++others_it;
+          }
+        }
+        if (*inserts_it == table_queries.create) {
+          inserts_it = table_queries.inserts.erase(inserts_it);
+        } else {
+          ++inserts_it;
+        }
+      }
+      auto updates_it = table_queries.updates.begin();
+      while (updates_it != table_queries.updates.end()) {
+        auto others_it = table_queries.others.begin();
+        while (others_it != table_queries.others.end()) {
+          if (*others_it == *updates_it) {
+            others_it = table_queries.others.erase(others_it);
+          } else {
+            ++others_it;
+          }
+        }
+        if (*updates_it == table_queries.create) {
+          updates_it = table_queries.updates.erase(updates_it);
+        } else {
+          ++updates_it;
+        }
+      }
 
-  template <class Edge, class Graph> void back_edge(Edge, Graph &) {
-    _has_cycle = true;
+      if (with_tables) {
+        UpdateEdges(depends_on, table_queries.others, table_name);
+        UpdateEdges(depends_on, table_queries.inserts, table_queries.create);
+        UpdateEdges(depends_on, table_queries.updates, table_queries.create);
+        for (const auto &insert : table_queries.inserts) {
+          UpdateEdges(depends_on, {table_name}, insert);
+        }
+        for (const auto &update : table_queries.updates) {
+          UpdateEdges(depends_on, {table_name}, update);
+        }
+        UpdateEdges(depends_on, {table_name}, table_queries.create);
+        table_vertices.insert(table_name);
+      } else {
+        for (const auto &insert : table_queries.inserts) {
+          UpdateEdges(depends_on, table_queries.others, insert);
+        }
+        for (const auto &update : table_queries.updates) {
+          UpdateEdges(depends_on, table_queries.others, update);
+        }
+        UpdateEdges(depends_on, table_queries.inserts, table_queries.create);
+        UpdateEdges(depends_on, table_queries.updates, table_queries.create);
+        UpdateEdges(depends_on, table_queries.others, table_queries.create);
+      }
+    } else {
+      if (with_tables) {
+        UpdateEdges(depends_on, table_queries.others, table_name);
+        UpdateEdges(depends_on, {table_name}, table_queries.create);
+        table_vertices.insert(table_name);
+      } else {
+        UpdateEdges(depends_on, table_queries.others, table_queries.create);
+      }
+    }
+    if (table_queries.create.empty()) {
+      external_required_tables->push_back(table_name);
+    }
   }
 
-protected:
-  bool &_has_cycle;
-};
+  std::set<std::string> function_vertices;
+  for (auto const &[function_name, function_queries] : function_queries_map) {
+    if (with_functions &&
+        !function_queries.create.empty()) { // Skip default functions
+      UpdateEdges(depends_on, function_queries.call, function_name);
+      UpdateEdges(depends_on, {function_name}, function_queries.create);
+      function_vertices.insert(function_name);
+    } else {
+      UpdateEdges(depends_on, function_queries.call, function_queries.create);
+    }
+  }
+
+  const int nedges = depends_on.size();
+
+  DAGGraph &g = *graph;
+  g = DAGGraph(vertices.size() + table_vertices.size() +
+               function_vertices.size());
+
+  std::map<std::string, DAGGraph::vertex_descriptor> indexes;
+  // fills the property 'vertex_name_t' of the vertices
+  int i = 0;
+  for (const auto &vertice : vertices) {
+    g[i].label = vertice; // set the property of a vertex
+    g[i].type = "query";
+    indexes[vertice] =
+        boost::vertex(i, g); // retrives the associated vertex descriptor
+    ++i;
+  }
+  for (const auto &vertice : table_vertices) {
+    g[i].label = vertice; // set the property of a vertex
+    g[i].type = "table";
+    g[i].shape = "box";
+    indexes[vertice] =
+        boost::vertex(i, g); // retrives the associated vertex descriptor
+    ++i;
+  }
+  for (const auto &vertice : function_vertices) {
+    g[i].label = vertice; // set the property of a vertex
+    g[i].type = "function";
+    g[i].shape = "cds";
+    indexes[vertice] =
+        boost::vertex(i, g); // retrives the associated vertex descriptor
+    ++i;
+  }
+
+  // adds the edges
+  for (int i = 0; i < nedges; i++) {
+    // Skip duplicates
+    if (boost::edge(indexes[depends_on[i].second],
+                    indexes[depends_on[i].first], g)
+            .second) {
+      continue;
+    }
+    boost::add_edge(indexes[depends_on[i].second],
+                    indexes[depends_on[i].first], g);
+  }
+}
+
+// Writes <g> in DOT to <output_path>, or to stdout if it is empty. Returns
+// false if <output_path> is not a file.
+bool WriteDAG(const DAGGraph &g, const std::string &output_path) {
+  ScopedAllocationPhase phase(AllocationPhase::kOutput);
+  boost::dynamic_properties dp;
+  dp.property("shape", get(&DAGVertex::shape, g));
+  dp.property("type", get(&DAGVertex::type, g));
+  dp.property("label", get(&DAGVertex::label, g));
+  dp.property("node_id", get(boost::vertex_index, g));
+  if (output_path.empty()) {
+    write_graphviz_dp(std::cout, g, dp);
+    return true;
+  }
+  if (std::filesystem::is_regular_file(output_path) ||
+      std::filesystem::is_fifo(output_path) ||
+      !std::filesystem::exists(output_path)) {
+    std::filesystem::path parent =
+        std::filesystem::path(output_path).parent_path();
+    if (!std::filesystem::is_directory(parent) && parent != "") {
+      // Ignore error code for empty directory
+      std::error_code ec;
+      std::filesystem::create_directories(parent, ec);
+    }
+    std::ofstream out(output_path);
+    write_graphviz_dp(out, g, dp);
+    return true;
+  }
+  return false;
+}
+
+// Writes the tables to <output_path>, or to stdout if it is empty. Returns
+// false if <output_path> is not a file.
+bool WriteExternalRequiredTables(
+    const std::vector<std::string> &external_required_tables,
+    const std::string &output_path) {
+  ScopedAllocationPhase phase(AllocationPhase::kOutput);
+  if (output_path.empty()) {
+    std::cout << "EXTERNAL REQUIRED TABLES:\n";
+    for (const auto &required_table : external_required_tables) {
+      std::cout << required_table << '\n';
+    }
+    return true;
+  }
+  if (std::filesystem::is_regular_file(output_path) ||
+      std::filesystem::is_fifo(output_path) ||
+      !std::filesystem::exists(output_path)) {
+    std::filesystem::path parent =
+        std::filesystem::path(output_path).parent_path();
+    if (!std::filesystem::is_directory(parent)) {
+      // Ignore error code for empty directory
+      std::error_code ec;
+      std::filesystem::create_directories(parent, ec);
+    }
+    std::ofstream out(output_path);
+    for (const auto &required_table : external_required_tables) {
+      out << required_table << '\n';
+    }
+    return true;
+  }
+  return false;
+}
+
+// Reads the SQL files under <paths>, builds their dependency graph into <g> and
+// writes the DAG and external required tables. With <write_to_stdout>, an
+// output whose path flag is empty goes to stdout; otherwise it is skipped.
+// Parsed files are moved into <sql_files> if it is not null. Returns the exit
+// code for main: 0 on success, 1 after reporting an error.
+int ExtractDAG(
+    const std::vector<char *> &paths, bool write_to_stdout, DAGGraph *g,
+    std::map<std::string, std::unique_ptr<SQLFile>> *sql_files = nullptr) {
+  std::map<std::string, table_queries> table_queries_map;
+  std::map<std::string, function_queries> function_queries_map;
+  std::set<std::string> vertices;
+  if (ShowProgress()) {
+    std::cout << "Reading paths passed as a command line arguments...\n"
+              << "Only files that end with .sql or .bq are analyzed.\n";
+  }
+  absl::Status status = UpdateIdentifierQueriesMapsAndVerticesFromPaths(
+      paths, table_queries_map, function_queries_map, vertices, sql_files);
+  if (!status.ok()) {
+    Report(MakeDiagnostic(Severity::kError, std::string(status.message()),
+                          status),
+           status.ToString(), std::cerr);
+    return 1;
+  }
+
+  std::vector<std::string> external_required_tables;
+  BuildDependencyGraph(table_queries_map, function_queries_map, vertices,
+                       absl::GetFlag(FLAGS_with_tables),
+                       absl::GetFlag(FLAGS_with_functions),
+                       absl::GetFlag(FLAGS_side_effect_first), g,
+                       &external_required_tables);
+
+  const std::string output_path = absl::GetFlag(FLAGS_output_path);
+  if ((write_to_stdout || !output_path.empty()) &&
+      !WriteDAG(*g, output_path)) {
+    std::cerr << "output_path is not a file!" << std::endl;
+    return 1;
+  }
+  const std::string external_required_tables_output_path =
+      absl::GetFlag(FLAGS_external_required_tables_output_path);
+  if ((write_to_stdout || !external_required_tables_output_path.empty()) &&
+      !WriteExternalRequiredTables(external_required_tables,
+                                   external_required_tables_output_path)) {
+    std::cerr << "external_required_tables_output_path is not a file!"
+              << std::endl;
+    return 1;
+  }
+  return 0;
+}
+} // namespace alphasql
@@ -0,0 +1,121 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/dag_scheduler.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace alphasql {
+
+std::vector<TaskState>
+RunDAG(const std::vector<std::vector<size_t>> &upstreams,
+       const std::function<bool(size_t)> &task, int jobs, bool keep_going) {
+  const size_t num_nodes = upstreams.size();
+  std::vector<TaskState> states(num_nodes, TaskState::kNotRun);
+  std::vector<std::vector<size_t>> downstreams(num_nodes);
+  std::vector<size_t> num_pending_upstreams(num_nodes);
+  for (size_t node = 0; node < num_nodes; ++node) {
+    num_pending_upstreams[node] = upstreams[node].size();
+    for (const size_t upstream : upstreams[node]) {
+      downstreams[upstream].push_back(node);
+    }
+  }
+
+  // Min-heap so that the earliest node in the plan is dispatched first.
+  std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>> ready;
+  for (size_t node = 0; node < num_nodes; ++node) {
+    if (num_pending_upstreams[node] == 0) {
+      ready.push(node);
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  int running = 0;
+  bool stopped = false;
+
+  auto skip_downstreams = [&](size_t failed) {
+    std::vector<size_t> stack(downstreams[failed]);
+    while (!stack.empty()) {
+      const size_t node = stack.back();
+      stack.pop_back();
+      if (states[node] == TaskState::kSkipped) {
+        continue;
+      }
+      states[node] = TaskState::kSkipped;
+      stack.insert(stack.end(), downstreams[node].begin(),
+                   downstreams[node].end());
+    }
+  };
+
+  auto worker = [&]() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      cv.wait(lock, [&] { return stopped || !ready.empty() || running == 0; });
+      if (stopped || ready.empty()) {
+        // Either a failure stopped the run, or nothing is ready and nothing
+        // is running, so nothing will ever become ready again.
+        return;
+      }
+      const size_t node = ready.top();
+      ready.pop();
+      ++running;
+
+      lock.unlock();
+      const bool ok = task(node);
+      lock.lock();
+
+      --running;
+      if (ok) {
+        states[node] = TaskState::kSucceeded;
+        for (const size_t downstream : downstreams[node]) {
+          if (--num_pending_upstreams[downstream] == 0 &&
+              states[downstream] == TaskState::kNotRun) {
+            ready.push(downstream);
+          }
+        }
+      } else {
+        states[node] = TaskState::kFailed;
+        if (keep_going) {
+          skip_downstreams(node);
+        } else {
+          stopped = true;
+        }
+      }
+      cv.notify_all();
+    }
+  };
+
+  if (jobs <= 1) {
+    worker();
+    return states;
+  }
+  std::vector<std::thread> workers;
+  for (int i = 0; i < jobs; ++i) {
+    workers.emplace_back(worker);
+  }
+  for (auto &thread : workers) {
+    thread.join();
+  }
+  return states;
+}
+
+} // namespace alphasql
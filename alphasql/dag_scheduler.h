@@ -0,0 +1,49 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_DAG_SCHEDULER_H_
+#define ALPHASQL_DAG_SCHEDULER_H_
+
+#include <functional>
+#include <vector>
+
+namespace alphasql {
+
+enum class TaskState {
+  kNotRun,    // Never dispatched, e.g. after a failure without keep_going.
+  kSucceeded,
+  kFailed,
+  kSkipped,   // An upstream task failed.
+};
+
+// Runs <task> once for each node of a DAG, given as the list of upstream
+// node indices of every node. Node indices must be a topological order.
+//
+// A node is dispatched as soon as all of its upstream nodes succeeded, on one
+// of <jobs> worker threads. When several nodes are ready the one with the
+// smallest index runs first, so with a single job the nodes run exactly in
+// index order on the calling thread.
+//
+// <task> returns false on failure. Without <keep_going> no further nodes are
+// dispatched after a failure (running ones are waited for); with it, only the
+// downstream nodes of the failed node are skipped.
+std::vector<TaskState>
+RunDAG(const std::vector<std::vector<size_t>> &upstreams,
+       const std::function<bool(size_t)> &task, int jobs, bool keep_going);
+
+} // namespace alphasql
+
+#endif // ALPHASQL_DAG_SCHEDULER_H_
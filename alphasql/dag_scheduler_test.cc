@@ -0,0 +1,103 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/dag_scheduler.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace alphasql {
+namespace {
+
+// 0 -> 2, 1 -> 2, 2 -> 3, 1 -> 4
+const std::vector<std::vector<size_t>> kUpstreams = {{}, {}, {0, 1}, {2}, {1}};
+
+TEST(RunDAG, SingleJobRunsInPlanOrder) {
+  std::vector<size_t> order;
+  const auto states = RunDAG(
+      kUpstreams,
+      [&](size_t node) {
+        order.push_back(node);
+        return true;
+      },
+      /*jobs=*/1, /*keep_going=*/false);
+  ASSERT_EQ(order, std::vector<size_t>({0, 1, 2, 3, 4}));
+  for (const auto state : states) {
+    ASSERT_EQ(state, TaskState::kSucceeded);
+  }
+}
+
+TEST(RunDAG, FailFast) {
+  std::vector<size_t> order;
+  const auto states = RunDAG(
+      kUpstreams,
+      [&](size_t node) {
+        order.push_back(node);
+        return node != 1;
+      },
+      /*jobs=*/1, /*keep_going=*/false);
+  ASSERT_EQ(order, std::vector<size_t>({0, 1}));
+  ASSERT_EQ(states[1], TaskState::kFailed);
+  ASSERT_EQ(states[2], TaskState::kNotRun);
+  ASSERT_EQ(states[4], TaskState::kNotRun);
+}
+
+TEST(RunDAG, KeepGoingSkipsOnlyDownstreams) {
+  const auto states = RunDAG(
+      kUpstreams, [&](size_t node) { return node != 0; },
+      /*jobs=*/1, /*keep_going=*/true);
+  ASSERT_EQ(states[0], TaskState::kFailed);
+  ASSERT_EQ(states[1], TaskState::kSucceeded);
+  ASSERT_EQ(states[2], TaskState::kSkipped);
+  ASSERT_EQ(states[3], TaskState::kSkipped);
+  ASSERT_EQ(states[4], TaskState::kSucceeded);
+}
+
+TEST(RunDAG, ParallelRespectsDependencies) {
+  // A wide diamond: 0 -> {1..n} -> n + 1.
+  const size_t width = 64;
+  std::vector<std::vector<size_t>> upstreams(width + 2);
+  for (size_t node = 1; node <= width; ++node) {
+    upstreams[node].push_back(0);
+    upstreams[width + 1].push_back(node);
+  }
+  std::mutex mutex;
+  std::vector<bool> finished(width + 2, false);
+  std::atomic<bool> violated(false);
+  const auto states = RunDAG(
+      upstreams,
+      [&](size_t node) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const size_t upstream : upstreams[node]) {
+          if (!finished[upstream]) {
+            violated = true;
+          }
+        }
+        finished[node] = true;
+        return true;
+      },
+      /*jobs=*/8, /*keep_going=*/false);
+  ASSERT_FALSE(violated);
+  for (const auto state : states) {
+    ASSERT_EQ(state, TaskState::kSucceeded);
+  }
+}
+
+} // namespace
+} // namespace alphasql
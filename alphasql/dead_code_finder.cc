@@ -0,0 +1,230 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/dead_code_finder.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_join.h"
+#include "zetasql/base/status_macros.h"
+#include "zetasql/public/templated_sql_function.h"
+#include "zetasql/public/templated_sql_tvf.h"
+#include "zetasql/resolved_ast/resolved_ast_visitor.h"
+
+namespace alphasql {
+
+using namespace zetasql;
+
+namespace {
+
+bool ByName(const DeadCode &a, const DeadCode &b) {
+  return std::tie(a.table_name, a.column_name, a.path) <
+         std::tie(b.table_name, b.column_name, b.path);
+}
+
+// Collects the columns read from each table, keyed by lowercased names,
+// skipping the scan of the table a DML statement writes to. Templated function
+// and TVF bodies are resolved for each call and kept in the call, not in the
+// tree, so they are visited there.
+class ReadCollector : public ResolvedASTVisitor {
+public:
+  explicit ReadCollector(const ResolvedTableScan *target) : target_(target) {}
+
+  absl::Status VisitResolvedTableScan(const ResolvedTableScan *node) override {
+    if (node == target_) {
+      return DefaultVisit(node);
+    }
+    std::set<std::string> &columns =
+        read_[absl::AsciiStrToLower(node->table()->Name())];
+    for (int i = 0; i < node->column_list_size(); ++i) {
+      std::string column_name = node->column_list(i).name();
+      if (i < node->column_index_list_size()) {
+        column_name =
+            node->table()->GetColumn(node->column_index_list(i))->Name();
+      }
+      columns.insert(absl::AsciiStrToLower(column_name));
+    }
+    return DefaultVisit(node);
+  }
+
+  absl::Status VisitResolvedTVFScan(const ResolvedTVFScan *node) override {
+    const auto *signature =
+        dynamic_cast<const TemplatedSQLTVFSignature *>(node->signature().get());
+    if (signature != nullptr &&
+        signature->resolved_templated_query() != nullptr) {
+      ZETASQL_RETURN_IF_ERROR(
+          signature->resolved_templated_query()->Accept(this));
+    }
+    return DefaultVisit(node);
+  }
+
+  absl::Status
+  VisitResolvedFunctionCall(const ResolvedFunctionCall *node) override {
+    ZETASQL_RETURN_IF_ERROR(VisitTemplatedBody(node));
+    return DefaultVisit(node);
+  }
+
+  absl::Status VisitResolvedAggregateFunctionCall(
+      const ResolvedAggregateFunctionCall *node) override {
+    ZETASQL_RETURN_IF_ERROR(VisitTemplatedBody(node));
+    return DefaultVisit(node);
+  }
+
+  absl::Status VisitResolvedAnalyticFunctionCall(
+      const ResolvedAnalyticFunctionCall *node) override {
+    ZETASQL_RETURN_IF_ERROR(VisitTemplatedBody(node));
+    return DefaultVisit(node);
+  }
+
+  const std::map<std::string, std::set<std::string>> &read() const {
+    return read_;
+  }
+
+private:
+  absl::Status VisitTemplatedBody(const ResolvedFunctionCallBase *node) {
+    const auto *call = dynamic_cast<const TemplatedSQLFunctionCall *>(
+        node->function_call_info().get());
+    if (call == nullptr) {
+      return absl::OkStatus();
+    }
+    ZETASQL_RETURN_IF_ERROR(call->expr()->Accept(this));
+    for (const auto &aggregate : call->aggregate_expression_list()) {
+      ZETASQL_RETURN_IF_ERROR(aggregate->Accept(this));
+    }
+    return absl::OkStatus();
+  }
+
+  const ResolvedTableScan *target_;
+  std::map<std::string, std::set<std::string>> read_;
+};
+
+const ResolvedTableScan *TargetScan(const ResolvedStatement *statement) {
+  switch (statement->node_kind()) {
+  case RESOLVED_INSERT_STMT:
+    return statement->GetAs<ResolvedInsertStmt>()->table_scan();
+  case RESOLVED_UPDATE_STMT:
+    return statement->GetAs<ResolvedUpdateStmt>()->table_scan();
+  case RESOLVED_DELETE_STMT:
+    return statement->GetAs<ResolvedDeleteStmt>()->table_scan();
+  case RESOLVED_MERGE_STMT:
+    return statement->GetAs<ResolvedMergeStmt>()->table_scan();
+  case RESOLVED_TRUNCATE_STMT:
+    return statement->GetAs<ResolvedTruncateStmt>()->table_scan();
+  default:
+    return nullptr;
+  }
+}
+
+} // namespace
+
+absl::Status
+DeadCodeFinder::AddStatement(const std::string &path,
+                             const ResolvedStatement *statement) {
+  ReadCollector reads(TargetScan(statement));
+  ZETASQL_RETURN_IF_ERROR(statement->Accept(&reads));
+
+  absl::MutexLock l(&mutex_);
+  for (const auto &[table_name, columns] : reads.read()) {
+    // Temporary tables of the file shadow the others.
+    auto it = tables_.find({path, table_name});
+    if (it == tables_.end()) {
+      it = tables_.find({"", table_name});
+    }
+    if (it == tables_.end()) {
+      // External tables are not created by the pipeline.
+      continue;
+    }
+    it->second.read = true;
+    it->second.read_columns.insert(columns.begin(), columns.end());
+  }
+
+  const auto kind = statement->node_kind();
+  if (kind != RESOLVED_CREATE_TABLE_STMT &&
+      kind != RESOLVED_CREATE_TABLE_AS_SELECT_STMT) {
+    return absl::OkStatus();
+  }
+  const auto *create_table_stmt =
+      statement->GetAs<ResolvedCreateTableStmtBase>();
+  const std::string table_name =
+      absl::StrJoin(create_table_stmt->name_path(), ".");
+  const bool is_temp = create_table_stmt->create_scope() ==
+                       ResolvedCreateStatement::CREATE_TEMP;
+  // A table created again keeps the reads of its former definition.
+  CreatedTable &table =
+      tables_[{is_temp ? path : "", absl::AsciiStrToLower(table_name)}];
+  table.name = table_name;
+  table.path = path;
+  table.is_create_as_select = kind == RESOLVED_CREATE_TABLE_AS_SELECT_STMT;
+  table.columns.clear();
+  for (const auto &column_definition :
+       create_table_stmt->column_definition_list()) {
+    table.columns.push_back(column_definition->name());
+  }
+  return absl::OkStatus();
+}
+
+int64_t DeadCodeFinder::EstimatedBytes(const std::string &table_name,
+                                       const std::string &column_name) const {
+  int64_t bytes;
+  if (estimator_ == nullptr) {
+    return -1;
+  }
+  if (column_name.empty()) {
+    return estimator_->EstimatedBytes(table_name, &bytes) ? bytes : -1;
+  }
+  return estimator_->EstimatedBytes(table_name, column_name, &bytes) ? bytes
+                                                                     : -1;
+}
+
+std::vector<DeadCode> DeadCodeFinder::DeadTables() const {
+  absl::MutexLock l(&mutex_);
+  std::vector<DeadCode> dead_tables;
+  for (const auto &[key, table] : tables_) {
+    if (!table.read) {
+      dead_tables.push_back(
+          {table.name, "", table.path, EstimatedBytes(table.name, "")});
+    }
+  }
+  std::sort(dead_tables.begin(), dead_tables.end(), ByName);
+  return dead_tables;
+}
+
+std::vector<DeadCode> DeadCodeFinder::DeadColumns() const {
+  absl::MutexLock l(&mutex_);
+  std::vector<DeadCode> dead_columns;
+  for (const auto &[key, table] : tables_) {
+    if (!table.read || !table.is_create_as_select) {
+      continue;
+    }
+    for (const std::string &column_name : table.columns) {
+      const std::string key = absl::AsciiStrToLower(column_name);
+      if (table.read_columns.count(key) == 0) {
+        dead_columns.push_back({table.name, column_name, table.path,
+                                EstimatedBytes(table.name, column_name)});
+      }
+    }
+  }
+  std::sort(dead_columns.begin(), dead_columns.end(), ByName);
+  return dead_columns;
+}
+
+} // namespace alphasql
@@ -0,0 +1,95 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_DEAD_CODE_FINDER_H_
+#define ALPHASQL_DEAD_CODE_FINDER_H_
+
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "alphasql/cost_estimator.h"
+#include "zetasql/base/status.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+
+namespace alphasql {
+
+// A table, or a column of it, that nothing reads.
+struct DeadCode {
+  std::string table_name;
+  // Empty for a whole table.
+  std::string column_name;
+  // The file that created the table.
+  std::string path;
+  // Estimated size, -1 without statistics.
+  int64_t bytes;
+};
+
+// Finds tables created by the pipeline that no later statement reads, and
+// columns of tables created by CREATE TABLE AS SELECT that no later statement
+// references, which can be pruned from the pipeline.
+//
+// Reads are the table scans of any statement, including EXPORT DATA, views,
+// the bodies of functions and TVFs, also templated ones where they are
+// called, and the sources of DML, but not the targets of DML. Referenced
+// columns are only known when the statements are analyzed with unused columns
+// pruned. Statements must be added in an order where upstream files come
+// first. This class is thread-safe.
+class DeadCodeFinder {
+public:
+  // <estimator> gives the sizes of dead tables and columns and may be null.
+  explicit DeadCodeFinder(const CostEstimator *estimator)
+      : estimator_(estimator) {}
+
+  absl::Status AddStatement(const std::string &path,
+                            const zetasql::ResolvedStatement *statement);
+
+  // Ordered by table name.
+  std::vector<DeadCode> DeadTables() const;
+  // Columns of read tables, ordered by table and column name.
+  std::vector<DeadCode> DeadColumns() const;
+
+private:
+  struct CreatedTable {
+    std::string name;
+    std::string path;
+    // Only columns of tables created by CREATE TABLE AS SELECT are reported.
+    bool is_create_as_select = false;
+    std::vector<std::string> columns;
+    bool read = false;
+    // Lowercased.
+    std::set<std::string> read_columns;
+  };
+  // Keyed by the path of the file for temporary tables, or empty, and the
+  // lowercased name.
+  using TableKey = std::pair<std::string, std::string>;
+
+  int64_t EstimatedBytes(const std::string &table_name,
+                         const std::string &column_name) const;
+
+  const CostEstimator *estimator_; // Not owned.
+
+  mutable absl::Mutex mutex_;
+  std::map<TableKey, CreatedTable> tables_ ABSL_GUARDED_BY(mutex_);
+};
+
+} // namespace alphasql
+
+#endif // ALPHASQL_DEAD_CODE_FINDER_H_
@@ -0,0 +1,124 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "alphasql/dead_code_finder.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "alphasql/analysis_test_util.h"
+#include "gtest/gtest.h"
+
+namespace alphasql {
+namespace {
+
+using namespace zetasql;
+
+// The statements read the catalog's tables a and b as if earlier statements
+// had created them.
+class DeadCodeFinderTest : public AnalysisTest {
+protected:
+  DeadCodeFinderTest() : finder_(/*estimator=*/nullptr) {}
+
+  // Analyzes <sql> and adds it to the finder, registering the functions it
+  // creates as alphacheck does.
+  void Add(const std::string &sql) {
+    const auto output = Analyze(sql);
+    ASSERT_NE(output, nullptr);
+    const ResolvedStatement *statement = output->resolved_statement();
+    const absl::Status status = finder_.AddStatement("file.sql", statement);
+    ASSERT_TRUE(status.ok()) << status;
+    AddFunction(statement);
+  }
+
+  std::vector<std::string> DeadTables() const {
+    std::vector<std::string> names;
+    for (const DeadCode &dead : finder_.DeadTables()) {
+      names.push_back(dead.table_name);
+    }
+    return names;
+  }
+
+  std::vector<std::string> DeadColumns() const {
+    std::vector<std::string> names;
+    for (const DeadCode &dead : finder_.DeadColumns()) {
+      names.push_back(dead.table_name + "." + dead.column_name);
+    }
+    return names;
+  }
+
+  DeadCodeFinder finder_;
+};
+
+TEST_F(DeadCodeFinderTest, UnreadTablesAreDead) {
+  Add("CREATE TABLE a AS SELECT 1 AS x, 2 AS y");
+  EXPECT_EQ(DeadTables(), std::vector<std::string>({"a"}));
+  EXPECT_TRUE(DeadColumns().empty());
+}
+
+TEST_F(DeadCodeFinderTest, UnreferencedColumnsOfReadTablesAreDead) {
+  Add("CREATE TABLE a AS SELECT 1 AS x, 2 AS y");
+  Add("CREATE TABLE b AS SELECT x, x AS y FROM a");
+  EXPECT_EQ(DeadTables(), std::vector<std::string>({"b"}));
+  EXPECT_EQ(DeadColumns(), std::vector<std::string>({"a.y"}));
+}
+
+TEST_F(DeadCodeFinderTest, DMLTargetsAreNotReads) {
+  Add("CREATE TABLE a (x INT64, y INT64)");
+  Add("INSERT INTO a (x, y) VALUES (1, 2)");
+  Add("DELETE FROM a WHERE TRUE");
+  EXPECT_EQ(DeadTables(), std::vector<std::string>({"a"}));
+}
+
+TEST_F(DeadCodeFinderTest, DMLSourcesAreReads) {
+  Add("CREATE TABLE a AS SELECT 1 AS x, 2 AS y");
+  Add("CREATE TABLE b (x INT64, y INT64)");
+  Add("INSERT INTO b (x, y) SELECT x, y FROM a");
+  EXPECT_EQ(DeadTables(), std::vector<std::string>({"b"}));
+  EXPECT_TRUE(DeadColumns().empty());
+}
+
+TEST_F(DeadCodeFinderTest, TablesReadInTemplatedTVFBodiesAreRead) {
+  Add("CREATE TABLE a AS SELECT 1 AS x, 2 AS y");
+  Add("CREATE TABLE FUNCTION f(n ANY TYPE) AS SELECT x FROM a WHERE x > n");
+  Add("CREATE TABLE b AS SELECT x, x AS y FROM f(1)");
+  EXPECT_EQ(DeadTables(), std::vector<std::string>({"b"}));
+  EXPECT_EQ(DeadColumns(), std::vector<std::string>({"a.y"}));
+}
+
+TEST_F(DeadCodeFinderTest, TablesReadInTemplatedFunctionBodiesAreRead) {
+  Add("CREATE TABLE a AS SELECT 1 AS x, 2 AS y");
+  Add("CREATE FUNCTION g(n ANY TYPE) AS ((SELECT MAX(y) FROM a) + n)");
+  Add("CREATE TABLE b AS SELECT g(1) AS x, 2 AS y");
+  EXPECT_EQ(DeadTables(), std::vector<std::string>({"b"}));
+  EXPECT_EQ(DeadColumns(), std::vector<std::string>({"a.x"}));
+}
+
+TEST_F(DeadCodeFinderTest, TablesReadInFunctionBodiesAreRead) {
+  Add("CREATE TABLE a AS SELECT 1 AS x, 2 AS y");
+  Add("CREATE FUNCTION g(n INT64) AS ((SELECT MAX(x) FROM a) + n)");
+  EXPECT_TRUE(DeadTables().empty());
+  EXPECT_EQ(DeadColumns(), std::vector<std::string>({"a.y"}));
+}
+
+TEST_F(DeadCodeFinderTest, TemporaryTablesAreKeyedByFile) {
+  Add("CREATE TEMP TABLE a AS SELECT 1 AS x, 2 AS y");
+  Add("CREATE TABLE b AS SELECT x, y FROM a");
+  EXPECT_EQ(DeadTables(), std::vector<std::string>({"b"}));
+}
+
+} // namespace
+} // namespace alphasql
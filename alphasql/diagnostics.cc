@@ -0,0 +1,226 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/diagnostics.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+#include "absl/base/thread_annotations.h"
+#include "absl/flags/flag.h"
+#include "absl/strings/str_cat.h"
+#include "absl/synchronization/mutex.h"
+#include "zetasql/common/status_payload_utils.h"
+#include "zetasql/public/error_location.pb.h"
+#include "zetasql/public/parse_location.h"
+
+ABSL_FLAG(std::string, diagnostics_format, "text",
+          "Format of warnings and errors: text, json for a JSON object per "
+          "line on stderr, or sarif for a SARIF log on stderr at exit.");
+ABSL_FLAG(bool, quiet, false,
+          "Leave out progress lines such as Reading and Analyzing.");
+
+namespace alphasql {
+
+namespace {
+
+struct DiagnosticsState {
+  absl::Mutex mutex;
+  std::string tool ABSL_GUARDED_BY(mutex);
+  std::vector<Diagnostic> sarif_results ABSL_GUARDED_BY(mutex);
+  bool flushed ABSL_GUARDED_BY(mutex) = false;
+};
+
+DiagnosticsState &GetState() {
+  static DiagnosticsState *state = new DiagnosticsState;
+  return *state;
+}
+
+const char *SeverityName(Severity severity) {
+  switch (severity) {
+  case Severity::kNote:
+    return "note";
+  case Severity::kWarning:
+    return "warning";
+  case Severity::kError:
+    return "error";
+  }
+  return "error";
+}
+
+std::string JSONString(absl::string_view text) {
+  std::string json = "\"";
+  for (const char c : text) {
+    switch (c) {
+    case '"':
+      json += "\\\"";
+      break;
+    case '\\':
+      json += "\\\\";
+      break;
+    case '\n':
+      json += "\\n";
+      break;
+    case '\r':
+      json += "\\r";
+      break;
+    case '\t':
+      json += "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        absl::StrAppend(&json, "\\u",
+                        absl::Hex(static_cast<unsigned char>(c),
+                                  absl::kZeroPad4));
+      } else {
+        json += c;
+      }
+    }
+  }
+  json += '"';
+  return json;
+}
+
+void AtExit() { FlushDiagnostics(); }
+
+} // namespace
+
+absl::Status InitDiagnostics(const std::string &tool) {
+  const std::string format = absl::GetFlag(FLAGS_diagnostics_format);
+  if (format != "text" && format != "json" && format != "sarif") {
+    return absl::InvalidArgumentError(
+        absl::StrCat("--diagnostics_format must be text, json or sarif, not ",
+                     format));
+  }
+  DiagnosticsState &state = GetState();
+  absl::MutexLock l(&state.mutex);
+  state.tool = tool;
+  std::atexit(AtExit);
+  return absl::OkStatus();
+}
+
+bool ShowProgress() { return !absl::GetFlag(FLAGS_quiet); }
+
+Diagnostic MakeDiagnostic(Severity severity, const std::string &message,
+                          const absl::Status &status,
+                          const std::string &file) {
+  Diagnostic diagnostic{severity, message, file};
+  if (zetasql::internal::HasPayloadWithType<zetasql::ErrorLocation>(
+          status)) {
+    const auto location =
+        zetasql::internal::GetPayload<zetasql::ErrorLocation>(status);
+    if (location.has_filename()) {
+      diagnostic.file = location.filename();
+    }
+    diagnostic.line = location.line();
+    diagnostic.column = location.column();
+  }
+  return diagnostic;
+}
+
+Diagnostic MakeDiagnostic(Severity severity, const std::string &message,
+                          absl::string_view sql,
+                          const zetasql::ParseLocationPoint &point,
+                          const std::string &file) {
+  Diagnostic diagnostic{severity, message, file};
+  const auto line_and_column =
+      zetasql::ParseLocationTranslator(sql).GetLineAndColumnAfterTabExpansion(
+          point);
+  if (line_and_column.ok()) {
+    diagnostic.line = line_and_column.value().first;
+    diagnostic.column = line_and_column.value().second;
+  }
+  return diagnostic;
+}
+
+void Report(const Diagnostic &diagnostic, absl::string_view text,
+            std::ostream &out) {
+  const std::string format = absl::GetFlag(FLAGS_diagnostics_format);
+  if (format == "json") {
+    DiagnosticsState &state = GetState();
+    absl::MutexLock l(&state.mutex);
+    std::cerr << DiagnosticToJSON(diagnostic) << '\n';
+    return;
+  }
+  if (format == "sarif") {
+    DiagnosticsState &state = GetState();
+    absl::MutexLock l(&state.mutex);
+    state.sarif_results.push_back(diagnostic);
+    return;
+  }
+  out << text << '\n';
+}
+
+void FlushDiagnostics() {
+  DiagnosticsState &state = GetState();
+  absl::MutexLock l(&state.mutex);
+  if (!state.flushed && absl::GetFlag(FLAGS_diagnostics_format) == "sarif") {
+    std::cerr << DiagnosticsToSARIF(state.tool, state.sarif_results)
+              << std::endl;
+    state.flushed = true;
+  }
+  std::cout.flush();
+}
+
+std::string DiagnosticToJSON(const Diagnostic &diagnostic) {
+  std::string json =
+      absl::StrCat("{\"severity\":\"", SeverityName(diagnostic.severity),
+                   "\",\"message\":", JSONString(diagnostic.message));
+  if (!diagnostic.file.empty()) {
+    absl::StrAppend(&json, ",\"file\":", JSONString(diagnostic.file));
+  }
+  if (diagnostic.line > 0) {
+    absl::StrAppend(&json, ",\"line\":", diagnostic.line,
+                    ",\"column\":", diagnostic.column);
+  }
+  json += "}";
+  return json;
+}
+
+std::string DiagnosticsToSARIF(const std::string &tool,
+                               const std::vector<Diagnostic> &diagnostics) {
+  std::string sarif = absl::StrCat(
+      "{\"version\":\"2.1.0\",",
+      "\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\",",
+      "\"runs\":[{\"tool\":{\"driver\":{\"name\":", JSONString(tool),
+      ",\"informationUri\":\"https://github.com/Matts966/alphasql\"}},",
+      "\"results\":[");
+  for (size_t i = 0; i < diagnostics.size(); ++i) {
+    const Diagnostic &diagnostic = diagnostics[i];
+    absl::StrAppend(&sarif, i > 0 ? "," : "", "{\"level\":\"",
+                    SeverityName(diagnostic.severity),
+                    "\",\"message\":{\"text\":", JSONString(diagnostic.message),
+                    "}");
+    if (!diagnostic.file.empty()) {
+      absl::StrAppend(&sarif,
+                      ",\"locations\":[{\"physicalLocation\":{"
+                      "\"artifactLocation\":{\"uri\":",
+                      JSONString(diagnostic.file), "}");
+      if (diagnostic.line > 0) {
+        absl::StrAppend(&sarif, ",\"region\":{\"startLine\":", diagnostic.line,
+                        ",\"startColumn\":", std::max(diagnostic.column, 1),
+                        "}");
+      }
+      sarif += "}}]";
+    }
+    sarif += "}";
+  }
+  sarif += "]}]}";
+  return sarif;
+}
+
+} // namespace alphasql
@@ -0,0 +1,89 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_DIAGNOSTICS_H_
+#define ALPHASQL_DIAGNOSTICS_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "absl/flags/declare.h"
+#include "absl/strings/string_view.h"
+#include "zetasql/base/status.h"
+#include "zetasql/public/parse_location.h"
+
+ABSL_DECLARE_FLAG(std::string, diagnostics_format);
+ABSL_DECLARE_FLAG(bool, quiet);
+
+namespace alphasql {
+
+enum class Severity { kNote, kWarning, kError };
+
+// A warning or an error, located in a file if known.
+struct Diagnostic {
+  Severity severity;
+  std::string message;
+  std::string file;
+  // 1-based, or 0 if unknown.
+  int line = 0;
+  int column = 0;
+};
+
+// Checks --diagnostics_format and names the tool reporting diagnostics. Must
+// be called once flags are parsed and before anything is reported.
+absl::Status InitDiagnostics(const std::string &tool);
+
+// Whether progress lines such as "Reading <path>" are printed, that is unless
+// --quiet is set.
+bool ShowProgress();
+
+// Builds a diagnostic with <message>, located by the ErrorLocation payload of
+// <status> if it has one, or else in <file>.
+Diagnostic MakeDiagnostic(Severity severity, const std::string &message,
+                          const absl::Status &status,
+                          const std::string &file = "");
+
+// Builds a diagnostic with <message> located at <point> of <sql>, which is the
+// content of <file>.
+Diagnostic MakeDiagnostic(Severity severity, const std::string &message,
+                          absl::string_view sql,
+                          const zetasql::ParseLocationPoint &point,
+                          const std::string &file);
+
+// Reports <diagnostic>. With --diagnostics_format=text, <text> is written to
+// <out> as a line, as the tools always did. With json, <diagnostic> is
+// written to stderr as a JSON object on a line of its own, and with sarif it
+// is kept for the SARIF log written to stderr at exit. Thread-safe as long
+// as <out> is not shared.
+void Report(const Diagnostic &diagnostic, absl::string_view text,
+            std::ostream &out);
+
+// Writes the SARIF log of the diagnostics reported so far if asked for, once,
+// and flushes stdout, which is not flushed after every line. Runs at exit
+// after InitDiagnostics.
+void FlushDiagnostics();
+
+// The JSON object <diagnostic> is written as with --diagnostics_format=json.
+std::string DiagnosticToJSON(const Diagnostic &diagnostic);
+
+// The SARIF 2.1.0 log of <diagnostics> reported by <tool>.
+std::string DiagnosticsToSARIF(const std::string &tool,
+                               const std::vector<Diagnostic> &diagnostics);
+
+} // namespace alphasql
+
+#endif // ALPHASQL_DIAGNOSTICS_H_
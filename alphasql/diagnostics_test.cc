@@ -0,0 +1,74 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+
+#include "alphasql/diagnostics.h"
+
+#include <sstream>
+
+#include "absl/flags/flag.h"
+#include "gtest/gtest.h"
+
+namespace alphasql {
+namespace {
+
+TEST(Diagnostics, TextIsWrittenAsIs) {
+  std::ostringstream out;
+  Report({Severity::kWarning, "unused", "a.sql", 1, 2}, "WARNING: unused", out);
+  ASSERT_EQ(out.str(), "WARNING: unused\n");
+}
+
+TEST(Diagnostics, JSONIsNotWrittenToOut) {
+  absl::SetFlag(&FLAGS_diagnostics_format, "json");
+  std::ostringstream out;
+  Report({Severity::kWarning, "unused"}, "WARNING: unused", out);
+  absl::SetFlag(&FLAGS_diagnostics_format, "text");
+  ASSERT_EQ(out.str(), "");
+}
+
+TEST(Diagnostics, DiagnosticToJSON) {
+  ASSERT_EQ(DiagnosticToJSON({Severity::kError, "say \"hi\"\n", "a.sql", 3, 4}),
+            "{\"severity\":\"error\",\"message\":\"say \\\"hi\\\"\\n\","
+            "\"file\":\"a.sql\",\"line\":3,\"column\":4}");
+  ASSERT_EQ(DiagnosticToJSON({Severity::kNote, "skipped"}),
+            "{\"severity\":\"note\",\"message\":\"skipped\"}");
+}
+
+TEST(Diagnostics, DiagnosticsToSARIF) {
+  const std::string sarif = DiagnosticsToSARIF(
+      "alphacheck", {{Severity::kWarning, "w", "a.sql", 2, 5},
+                     {Severity::kError, "e"}});
+  EXPECT_NE(sarif.find("\"version\":\"2.1.0\""), std::string::npos);
+  EXPECT_NE(sarif.find("\"driver\":{\"name\":\"alphacheck\""),
+            std::string::npos);
+  EXPECT_NE(sarif.find("{\"level\":\"warning\",\"message\":{\"text\":\"w\"},"
+                       "\"locations\":[{\"physicalLocation\":{"
+                       "\"artifactLocation\":{\"uri\":\"a.sql\"},"
+                       "\"region\":{\"startLine\":2,\"startColumn\":5}}}]}"),
+            std::string::npos);
+  EXPECT_NE(sarif.find("{\"level\":\"error\",\"message\":{\"text\":\"e\"}}]"),
+            std::string::npos);
+}
+
+TEST(Diagnostics, InitRejectsUnknownFormat) {
+  absl::SetFlag(&FLAGS_diagnostics_format, "xml");
+  const absl::Status status = InitDiagnostics("alphacheck");
+  absl::SetFlag(&FLAGS_diagnostics_format, "text");
+  ASSERT_FALSE(status.ok());
+}
+
+} // namespace
+} // namespace alphasql
@@ -0,0 +1,412 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/duplicate_subquery_finder.h"
+
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/hash/hash.h"
+#include "absl/strings/ascii.h"
+
+namespace alphasql {
+
+using namespace zetasql;
+
+namespace {
+
+// Scans worth computing once for many files.
+bool IsExpensive(ResolvedNodeKind kind) {
+  return kind == RESOLVED_JOIN_SCAN || kind == RESOLVED_AGGREGATE_SCAN ||
+         kind == RESOLVED_ANALYTIC_SCAN || kind == RESOLVED_SET_OPERATION_SCAN;
+}
+
+size_t Combine(size_t hash, size_t value) {
+  return absl::Hash<std::pair<size_t, size_t>>()({hash, value});
+}
+
+size_t HashString(const std::string &value) {
+  return absl::Hash<std::string>()(value);
+}
+
+// Hash of what <node> names besides its children: tables, functions,
+// literals, types and operators.
+size_t HashFields(const ResolvedNode *node) {
+  switch (node->node_kind()) {
+  case RESOLVED_TABLE_SCAN:
+    return HashString(absl::AsciiStrToLower(
+        node->GetAs<ResolvedTableScan>()->table()->FullName()));
+  case RESOLVED_LITERAL: {
+    const auto *literal = node->GetAs<ResolvedLiteral>();
+    return Combine(HashString(literal->type()->DebugString()),
+                   literal->value().HashCode());
+  }
+  case RESOLVED_PARAMETER: {
+    const auto *parameter = node->GetAs<ResolvedParameter>();
+    return Combine(HashString(parameter->name()), parameter->position());
+  }
+  case RESOLVED_CAST:
+    return HashString(node->GetAs<ResolvedCast>()->type()->DebugString());
+  case RESOLVED_FUNCTION_CALL:
+    return HashString(
+        node->GetAs<ResolvedFunctionCallBase>()->function()->Name());
+  case RESOLVED_AGGREGATE_FUNCTION_CALL:
+  case RESOLVED_ANALYTIC_FUNCTION_CALL: {
+    const auto *call = node->GetAs<ResolvedNonScalarFunctionCallBase>();
+    return Combine(HashString(call->function()->Name()),
+                   Combine(call->distinct(), call->null_handling_modifier()));
+  }
+  case RESOLVED_GET_STRUCT_FIELD:
+    return node->GetAs<ResolvedGetStructField>()->field_idx();
+  case RESOLVED_SUBQUERY_EXPR:
+    return node->GetAs<ResolvedSubqueryExpr>()->subquery_type();
+  case RESOLVED_JOIN_SCAN:
+    return node->GetAs<ResolvedJoinScan>()->join_type();
+  case RESOLVED_SET_OPERATION_SCAN:
+    return node->GetAs<ResolvedSetOperationScan>()->op_type();
+  case RESOLVED_ARRAY_SCAN:
+    return node->GetAs<ResolvedArrayScan>()->is_outer();
+  case RESOLVED_ORDER_BY_ITEM: {
+    const auto *item = node->GetAs<ResolvedOrderByItem>();
+    return Combine(item->is_descending(), item->null_order());
+  }
+  default:
+    return 0;
+  }
+}
+
+// Children in the order their hashes are computed: CTE definitions before
+// the queries reading them, and scans before the expressions reading their
+// columns.
+std::vector<const ResolvedNode *> OrderedChildNodes(const ResolvedNode *node) {
+  std::vector<const ResolvedNode *> children;
+  node->GetChildNodes(&children);
+  const auto rank = [](const ResolvedNode *child) {
+    return child->node_kind() == RESOLVED_WITH_ENTRY ? 0
+           : child->IsScan()                         ? 1
+                                                     : 2;
+  };
+  std::stable_sort(children.begin(), children.end(),
+                   [&rank](const ResolvedNode *a, const ResolvedNode *b) {
+                     return rank(a) < rank(b);
+                   });
+  return children;
+}
+
+// No parse location recorded.
+constexpr int kNoOffset = std::numeric_limits<int>::max();
+
+struct FoundFragment {
+  size_t hash;
+  size_t parent;
+  int64_t bytes_scanned;
+  int size;
+  // Byte offset of the earliest parse location of its nodes.
+  int start_offset;
+};
+
+// Hashes the nodes of a statement bottom-up and collects its fragments,
+// keeping the nodes being visited on an explicit stack.
+class FragmentCollector {
+public:
+  // <estimator> may be null, in which case fragments scan 0 bytes.
+  explicit FragmentCollector(const CostEstimator *estimator)
+      : estimator_(estimator) {}
+
+  void Collect(const ResolvedNode *root, std::vector<FoundFragment> *found) {
+    std::vector<Visit> stack;
+    stack.push_back(StartVisit(root));
+    while (true) {
+      Visit &visit = stack.back();
+      if (visit.next_child < visit.children.size()) {
+        const ResolvedNode *child = visit.children[visit.next_child++];
+        stack.push_back(StartVisit(child));
+        continue;
+      }
+      FinishVisit(&visit, found);
+      Visit finished = std::move(visit);
+      stack.pop_back();
+      if (stack.empty()) {
+        for (const size_t i : finished.unparented) {
+          (*found)[i].parent = 0;
+        }
+        return;
+      }
+      AddChild(std::move(finished), &stack.back());
+    }
+  }
+
+private:
+  // A node being visited, and what its visited children contribute to it.
+  struct Visit {
+    const ResolvedNode *node;
+    std::vector<const ResolvedNode *> children;
+    size_t next_child = 0;
+    std::vector<size_t> child_hashes;
+    size_t hash = 0;
+    int size = 1;
+    int start_offset = kNoOffset;
+    bool expensive = false;
+    bool correlated = false;
+    // CTEs read under the node but not defined there.
+    std::set<std::string> free_with_names;
+    // Lowercased columns read under the node, keyed by lowercased table
+    // name, only with an estimator.
+    std::map<std::string, std::set<std::string>> scanned;
+    // Fragments under the node not enclosed by another fragment under it.
+    std::vector<size_t> unparented;
+  };
+
+  Visit StartVisit(const ResolvedNode *node) const {
+    Visit visit;
+    visit.node = node;
+    visit.children = OrderedChildNodes(node);
+    const ParseLocationRange *range = node->GetParseLocationRangeOrNULL();
+    if (range != nullptr) {
+      visit.start_offset = range->start().GetByteOffset();
+    }
+    return visit;
+  }
+
+  void AddChild(Visit child, Visit *parent) const {
+    parent->child_hashes.push_back(child.hash);
+    parent->size += child.size;
+    parent->start_offset = std::min(parent->start_offset, child.start_offset);
+    parent->expensive |= child.expensive;
+    parent->correlated |= child.correlated;
+    parent->free_with_names.insert(child.free_with_names.begin(),
+                                   child.free_with_names.end());
+    for (auto &[table_name, columns] : child.scanned) {
+      parent->scanned[table_name].insert(columns.begin(), columns.end());
+    }
+    parent->unparented.insert(parent->unparented.end(),
+                              child.unparented.begin(),
+                              child.unparented.end());
+  }
+
+  size_t ColumnHash(const ResolvedColumn &column) const {
+    const auto it = column_hashes_.find(column.column_id());
+    if (it != column_hashes_.end()) {
+      return it->second;
+    }
+    // Defined outside the statement part visited so far.
+    return Combine(HashString(column.table_name()), HashString(column.name()));
+  }
+
+  void FinishVisit(Visit *visit, std::vector<FoundFragment> *found) {
+    const ResolvedNode *node = visit->node;
+    size_t hash = Combine(node->node_kind(), HashFields(node));
+    for (const size_t child_hash : visit->child_hashes) {
+      hash = Combine(hash, child_hash);
+    }
+
+    switch (node->node_kind()) {
+    case RESOLVED_TABLE_SCAN: {
+      const auto *scan = node->GetAs<ResolvedTableScan>();
+      const std::string table_name =
+          absl::AsciiStrToLower(scan->table()->Name());
+      for (int i = 0; i < scan->column_list_size(); ++i) {
+        std::string column_name = scan->column_list(i).name();
+        if (i < scan->column_index_list_size()) {
+          column_name =
+              scan->table()->GetColumn(scan->column_index_list(i))->Name();
+        }
+        column_name = absl::AsciiStrToLower(column_name);
+        column_hashes_[scan->column_list(i).column_id()] =
+            Combine(HashString(table_name), HashString(column_name));
+        if (estimator_ != nullptr) {
+          visit->scanned[table_name].insert(column_name);
+        }
+      }
+      break;
+    }
+    case RESOLVED_COLUMN_REF: {
+      const auto *column_ref = node->GetAs<ResolvedColumnRef>();
+      hash = Combine(hash, ColumnHash(column_ref->column()));
+      visit->correlated |= column_ref->is_correlated();
+      break;
+    }
+    case RESOLVED_COMPUTED_COLUMN:
+      // Computed columns are their expression, whatever their alias.
+      column_hashes_[node->GetAs<ResolvedComputedColumn>()
+                         ->column()
+                         .column_id()] = hash;
+      break;
+    case RESOLVED_WITH_ENTRY:
+      with_hashes_[node->GetAs<ResolvedWithEntry>()->with_query_name()] =
+          hash;
+      break;
+    case RESOLVED_WITH_REF_SCAN: {
+      const std::string &name =
+          node->GetAs<ResolvedWithRefScan>()->with_query_name();
+      const auto it = with_hashes_.find(name);
+      hash = Combine(hash, it != with_hashes_.end() ? it->second
+                                                    : HashString(name));
+      visit->free_with_names.insert(name);
+      break;
+    }
+    case RESOLVED_WITH_SCAN:
+      for (const auto &entry :
+           node->GetAs<ResolvedWithScan>()->with_entry_list()) {
+        visit->free_with_names.erase(entry->with_query_name());
+      }
+      break;
+    default:
+      break;
+    }
+
+    if (node->IsScan()) {
+      const auto *scan = node->GetAs<ResolvedScan>();
+      // Columns the scan produces itself, such as the ones of set operations
+      // and CTE references, are its output at their position.
+      for (int i = 0; i < scan->column_list_size(); ++i) {
+        column_hashes_.emplace(scan->column_list(i).column_id(),
+                               Combine(hash, i));
+      }
+      for (const ResolvedColumn &column : scan->column_list()) {
+        hash = Combine(hash, ColumnHash(column));
+      }
+      visit->expensive |= IsExpensive(node->node_kind());
+    }
+    visit->hash = hash;
+
+    if (!node->IsScan() || !visit->expensive || visit->correlated ||
+        !visit->free_with_names.empty()) {
+      return;
+    }
+    for (const size_t i : visit->unparented) {
+      (*found)[i].parent = hash;
+    }
+    visit->unparented = {found->size()};
+    found->push_back({hash, 0, BytesScanned(visit->scanned), visit->size,
+                      visit->start_offset});
+  }
+
+  int64_t BytesScanned(
+      const std::map<std::string, std::set<std::string>> &scanned) const {
+    int64_t bytes_scanned = 0;
+    for (const auto &[table_name, columns] : scanned) {
+      for (const std::string &column : columns) {
+        int64_t bytes;
+        if (estimator_->EstimatedBytes(table_name, column, &bytes)) {
+          bytes_scanned += bytes;
+        }
+      }
+    }
+    return bytes_scanned;
+  }
+
+  const CostEstimator *estimator_; // Not owned.
+  absl::flat_hash_map<int, size_t> column_hashes_;
+  absl::flat_hash_map<std::string, size_t> with_hashes_;
+};
+
+} // namespace
+
+absl::Status
+DuplicateSubqueryFinder::AddStatement(const std::string &path,
+                                      absl::string_view sql,
+                                      const ParseLocationPoint &statement_start,
+                                      const ResolvedStatement *statement) {
+  // Hashes are computed before locking, since they are the expensive part.
+  std::vector<FoundFragment> found;
+  FragmentCollector(estimator_).Collect(statement, &found);
+  std::vector<FragmentOccurrence> occurrences;
+  const ParseLocationTranslator translator(sql);
+  for (const FoundFragment &fragment : found) {
+    const ParseLocationPoint start =
+        fragment.start_offset != kNoOffset
+            ? ParseLocationPoint::FromByteOffset(fragment.start_offset)
+            : statement_start;
+    const auto line_and_column =
+        translator.GetLineAndColumnAfterTabExpansion(start);
+    occurrences.push_back(
+        line_and_column.ok()
+            ? FragmentOccurrence{path, line_and_column.value().first,
+                                 line_and_column.value().second}
+            : FragmentOccurrence{path, 1, 1});
+  }
+
+  absl::MutexLock l(&mutex_);
+  for (size_t i = 0; i < found.size(); ++i) {
+    const FoundFragment &fragment = found[i];
+    const auto [it, inserted] = fragments_.try_emplace(fragment.hash);
+    Fragment &entry = it->second;
+    if (inserted) {
+      entry.bytes_scanned = fragment.bytes_scanned;
+      entry.size = fragment.size;
+    }
+    entry.occurrences.push_back(std::move(occurrences[i]));
+    entry.parents.push_back(fragment.parent);
+  }
+  return absl::OkStatus();
+}
+
+std::vector<DuplicateFragment> DuplicateSubqueryFinder::Duplicates() const {
+  absl::MutexLock l(&mutex_);
+  std::vector<DuplicateFragment> duplicates;
+  for (const auto &[hash, fragment] : fragments_) {
+    std::set<std::string> files;
+    for (const FragmentOccurrence &occurrence : fragment.occurrences) {
+      files.insert(occurrence.path);
+    }
+    if (files.size() < 2) {
+      continue;
+    }
+    // Left out if every occurrence is inside an occurrence of one larger
+    // fragment, which is reported instead.
+    const size_t parent = fragment.parents.front();
+    if (parent != 0 &&
+        std::all_of(fragment.parents.begin(), fragment.parents.end(),
+                    [parent](size_t p) { return p == parent; })) {
+      const auto it = fragments_.find(parent);
+      if (it != fragments_.end() &&
+          it->second.occurrences.size() == fragment.occurrences.size()) {
+        continue;
+      }
+    }
+    DuplicateFragment duplicate{fragment.occurrences,
+                                static_cast<int>(files.size()),
+                                fragment.bytes_scanned, fragment.size};
+    std::sort(duplicate.occurrences.begin(), duplicate.occurrences.end(),
+              [](const FragmentOccurrence &a, const FragmentOccurrence &b) {
+                return std::tie(a.path, a.line, a.column) <
+                       std::tie(b.path, b.line, b.column);
+              });
+    duplicates.push_back(std::move(duplicate));
+  }
+
+  std::sort(duplicates.begin(), duplicates.end(),
+            [](const DuplicateFragment &a, const DuplicateFragment &b) {
+              const int64_t count_a = a.occurrences.size();
+              const int64_t count_b = b.occurrences.size();
+              const FragmentOccurrence &first_a = a.occurrences.front();
+              const FragmentOccurrence &first_b = b.occurrences.front();
+              return std::tie(count_b, b.bytes_scanned, b.size, first_a.path,
+                              first_a.line, first_a.column) <
+                     std::tie(count_a, a.bytes_scanned, a.size, first_b.path,
+                              first_b.line, first_b.column);
+            });
+  return duplicates;
+}
+
+} // namespace alphasql
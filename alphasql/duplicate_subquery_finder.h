@@ -0,0 +1,103 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_DUPLICATE_SUBQUERY_FINDER_H_
+#define ALPHASQL_DUPLICATE_SUBQUERY_FINDER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "alphasql/cost_estimator.h"
+#include "zetasql/base/status.h"
+#include "zetasql/public/parse_location.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+
+namespace alphasql {
+
+// Where a fragment occurs: the file and the line and column of the fragment.
+struct FragmentOccurrence {
+  std::string path;
+  int line;
+  int column;
+};
+
+// A query fragment found in more than one file.
+struct DuplicateFragment {
+  std::vector<FragmentOccurrence> occurrences;
+  int files;
+  // Bytes the fragment scans once, 0 without statistics.
+  int64_t bytes_scanned;
+  // Number of resolved nodes of the fragment.
+  int size;
+};
+
+// Finds queries, subqueries and CTEs that more than one file computes, as
+// candidates to materialize once in a shared upstream table.
+//
+// Every scan that joins, aggregates, runs analytic functions or combines
+// queries is a fragment. Fragments are compared by a structural hash of their
+// resolved tree, computed bottom-up in one pass over the statement from the
+// kind of each node, the tables, functions, literals and operators it names
+// and the hashes of its children. Columns hash as the table column they read
+// or the expression that computes them, and CTE references as the query of
+// the CTE, so fragments that only differ in aliases are the same. Only the
+// first occurrence of a hash is kept besides the locations of the others.
+// A fragment is located at the earliest parse location recorded in its nodes,
+// so statements should be analyzed with parse locations recorded.
+// Correlated fragments and fragments reading CTEs defined outside them can not
+// be computed on their own and are ignored. This class is thread-safe.
+class DuplicateSubqueryFinder {
+public:
+  // <estimator> gives the sizes of scanned tables and may be null.
+  explicit DuplicateSubqueryFinder(const CostEstimator *estimator)
+      : estimator_(estimator) {}
+
+  // Adds the fragments of <statement>, analyzed from <sql> of the file at
+  // <path>. Fragments without recorded parse locations are located at
+  // <statement_start>.
+  absl::Status AddStatement(const std::string &path, absl::string_view sql,
+                            const zetasql::ParseLocationPoint &statement_start,
+                            const zetasql::ResolvedStatement *statement);
+
+  // Fragments found in more than one file, most frequent first, then the
+  // ones scanning more bytes and the larger ones. Fragments that only occur
+  // as part of a larger duplicate are left out.
+  std::vector<DuplicateFragment> Duplicates() const;
+
+private:
+  struct Fragment {
+    std::vector<FragmentOccurrence> occurrences;
+    // Hashes of the innermost fragments enclosing each occurrence, 0 at the
+    // top.
+    std::vector<size_t> parents;
+    int64_t bytes_scanned = 0;
+    int size = 0;
+  };
+
+  const CostEstimator *estimator_; // Not owned.
+
+  mutable absl::Mutex mutex_;
+  // Keyed by structural hash.
+  absl::flat_hash_map<size_t, Fragment> fragments_ ABSL_GUARDED_BY(mutex_);
+};
+
+} // namespace alphasql
+
+#endif // ALPHASQL_DUPLICATE_SUBQUERY_FINDER_H_
@@ -0,0 +1,153 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "alphasql/duplicate_subquery_finder.h"
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "alphasql/analysis_test_util.h"
+#include "alphasql/cost_estimator.h"
+#include "gtest/gtest.h"
+
+namespace alphasql {
+namespace {
+
+using namespace zetasql;
+
+class DuplicateSubqueryFinderTest : public AnalysisTest {
+protected:
+  DuplicateSubqueryFinderTest() : finder_(&estimator_) {
+    // As alphacheck analyzes statements for --duplicate_subqueries.
+    options_.set_record_parse_locations(true);
+  }
+
+  // Adds <sql> as the statement of the file at <path>.
+  void Add(const std::string &path, const std::string &sql) {
+    const auto output = Analyze(sql);
+    ASSERT_NE(output, nullptr);
+    const absl::Status status =
+        finder_.AddStatement(path, sql, ParseLocationPoint::FromByteOffset(0),
+                             output->resolved_statement());
+    ASSERT_TRUE(status.ok()) << status;
+  }
+
+  CostEstimator estimator_;
+  DuplicateSubqueryFinder finder_;
+};
+
+TEST_F(DuplicateSubqueryFinderTest, FragmentsDifferingInAliases) {
+  Add("first.sql", "SELECT x, COUNT(*) AS n FROM a GROUP BY x");
+  Add("second.sql", "SELECT t.x AS key, COUNT(*) AS total FROM a AS t "
+                    "GROUP BY key");
+  const auto duplicates = finder_.Duplicates();
+  ASSERT_EQ(duplicates.size(), 1u);
+  EXPECT_EQ(duplicates[0].files, 2);
+  ASSERT_EQ(duplicates[0].occurrences.size(), 2u);
+  EXPECT_EQ(duplicates[0].occurrences[0].path, "first.sql");
+  EXPECT_EQ(duplicates[0].occurrences[1].path, "second.sql");
+}
+
+TEST_F(DuplicateSubqueryFinderTest, OccurrencesAreLocatedAtTheFragment) {
+  Add("first.sql", "SELECT x, COUNT(*) AS n FROM a GROUP BY x");
+  Add("second.sql", "SELECT *\nFROM (\n  SELECT x, COUNT(*) AS n FROM a "
+                    "GROUP BY x)");
+  const auto duplicates = finder_.Duplicates();
+  ASSERT_EQ(duplicates.size(), 1u);
+  ASSERT_EQ(duplicates[0].occurrences.size(), 2u);
+  EXPECT_EQ(duplicates[0].occurrences[0].line, 1);
+  // Inside the subquery, not at the start of the statement.
+  EXPECT_EQ(duplicates[0].occurrences[1].path, "second.sql");
+  EXPECT_EQ(duplicates[0].occurrences[1].line, 3);
+  EXPECT_GT(duplicates[0].occurrences[1].column, 2);
+}
+
+TEST_F(DuplicateSubqueryFinderTest, DifferentFragments) {
+  Add("tables.sql", "SELECT x, COUNT(*) AS n FROM a GROUP BY x");
+  Add("other_table.sql", "SELECT x, COUNT(*) AS n FROM b GROUP BY x");
+  Add("other_column.sql", "SELECT y, COUNT(*) AS n FROM a GROUP BY y");
+  Add("other_function.sql", "SELECT x, SUM(y) AS n FROM a GROUP BY x");
+  Add("filtered.sql", "SELECT x, COUNT(*) AS n FROM a WHERE y = 1 GROUP BY x");
+  Add("filtered_other.sql",
+      "SELECT x, COUNT(*) AS n FROM a WHERE y = 2 GROUP BY x");
+  Add("cross_join.sql", "SELECT a.x FROM a CROSS JOIN b");
+  Add("left_join.sql", "SELECT a.x FROM a LEFT JOIN b ON TRUE");
+  EXPECT_TRUE(finder_.Duplicates().empty());
+}
+
+TEST_F(DuplicateSubqueryFinderTest, DuplicatesWithinOneFile) {
+  Add("first.sql", "SELECT x, COUNT(*) AS n FROM a GROUP BY x");
+  Add("first.sql", "SELECT x, COUNT(*) AS n FROM a GROUP BY x");
+  EXPECT_TRUE(finder_.Duplicates().empty());
+}
+
+TEST_F(DuplicateSubqueryFinderTest, OnlyTheLargestDuplicateIsReported) {
+  const std::string join = "SELECT a.x FROM a JOIN b ON a.x = b.x";
+  Add("first.sql", absl::StrCat("SELECT x, COUNT(*) AS n FROM (", join,
+                                ") GROUP BY x"));
+  Add("second.sql", absl::StrCat("SELECT x, COUNT(*) AS c FROM (", join,
+                                 ") AS j GROUP BY x"));
+  auto duplicates = finder_.Duplicates();
+  ASSERT_EQ(duplicates.size(), 1u);
+  const int size = duplicates[0].size;
+
+  // Reported on its own once it occurs outside the aggregation too.
+  Add("third.sql", join);
+  duplicates = finder_.Duplicates();
+  ASSERT_EQ(duplicates.size(), 2u);
+  EXPECT_EQ(duplicates[0].occurrences.size(), 3u);
+  EXPECT_LT(duplicates[0].size, size);
+}
+
+TEST_F(DuplicateSubqueryFinderTest, CTEsAreComparedByTheirQuery) {
+  Add("first.sql", "WITH c AS (SELECT x, COUNT(*) AS n FROM a GROUP BY x) "
+                   "SELECT c.x FROM c JOIN b ON c.x = b.x");
+  Add("second.sql", "WITH d AS (SELECT x, COUNT(*) AS m FROM a GROUP BY x) "
+                    "SELECT d.x FROM d JOIN b ON d.x = b.x");
+  Add("third.sql", "WITH d AS (SELECT y, COUNT(*) AS m FROM a GROUP BY y) "
+                   "SELECT d.y FROM d JOIN b ON d.y = b.x");
+  const auto duplicates = finder_.Duplicates();
+  ASSERT_EQ(duplicates.size(), 1u);
+  EXPECT_EQ(duplicates[0].files, 2);
+}
+
+TEST_F(DuplicateSubqueryFinderTest, CorrelatedFragmentsAreIgnored) {
+  const std::string sql =
+      "SELECT (SELECT COUNT(*) FROM b WHERE b.x = a.x) AS n FROM a";
+  Add("first.sql", sql);
+  Add("second.sql", sql);
+  EXPECT_TRUE(finder_.Duplicates().empty());
+}
+
+TEST_F(DuplicateSubqueryFinderTest, BytesScanned) {
+  const std::string stats_path = absl::StrCat(
+      testing::TempDir(), "/duplicate_subquery_finder_test_stats.json");
+  std::ofstream(stats_path)
+      << R"({"a": {"rows": 10, "columns": {"x": 100, "y": 1000}}})";
+  ASSERT_TRUE(estimator_.ReadStats(stats_path).ok());
+  // A self join reads each column of the table once.
+  const std::string sql = "SELECT COUNT(*) AS n FROM a JOIN a AS c USING (x)";
+  Add("first.sql", sql);
+  Add("second.sql", sql);
+  const auto duplicates = finder_.Duplicates();
+  ASSERT_EQ(duplicates.size(), 1u);
+  EXPECT_EQ(duplicates[0].bytes_scanned, 100);
+}
+
+} // namespace
+} // namespace alphasql
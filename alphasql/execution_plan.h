@@ -0,0 +1,113 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_EXECUTION_PLAN_H_
+#define ALPHASQL_EXECUTION_PLAN_H_
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "boost/graph/adjacency_list.hpp"
+#include "boost/graph/depth_first_search.hpp"
+#include "boost/graph/topological_sort.hpp"
+
+struct cycle_detector : public boost::dfs_visitor<> {
+  cycle_detector(bool &has_cycle) : _has_cycle(has_cycle) {}
+
+  template <class Edge, class Graph> void back_edge(Edge, Graph &) {
+    _has_cycle = true;
+  }
+
+protected:
+  bool &_has_cycle;
+};
+
+namespace alphasql {
+
+// A vertex of the dependency graph as written to and read from DOT files.
+struct DAGVertex {
+  std::string label;
+  std::string shape;
+  // "query", "table" or "function".
+  std::string type;
+};
+
+typedef boost::adjacency_list<boost::vecS, boost::vecS, boost::directedS,
+                              DAGVertex>
+    DAGGraph;
+
+inline bool HasCycle(const DAGGraph &g) {
+  bool has_cycle = false;
+  cycle_detector vis(has_cycle);
+  boost::depth_first_search(g, boost::visitor(vis));
+  return has_cycle;
+}
+
+// Fills <execution_plan> with the query files of the acyclic graph <g> in
+// topological order. If <upstreams> is not null, it is filled with the
+// indices in <execution_plan> of the query files each file depends on,
+// looking through table and function vertices.
+inline void GetExecutionPlan(const DAGGraph &g,
+                             std::vector<std::string> *execution_plan,
+                             std::vector<std::vector<size_t>> *upstreams) {
+  using namespace boost;
+  std::list<int> result;
+  topological_sort(g, std::front_inserter(result));
+  std::map<int, size_t> plan_indices;
+  for (int i : result) {
+    if (g[i].type == "query") {
+      plan_indices[i] = execution_plan->size();
+      execution_plan->push_back(g[i].label);
+    }
+  }
+  if (upstreams == nullptr) {
+    return;
+  }
+
+  std::vector<std::vector<int>> predecessors(num_vertices(g));
+  graph_traits<DAGGraph>::edge_iterator ei, ei_end;
+  for (tie(ei, ei_end) = edges(g); ei != ei_end; ++ei) {
+    predecessors[target(*ei, g)].push_back(source(*ei, g));
+  }
+  upstreams->assign(execution_plan->size(), {});
+  for (const auto &[vertex, plan_index] : plan_indices) {
+    std::set<size_t> query_upstreams;
+    std::set<int> visited;
+    std::vector<int> stack(predecessors[vertex]);
+    while (!stack.empty()) {
+      const int predecessor = stack.back();
+      stack.pop_back();
+      if (!visited.insert(predecessor).second) {
+        continue;
+      }
+      if (g[predecessor].type == "query") {
+        query_upstreams.insert(plan_indices[predecessor]);
+        continue;
+      }
+      stack.insert(stack.end(), predecessors[predecessor].begin(),
+                   predecessors[predecessor].end());
+    }
+    (*upstreams)[plan_index].assign(query_upstreams.begin(),
+                                    query_upstreams.end());
+  }
+}
+
+} // namespace alphasql
+
+#endif // ALPHASQL_EXECUTION_PLAN_H_
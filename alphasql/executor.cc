@@ -0,0 +1,365 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/executor.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "alphasql/diagnostics.h"
+#include "alphasql/fixture_reader.h"
+#include "zetasql/base/status_macros.h"
+#include "zetasql/common/errors.h"
+#include "zetasql/public/cast.h"
+#include "zetasql/public/evaluator.h"
+#include "zetasql/public/evaluator_table_iterator.h"
+#include "zetasql/public/parse_resume_location.h"
+#include "zetasql/public/simple_catalog.h"
+#include "zetasql/public/templated_sql_function.h"
+#include "zetasql/public/templated_sql_tvf.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+
+namespace alphasql {
+
+using namespace zetasql;
+
+namespace {
+
+// State shared by the statements executed for one file.
+struct ExecutionContext {
+  const std::string &file;
+  const std::string &sql;
+  const AnalyzerOptions &options;
+  bool skipped_as_error;
+  LayeredCatalog *catalog;
+  std::ostream &out;
+  ExecutionStats *stats;
+  std::vector<std::string> temp_table_names;
+  std::vector<std::string> temp_function_names;
+};
+
+std::string Text(const std::string &sql, const ASTNode *node) {
+  const auto range = node->GetParseLocationRange();
+  return sql.substr(range.start().GetByteOffset(),
+                    range.end().GetByteOffset() -
+                        range.start().GetByteOffset());
+}
+
+// Skips a statement that can not be executed locally because of <status>,
+// which is located in the file: reports it as a warning, or returns it if
+// skipped statements are errors.
+absl::Status Skip(const absl::Status &status, ExecutionContext *context) {
+  if (context->skipped_as_error) {
+    return status;
+  }
+  Report(MakeDiagnostic(Severity::kWarning,
+                        absl::StrCat("execution skipped with the error: ",
+                                     status.message()),
+                        status, context->file),
+         absl::StrCat("WARNING: execution skipped with the error: ",
+                      status.ToString()),
+         context->out);
+  ++context->stats->statements_skipped;
+  return absl::OkStatus();
+}
+
+// Evaluates <query_sql> and appends its rows to <rows>.
+absl::Status Evaluate(const std::string &query_sql, ExecutionContext *context,
+                      TableRows *rows) {
+  EvaluatorOptions evaluator_options;
+  // Materialized values must outlive the query, so their types come from the
+  // factory of the catalog rather than one owned by the query.
+  evaluator_options.type_factory = context->catalog->type_factory();
+  PreparedQuery query(query_sql, evaluator_options);
+  ZETASQL_RETURN_IF_ERROR(query.Prepare(context->options, context->catalog));
+  ZETASQL_ASSIGN_OR_RETURN(std::unique_ptr<EvaluatorTableIterator> iterator,
+                           query.Execute());
+  while (iterator->NextRow()) {
+    std::vector<Value> row;
+    row.reserve(iterator->NumColumns());
+    for (int i = 0; i < iterator->NumColumns(); ++i) {
+      row.push_back(iterator->GetValue(i));
+    }
+    rows->push_back(std::move(row));
+  }
+  return iterator->Status();
+}
+
+// Casts <value> to <type> unless it already has the type, as BigQuery does
+// for compatible types when writing to a table.
+absl::Status Coerce(const Type *type, ExecutionContext *context,
+                    Value *value) {
+  if (value->type()->Equals(type)) {
+    return absl::OkStatus();
+  }
+  ZETASQL_ASSIGN_OR_RETURN(*value,
+                           CastValue(*value, absl::UTCTimeZone(),
+                                     context->options.language(), type));
+  return absl::OkStatus();
+}
+
+// The rows to insert as a query, turning VALUES rows into a UNION ALL.
+absl::Status InsertQuery(const ASTInsertStatement *insert,
+                         ExecutionContext *context, std::string *query_sql) {
+  if (insert->query() != nullptr) {
+    *query_sql = Text(context->sql, insert->query());
+    return absl::OkStatus();
+  }
+  if (insert->rows() == nullptr) {
+    return absl::UnimplementedError("INSERT without rows is not supported");
+  }
+  std::vector<std::string> selects;
+  for (const ASTInsertValuesRow *row : insert->rows()->rows()) {
+    std::vector<std::string> values;
+    for (const ASTExpression *value : row->values()) {
+      values.push_back(value->node_kind() == AST_DEFAULT_LITERAL
+                           ? "NULL"
+                           : Text(context->sql, value));
+    }
+    selects.push_back(absl::StrCat("SELECT ", absl::StrJoin(values, ", ")));
+  }
+  *query_sql = absl::StrJoin(selects, " UNION ALL ");
+  return absl::OkStatus();
+}
+
+absl::Status CreateTable(const ASTStatement *statement,
+                         const ResolvedCreateTableStmtBase *create_table_stmt,
+                         ExecutionContext *context) {
+  const std::string table_name =
+      absl::StrJoin(create_table_stmt->name_path(), ".");
+  const Table *existing;
+  if (create_table_stmt->create_mode() ==
+          ResolvedCreateStatement::CREATE_IF_NOT_EXISTS &&
+      context->catalog->FindTable(create_table_stmt->name_path(), &existing)
+          .ok()) {
+    if (ShowProgress()) {
+      context->out << "Table " << table_name << " already exists\n";
+    }
+    return absl::OkStatus();
+  }
+
+  TableRows rows;
+  const auto *query = statement->GetAs<ASTCreateTableStatement>()->query();
+  if (query != nullptr) {
+    ZETASQL_RETURN_IF_ERROR(Evaluate(Text(context->sql, query), context, &rows));
+  }
+  auto table = absl::make_unique<SimpleTable>(table_name);
+  const auto &column_definitions = create_table_stmt->column_definition_list();
+  for (const auto &column_definition : column_definitions) {
+    ZETASQL_RETURN_IF_ERROR(table->AddColumn(
+        new SimpleColumn(table_name,
+                         column_definition->column().name_id().ToString(),
+                         column_definition->column().type()),
+        /*is_owned=*/true));
+  }
+  for (std::vector<Value> &row : rows) {
+    for (size_t i = 0; i < row.size() && i < column_definitions.size(); ++i) {
+      ZETASQL_RETURN_IF_ERROR(Coerce(column_definitions[i]->column().type(),
+                                     context, &row[i]));
+    }
+  }
+  if (ShowProgress()) {
+    context->out << "Table " << table_name << " materialized with "
+                 << rows.size() << " rows\n";
+  }
+  context->stats->rows_written += rows.size();
+  table->SetContents(rows);
+  context->catalog->AddOwnedTable(table.release());
+  if (create_table_stmt->create_scope() ==
+      ResolvedCreateStatement::CREATE_TEMP) {
+    context->temp_table_names.push_back(table_name);
+  }
+  return absl::OkStatus();
+}
+
+absl::Status Insert(const ASTStatement *statement,
+                    const ResolvedInsertStmt *insert_stmt,
+                    ExecutionContext *context) {
+  const Table *target = insert_stmt->table_scan()->table();
+  absl::flat_hash_map<std::string, int> target_indices;
+  for (int i = 0; i < target->NumColumns(); ++i) {
+    target_indices[absl::AsciiStrToLower(target->GetColumn(i)->Name())] = i;
+  }
+  std::vector<int> indices;
+  for (const ResolvedColumn &column : insert_stmt->insert_column_list()) {
+    indices.push_back(target_indices.at(absl::AsciiStrToLower(column.name())));
+  }
+
+  std::string query_sql;
+  ZETASQL_RETURN_IF_ERROR(InsertQuery(statement->GetAs<ASTInsertStatement>(),
+                                      context, &query_sql));
+  TableRows inserted;
+  ZETASQL_RETURN_IF_ERROR(Evaluate(query_sql, context, &inserted));
+
+  // Tables are immutable once visible, so the rows are copied into a new
+  // table that replaces the target.
+  TableRows rows;
+  ZETASQL_RETURN_IF_ERROR(ReadRows(*target, &rows));
+  for (std::vector<Value> &values : inserted) {
+    std::vector<Value> row;
+    row.reserve(target->NumColumns());
+    for (int i = 0; i < target->NumColumns(); ++i) {
+      row.push_back(Value::Null(target->GetColumn(i)->GetType()));
+    }
+    for (size_t i = 0; i < values.size() && i < indices.size(); ++i) {
+      ZETASQL_RETURN_IF_ERROR(Coerce(target->GetColumn(indices[i])->GetType(),
+                                     context, &values[i]));
+      row[indices[i]] = std::move(values[i]);
+    }
+    rows.push_back(std::move(row));
+  }
+  if (ShowProgress()) {
+    context->out << "Inserted " << inserted.size() << " rows into "
+                 << target->Name() << '\n';
+  }
+  context->stats->rows_written += inserted.size();
+  context->catalog->AddOwnedTable(
+      MakeTableWithRows(target->Name(), *target, std::move(rows)).release());
+  return absl::OkStatus();
+}
+
+absl::Status Execute(const ASTStatement *statement,
+                     ExecutionContext *context) {
+  if (statement->node_kind() == AST_BEGIN_END_BLOCK) {
+    // Exception handlers only run on errors, which stop the execution anyway.
+    const ASTBeginEndBlock *stmt = statement->GetAs<ASTBeginEndBlock>();
+    for (const auto &body : stmt->statement_list_node()->statement_list()) {
+      ZETASQL_RETURN_IF_ERROR(Execute(body, context));
+    }
+    return absl::OkStatus();
+  }
+
+  std::unique_ptr<const AnalyzerOutput> output;
+  LayeredCatalog *catalog = context->catalog;
+  std::ostream &out = context->out;
+  const auto status = AnalyzeStatementFromParserAST(
+      *statement, context->options, context->sql, catalog,
+      catalog->type_factory(), &output);
+  if (!status.ok()) {
+    if (status.message().find("Statement not supported") == std::string::npos) {
+      return status;
+    }
+    return Skip(status, context);
+  }
+
+  auto resolved_statement = output->resolved_statement();
+  switch (resolved_statement->node_kind()) {
+  case RESOLVED_QUERY_STMT: {
+    TableRows rows;
+    ZETASQL_RETURN_IF_ERROR(
+        Evaluate(Text(context->sql, statement), context, &rows));
+    if (ShowProgress()) {
+      out << "Query returned " << rows.size() << " rows\n";
+    }
+    context->stats->rows_returned += rows.size();
+    break;
+  }
+  case RESOLVED_CREATE_TABLE_STMT:
+  case RESOLVED_CREATE_TABLE_AS_SELECT_STMT:
+    ZETASQL_RETURN_IF_ERROR(CreateTable(
+        statement, resolved_statement->GetAs<ResolvedCreateTableStmtBase>(),
+        context));
+    break;
+  case RESOLVED_INSERT_STMT:
+    ZETASQL_RETURN_IF_ERROR(Insert(
+        statement, resolved_statement->GetAs<ResolvedInsertStmt>(), context));
+    break;
+  case RESOLVED_CREATE_FUNCTION_STMT: {
+    auto *create_function_stmt =
+        resolved_statement->GetAs<ResolvedCreateFunctionStmt>();
+    // Registered with its body, so that calls can be evaluated.
+    catalog->AddOwnedFunction(new TemplatedSQLFunction(
+        create_function_stmt->name_path(), create_function_stmt->signature(),
+        create_function_stmt->argument_name_list(),
+        ParseResumeLocation::FromString(create_function_stmt->code())));
+    if (create_function_stmt->create_scope() ==
+        ResolvedCreateStatement::CREATE_TEMP) {
+      context->temp_function_names.push_back(
+          absl::StrJoin(create_function_stmt->name_path(), "."));
+    }
+    if (ShowProgress()) {
+      out << "Function "
+          << absl::StrJoin(create_function_stmt->name_path(), ".")
+          << " created\n";
+    }
+    break;
+  }
+  case RESOLVED_CREATE_TABLE_FUNCTION_STMT: {
+    auto *create_table_function_stmt =
+        resolved_statement->GetAs<ResolvedCreateTableFunctionStmt>();
+    catalog->AddOwnedTableValuedFunction(new TemplatedSQLTVF(
+        create_table_function_stmt->name_path(),
+        create_table_function_stmt->signature(),
+        create_table_function_stmt->argument_name_list(),
+        ParseResumeLocation::FromString(create_table_function_stmt->code())));
+    if (ShowProgress()) {
+      out << "Table function "
+          << absl::StrJoin(create_table_function_stmt->name_path(), ".")
+          << " created\n";
+    }
+    break;
+  }
+  case RESOLVED_DROP_STMT: {
+    auto *drop_stmt = resolved_statement->GetAs<ResolvedDropStmt>();
+    std::string table_name = absl::StrJoin(drop_stmt->name_path(), ".");
+    ZETASQL_RETURN_IF_ERROR(
+        catalog->DropTable(table_name, drop_stmt->is_if_exists()));
+    if (ShowProgress()) {
+      out << "Table " << table_name << " dropped\n";
+    }
+    break;
+  }
+  default:
+    return Skip(ConvertInternalErrorLocationToExternal(
+                    MakeSqlErrorAt(statement)
+                        << "Execution not supported: "
+                        << resolved_statement->node_kind_string(),
+                    context->sql),
+                context);
+  }
+  return absl::OkStatus();
+}
+
+} // namespace
+
+absl::Status ExecuteScript(const std::string &file, const std::string &sql,
+                           const ASTScript &script,
+                           const AnalyzerOptions &options,
+                           bool skipped_as_error, LayeredCatalog *catalog,
+                           std::ostream &out, ExecutionStats *stats) {
+  ExecutionContext context{file,    sql, options, skipped_as_error,
+                           catalog, out, stats};
+  for (const ASTStatement *statement :
+       script.statement_list_node()->statement_list()) {
+    ZETASQL_RETURN_IF_ERROR(Execute(statement, &context));
+  }
+  for (const auto &table_name : context.temp_table_names) {
+    ZETASQL_RETURN_IF_ERROR(catalog->DropTable(table_name, /*if_exists=*/true));
+  }
+  for (const auto &function_name : context.temp_function_names) {
+    ZETASQL_RETURN_IF_ERROR(catalog->DropFunction(function_name));
+  }
+  return absl::OkStatus();
+}
+
+} // namespace alphasql
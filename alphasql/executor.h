@@ -0,0 +1,60 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_EXECUTOR_H_
+#define ALPHASQL_EXECUTOR_H_
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "absl/time/time.h"
+#include "alphasql/layered_catalog.h"
+#include "zetasql/base/status.h"
+#include "zetasql/parser/parser.h"
+#include "zetasql/public/analyzer.h"
+
+namespace alphasql {
+
+// What executing one file took and produced.
+struct ExecutionStats {
+  absl::Duration runtime;
+  // Rows returned by queries.
+  int64_t rows_returned = 0;
+  // Rows of tables created and rows inserted.
+  int64_t rows_written = 0;
+  // Statements that can not be executed locally and were skipped.
+  int64_t statements_skipped = 0;
+};
+
+// Executes the statements of <script> parsed from <sql>, the content of
+// <file>, with the reference evaluator, reading tables from <catalog>, whose
+// tables must all hold rows, e.g. after LoadFixtures. Tables created by CREATE
+// TABLE and CREATE TABLE AS SELECT and modified by INSERT are materialized in
+// memory and added to <catalog>, and temporary ones are dropped at the end.
+// Statements that can not be executed locally, e.g. UPDATE or CALL, are
+// reported as warnings and skipped, or fail the script if
+// <skipped_as_error>. Progress is printed to <out> unless --quiet is set and
+// counted in <stats>.
+absl::Status ExecuteScript(const std::string &file, const std::string &sql,
+                           const zetasql::ASTScript &script,
+                           const zetasql::AnalyzerOptions &options,
+                           bool skipped_as_error, LayeredCatalog *catalog,
+                           std::ostream &out, ExecutionStats *stats);
+
+} // namespace alphasql
+
+#endif // ALPHASQL_EXECUTOR_H_
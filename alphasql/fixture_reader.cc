@@ -0,0 +1,303 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/fixture_reader.h"
+
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/time/time.h"
+#include "boost/property_tree/json_parser.hpp"
+#include "boost/property_tree/ptree.hpp"
+#include "zetasql/base/logging.h"
+#include "zetasql/base/status_macros.h"
+#include "zetasql/public/cast.h"
+#include "zetasql/public/evaluator_table_iterator.h"
+
+namespace alphasql {
+
+using namespace zetasql;
+
+namespace {
+
+// Indices of the columns of <table> keyed by lowercased name.
+absl::flat_hash_map<std::string, int> ColumnIndices(const Table &table) {
+  absl::flat_hash_map<std::string, int> indices;
+  for (int i = 0; i < table.NumColumns(); ++i) {
+    indices[absl::AsciiStrToLower(table.GetColumn(i)->Name())] = i;
+  }
+  return indices;
+}
+
+absl::Status FixtureError(const std::string &path, int line,
+                          absl::string_view message) {
+  return absl::InvalidArgumentError(
+      absl::StrCat(message, " [at ", path, ":", line, ":1]"));
+}
+
+// Casts the string <field> to the type of the column, as BigQuery does when
+// loading. NULL if <is_null>.
+absl::Status ToValue(const std::string &field, bool is_null,
+                     const Column &column,
+                     const LanguageOptions &language_options, Value *value) {
+  const Type *type = column.GetType();
+  if (is_null) {
+    *value = Value::Null(type);
+    return absl::OkStatus();
+  }
+  if (!type->IsSimpleType()) {
+    return absl::UnimplementedError(
+        absl::StrCat("Fixtures of column ", column.Name(), " of type ",
+                     type->TypeName(PRODUCT_EXTERNAL), " are not supported"));
+  }
+  ZETASQL_ASSIGN_OR_RETURN(*value, CastValue(Value::String(field),
+                                             absl::UTCTimeZone(),
+                                             language_options, type));
+  return absl::OkStatus();
+}
+
+absl::Status ReadCSVFixture(const std::string &path, const std::string &content,
+                            const Table &table,
+                            const LanguageOptions &language_options,
+                            TableRows *rows) {
+  std::vector<std::vector<std::string>> records;
+  ZETASQL_RETURN_IF_ERROR(ParseCSV(content, &records));
+  if (records.empty()) {
+    return absl::OkStatus();
+  }
+  const auto indices = ColumnIndices(table);
+  std::vector<int> header;
+  for (const std::string &name : records[0]) {
+    const auto it = indices.find(absl::AsciiStrToLower(name));
+    if (it == indices.end()) {
+      return FixtureError(path, 1,
+                          absl::StrCat("No column named ", name, " in table ",
+                                       table.Name()));
+    }
+    header.push_back(it->second);
+  }
+  for (size_t i = 1; i < records.size(); ++i) {
+    const std::vector<std::string> &record = records[i];
+    if (record.size() != header.size()) {
+      return FixtureError(path, i + 1,
+                          absl::StrCat("Expected ", header.size(),
+                                       " fields but got ", record.size()));
+    }
+    std::vector<Value> row(table.NumColumns());
+    for (int j = 0; j < table.NumColumns(); ++j) {
+      row[j] = Value::Null(table.GetColumn(j)->GetType());
+    }
+    for (size_t j = 0; j < record.size(); ++j) {
+      const Column &column = *table.GetColumn(header[j]);
+      const auto status = ToValue(record[j], record[j].empty(), column,
+                                  language_options, &row[header[j]]);
+      if (!status.ok()) {
+        return FixtureError(path, i + 1, status.message());
+      }
+    }
+    rows->push_back(std::move(row));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ReadJSONFixture(const std::string &path,
+                             const std::string &content, const Table &table,
+                             const LanguageOptions &language_options,
+                             TableRows *rows) {
+  using namespace boost;
+  const auto indices = ColumnIndices(table);
+  std::istringstream lines(content);
+  std::string line;
+  for (int line_number = 1; std::getline(lines, line); ++line_number) {
+    if (absl::StripAsciiWhitespace(line).empty()) {
+      continue;
+    }
+    property_tree::ptree pt;
+    try {
+      std::istringstream stream(line);
+      property_tree::read_json(stream, pt);
+    } catch (const property_tree::json_parser_error &error) {
+      return FixtureError(path, line_number, error.message());
+    }
+    std::vector<Value> row(table.NumColumns());
+    for (int j = 0; j < table.NumColumns(); ++j) {
+      row[j] = Value::Null(table.GetColumn(j)->GetType());
+    }
+    for (const auto &[name, field] : pt) {
+      const auto it = indices.find(absl::AsciiStrToLower(name));
+      if (it == indices.end()) {
+        return FixtureError(path, line_number,
+                            absl::StrCat("No column named ", name,
+                                         " in table ", table.Name()));
+      }
+      if (!field.empty()) {
+        return FixtureError(path, line_number,
+                            absl::StrCat("Nested value of column ", name,
+                                         " is not supported"));
+      }
+      // property_tree does not tell JSON null from the string "null".
+      const auto status =
+          ToValue(field.data(), field.data() == "null",
+                  *table.GetColumn(it->second), language_options,
+                  &row[it->second]);
+      if (!status.ok()) {
+        return FixtureError(path, line_number, status.message());
+      }
+    }
+    rows->push_back(std::move(row));
+  }
+  return absl::OkStatus();
+}
+
+} // namespace
+
+absl::Status ParseCSV(absl::string_view content,
+                      std::vector<std::vector<std::string>> *records) {
+  std::vector<std::string> record;
+  std::string field;
+  bool quoted = false;
+  // Whether the current record has any field, so that blank lines and a
+  // trailing newline do not produce empty records.
+  bool in_record = false;
+  for (size_t i = 0; i < content.size(); ++i) {
+    const char c = content[i];
+    if (quoted) {
+      if (c != '"') {
+        field += c;
+      } else if (i + 1 < content.size() && content[i + 1] == '"') {
+        field += '"';
+        ++i;
+      } else {
+        quoted = false;
+      }
+      continue;
+    }
+    switch (c) {
+    case '"':
+      quoted = true;
+      in_record = true;
+      break;
+    case ',':
+      record.push_back(std::move(field));
+      field.clear();
+      in_record = true;
+      break;
+    case '\r':
+      break;
+    case '\n':
+      if (in_record) {
+        record.push_back(std::move(field));
+        records->push_back(std::move(record));
+      }
+      field.clear();
+      record.clear();
+      in_record = false;
+      break;
+    default:
+      field += c;
+      in_record = true;
+    }
+  }
+  if (quoted) {
+    return absl::InvalidArgumentError("Unterminated quoted field in CSV");
+  }
+  if (in_record) {
+    record.push_back(std::move(field));
+    records->push_back(std::move(record));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ReadFixture(const std::string &path, const Table &table,
+                         const LanguageOptions &language_options,
+                         TableRows *rows) {
+  std::ifstream file(path, std::ios::in);
+  if (!file) {
+    return absl::NotFoundError(absl::StrCat("Can not read fixture ", path));
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  if (std::filesystem::path(path).extension() == ".json") {
+    return ReadJSONFixture(path, buffer.str(), table, language_options, rows);
+  }
+  return ReadCSVFixture(path, buffer.str(), table, language_options, rows);
+}
+
+absl::Status LoadFixtures(const std::string &fixture_dir,
+                          const LanguageOptions &language_options,
+                          LayeredCatalog *catalog) {
+  for (const std::string &key : catalog->table_names()) {
+    const Table *table;
+    ZETASQL_RETURN_IF_ERROR(catalog->FindTable({key}, &table));
+    TableRows rows;
+    if (!fixture_dir.empty()) {
+      for (const char *extension : {".csv", ".json"}) {
+        const std::filesystem::path path =
+            std::filesystem::path(fixture_dir) /
+            absl::StrCat(table->Name(), extension);
+        if (std::filesystem::is_regular_file(path)) {
+          ZETASQL_RETURN_IF_ERROR(
+              ReadFixture(path.string(), *table, language_options, &rows));
+          break;
+        }
+      }
+    }
+    catalog->AddOwnedTable(
+        MakeTableWithRows(table->Name(), *table, std::move(rows)).release());
+  }
+  return absl::OkStatus();
+}
+
+std::unique_ptr<SimpleTable> MakeTableWithRows(const std::string &name,
+                                               const Table &table,
+                                               TableRows rows) {
+  auto copy = absl::make_unique<SimpleTable>(name);
+  for (int i = 0; i < table.NumColumns(); ++i) {
+    const Column *column = table.GetColumn(i);
+    ZETASQL_CHECK_OK(copy->AddColumn(
+        new SimpleColumn(name, column->Name(), column->GetType()),
+        /*is_owned=*/true));
+  }
+  copy->SetContents(rows);
+  return copy;
+}
+
+absl::Status ReadRows(const Table &table, TableRows *rows) {
+  std::vector<int> columns(table.NumColumns());
+  std::iota(columns.begin(), columns.end(), 0);
+  ZETASQL_ASSIGN_OR_RETURN(auto iterator,
+                           table.CreateEvaluatorTableIterator(columns));
+  while (iterator->NextRow()) {
+    std::vector<Value> row;
+    row.reserve(iterator->NumColumns());
+    for (int i = 0; i < iterator->NumColumns(); ++i) {
+      row.push_back(iterator->GetValue(i));
+    }
+    rows->push_back(std::move(row));
+  }
+  return iterator->Status();
+}
+
+} // namespace alphasql
@@ -0,0 +1,68 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_FIXTURE_READER_H_
+#define ALPHASQL_FIXTURE_READER_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "alphasql/layered_catalog.h"
+#include "zetasql/base/status.h"
+#include "zetasql/public/language_options.h"
+#include "zetasql/public/simple_catalog.h"
+#include "zetasql/public/value.h"
+
+namespace alphasql {
+
+typedef std::vector<std::vector<zetasql::Value>> TableRows;
+
+// Splits RFC 4180 CSV <content> into records of fields. Fields may be quoted
+// with '"', in which case they can contain commas, newlines and doubled
+// quotes.
+absl::Status ParseCSV(absl::string_view content,
+                      std::vector<std::vector<std::string>> *records);
+
+// Reads the rows of <table> from the fixture at <path>, which is either a CSV
+// file with a header row of column names or a newline delimited JSON file
+// with one object per row, as exported by BigQuery. Columns missing from the
+// fixture and empty CSV fields are NULL. Values are cast from strings to the
+// column types, so only columns of scalar types are supported.
+absl::Status ReadFixture(const std::string &path, const zetasql::Table &table,
+                         const zetasql::LanguageOptions &language_options,
+                         TableRows *rows);
+
+// Replaces every table visible through <catalog> with a copy holding the rows
+// of the fixture named after it in <fixture_dir>, "<table name>.csv" or
+// "<table name>.json", or no rows if there is none, so that the tables can be
+// read by the reference evaluator. <fixture_dir> may be empty.
+absl::Status LoadFixtures(const std::string &fixture_dir,
+                          const zetasql::LanguageOptions &language_options,
+                          LayeredCatalog *catalog);
+
+// Returns a copy of the columns of <table> named <name> holding <rows>.
+std::unique_ptr<zetasql::SimpleTable>
+MakeTableWithRows(const std::string &name, const zetasql::Table &table,
+                  TableRows rows);
+
+// Reads all rows of <table>, which must support evaluator table iterators.
+absl::Status ReadRows(const zetasql::Table &table, TableRows *rows);
+
+} // namespace alphasql
+
+#endif // ALPHASQL_FIXTURE_READER_H_
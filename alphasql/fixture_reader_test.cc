@@ -0,0 +1,56 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/fixture_reader.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace alphasql {
+namespace {
+
+typedef std::vector<std::vector<std::string>> Records;
+
+TEST(ParseCSV, SplitsRecordsAndFields) {
+  Records records;
+  ASSERT_TRUE(ParseCSV("a,b\n1,\n,2\n", &records).ok());
+  ASSERT_EQ(records, Records({{"a", "b"}, {"1", ""}, {"", "2"}}));
+}
+
+TEST(ParseCSV, HandlesQuotedFields) {
+  Records records;
+  ASSERT_TRUE(
+      ParseCSV("\"a,b\",\"say \"\"hi\"\"\"\r\n\"multi\nline\",x", &records)
+          .ok());
+  ASSERT_EQ(records,
+            Records({{"a,b", "say \"hi\""}, {"multi\nline", "x"}}));
+}
+
+TEST(ParseCSV, SkipsBlankLines) {
+  Records records;
+  ASSERT_TRUE(ParseCSV("\na\n\n\nb", &records).ok());
+  ASSERT_EQ(records, Records({{"a"}, {"b"}}));
+}
+
+TEST(ParseCSV, RejectsUnterminatedQuotes) {
+  Records records;
+  ASSERT_FALSE(ParseCSV("\"a,b\nc", &records).ok());
+}
+
+} // namespace
+} // namespace alphasql
@@ -22,7 +22,14 @@
 #include <utility>
 #include <vector>
 
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "alphasql/builtin_functions.h"
+#include "alphasql/check_cache.h"
+#include "alphasql/diagnostics.h"
 #include "alphasql/identifier_resolver.h"
+#include "alphasql/proto/alphasql_service.pb.h"
+#include "alphasql/statement_cache.h"
 #include "alphasql/table_name_resolver.h"
 #include "zetasql/base/case.h"
 #include "zetasql/base/logging.h"
@@ -37,13 +44,24 @@
 #include "zetasql/parser/parse_tree_errors.h"
 #include "zetasql/parser/parser.h"
 #include "zetasql/public/analyzer.h"
+#include "zetasql/public/error_helpers.h"
+#include "zetasql/public/id_string.h"
 #include "zetasql/public/language_options.h"
 #include "zetasql/public/options.pb.h"
+#include "zetasql/public/parse_location.h"
 #include "zetasql/public/parse_resume_location.h"
 #include "zetasql/resolved_ast/resolved_ast.h"
 #include "zetasql/resolved_ast/resolved_node_kind.pb.h"
 
 ABSL_FLAG(bool, warning_as_error, false, "Raise error when emitting warning.");
+ABSL_FLAG(bool, stream_statements, false,
+          "Parse, analyze and free the statements of each file one at a time "
+          "instead of parsing whole files, so that memory is bounded by the "
+          "largest statement. Useful for very large generated scripts.");
+ABSL_FLAG(std::string, statement_cache_dir, "",
+          "Cache what each top-level statement creates, references and calls "
+          "in this directory, so that only statements whose text or whose "
+          "preceding definitions changed since the last run are parsed.");
 
 namespace alphasql {
 
@@ -64,95 +82,491 @@ const AnalyzerOptions GetAnalyzerOptions() {
 
 namespace identifier_resolver {
 
-zetasql_base::StatusOr<identifier_info>
-GetIdentifierInformation(const std::string &sql_file_path) {
-  const AnalyzerOptions options = GetAnalyzerOptions();
-  std::unique_ptr<ParserOutput> parser_output;
+namespace {
 
-  std::filesystem::path file_path(sql_file_path);
-  std::ifstream file(file_path, std::ios::in);
-  std::string sql(std::istreambuf_iterator<char>(file), {});
-
-  ZETASQL_RETURN_IF_ERROR(zetasql::ParseScript(sql, options.GetParserOptions(),
-                                                options.error_message_mode(),
-                                                &parser_output, file_path));
+void EmitWarning(const Diagnostic &diagnostic) {
+  Report(diagnostic, diagnostic.message, std::cout);
+  const bool warning_as_error = absl::GetFlag(FLAGS_warning_as_error);
+  if (warning_as_error) {
+    exit(1);
+  }
+}
 
-  IdentifierResolver resolver = IdentifierResolver();
-  parser_output->script()->Accept(&resolver, nullptr);
-  const auto status = table_name_resolver::GetTables(
-      sql_file_path, options,
-      &resolver.identifier_information.table_information.referenced);
-  if (!status.ok()) {
-    return status;
+// Only the declaration and the body of functions hold identifiers.
+bool IsIgnoredPartOf(const ASTNode *parent, const ASTNode *node) {
+  switch (parent->node_kind()) {
+  case AST_CREATE_FUNCTION_STATEMENT: {
+    const auto *create = parent->GetAs<ASTCreateFunctionStatement>();
+    return node != create->function_declaration() &&
+           node != create->sql_function_body();
+  }
+  case AST_CREATE_TABLE_FUNCTION_STATEMENT: {
+    const auto *create = parent->GetAs<ASTCreateTableFunctionStatement>();
+    return node != create->function_declaration() && node != create->query();
   }
+  default:
+    return false;
+  }
+}
 
-  // Filter temporary tables from referenced tables because they are local.
-  for (const auto &temporary_table : resolver.temporary_tables) {
-    auto referenced_it =
-        resolver.identifier_information.table_information.referenced.begin();
-    while (referenced_it !=
-           resolver.identifier_information.table_information.referenced.end()) {
+// Filter temporary tables from referenced tables because they are local.
+void FilterTemporaryTables(const std::set<std::string> &temporary_tables,
+                           identifier_info *information) {
+  auto &referenced = information->table_information.referenced;
+  for (const auto &temporary_table : temporary_tables) {
+    auto referenced_it = referenced.begin();
+    while (referenced_it != referenced.end()) {
       if (absl::StrJoin(*referenced_it, ".") == temporary_table) {
-        referenced_it =
-            resolver.identifier_information.table_information.referenced.erase(
-                referenced_it);
+        referenced_it = referenced.erase(referenced_it);
       } else {
         ++referenced_it;
       }
     }
   }
+}
+
+std::vector<std::string> ToPath(const NamePath &name_path) {
+  return {name_path.names().begin(), name_path.names().end()};
+}
+
+void ToNamePath(const std::vector<std::string> &path, NamePath *name_path) {
+  for (const std::string &name : path) {
+    name_path->add_names(name);
+  }
+}
+
+void AddPaths(const std::set<std::vector<std::string>> &paths,
+              google::protobuf::RepeatedPtrField<NamePath> *name_paths) {
+  for (const auto &path : paths) {
+    ToNamePath(path, name_paths->Add());
+  }
+}
+
+void InsertPaths(const google::protobuf::RepeatedPtrField<NamePath> &name_paths,
+                 std::set<std::vector<std::string>> *paths) {
+  for (const NamePath &name_path : name_paths) {
+    paths->insert(ToPath(name_path));
+  }
+}
+
+// Adds the tables created in the bodies of the procedures defined under
+// <root> to their artifacts. Nodes are walked from an explicit stack, along
+// with the procedure they are part of, so that deeply nested blocks can not
+// exhaust the call stack.
+void IndexProceduresUnder(const ASTNode *root, ProcedureIndex *procedures) {
+  std::vector<std::pair<const ASTNode *, const ASTCreateProcedureStatement *>>
+      stack = {{root, nullptr}};
+  while (!stack.empty()) {
+    const auto [node, procedure] = stack.back();
+    stack.pop_back();
+    const ASTCreateProcedureStatement *children_procedure = procedure;
+    switch (node->node_kind()) {
+    case AST_CREATE_PROCEDURE_STATEMENT: {
+      const auto *create = node->GetAs<ASTCreateProcedureStatement>();
+      if (create->scope() != ASTCreateStatement::TEMPORARY) {
+        children_procedure = create;
+      }
+      break;
+    }
+    case AST_CREATE_TABLE_STATEMENT: {
+      const auto *create = node->GetAs<ASTCreateTableStatement>();
+      if (procedure != nullptr &&
+          create->scope() != ASTCreateStatement::TEMPORARY) {
+        (*procedures)[procedure->name()->ToIdentifierVector()].insert(
+            create->name()->ToIdentifierVector());
+      }
+      break;
+    }
+    default:
+      break;
+    }
+    // Expressions hold neither procedures nor tables.
+    if (node->IsExpression()) {
+      continue;
+    }
+    for (int i = node->num_children() - 1; i >= 0; --i) {
+      stack.push_back({node->child(i), children_procedure});
+    }
+  }
+}
+
+// Fingerprint of the artifacts of the procedures among <called>, which CALL
+// statements add to the created tables.
+uint64_t ProcedureFingerprint(const std::set<std::vector<std::string>> &called,
+                              const ProcedureIndex &procedures) {
+  uint64_t fingerprint = 0;
+  for (const auto &name : called) {
+    const auto it = procedures.find(name);
+    if (it == procedures.end() || it->second.empty()) {
+      continue;
+    }
+    std::string description = absl::StrJoin(name, ".");
+    for (const auto &artifact : it->second) {
+      absl::StrAppend(&description, " ", absl::StrJoin(artifact, "."));
+    }
+    fingerprint += Fingerprint(description);
+  }
+  return fingerprint;
+}
+
+// Identifiers of a file gathered statement by statement, along with an order
+// independent fingerprint of the tables statements read from earlier ones.
+struct IncrementalState {
+  identifier_info information;
+  std::set<std::string> temporary_tables;
+  uint64_t context_fingerprint = 0;
+
+  void AddCreated(const std::vector<std::string> &path) {
+    if (information.table_information.created.insert(path).second) {
+      context_fingerprint +=
+          Fingerprint(absl::StrCat("created ", absl::StrJoin(path, ".")));
+    }
+  }
+
+  void AddTemporary(const std::string &name) {
+    if (temporary_tables.insert(name).second) {
+      context_fingerprint += Fingerprint(absl::StrCat("temporary ", name));
+    }
+  }
+
+  // Adds what <statement> contributes to the file.
+  void Apply(const CachedStatement &statement) {
+    auto &tables = information.table_information;
+    auto &functions = information.function_information;
+    for (const NamePath &name_path : statement.created_tables()) {
+      AddCreated(ToPath(name_path));
+    }
+    InsertPaths(statement.referenced_tables(), &tables.referenced);
+    InsertPaths(statement.dropped_tables(), &tables.dropped);
+    InsertPaths(statement.inserted_tables(), &tables.inserted);
+    InsertPaths(statement.updated_tables(), &tables.updated);
+    InsertPaths(statement.called_functions(), &functions.called);
+    InsertPaths(statement.defined_functions(), &functions.defined);
+    InsertPaths(statement.dropped_functions(), &functions.dropped);
+    for (const std::string &name : statement.temporary_tables()) {
+      AddTemporary(name);
+    }
+  }
+};
+
+// Parses the statement at <position> of <sql_file> and records in
+// <statement> what it contributes to the file after what <state> holds.
+absl::Status ResolveStatement(const AnalyzerOptions &options,
+                              const SQLFile &sql_file, size_t position,
+                              const ProcedureIndex &procedures,
+                              const IncrementalState &state,
+                              CachedStatement *statement) {
+  ParseResumeLocation location =
+      ParseResumeLocation::FromStringView(sql_file.path, sql_file.sql);
+  location.set_byte_position(position);
+  const ParserOptions parser_options(
+      std::make_shared<IdStringPool>(),
+      std::make_shared<zetasql_base::UnsafeArena>(/*block_size=*/4096),
+      &options.language());
+  std::unique_ptr<ParserOutput> parser_output;
+  bool at_end_of_input;
+  const absl::Status status = ParseNextScriptStatement(
+      &location, parser_options, &parser_output, &at_end_of_input);
+  if (!status.ok()) {
+    return MaybeUpdateErrorFromPayload(options.error_message_mode(),
+                                       sql_file.sql, status);
+  }
+  const ASTStatement *ast_statement = parser_output->statement();
+
+  IdentifierResolver resolver(&procedures);
+  resolver.temporary_tables = state.temporary_tables;
+  resolver.identifier_information.table_information.created =
+      state.information.table_information.created;
+  ZETASQL_RETURN_IF_ERROR(
+      resolver.Resolve(ast_statement, sql_file.sql, options));
+
+  // Only whitespace and comments follow the last statement when it lacks its
+  // semicolon.
+  const int statement_end =
+      ast_statement->GetParseLocationRange().end().GetByteOffset();
+  StatementCache::SetSegment(
+      absl::string_view(sql_file.sql)
+          .substr(position, location.byte_position() - position),
+      /*terminated=*/!IsBlankFrom(
+          absl::string_view(sql_file.sql).substr(0, location.byte_position()),
+          statement_end),
+      statement);
+  const auto &tables = resolver.identifier_information.table_information;
+  const auto &functions = resolver.identifier_information.function_information;
+  statement->set_context_fingerprint(state.context_fingerprint);
+  statement->set_procedure_fingerprint(
+      ProcedureFingerprint(functions.called, procedures));
+  for (const auto &path : tables.created) {
+    if (state.information.table_information.created.count(path) == 0) {
+      ToNamePath(path, statement->add_created_tables());
+    }
+  }
+  AddPaths(tables.referenced, statement->mutable_referenced_tables());
+  AddPaths(tables.dropped, statement->mutable_dropped_tables());
+  AddPaths(tables.inserted, statement->mutable_inserted_tables());
+  AddPaths(tables.updated, statement->mutable_updated_tables());
+  AddPaths(functions.called, statement->mutable_called_functions());
+  AddPaths(functions.defined, statement->mutable_defined_functions());
+  AddPaths(functions.dropped, statement->mutable_dropped_functions());
+  for (const std::string &name : resolver.temporary_tables) {
+    if (state.temporary_tables.count(name) == 0) {
+      statement->add_temporary_tables(name);
+    }
+  }
+  for (const std::string &warning : resolver.warnings) {
+    statement->add_warnings(warning);
+  }
+  return absl::OkStatus();
+}
+
+// Same as GetIdentifierInformation, reusing what statements cached in
+// <cache_dir> contributed when neither their text nor what they read from
+// earlier statements changed, and parsing the others one at a time.
+zetasql_base::StatusOr<identifier_info>
+GetIdentifierInformationIncrementally(const SQLFile &sql_file,
+                                      const ProcedureIndex &procedures,
+                                      const std::string &cache_dir) {
+  const AnalyzerOptions options = GetAnalyzerOptions();
+  const StatementCache cache(cache_dir, sql_file.path);
+  IncrementalState state;
+  std::vector<CachedStatement> statements;
+  size_t position = 0;
+  while (!IsBlankFrom(sql_file.sql, position)) {
+    const CachedStatement *cached = nullptr;
+    for (const CachedStatement *candidate :
+         cache.Find(sql_file.sql, position)) {
+      std::set<std::vector<std::string>> called;
+      InsertPaths(candidate->called_functions(), &called);
+      if (candidate->context_fingerprint() == state.context_fingerprint &&
+          candidate->procedure_fingerprint() ==
+              ProcedureFingerprint(called, procedures)) {
+        cached = candidate;
+        break;
+      }
+    }
+    CachedStatement statement;
+    if (cached != nullptr) {
+      // Cached warnings are located at the start of their statement.
+      for (const std::string &warning : cached->warnings()) {
+        EmitWarning(MakeDiagnostic(
+            Severity::kWarning, warning, sql_file.sql,
+            ParseLocationPoint::FromByteOffset(sql_file.path, position),
+            sql_file.path));
+      }
+      statement = *cached;
+    } else {
+      ZETASQL_RETURN_IF_ERROR(ResolveStatement(options, sql_file, position,
+                                               procedures, state, &statement));
+    }
+    state.Apply(statement);
+    position += statement.segment_length();
+    statements.push_back(std::move(statement));
+  }
+
+  const auto status = cache.Store(statements);
+  if (!status.ok()) {
+    Report(MakeDiagnostic(Severity::kWarning,
+                          absl::StrCat("statement cache not updated: ",
+                                       status.message()),
+                          absl::OkStatus(), sql_file.path),
+           absl::StrCat("WARNING: statement cache not updated: ",
+                        status.ToString()),
+           std::cout);
+  }
+  FilterTemporaryTables(state.temporary_tables, &state.information);
+  return state.information;
+}
+
+} // namespace
+
+bool ParsesWholeFiles() {
+  return !absl::GetFlag(FLAGS_stream_statements) &&
+         absl::GetFlag(FLAGS_statement_cache_dir).empty();
+}
+
+bool MayDefineProcedures(const SQLFile &sql_file) {
+  return absl::AsciiStrToLower(sql_file.sql).find("procedure") !=
+         std::string::npos;
+}
+
+absl::Status IndexProcedures(const SQLFile &sql_file,
+                             ProcedureIndex *procedures) {
+  // Most files define no procedure and need not be parsed here.
+  if (sql_file.parser_output == nullptr && !MayDefineProcedures(sql_file)) {
+    return absl::OkStatus();
+  }
+  return ForEachStatement(
+      GetAnalyzerOptions(), sql_file, [&](const ASTStatement *statement) {
+        IndexProceduresUnder(statement, procedures);
+        return absl::OkStatus();
+      });
+}
 
+zetasql_base::StatusOr<identifier_info>
+GetIdentifierInformation(const std::string &sql_file_path,
+                         const ProcedureIndex &procedures) {
+  const AnalyzerOptions options = GetAnalyzerOptions();
+  SQLFile sql_file;
+  ReadSQLFile(sql_file_path, &sql_file);
+  if (ParsesWholeFiles()) {
+    ZETASQL_RETURN_IF_ERROR(ParseSQLFile(options, &sql_file));
+  }
+  return GetIdentifierInformation(sql_file, procedures);
+}
+
+zetasql_base::StatusOr<identifier_info>
+GetIdentifierInformation(const SQLFile &sql_file,
+                         const ProcedureIndex &procedures) {
+  const std::string cache_dir = absl::GetFlag(FLAGS_statement_cache_dir);
+  if (!cache_dir.empty()) {
+    return GetIdentifierInformationIncrementally(sql_file, procedures,
+                                                 cache_dir);
+  }
+  const AnalyzerOptions options = GetAnalyzerOptions();
+
+  IdentifierResolver resolver(&procedures);
+  const auto status = ForEachStatement(
+      options, sql_file, [&](const ASTStatement *statement) {
+        return resolver.Resolve(statement, sql_file.sql, options);
+      });
+  if (!status.ok()) {
+    return status;
+  }
+
+  FilterTemporaryTables(resolver.temporary_tables,
+                        &resolver.identifier_information);
   return resolver.identifier_information;
 }
 
-void IdentifierResolver::visitASTDropStatement(const ASTDropStatement *node,
-                                               void *data) {
+absl::Status IdentifierResolver::Resolve(const ASTStatement *statement,
+                                         absl::string_view sql,
+                                         const AnalyzerOptions &options) {
+  table_name_resolver::TableNameResolver table_finder(
+      sql, &options, /*type_factory=*/nullptr, /*catalog=*/nullptr,
+      &identifier_information.table_information.referenced,
+      /*table_resolution_time_info_map=*/nullptr);
+  table_finder.set_observer(this);
+  sql_ = sql;
+  return table_finder.FindInStatement(statement);
+}
+
+bool IdentifierResolver::Enter(const ASTNode *node) {
+  if (node->parent() != nullptr && IsIgnoredPartOf(node->parent(), node)) {
+    return false;
+  }
+  switch (node->node_kind()) {
+  // Tables
+  case AST_DROP_STATEMENT:
+    EnterDropStatement(node->GetAs<ASTDropStatement>());
+    return true;
+  case AST_CREATE_TABLE_STATEMENT:
+    EnterCreateTableStatement(node->GetAs<ASTCreateTableStatement>());
+    return true;
+  case AST_INSERT_STATEMENT:
+    EnterInsertStatement(node->GetAs<ASTInsertStatement>());
+    return true;
+  case AST_UPDATE_STATEMENT:
+    EnterUpdateStatement(node->GetAs<ASTUpdateStatement>());
+    return true;
+
+  // Functions
+  case AST_DROP_FUNCTION_STATEMENT:
+    // if (node->is_if_exists()) {}
+    identifier_information.function_information.dropped.insert(
+        node->GetAs<ASTDropFunctionStatement>()->name()->ToIdentifierVector());
+    return true;
+  case AST_TVF:
+    identifier_information.function_information.called.insert(
+        node->GetAs<ASTTVF>()->name()->ToIdentifierVector());
+    return true;
+  case AST_FUNCTION_CALL: {
+    // Builtins are never defined by files, so they can not add edges.
+    std::vector<std::string> path =
+        node->GetAs<ASTFunctionCall>()->function()->ToIdentifierVector();
+    if (!IsBuiltinFunction(path)) {
+      identifier_information.function_information.called.insert(
+          std::move(path));
+    }
+    return true;
+  }
+  case AST_FUNCTION_DECLARATION:
+    identifier_information.function_information.defined.insert(
+        node->GetAs<ASTFunctionDeclaration>()->name()->ToIdentifierVector());
+    return false;
+  case AST_CREATE_FUNCTION_STATEMENT:
+    return !node->GetAs<ASTCreateFunctionStatement>()->is_temp();
+  case AST_CREATE_TABLE_FUNCTION_STATEMENT:
+    return !node->GetAs<ASTCreateTableFunctionStatement>()->is_temp();
+  case AST_CALL_STATEMENT:
+    EnterCallStatement(node->GetAs<ASTCallStatement>());
+    return true;
+  case AST_CREATE_PROCEDURE_STATEMENT:
+    EnterCreateProcedureStatement(node->GetAs<ASTCreateProcedureStatement>());
+    return true;
+  default:
+    return true;
+  }
+}
+
+void IdentifierResolver::Leave(const ASTNode *node) {
+  if (node->node_kind() == AST_CREATE_PROCEDURE_STATEMENT &&
+      node->GetAs<ASTCreateProcedureStatement>()->scope() !=
+          ASTCreateStatement::TEMPORARY) {
+    is_inside_procedure = false;
+  }
+}
+
+void IdentifierResolver::Warn(const ASTNode *node,
+                              const std::string &message) {
+  warnings.push_back(message);
+  const ParseLocationPoint &start = node->GetParseLocationRange().start();
+  EmitWarning(MakeDiagnostic(Severity::kWarning, message, sql_, start,
+                             std::string(start.filename())));
+}
+
+void IdentifierResolver::EnterDropStatement(const ASTDropStatement *node) {
   if (node->schema_object_kind() == SchemaObjectKind::kTable) {
     const auto table_name = absl::StrJoin(node->name()->ToIdentifierVector(), ".");
     if (temporary_tables.find(table_name) != temporary_tables.end()) {
-      visitASTChildren(node, data);
       return;
     }
     identifier_information.table_information.dropped.insert(
         node->name()->ToIdentifierVector());
   }
-  visitASTChildren(node, data);
 }
 
-void IdentifierResolver::visitASTCreateTableStatement(
-    const ASTCreateTableStatement *node, void *data) {
+void IdentifierResolver::EnterCreateTableStatement(
+    const ASTCreateTableStatement *node) {
   const auto &name_vector = node->name()->ToIdentifierVector();
   if (node->scope() == ASTCreateStatement::TEMPORARY) {
     const std::string path_str = absl::StrJoin(name_vector, ".");
     temporary_tables.insert(path_str);
-    visitASTChildren(node, data);
     return;
   }
 
+  // Tables of procedures are created by CALL statements instead.
   if (is_inside_procedure) {
-    procedure_artifacts_map[procedure_name].insert(name_vector);
-    visitASTChildren(node, data);
     return;
   }
   identifier_information.table_information.created.insert(name_vector);
-  visitASTChildren(node, data);
 }
 
 // Check INSERT and UPDATE statement to emit warnings for side effects.
-void IdentifierResolver::visitASTInsertStatement(const ASTInsertStatement *node,
-                                                 void *data) {
+void IdentifierResolver::EnterInsertStatement(const ASTInsertStatement *node) {
   const auto status_or_path = node->GetTargetPathForNonNested();
   if (!status_or_path.ok()) {
-    std::cerr << "Path expression can't be extracted" << std::endl;
-    std::cerr << status_or_path.status() << std::endl;
-    visitASTChildren(node, data);
+    Report(MakeDiagnostic(Severity::kError,
+                          std::string(status_or_path.status().message()),
+                          status_or_path.status()),
+           absl::StrCat("Path expression can't be extracted\n",
+                        status_or_path.status().ToString()),
+           std::cerr);
     return;
   }
 
   const auto path = status_or_path.value()->ToIdentifierVector();
   const auto table_name = absl::StrJoin(path, ".");
   if (temporary_tables.find(table_name) != temporary_tables.end()) {
-    visitASTChildren(node, data);
     return;
   }
   identifier_information.table_information.inserted.insert(path);
@@ -161,37 +575,32 @@ void IdentifierResolver::visitASTInsertStatement(const ASTInsertStatement *node,
   for (const auto &created_table :
        identifier_information.table_information.created) {
     if (absl::StrJoin(created_table, ".") == path_str) {
-      visitASTChildren(node, data);
       return;
     }
   }
-  std::cout << "Warning!!! the target of INSERT statement " << path_str
-            << " is not created in the same script!!!" << std::endl;
-  std::cout << "This script is not idempotent. See "
-               "https://github.com/Matts966/alphasql/issues/"
-               "5#issuecomment-735209829 for more details."
-            << std::endl;
-  const bool warning_as_error = absl::GetFlag(FLAGS_warning_as_error);
-  if (warning_as_error) {
-    exit(1);
-  }
-  visitASTChildren(node, data);
+  Warn(node,
+       absl::StrCat("Warning!!! the target of INSERT statement ", path_str,
+                    " is not created in the same script!!!\n",
+                    "This script is not idempotent. See "
+                    "https://github.com/Matts966/alphasql/issues/"
+                    "5#issuecomment-735209829 for more details."));
 }
 
-void IdentifierResolver::visitASTUpdateStatement(const ASTUpdateStatement *node,
-                                                 void *data) {
+void IdentifierResolver::EnterUpdateStatement(const ASTUpdateStatement *node) {
   const auto status_or_path = node->GetTargetPathForNonNested();
   if (!status_or_path.ok()) {
-    std::cerr << "Path expression can't be extracted!" << std::endl;
-    std::cerr << status_or_path.status() << std::endl;
-    visitASTChildren(node, data);
+    Report(MakeDiagnostic(Severity::kError,
+                          std::string(status_or_path.status().message()),
+                          status_or_path.status()),
+           absl::StrCat("Path expression can't be extracted!\n",
+                        status_or_path.status().ToString()),
+           std::cerr);
     return;
   }
 
   const auto path = status_or_path.value()->ToIdentifierVector();
   const auto table_name = absl::StrJoin(path, ".");
   if (temporary_tables.find(table_name) != temporary_tables.end()) {
-    visitASTChildren(node, data);
     return;
   }
   identifier_information.table_information.updated.insert(path);
@@ -200,97 +609,37 @@ void IdentifierResolver::visitASTUpdateStatement(const ASTUpdateStatement *node,
   for (const auto &created_table :
        identifier_information.table_information.created) {
     if (absl::StrJoin(created_table, ".") == path_str) {
-      visitASTChildren(node, data);
       return;
     }
   }
-  std::cout << "Warning!!! the target of UPDATE statement " << path_str
-            << " is not created in the same script!!!" << std::endl;
-  std::cout << "This script is not idempotent. See "
-               "https://github.com/Matts966/alphasql/issues/"
-               "5#issuecomment-735209829 for more details."
-            << std::endl;
-  const bool warning_as_error = absl::GetFlag(FLAGS_warning_as_error);
-  if (warning_as_error) {
-    exit(1);
-  }
-  visitASTChildren(node, data);
+  Warn(node,
+       absl::StrCat("Warning!!! the target of UPDATE statement ", path_str,
+                    " is not created in the same script!!!\n",
+                    "This script is not idempotent. See "
+                    "https://github.com/Matts966/alphasql/issues/"
+                    "5#issuecomment-735209829 for more details."));
 }
 
-void IdentifierResolver::visitASTDropFunctionStatement(
-    const ASTDropFunctionStatement *node, void *data) {
-  // if (node->is_if_exists()) {}
-  identifier_information.function_information.dropped.insert(
-      node->name()->ToIdentifierVector());
-  visitASTChildren(node, data);
-}
-
-void IdentifierResolver::visitASTTVF(const ASTTVF* node, void* data) {
-  identifier_information.function_information.called.insert(
-      node->name()->ToIdentifierVector());
-  visitASTChildren(node, data);
-}
-
-void IdentifierResolver::visitASTFunctionCall(const ASTFunctionCall *node,
-                                              void *data) {
-  identifier_information.function_information.called.insert(
-      node->function()->ToIdentifierVector());
-  visitASTChildren(node, data);
-}
-
-void IdentifierResolver::visitASTFunctionDeclaration(
-    const ASTFunctionDeclaration *node, void *data) {
-  identifier_information.function_information.defined.insert(
-      node->name()->ToIdentifierVector());
-}
-
-void IdentifierResolver::visitASTCreateFunctionStatement(
-    const ASTCreateFunctionStatement *node, void *data) {
-  if (node->is_temp()) {
-    return;
-  }
-  node->function_declaration()->Accept(this, data);
-  if (node->sql_function_body() != nullptr) {
-    node->sql_function_body()->Accept(this, data);
-  }
-}
-
-void IdentifierResolver::visitASTCreateTableFunctionStatement(
-    const ASTCreateTableFunctionStatement *node, void *data) {
-  if (node->is_temp()) {
-    return;
-  }
-  node->function_declaration()->Accept(this, data);
-  if (node->query() != nullptr) {
-    node->query()->Accept(this, data);
-  }
-}
-
-void IdentifierResolver::visitASTCallStatement(const ASTCallStatement *node,
-                                               void *data) {
-  for (const auto &artifact_table : procedure_artifacts_map[node->procedure_name()->ToIdentifierVector()]) {
-    identifier_information.table_information.created.insert(artifact_table);
+void IdentifierResolver::EnterCallStatement(const ASTCallStatement *node) {
+  const auto procedure = node->procedure_name()->ToIdentifierVector();
+  const auto it = procedures_->find(procedure);
+  if (it != procedures_->end()) {
+    for (const auto &artifact_table : it->second) {
+      identifier_information.table_information.created.insert(artifact_table);
+    }
   }
-  identifier_information.function_information.called.insert(
-      node->procedure_name()->ToIdentifierVector());
-  node->ChildrenAccept(this, data);
-  return;
+  identifier_information.function_information.called.insert(procedure);
 }
 
-void IdentifierResolver::visitASTCreateProcedureStatement(
-    const ASTCreateProcedureStatement* node, void* data) {
-  const auto &name_vector = node->name()->ToIdentifierVector();
+void IdentifierResolver::EnterCreateProcedureStatement(
+    const ASTCreateProcedureStatement *node) {
   if (node->scope() == ASTCreateStatement::TEMPORARY) {
-    node->ChildrenAccept(this, data);
     return;
   }
 
   is_inside_procedure = true;
-  procedure_name = name_vector;
-  identifier_information.function_information.defined.insert(name_vector);
-  node->ChildrenAccept(this, data);
-  is_inside_procedure = false;
-  return;
+  identifier_information.function_information.defined.insert(
+      node->name()->ToIdentifierVector());
 }
 
 } // namespace identifier_resolver
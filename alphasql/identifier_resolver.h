@@ -18,18 +18,23 @@
 #define ALPHASQL_IDENTIFIER_RESOLVER_H_
 
 #include <filesystem>
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
 #include "absl/flags/flag.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
+#include "alphasql/node_observer.h"
+#include "alphasql/sql_file.h"
 #include "zetasql/base/logging.h"
 #include "zetasql/parser/parse_tree.h"
-#include "zetasql/parser/parse_tree_visitor.h"
 #include "zetasql/public/analyzer.h"
 
 ABSL_DECLARE_FLAG(bool, warning_as_error);
+ABSL_DECLARE_FLAG(bool, stream_statements);
+ABSL_DECLARE_FLAG(std::string, statement_cache_dir);
 
 namespace alphasql {
 
@@ -59,58 +64,81 @@ struct identifier_info {
   table_info table_information;
 };
 
+// Tables created in the bodies of procedures, keyed by procedure name. Calling
+// a procedure creates its tables.
+using ProcedureIndex =
+    std::map<std::vector<std::string>, std::set<std::vector<std::string>>>;
+
+// Whether files are parsed whole, rather than one statement at a time as with
+// --stream_statements and --statement_cache_dir.
+bool ParsesWholeFiles();
+
+// Whether <sql_file> may define procedures, so that IndexProcedures has to
+// parse it.
+bool MayDefineProcedures(const SQLFile &sql_file);
+
+// Adds the procedures <sql_file> defines to <procedures>. Every file is
+// indexed before any is resolved against the index, so that CALL statements
+// resolve the same way whatever order files are resolved in, and files can be
+// resolved concurrently.
+absl::Status IndexProcedures(const SQLFile &sql_file,
+                             ProcedureIndex *procedures);
+
 zetasql_base::StatusOr<identifier_info>
-GetIdentifierInformation(const std::string &sql_file_path);
+GetIdentifierInformation(const std::string &sql_file_path,
+                         const ProcedureIndex &procedures);
 
-class IdentifierResolver : public DefaultParseTreeVisitor {
+// Same as above for a file parsed with GetAnalyzerOptions(), or not parsed
+// yet, in which case its statements are parsed one at a time.
+zetasql_base::StatusOr<identifier_info>
+GetIdentifierInformation(const SQLFile &sql_file,
+                         const ProcedureIndex &procedures);
+
+// Gathers what statements create, reference, drop, insert into, update,
+// call and define. The nodes of each statement are reported by the
+// TableNameResolver finding the tables it references, so that both share a
+// single traversal.
+class IdentifierResolver : public NodeObserver {
 public:
-  explicit IdentifierResolver() {}
+  // <procedures> must outlive the created IdentifierResolver.
+  explicit IdentifierResolver(const ProcedureIndex *procedures)
+      : procedures_(procedures) {}
   IdentifierResolver(const IdentifierResolver &) = delete;
   IdentifierResolver &operator=(const IdentifierResolver &) = delete;
   ~IdentifierResolver() override {}
 
   identifier_info identifier_information;
   std::set<std::string> temporary_tables;
+  // Warnings emitted while resolving, in order.
+  std::vector<std::string> warnings;
   bool is_inside_procedure = false;
-  std::vector<std::string> procedure_name;
-  inline static std::map<std::vector<std::string>, std::set<std::vector<std::string>>>
-      procedure_artifacts_map;
-
-  void defaultVisit(const ASTNode *node, void *data) override {
-    visitASTChildren(node, data);
-  }
 
-  void visitASTChildren(const ASTNode *node, void *data) {
-    node->ChildrenAccept(this, data);
-  }
+  // Adds the identifiers of <statement>, parsed from <sql> with <options>,
+  // including the tables it references.
+  absl::Status Resolve(const ASTStatement *statement, absl::string_view sql,
+                       const AnalyzerOptions &options);
 
-  void visit(const ASTNode *node, void *data) override {
-    visitASTChildren(node, data);
-  }
+  // NodeObserver implementation.
+  bool Enter(const ASTNode *node) override;
+  void Leave(const ASTNode *node) override;
 
-  // Visitor implementation.
+private:
   // Tables
-  void visitASTDropStatement(const ASTDropStatement *node, void *data) override;
-  void visitASTCreateTableStatement(const ASTCreateTableStatement *node,
-                                    void *data) override;
-  void visitASTInsertStatement(const ASTInsertStatement *node,
-                               void *data) override;
-  void visitASTUpdateStatement(const ASTUpdateStatement *node,
-                               void *data) override;
+  void EnterDropStatement(const ASTDropStatement *node);
+  void EnterCreateTableStatement(const ASTCreateTableStatement *node);
+  void EnterInsertStatement(const ASTInsertStatement *node);
+  void EnterUpdateStatement(const ASTUpdateStatement *node);
 
   // Functions
-  void visitASTDropFunctionStatement(const ASTDropFunctionStatement *node,
-                                     void *data) override;
-  void visitASTTVF(const ASTTVF* node, void* data) override;
-  void visitASTFunctionCall(const ASTFunctionCall *node, void *data) override;
-  void visitASTFunctionDeclaration(const ASTFunctionDeclaration *node,
-                                   void *data) override;
-  void visitASTCreateFunctionStatement(const ASTCreateFunctionStatement *node,
-                                       void *data) override;
-  void visitASTCreateTableFunctionStatement(
-      const ASTCreateTableFunctionStatement *node, void *data) override;
-  void visitASTCallStatement(const ASTCallStatement *node, void *data) override;
-  void visitASTCreateProcedureStatement(const ASTCreateProcedureStatement* node, void* data) override;
+  void EnterCallStatement(const ASTCallStatement *node);
+  void EnterCreateProcedureStatement(const ASTCreateProcedureStatement *node);
+
+  // Emits <message> located at <node>.
+  void Warn(const ASTNode *node, const std::string &message);
+
+  const ProcedureIndex *procedures_; // Not owned.
+  // The SQL being resolved, for locations. Not owned.
+  absl::string_view sql_;
 };
 
 } // namespace identifier_resolver
@@ -0,0 +1,174 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/identifier_resolver.h"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "alphasql/sql_file.h"
+#include "gtest/gtest.h"
+
+namespace alphasql {
+namespace {
+
+using namespace identifier_resolver;
+
+// Deep enough to exhaust the call stack of a recursive traversal.
+constexpr int kDepth = 60000;
+
+SQLFile MakeFile(const std::string &sql) {
+  SQLFile file;
+  file.path = "generated.sql";
+  file.sql = sql;
+  return file;
+}
+
+// Records the time taken since <start> and the peak resident set size of the
+// test, so that regressions on deep inputs show up in the test report.
+void RecordCost(const std::chrono::steady_clock::time_point &start) {
+  const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - start);
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  ::testing::Test::RecordProperty("milliseconds",
+                                  static_cast<int>(elapsed.count()));
+  ::testing::Test::RecordProperty("peak_rss_kilobytes",
+                                  static_cast<int>(usage.ru_maxrss));
+}
+
+identifier_info Resolve(const std::string &sql) {
+  const auto start = std::chrono::steady_clock::now();
+  const auto information = GetIdentifierInformation(MakeFile(sql), {});
+  RecordCost(start);
+  EXPECT_TRUE(information.ok()) << information.status();
+  if (!information.ok()) {
+    return {};
+  }
+  return information.value();
+}
+
+// SELECT my_udf(x) + 1 + ... + 1 FROM t, a left-deep chain of additions.
+TEST(IdentifierResolverDepth, ChainedExpressions) {
+  std::string sql = "SELECT my_udf(x)";
+  for (int i = 0; i < kDepth; ++i) {
+    absl::StrAppend(&sql, " + 1");
+  }
+  absl::StrAppend(&sql, " FROM t");
+
+  const identifier_info information = Resolve(sql);
+  EXPECT_EQ(information.table_information.referenced,
+            (std::set<std::vector<std::string>>{{"t"}}));
+  EXPECT_EQ(information.function_information.called,
+            (std::set<std::vector<std::string>>{{"my_udf"}}));
+}
+
+// CASE WHEN x = 0 THEN 0 ELSE CASE ... ELSE (SELECT my_udf(x) FROM t) END END
+TEST(IdentifierResolverDepth, NestedCaseExpressions) {
+  std::string sql = "SELECT ";
+  for (int i = 0; i < kDepth; ++i) {
+    absl::StrAppend(&sql, "CASE WHEN x = ", i, " THEN ", i, " ELSE ");
+  }
+  absl::StrAppend(&sql, "(SELECT my_udf(x) FROM t)");
+  for (int i = 0; i < kDepth; ++i) {
+    absl::StrAppend(&sql, " END");
+  }
+  absl::StrAppend(&sql, " FROM u");
+
+  const identifier_info information = Resolve(sql);
+  EXPECT_EQ(information.table_information.referenced,
+            (std::set<std::vector<std::string>>{{"t"}, {"u"}}));
+  EXPECT_EQ(information.function_information.called,
+            (std::set<std::vector<std::string>>{{"my_udf"}}));
+}
+
+// CREATE TABLE created AS ((SELECT x FROM t) UNION ALL SELECT 1) UNION ALL ...
+TEST(IdentifierResolverDepth, NestedSetOperations) {
+  std::string query = std::string(kDepth, '(');
+  absl::StrAppend(&query, "SELECT x FROM t");
+  for (int i = 0; i < kDepth; ++i) {
+    absl::StrAppend(&query, ") UNION ALL SELECT ", i);
+  }
+
+  const identifier_info information =
+      Resolve(absl::StrCat("CREATE TABLE created AS ", query));
+  EXPECT_EQ(information.table_information.created,
+            (std::set<std::vector<std::string>>{{"created"}}));
+  EXPECT_EQ(information.table_information.referenced,
+            (std::set<std::vector<std::string>>{{"t"}}));
+}
+
+// SELECT * FROM (SELECT * FROM (... FROM t AS a, a.items) AS s1) AS s0,
+// which must still see correlated paths as aliases rather than tables.
+TEST(IdentifierResolverDepth, NestedTableSubqueries) {
+  std::string query;
+  for (int i = 0; i < kDepth; ++i) {
+    absl::StrAppend(&query, "SELECT * FROM (");
+  }
+  absl::StrAppend(&query, "SELECT * FROM t AS a, a.items");
+  for (int i = kDepth - 1; i >= 0; --i) {
+    absl::StrAppend(&query, ") AS s", i);
+  }
+
+  const identifier_info information = Resolve(query);
+  EXPECT_EQ(information.table_information.referenced,
+            (std::set<std::vector<std::string>>{{"t"}}));
+}
+
+// CREATE PROCEDURE p() BEGIN BEGIN ... CREATE TABLE created ... END; END;
+TEST(IdentifierResolverDepth, NestedBlocks) {
+  std::string sql = "CREATE PROCEDURE p()\n";
+  for (int i = 0; i < kDepth; ++i) {
+    absl::StrAppend(&sql, "BEGIN\n");
+  }
+  absl::StrAppend(&sql, "CREATE TABLE created AS SELECT x FROM t;\n");
+  for (int i = 0; i < kDepth; ++i) {
+    absl::StrAppend(&sql, "END;\n");
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  ProcedureIndex procedures;
+  const absl::Status status = IndexProcedures(MakeFile(sql), &procedures);
+  RecordCost(start);
+  ASSERT_TRUE(status.ok()) << status;
+  ProcedureIndex expected;
+  expected[{"p"}].insert({"created"});
+  EXPECT_EQ(procedures, expected);
+
+  // Tables created in the body are artifacts of calls, not of the definition.
+  const identifier_info information = Resolve(sql);
+  EXPECT_TRUE(information.table_information.created.empty());
+}
+
+TEST(IdentifierResolverIncremental, AppendingToUnterminatedLastStatement) {
+  absl::SetFlag(&FLAGS_statement_cache_dir,
+                absl::StrCat(testing::TempDir(), "/identifier_cache_append"));
+  const std::string sql = "SELECT 1;\nSELECT x FROM a";
+  EXPECT_EQ(Resolve(sql).table_information.referenced,
+            (std::set<std::vector<std::string>>{{"a"}}));
+  // The cached last statement is now only a prefix of the statement.
+  EXPECT_EQ(Resolve(sql + " JOIN b USING (x)").table_information.referenced,
+            (std::set<std::vector<std::string>>{{"a"}, {"b"}}));
+  absl::SetFlag(&FLAGS_statement_cache_dir, "");
+}
+
+} // namespace
+} // namespace alphasql
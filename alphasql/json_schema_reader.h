@@ -14,7 +14,13 @@
 // limitations under the License.
 //
 
+#ifndef ALPHASQL_JSON_SCHEMA_READER_H_
+#define ALPHASQL_JSON_SCHEMA_READER_H_
+
+#include "absl/container/flat_hash_map.h"
 #include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "alphasql/diagnostics.h"
 #include "alphasql/proto/alphasql_service.pb.h"
 #include "zetasql/base/status.h"
 #include "zetasql/base/status_macros.h"
@@ -24,9 +30,13 @@
 #include <boost/foreach.hpp>
 #include <boost/property_tree/json_parser.hpp>
 #include <google/protobuf/util/json_util.h>
+#include <filesystem>
 #include <iostream>
+#include <map>
+#include <sstream>
 #include <string>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 namespace alphasql {
@@ -41,11 +51,62 @@ std::map<SupportedType, zetasql::TypeKind> FromBigQueryTypeToZetaSQLTypeMap = {
     {DATETIME, zetasql::TYPE_DATETIME}, {GEOGRAPHY, zetasql::TYPE_GEOGRAPHY},
 };
 
-static zetasql::TypeFactory tf;
+// Interns struct and array types built from JSON schema columns so that
+// identical RECORD shapes, which tend to repeat across many tables, share one
+// zetasql::Type instead of allocating a new one per column.
+// Field types are interned bottom-up, so nested shapes can be keyed by the
+// pointers of their (already canonical) field types.
+// This class is not thread-safe.
+class CanonicalTypeCache {
+public:
+  explicit CanonicalTypeCache(zetasql::TypeFactory *type_factory)
+      : type_factory_(type_factory) {}
+  CanonicalTypeCache(const CanonicalTypeCache &) = delete;
+  CanonicalTypeCache &operator=(const CanonicalTypeCache &) = delete;
+
+  absl::Status MakeStructType(const std::vector<zetasql::StructField> &fields,
+                              const zetasql::Type **result) {
+    StructKey key;
+    key.reserve(fields.size());
+    for (const auto &field : fields) {
+      key.emplace_back(field.name, field.type);
+    }
+    const auto it = struct_types_.find(key);
+    if (it != struct_types_.end()) {
+      *result = it->second;
+      return absl::OkStatus();
+    }
+    ZETASQL_RETURN_IF_ERROR(
+        type_factory_->MakeStructTypeFromVector(fields, result));
+    struct_types_.emplace(std::move(key), *result);
+    return absl::OkStatus();
+  }
+
+  absl::Status MakeArrayType(const zetasql::Type *element_type,
+                             const zetasql::Type **result) {
+    const auto it = array_types_.find(element_type);
+    if (it != array_types_.end()) {
+      *result = it->second;
+      return absl::OkStatus();
+    }
+    ZETASQL_RETURN_IF_ERROR(type_factory_->MakeArrayType(element_type, result));
+    array_types_.emplace(element_type, *result);
+    return absl::OkStatus();
+  }
+
+private:
+  typedef std::vector<std::pair<std::string, const zetasql::Type *>> StructKey;
+
+  zetasql::TypeFactory *type_factory_; // Not owned.
+  absl::flat_hash_map<StructKey, const zetasql::Type *> struct_types_;
+  absl::flat_hash_map<const zetasql::Type *, const zetasql::Type *>
+      array_types_;
+};
 
 // TODO: Handle return statuses of type:: functions
 absl::Status ConvertSupportedTypeToZetaSQLType(const zetasql::Type **zetasql_type,
-                                       const Column *column) {
+                                       const Column *column,
+                                       CanonicalTypeCache *types) {
   if (column->mode() == REPEATED && column->type() != RECORD) {
     // Array types
     *zetasql_type = zetasql::types::ArrayTypeFromSimpleTypeKind(
@@ -61,14 +122,15 @@ absl::Status ConvertSupportedTypeToZetaSQLType(const zetasql::Type **zetasql_typ
   std::vector<zetasql::StructField> fields;
   for (const auto &field : column->fields()) {
     const zetasql::Type *field_type;
-    const auto status = ConvertSupportedTypeToZetaSQLType(&field_type, &field);
+    const auto status =
+        ConvertSupportedTypeToZetaSQLType(&field_type, &field, types);
     if (!status.ok()) {
       return status;
     }
     fields.push_back(zetasql::StructField(field.name(), field_type));
   }
   if (column->mode() != REPEATED) {
-    const auto status = tf.MakeStructTypeFromVector(fields, zetasql_type);
+    const auto status = types->MakeStructType(fields, zetasql_type);
     if (!status.ok()) {
       return absl::InvalidArgumentError(
           absl::StrCat("Could not convert record type: ", status.message()));
@@ -76,13 +138,13 @@ absl::Status ConvertSupportedTypeToZetaSQLType(const zetasql::Type **zetasql_typ
     return absl::OkStatus();
   }
   const zetasql::Type *element_type;
-  auto status = tf.MakeStructTypeFromVector(fields, &element_type);
+  auto status = types->MakeStructType(fields, &element_type);
   if (!status.ok()) {
     return absl::InvalidArgumentError(
         absl::StrCat("Could not convert repeated record type: ", status.message()));
   }
 
-  status = tf.MakeArrayType(element_type, zetasql_type);
+  status = types->MakeArrayType(element_type, zetasql_type);
   if (!status.ok()) {
     return absl::InvalidArgumentError(
         absl::StrCat("Could not convert repeated record type: ", status.message()));
@@ -91,7 +153,8 @@ absl::Status ConvertSupportedTypeToZetaSQLType(const zetasql::Type **zetasql_typ
   return absl::OkStatus();
 }
 
-absl::Status AddColumnToTable(zetasql::SimpleTable *table, const std::string field) {
+absl::Status AddColumnToTable(zetasql::SimpleTable *table, const std::string field,
+                              CanonicalTypeCache *types) {
   Column column_msg;
   google::protobuf::util::JsonParseOptions jsonParseOptions;
   jsonParseOptions.ignore_unknown_fields = true;
@@ -104,7 +167,7 @@ absl::Status AddColumnToTable(zetasql::SimpleTable *table, const std::string fie
 
   const zetasql::Type *zetasql_type;
 
-  const auto status = ConvertSupportedTypeToZetaSQLType(&zetasql_type, &column_msg);
+  const auto status = ConvertSupportedTypeToZetaSQLType(&zetasql_type, &column_msg, types);
   if (!status.ok()) {
     return status;
   }
@@ -121,12 +184,21 @@ absl::Status AddColumnToTable(zetasql::SimpleTable *table, const std::string fie
   return table->AddColumn(zetasql_column.release(), true);
 }
 
+// Adds the tables in the JSON schema to <catalog>, which may be any catalog
+// with AddOwnedTable. Types of the loaded columns are allocated by
+// <type_factory>, which must outlive <catalog>.
+template <class CatalogT>
 void UpdateCatalogFromJSON(const std::string &json_schema_path,
-                           zetasql::SimpleCatalog *catalog) {
+                           CatalogT *catalog,
+                           zetasql::TypeFactory *type_factory) {
   if (!std::filesystem::is_regular_file(json_schema_path) &&
       !std::filesystem::is_fifo(json_schema_path)) {
-    std::cerr << "ERROR: not a json file path [at " << json_schema_path << ":1:1]"
-              << std::endl;
+    Report({Severity::kError, "not a json file path", json_schema_path, 1, 1},
+           absl::StrCat("ERROR: not a json file path [at ", json_schema_path,
+                        ":1:1]"),
+           std::cerr);
+    // Rethrowing nothing terminates without running exit handlers.
+    FlushDiagnostics();
     throw;
   }
 
@@ -134,7 +206,7 @@ void UpdateCatalogFromJSON(const std::string &json_schema_path,
   property_tree::ptree pt;
   property_tree::read_json(json_schema_path, pt);
 
-  std::vector<std::unique_ptr<zetasql::SimpleTable>> tables;
+  CanonicalTypeCache types(type_factory);
   for (property_tree::ptree::const_iterator it = pt.begin(); it != pt.end();
        ++it) {
     const auto table_name = it->first;
@@ -145,17 +217,27 @@ void UpdateCatalogFromJSON(const std::string &json_schema_path,
          it != schema.end(); ++it) {
       std::ostringstream oss;
       property_tree::write_json(oss, it->second);
-      auto status = AddColumnToTable(table.get(), oss.str());
+      auto status = AddColumnToTable(table.get(), oss.str(), &types);
       if (!status.ok()) {
         status = zetasql::UpdateErrorLocationPayloadWithFilenameIfNotPresent(status, json_schema_path);
-        std::cerr << "Failed to generate catalog from JSON file: " << status << std::endl;
+        Report(MakeDiagnostic(Severity::kError,
+                              absl::StrCat("Failed to generate catalog from "
+                                           "JSON file: ",
+                                           status.message()),
+                              status, json_schema_path),
+               absl::StrCat("Failed to generate catalog from JSON file: ",
+                            status.ToString()),
+               std::cerr);
+        FlushDiagnostics();
         throw;
       }
     }
-    catalog->AddTable(table.release());
+    catalog->AddOwnedTable(table.release());
   }
 
   return;
 }
 
 } // namespace alphasql
+
+#endif // ALPHASQL_JSON_SCHEMA_READER_H_
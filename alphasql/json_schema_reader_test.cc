@@ -0,0 +1,90 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/json_schema_reader.h"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "zetasql/public/simple_catalog.h"
+#include "zetasql/public/types/type_factory.h"
+
+namespace alphasql {
+namespace {
+
+using namespace zetasql;
+
+constexpr char kSchema[] = R"({
+  "first": [
+    {"name": "record", "type": "RECORD", "mode": "NULLABLE", "fields": [
+      {"name": "a", "type": "INT64", "mode": "NULLABLE"},
+      {"name": "b", "type": "STRING", "mode": "NULLABLE"}
+    ]},
+    {"name": "records", "type": "RECORD", "mode": "REPEATED", "fields": [
+      {"name": "a", "type": "INT64", "mode": "NULLABLE"},
+      {"name": "b", "type": "STRING", "mode": "NULLABLE"}
+    ]}
+  ],
+  "second": [
+    {"name": "record", "type": "RECORD", "mode": "NULLABLE", "fields": [
+      {"name": "a", "type": "INT64", "mode": "NULLABLE"},
+      {"name": "b", "type": "STRING", "mode": "NULLABLE"}
+    ]},
+    {"name": "records", "type": "RECORD", "mode": "REPEATED", "fields": [
+      {"name": "a", "type": "INT64", "mode": "NULLABLE"},
+      {"name": "b", "type": "STRING", "mode": "NULLABLE"}
+    ]},
+    {"name": "other", "type": "RECORD", "mode": "NULLABLE", "fields": [
+      {"name": "a", "type": "STRING", "mode": "NULLABLE"}
+    ]}
+  ]
+})";
+
+const Type *ColumnType(SimpleCatalog *catalog, const std::string &table_name,
+                       const std::string &column_name) {
+  const Table *table;
+  EXPECT_TRUE(catalog->FindTable({table_name}, &table).ok());
+  const zetasql::Column *column = table->FindColumnByName(column_name);
+  EXPECT_NE(column, nullptr);
+  return column->GetType();
+}
+
+TEST(JSONSchemaReaderTest, RepeatedShapesShareTypes) {
+  const std::string path =
+      (std::filesystem::temp_directory_path() / "json_schema_reader_test.json")
+          .string();
+  std::ofstream(path) << kSchema;
+  TypeFactory type_factory;
+  SimpleCatalog catalog("catalog", &type_factory);
+  UpdateCatalogFromJSON(path, &catalog, &type_factory);
+  std::filesystem::remove(path);
+
+  const Type *record = ColumnType(&catalog, "first", "record");
+  ASSERT_TRUE(record->IsStruct());
+  EXPECT_EQ(ColumnType(&catalog, "second", "record"), record);
+
+  const Type *records = ColumnType(&catalog, "first", "records");
+  ASSERT_TRUE(records->IsArray());
+  EXPECT_EQ(records->AsArray()->element_type(), record);
+  EXPECT_EQ(ColumnType(&catalog, "second", "records"), records);
+
+  EXPECT_NE(ColumnType(&catalog, "second", "other"), record);
+}
+
+} // namespace
+} // namespace alphasql
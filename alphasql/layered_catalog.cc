@@ -0,0 +1,519 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/layered_catalog.h"
+
+#include <algorithm>
+#include <limits>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/memory/memory.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "zetasql/base/logging.h"
+
+namespace alphasql {
+
+using namespace zetasql;
+
+namespace {
+
+std::string NameKey(const std::string &name) {
+  return absl::AsciiStrToLower(name);
+}
+
+} // namespace
+
+std::string LayeredCatalog::Key(const absl::Span<const std::string> &path) {
+  return absl::AsciiStrToLower(absl::StrJoin(path, "."));
+}
+
+LayeredCatalog::LayeredCatalog(const std::string &name, Catalog *base,
+                               TypeFactory *type_factory)
+    : name_(name), base_(base), type_factory_(type_factory),
+      parent_(nullptr), upstreams_(nullptr), file_(0) {}
+
+LayeredCatalog::LayeredCatalog(LayeredCatalog *parent)
+    : LayeredCatalog(parent, nullptr, 0) {}
+
+LayeredCatalog::LayeredCatalog(LayeredCatalog *parent,
+                               const UpstreamLayers *upstreams, size_t file)
+    : name_(parent->name_), base_(parent->base_),
+      type_factory_(parent->type_factory_), parent_(parent),
+      upstreams_(upstreams), file_(file) {
+  for (LayeredCatalog *layer = parent_; layer != nullptr;
+       layer = layer->parent_) {
+    reads_from_.emplace_back(layer, layer->AddReader());
+  }
+}
+
+LayeredCatalog::~LayeredCatalog() {
+  for (const auto &[layer, reader] : reads_from_) {
+    layer->RemoveReader(reader);
+  }
+}
+
+uint64_t LayeredCatalog::AddReader() {
+  absl::MutexLock l(&mutex_);
+  const uint64_t reader = next_reader_++;
+  readers_.insert(reader);
+  return reader;
+}
+
+void LayeredCatalog::RemoveReader(uint64_t reader) {
+  // Declared before the lock, so that objects are freed after unlocking.
+  std::vector<std::unique_ptr<const Table>> tables;
+  std::vector<std::unique_ptr<const Function>> functions;
+  std::vector<std::unique_ptr<const TableValuedFunction>> table_valued_functions;
+  std::vector<std::unique_ptr<const Procedure>> procedures;
+  absl::MutexLock l(&mutex_);
+  readers_.erase(reader);
+  ReleaseRetired(&LayeredCatalog::retired_tables_, &tables);
+  ReleaseRetired(&LayeredCatalog::retired_functions_, &functions);
+  ReleaseRetired(&LayeredCatalog::retired_table_valued_functions_,
+                 &table_valued_functions);
+  ReleaseRetired(&LayeredCatalog::retired_procedures_, &procedures);
+}
+
+template <class T>
+void LayeredCatalog::ReleaseRetired(
+    Retired<T> LayeredCatalog::*retired,
+    std::vector<std::unique_ptr<const T>> *released) {
+  // Readers are added in increasing order, so an object retired before the
+  // oldest live reader was added can not be held by any.
+  const uint64_t oldest_reader = readers_.empty()
+                                     ? std::numeric_limits<uint64_t>::max()
+                                     : *readers_.begin();
+  Retired<T> &objects = this->*retired;
+  auto kept = objects.begin();
+  for (auto it = objects.begin(); it != objects.end(); ++it) {
+    if (it->first <= oldest_reader) {
+      released->push_back(std::move(it->second));
+    } else {
+      *kept++ = std::move(*it);
+    }
+  }
+  objects.erase(kept, objects.end());
+}
+
+size_t LayeredCatalog::num_retired() const {
+  absl::ReaderMutexLock l(&mutex_);
+  return retired_tables_.size() + retired_functions_.size() +
+         retired_table_valued_functions_.size() + retired_procedures_.size();
+}
+
+template <class T>
+bool LayeredCatalog::FindInLayers(EntryMap<T> LayeredCatalog::*entries,
+                                  const std::string &key,
+                                  const T **object) const {
+  for (const LayeredCatalog *layer = this; layer != nullptr;
+       layer = layer->parent_) {
+    if (layer->FindInLayer(entries, key, object) ||
+        layer->FindInUpstreams(entries, key, object)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <class T>
+bool LayeredCatalog::FindInLayer(EntryMap<T> LayeredCatalog::*entries,
+                                 const std::string &key,
+                                 const T **object) const {
+  absl::ReaderMutexLock l(&mutex_);
+  const EntryMap<T> &layer_entries = this->*entries;
+  const auto it = layer_entries.find(key);
+  if (it == layer_entries.end()) {
+    return false;
+  }
+  *object = it->second.get();
+  return true;
+}
+
+template <class T>
+bool LayeredCatalog::FindInUpstreams(EntryMap<T> LayeredCatalog::*entries,
+                                     const std::string &key,
+                                     const T **object) const {
+  if (upstreams_ == nullptr) {
+    return false;
+  }
+  for (const LayeredCatalog *upstream : upstreams_->Find(file_, key)) {
+    if (upstream->FindInLayer(entries, key, object)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <class T>
+void LayeredCatalog::NotifyIfMissing(EntryMap<T> LayeredCatalog::*entries,
+                                     ObjectKind kind,
+                                     const std::string &key) const {
+  if (miss_listener_ == nullptr) {
+    return;
+  }
+  {
+    absl::ReaderMutexLock l(&mutex_);
+    if ((this->*entries).contains(key)) {
+      return;
+    }
+  }
+  miss_listener_(kind, key);
+}
+
+template <class T>
+void LayeredCatalog::Put(EntryMap<T> LayeredCatalog::*entries,
+                         Retired<T> LayeredCatalog::*retired,
+                         const std::string &key,
+                         std::unique_ptr<const T> object) {
+  absl::MutexLock l(&mutex_);
+  std::unique_ptr<const T> &entry = (this->*entries)[key];
+  if (entry != nullptr) {
+    (this->*retired).emplace_back(next_reader_, std::move(entry));
+  }
+  entry = std::move(object);
+}
+
+template <class T>
+void LayeredCatalog::Remove(EntryMap<T> LayeredCatalog::*entries,
+                            Retired<T> LayeredCatalog::*retired,
+                            const std::string &key) {
+  absl::MutexLock l(&mutex_);
+  const auto it = (this->*entries).find(key);
+  if (it == (this->*entries).end()) {
+    return;
+  }
+  if (it->second != nullptr) {
+    (this->*retired).emplace_back(next_reader_, std::move(it->second));
+  }
+  (this->*entries).erase(it);
+}
+
+template <class T>
+bool LayeredCatalog::VisibleBelow(EntryMap<T> LayeredCatalog::*entries,
+                                  const std::string &key) const {
+  const T *object = nullptr;
+  if (FindInUpstreams(entries, key, &object) ||
+      (parent_ != nullptr && parent_->FindInLayers(entries, key, &object))) {
+    return object != nullptr;
+  }
+  return FindInBase(key, &object).ok();
+}
+
+template <class T>
+void LayeredCatalog::CommitEntries(EntryMap<T> *source,
+                                   EntryMap<T> LayeredCatalog::*entries,
+                                   Retired<T> LayeredCatalog::*retired) {
+  for (auto &[key, object] : *source) {
+    if (object != nullptr || VisibleBelow(entries, key)) {
+      Put(entries, retired, key, std::move(object));
+    } else {
+      // Dropping what was only created above the layers below leaves
+      // nothing to hide.
+      Remove(entries, retired, key);
+    }
+  }
+  source->clear();
+}
+
+absl::Status LayeredCatalog::FindInBase(const std::string &key,
+                                        const Table **table) const {
+  return base_->FindTable({key}, table);
+}
+
+absl::Status LayeredCatalog::FindInBase(const std::string &key,
+                                        const Function **function) const {
+  return base_->FindFunction({key}, function);
+}
+
+absl::Status
+LayeredCatalog::FindInBase(const std::string &key,
+                           const TableValuedFunction **function) const {
+  return base_->FindTableValuedFunction({key}, function);
+}
+
+absl::Status LayeredCatalog::FindInBase(const std::string &key,
+                                        const Procedure **procedure) const {
+  return base_->FindProcedure({key}, procedure);
+}
+
+template <class T>
+std::vector<std::string>
+LayeredCatalog::VisibleNames(EntryMap<T> LayeredCatalog::*entries) const {
+  absl::flat_hash_set<std::string> seen;
+  std::set<std::string> names;
+  auto add_names = [&](const LayeredCatalog *layer) {
+    absl::ReaderMutexLock l(&layer->mutex_);
+    for (const auto &[key, object] : layer->*entries) {
+      if (seen.insert(key).second && object != nullptr) {
+        names.insert(key);
+      }
+    }
+  };
+  for (const LayeredCatalog *layer = this; layer != nullptr;
+       layer = layer->parent_) {
+    add_names(layer);
+    if (layer->upstreams_ != nullptr) {
+      for (const LayeredCatalog *upstream :
+           layer->upstreams_->Closure(layer->file_)) {
+        add_names(upstream);
+      }
+    }
+  }
+  return std::vector<std::string>(names.begin(), names.end());
+}
+
+absl::Status LayeredCatalog::FindTable(const absl::Span<const std::string> &path,
+                                       const Table **table,
+                                       const FindOptions &options) {
+  const std::string key = Key(path);
+  NotifyIfMissing(&LayeredCatalog::tables_, ObjectKind::kTable, key);
+  if (FindInLayers(&LayeredCatalog::tables_, key, table)) {
+    return *table != nullptr ? absl::OkStatus() : TableNotFoundError(path);
+  }
+  return base_->FindTable(path, table, options);
+}
+
+absl::Status
+LayeredCatalog::FindFunction(const absl::Span<const std::string> &path,
+                             const Function **function,
+                             const FindOptions &options) {
+  const std::string key = Key(path);
+  NotifyIfMissing(&LayeredCatalog::functions_, ObjectKind::kFunction, key);
+  if (FindInLayers(&LayeredCatalog::functions_, key, function)) {
+    return *function != nullptr ? absl::OkStatus()
+                                : FunctionNotFoundError(path);
+  }
+  return base_->FindFunction(path, function, options);
+}
+
+absl::Status LayeredCatalog::FindTableValuedFunction(
+    const absl::Span<const std::string> &path,
+    const TableValuedFunction **function, const FindOptions &options) {
+  const std::string key = Key(path);
+  NotifyIfMissing(&LayeredCatalog::table_valued_functions_,
+                  ObjectKind::kTableValuedFunction, key);
+  if (FindInLayers(&LayeredCatalog::table_valued_functions_, key,
+                   function)) {
+    return *function != nullptr ? absl::OkStatus()
+                                : TableValuedFunctionNotFoundError(path);
+  }
+  return base_->FindTableValuedFunction(path, function, options);
+}
+
+absl::Status
+LayeredCatalog::FindProcedure(const absl::Span<const std::string> &path,
+                              const Procedure **procedure,
+                              const FindOptions &options) {
+  const std::string key = Key(path);
+  NotifyIfMissing(&LayeredCatalog::procedures_, ObjectKind::kProcedure, key);
+  if (FindInLayers(&LayeredCatalog::procedures_, key, procedure)) {
+    return *procedure != nullptr ? absl::OkStatus()
+                                 : ProcedureNotFoundError(path);
+  }
+  return base_->FindProcedure(path, procedure, options);
+}
+
+absl::Status LayeredCatalog::FindType(const absl::Span<const std::string> &path,
+                                      const Type **type,
+                                      const FindOptions &options) {
+  return base_->FindType(path, type, options);
+}
+
+void LayeredCatalog::AddOwnedTable(const Table *table) {
+  Put(&LayeredCatalog::tables_, &LayeredCatalog::retired_tables_,
+      NameKey(table->Name()), absl::WrapUnique(table));
+}
+
+void LayeredCatalog::AddOwnedFunction(const Function *function) {
+  Put(&LayeredCatalog::functions_, &LayeredCatalog::retired_functions_,
+      NameKey(function->FullName(/*include_group=*/false)),
+      absl::WrapUnique(function));
+}
+
+void LayeredCatalog::AddOwnedTableValuedFunction(
+    const TableValuedFunction *function) {
+  Put(&LayeredCatalog::table_valued_functions_,
+      &LayeredCatalog::retired_table_valued_functions_,
+      NameKey(function->FullName()), absl::WrapUnique(function));
+}
+
+void LayeredCatalog::AddOwnedProcedure(const Procedure *procedure) {
+  Put(&LayeredCatalog::procedures_, &LayeredCatalog::retired_procedures_,
+      NameKey(procedure->FullName()), absl::WrapUnique(procedure));
+}
+
+absl::Status LayeredCatalog::DropTable(const std::string &name,
+                                       bool if_exists) {
+  const Table *table;
+  if (!FindTable({name}, &table).ok()) {
+    if (if_exists) {
+      return absl::OkStatus();
+    }
+    return absl::NotFoundError(absl::StrCat("No table named ", name));
+  }
+  Put<Table>(&LayeredCatalog::tables_, &LayeredCatalog::retired_tables_,
+             NameKey(name), nullptr);
+  return absl::OkStatus();
+}
+
+absl::Status
+LayeredCatalog::DropFunction(const std::string &full_name_without_group) {
+  const Function *function;
+  if (!FindFunction({full_name_without_group}, &function).ok()) {
+    return absl::NotFoundError(
+        absl::StrCat("No function named ", full_name_without_group));
+  }
+  Put<Function>(&LayeredCatalog::functions_,
+                &LayeredCatalog::retired_functions_,
+                NameKey(full_name_without_group), nullptr);
+  return absl::OkStatus();
+}
+
+void LayeredCatalog::Commit() {
+  ZETASQL_CHECK(parent_ != nullptr) << "The bottom layer can not be committed";
+  absl::MutexLock l(&mutex_);
+  parent_->CommitEntries(&tables_, &LayeredCatalog::tables_,
+                         &LayeredCatalog::retired_tables_);
+  parent_->CommitEntries(&functions_, &LayeredCatalog::functions_,
+                         &LayeredCatalog::retired_functions_);
+  parent_->CommitEntries(&table_valued_functions_,
+                         &LayeredCatalog::table_valued_functions_,
+                         &LayeredCatalog::retired_table_valued_functions_);
+  parent_->CommitEntries(&procedures_, &LayeredCatalog::procedures_,
+                         &LayeredCatalog::retired_procedures_);
+}
+
+void LayeredCatalog::EvictTable(const std::string &key) {
+  // A table of the same name below stays hidden, as if this one were alive.
+  const bool hides_table = VisibleBelow(&LayeredCatalog::tables_, key);
+  // Declared before the lock, so that the table is freed after unlocking.
+  std::unique_ptr<const Table> table;
+  absl::MutexLock l(&mutex_);
+  const auto it = tables_.find(key);
+  if (it == tables_.end()) {
+    return;
+  }
+  table = std::move(it->second);
+  if (!hides_table) {
+    tables_.erase(it);
+  }
+}
+
+std::vector<std::string> LayeredCatalog::table_names() const {
+  return VisibleNames(&LayeredCatalog::tables_);
+}
+
+std::vector<std::string> LayeredCatalog::table_valued_function_names() const {
+  return VisibleNames(&LayeredCatalog::table_valued_functions_);
+}
+
+std::vector<std::pair<std::string, const Table *>>
+LayeredCatalog::layer_tables() const {
+  absl::ReaderMutexLock l(&mutex_);
+  std::vector<std::pair<std::string, const Table *>> tables;
+  for (const auto &[key, table] : tables_) {
+    tables.emplace_back(key, table.get());
+  }
+  return tables;
+}
+
+bool LayeredCatalog::layer_has_routines() const {
+  absl::ReaderMutexLock l(&mutex_);
+  return !functions_.empty() || !table_valued_functions_.empty() ||
+         !procedures_.empty();
+}
+
+UpstreamLayers::UpstreamLayers(
+    const std::vector<std::vector<size_t>> &upstreams, LayeredCatalog *parent)
+    : is_upstream_(upstreams.size()), published_(upstreams.size(), false) {
+  for (size_t i = 0; i < upstreams.size(); ++i) {
+    is_upstream_[i].assign(i, false);
+    for (const size_t upstream : upstreams[i]) {
+      ZETASQL_CHECK(upstream < i) << "Files must be in topological order";
+      is_upstream_[i][upstream] = true;
+      for (size_t j = 0; j < upstream; ++j) {
+        if (is_upstream_[upstream][j]) {
+          is_upstream_[i][j] = true;
+        }
+      }
+    }
+    layers_.push_back(absl::WrapUnique(new LayeredCatalog(parent, this, i)));
+  }
+}
+
+void UpstreamLayers::Publish(size_t i) {
+  std::vector<std::string> keys;
+  {
+    const LayeredCatalog &layer = *layers_[i];
+    absl::ReaderMutexLock l(&layer.mutex_);
+    for (const auto &[key, table] : layer.tables_) {
+      keys.push_back(key);
+    }
+    for (const auto &[key, function] : layer.functions_) {
+      keys.push_back(key);
+    }
+    for (const auto &[key, function] : layer.table_valued_functions_) {
+      keys.push_back(key);
+    }
+    for (const auto &[key, procedure] : layer.procedures_) {
+      keys.push_back(key);
+    }
+  }
+  absl::MutexLock l(&mutex_);
+  published_[i] = true;
+  for (const std::string &key : keys) {
+    std::vector<size_t> &publishers = publishers_[key];
+    // Files may finish out of plan order.
+    publishers.insert(
+        std::upper_bound(publishers.begin(), publishers.end(), i), i);
+  }
+}
+
+std::vector<const LayeredCatalog *>
+UpstreamLayers::Find(size_t i, const std::string &key) const {
+  std::vector<const LayeredCatalog *> layers;
+  absl::ReaderMutexLock l(&mutex_);
+  const auto it = publishers_.find(key);
+  if (it == publishers_.end()) {
+    return layers;
+  }
+  for (auto publisher = it->second.rbegin(); publisher != it->second.rend();
+       ++publisher) {
+    if (*publisher < i && is_upstream_[i][*publisher]) {
+      layers.push_back(layers_[*publisher].get());
+    }
+  }
+  return layers;
+}
+
+std::vector<const LayeredCatalog *> UpstreamLayers::Closure(size_t i) const {
+  std::vector<const LayeredCatalog *> layers;
+  absl::ReaderMutexLock l(&mutex_);
+  for (size_t j = i; j-- > 0;) {
+    if (is_upstream_[i][j] && published_[j]) {
+      layers.push_back(layers_[j].get());
+    }
+  }
+  return layers;
+}
+
+} // namespace alphasql
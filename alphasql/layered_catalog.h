@@ -0,0 +1,310 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_LAYERED_CATALOG_H_
+#define ALPHASQL_LAYERED_CATALOG_H_
+
+#include <functional>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "zetasql/public/catalog.h"
+#include "zetasql/public/function.h"
+#include "zetasql/public/procedure.h"
+#include "zetasql/public/table_valued_function.h"
+#include "zetasql/public/types/type_factory.h"
+
+namespace alphasql {
+
+class UpstreamLayers;
+
+// A catalog made of a stack of layers over an immutable base catalog.
+//
+// Each layer owns the tables, functions, TVFs and procedures added to it in
+// hash maps keyed by their lowercased full name, and records drops of names
+// defined below it as tombstones, so adding or dropping an object is O(1)
+// regardless of the size of the catalog. Lookups walk up the layers and
+// finally fall back to the base catalog, which typically holds the builtin
+// functions.
+//
+// A new layer on top of another one acts as a cheap checkpoint: Commit()
+// moves its entries down into the parent, and destroying it without
+// committing rolls it back. alphacheck uses one layer for the JSON schema,
+// one per file for the objects it published, see UpstreamLayers, and one per
+// file being checked, which also makes temporary objects disappear with the
+// file.
+//
+// Objects replaced or dropped from a layer are kept alive while a layer
+// created on top of it before the replacement is alive, since that layer may
+// still use them, and freed once the last such layer is destroyed. Drops
+// committed to a layer are only recorded if they hide an object of a layer
+// below it. This class is thread-safe.
+class LayeredCatalog : public zetasql::Catalog {
+public:
+  enum class ObjectKind { kTable, kFunction, kTableValuedFunction, kProcedure };
+  using MissListener =
+      std::function<void(ObjectKind kind, const std::string &key)>;
+
+  // Creates a bottom layer. <base> and <type_factory> must outlive it.
+  LayeredCatalog(const std::string &name, zetasql::Catalog *base,
+                 zetasql::TypeFactory *type_factory);
+  // Creates a layer on top of <parent>, which must outlive it.
+  explicit LayeredCatalog(LayeredCatalog *parent);
+  LayeredCatalog(const LayeredCatalog &) = delete;
+  LayeredCatalog &operator=(const LayeredCatalog &) = delete;
+  ~LayeredCatalog() override;
+
+  std::string FullName() const override { return name_; }
+
+  absl::Status FindTable(const absl::Span<const std::string> &path,
+                         const zetasql::Table **table,
+                         const FindOptions &options = FindOptions()) override;
+  absl::Status
+  FindFunction(const absl::Span<const std::string> &path,
+               const zetasql::Function **function,
+               const FindOptions &options = FindOptions()) override;
+  absl::Status FindTableValuedFunction(
+      const absl::Span<const std::string> &path,
+      const zetasql::TableValuedFunction **function,
+      const FindOptions &options = FindOptions()) override;
+  absl::Status
+  FindProcedure(const absl::Span<const std::string> &path,
+                const zetasql::Procedure **procedure,
+                const FindOptions &options = FindOptions()) override;
+  absl::Status FindType(const absl::Span<const std::string> &path,
+                        const zetasql::Type **type,
+                        const FindOptions &options = FindOptions()) override;
+
+  zetasql::TypeFactory *type_factory() const { return type_factory_; }
+  LayeredCatalog *parent() const { return parent_; }
+
+  // Calls <listener> with the kind and key of every name looked up through
+  // this layer that this layer itself has no entry for, i.e. of everything
+  // resolved against the layers below. Must be set before any lookup.
+  void set_miss_listener(MissListener listener) {
+    miss_listener_ = std::move(listener);
+  }
+
+  // Take ownership of the object, replacing any object of the same name
+  // visible through this layer.
+  void AddOwnedTable(const zetasql::Table *table);
+  void AddOwnedFunction(const zetasql::Function *function);
+  void AddOwnedTableValuedFunction(const zetasql::TableValuedFunction *function);
+  void AddOwnedProcedure(const zetasql::Procedure *procedure);
+
+  // Returns NotFound if no such table is visible and <if_exists> is false.
+  absl::Status DropTable(const std::string &name, bool if_exists);
+  absl::Status DropFunction(const std::string &full_name_without_group);
+
+  // Moves the entries of this layer, including drops, into its parent.
+  void Commit();
+
+  // Removes the table stored under <key> from this layer and frees it at
+  // once. Unlike DropTable, the table is not kept alive for concurrent
+  // readers, so the caller must make sure nothing uses it anymore. A table of
+  // the same name in the layers below stays hidden.
+  void EvictTable(const std::string &key);
+
+  // Names visible through this layer, excluding the base catalog.
+  std::vector<std::string> table_names() const;
+  std::vector<std::string> table_valued_function_names() const;
+
+  // Tables of this layer itself, with null for dropped names.
+  std::vector<std::pair<std::string, const zetasql::Table *>>
+  layer_tables() const;
+  // Whether this layer itself holds functions, TVFs or procedures.
+  bool layer_has_routines() const;
+
+  // The key objects are stored under, i.e. the lowercased joined path.
+  // Unlike SimpleCatalog, which looks the components of a path up in nested
+  // catalogs, a path therefore finds the object named after the whole path,
+  // as in BigQuery, where `dataset.table` and dataset.table are the same
+  // table.
+  static std::string Key(const absl::Span<const std::string> &path);
+
+  // Number of replaced or dropped objects this layer keeps alive.
+  size_t num_retired() const;
+
+private:
+  friend class UpstreamLayers;
+
+  template <class T>
+  using EntryMap = absl::flat_hash_map<std::string, std::unique_ptr<const T>>;
+  // Objects taken out of a layer, with the id of the first reader that can
+  // not have found them.
+  template <class T>
+  using Retired =
+      std::vector<std::pair<uint64_t, std::unique_ptr<const T>>>;
+
+  // Creates the layer file <file> of <upstreams> commits to.
+  LayeredCatalog(LayeredCatalog *parent, const UpstreamLayers *upstreams,
+                 size_t file);
+
+  // Looks <key> up from this layer downwards. Returns false if no layer has
+  // an entry for it; otherwise sets <object>, to null for a dropped name.
+  template <class T>
+  bool FindInLayers(EntryMap<T> LayeredCatalog::*entries, const std::string &key,
+                    const T **object) const;
+
+  // Same as FindInLayers, but only looks at this layer itself.
+  template <class T>
+  bool FindInLayer(EntryMap<T> LayeredCatalog::*entries, const std::string &key,
+                   const T **object) const;
+
+  // Same as FindInLayers, but only looks at the layers of the upstream files
+  // of this layer, if any.
+  template <class T>
+  bool FindInUpstreams(EntryMap<T> LayeredCatalog::*entries,
+                       const std::string &key, const T **object) const;
+
+  template <class T>
+  void NotifyIfMissing(EntryMap<T> LayeredCatalog::*entries, ObjectKind kind,
+                       const std::string &key) const;
+
+  template <class T>
+  void Put(EntryMap<T> LayeredCatalog::*entries,
+           Retired<T> LayeredCatalog::*retired, const std::string &key,
+           std::unique_ptr<const T> object);
+
+  // Removes the entry of this layer for <key>, if any.
+  template <class T>
+  void Remove(EntryMap<T> LayeredCatalog::*entries,
+              Retired<T> LayeredCatalog::*retired, const std::string &key);
+
+  // Whether <key> names an object in the layers below this one, including
+  // the base catalog.
+  template <class T>
+  bool VisibleBelow(EntryMap<T> LayeredCatalog::*entries,
+                    const std::string &key) const;
+
+  // Moves the entries of <source> into this layer, recording a drop only
+  // if it hides an object below this layer.
+  template <class T>
+  void CommitEntries(EntryMap<T> *source, EntryMap<T> LayeredCatalog::*entries,
+                     Retired<T> LayeredCatalog::*retired);
+
+  absl::Status FindInBase(const std::string &key,
+                          const zetasql::Table **table) const;
+  absl::Status FindInBase(const std::string &key,
+                          const zetasql::Function **function) const;
+  absl::Status
+  FindInBase(const std::string &key,
+             const zetasql::TableValuedFunction **function) const;
+  absl::Status FindInBase(const std::string &key,
+                          const zetasql::Procedure **procedure) const;
+
+  // Readers are the layers created on top of this one, which may hold
+  // objects they found in it.
+  uint64_t AddReader();
+  void RemoveReader(uint64_t reader);
+
+  // Moves the retired objects no reader can hold anymore to <released>, so
+  // that they are freed out of the lock.
+  template <class T>
+  void ReleaseRetired(Retired<T> LayeredCatalog::*retired,
+                      std::vector<std::unique_ptr<const T>> *released)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  template <class T>
+  std::vector<std::string> VisibleNames(EntryMap<T> LayeredCatalog::*entries) const;
+
+  const std::string name_;
+  zetasql::Catalog *const base_;           // Not owned.
+  zetasql::TypeFactory *const type_factory_; // Not owned.
+  LayeredCatalog *const parent_;           // Not owned, null for the bottom.
+  // Not owned, null unless this is the layer of a file of a DAG.
+  const UpstreamLayers *const upstreams_;
+  const size_t file_;
+  MissListener miss_listener_;
+  // The layers below this one and the reader ids this layer has on them.
+  std::vector<std::pair<LayeredCatalog *, uint64_t>> reads_from_;
+
+  mutable absl::Mutex mutex_;
+  // A null entry marks a name dropped from the layers below.
+  EntryMap<zetasql::Table> tables_ ABSL_GUARDED_BY(mutex_);
+  EntryMap<zetasql::Function> functions_ ABSL_GUARDED_BY(mutex_);
+  EntryMap<zetasql::TableValuedFunction>
+      table_valued_functions_ ABSL_GUARDED_BY(mutex_);
+  EntryMap<zetasql::Procedure> procedures_ ABSL_GUARDED_BY(mutex_);
+
+  Retired<zetasql::Table> retired_tables_ ABSL_GUARDED_BY(mutex_);
+  Retired<zetasql::Function> retired_functions_ ABSL_GUARDED_BY(mutex_);
+  Retired<zetasql::TableValuedFunction>
+      retired_table_valued_functions_ ABSL_GUARDED_BY(mutex_);
+  Retired<zetasql::Procedure> retired_procedures_ ABSL_GUARDED_BY(mutex_);
+
+  uint64_t next_reader_ ABSL_GUARDED_BY(mutex_) = 0;
+  std::set<uint64_t> readers_ ABSL_GUARDED_BY(mutex_);
+};
+
+// The layers the files of a DAG commit to, one per file, on top of a common
+// layer such as the one of the JSON schema.
+//
+// The layer of a file resolves names against its own objects, then against
+// the objects committed by its transitive upstream files, the latest in plan
+// order first, and finally against the common layer. A file therefore never
+// sees objects of files it does not depend on, so that running files in
+// parallel gives the same results as running them one at a time. The layers
+// of upstream files are only read once they are published and are not
+// modified anymore, except by evicting tables nothing reads.
+// This class is thread-safe.
+class UpstreamLayers {
+public:
+  // <upstreams> lists the upstream files of each file, which come before it
+  // in plan order as RunDAG requires. <parent> must outlive this.
+  UpstreamLayers(const std::vector<std::vector<size_t>> &upstreams,
+                 LayeredCatalog *parent);
+  UpstreamLayers(const UpstreamLayers &) = delete;
+  UpstreamLayers &operator=(const UpstreamLayers &) = delete;
+
+  // The layer file <i> commits to. Files are checked in a layer on top of it.
+  LayeredCatalog *layer(size_t i) const { return layers_[i].get(); }
+
+  // Makes what file <i> committed visible to its downstream files. Must be
+  // called before any of them starts.
+  void Publish(size_t i);
+
+private:
+  friend class LayeredCatalog;
+
+  // Layers of the upstream files of <i> that published an entry under
+  // <key>, the latest first.
+  std::vector<const LayeredCatalog *> Find(size_t i,
+                                           const std::string &key) const;
+  // Layers of all published upstream files of <i>, the latest first.
+  std::vector<const LayeredCatalog *> Closure(size_t i) const;
+
+  // Whether file j is a transitive upstream file of file i, for j < i.
+  std::vector<std::vector<bool>> is_upstream_;
+  std::vector<std::unique_ptr<LayeredCatalog>> layers_;
+
+  mutable absl::Mutex mutex_;
+  std::vector<bool> published_ ABSL_GUARDED_BY(mutex_);
+  // Files that published an entry under each key, in plan order.
+  absl::flat_hash_map<std::string, std::vector<size_t>>
+      publishers_ ABSL_GUARDED_BY(mutex_);
+};
+
+} // namespace alphasql
+
+#endif // ALPHASQL_LAYERED_CATALOG_H_
@@ -0,0 +1,185 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/layered_catalog.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "gtest/gtest.h"
+#include "zetasql/public/simple_catalog.h"
+#include "zetasql/public/types/type_factory.h"
+
+namespace alphasql {
+namespace {
+
+using namespace zetasql;
+
+// A table reporting when it is freed.
+class TrackedTable : public SimpleTable {
+public:
+  TrackedTable(const std::string &name, bool *freed)
+      : SimpleTable(name), freed_(freed) {}
+  ~TrackedTable() override { *freed_ = true; }
+
+private:
+  bool *freed_;
+};
+
+class LayeredCatalogTest : public ::testing::Test {
+protected:
+  LayeredCatalogTest()
+      : base_("base", &type_factory_),
+        schema_layer_("catalog", &base_, &type_factory_),
+        published_layer_(&schema_layer_) {}
+
+  bool HasTable(LayeredCatalog *catalog, const std::string &table_name) {
+    const Table *table;
+    return catalog->FindTable({table_name}, &table).ok();
+  }
+
+  TypeFactory type_factory_;
+  SimpleCatalog base_;
+  LayeredCatalog schema_layer_;
+  LayeredCatalog published_layer_;
+};
+
+TEST_F(LayeredCatalogTest, ReplacedObjectsAreFreedAfterOlderReaders) {
+  bool freed = false;
+  published_layer_.AddOwnedTable(new TrackedTable("t", &freed));
+  auto reader = absl::make_unique<LayeredCatalog>(&published_layer_);
+  published_layer_.AddOwnedTable(new SimpleTable("t"));
+  {
+    // Created after the replacement, so it can not hold the old table.
+    LayeredCatalog later_reader(&published_layer_);
+  }
+  EXPECT_FALSE(freed);
+  EXPECT_EQ(published_layer_.num_retired(), 1);
+
+  reader.reset();
+  EXPECT_TRUE(freed);
+  EXPECT_EQ(published_layer_.num_retired(), 0);
+}
+
+TEST_F(LayeredCatalogTest, CommittedReplacementsAreFreed) {
+  bool freed = false;
+  published_layer_.AddOwnedTable(new TrackedTable("t", &freed));
+  {
+    LayeredCatalog file_layer(&published_layer_);
+    ASSERT_TRUE(file_layer.DropTable("t", /*if_exists=*/false).ok());
+    file_layer.Commit();
+  }
+  EXPECT_TRUE(freed);
+  EXPECT_FALSE(HasTable(&published_layer_, "t"));
+}
+
+TEST_F(LayeredCatalogTest, DropsHidingNothingAreNotCommitted) {
+  {
+    LayeredCatalog file_layer(&published_layer_);
+    file_layer.AddOwnedTable(new SimpleTable("temp"));
+    ASSERT_TRUE(file_layer.DropTable("temp", /*if_exists=*/false).ok());
+    file_layer.Commit();
+  }
+  EXPECT_TRUE(published_layer_.layer_tables().empty());
+}
+
+TEST_F(LayeredCatalogTest, DropsHidingLowerLayersAreCommitted) {
+  schema_layer_.AddOwnedTable(new SimpleTable("external"));
+  {
+    LayeredCatalog file_layer(&published_layer_);
+    ASSERT_TRUE(file_layer.DropTable("external", /*if_exists=*/false).ok());
+    file_layer.Commit();
+  }
+  const auto tables = published_layer_.layer_tables();
+  ASSERT_EQ(tables.size(), 1);
+  EXPECT_EQ(tables[0].second, nullptr);
+  EXPECT_FALSE(HasTable(&published_layer_, "external"));
+  EXPECT_TRUE(HasTable(&schema_layer_, "external"));
+}
+
+TEST_F(LayeredCatalogTest, EvictedTablesAreFreed) {
+  bool freed = false;
+  published_layer_.AddOwnedTable(new TrackedTable("t", &freed));
+  LayeredCatalog reader(&published_layer_);
+  published_layer_.EvictTable("t");
+  EXPECT_TRUE(freed);
+  EXPECT_TRUE(published_layer_.layer_tables().empty());
+  EXPECT_EQ(published_layer_.num_retired(), 0);
+}
+
+TEST_F(LayeredCatalogTest, EvictedTablesKeepLowerLayersHidden) {
+  schema_layer_.AddOwnedTable(new SimpleTable("t"));
+  bool freed = false;
+  published_layer_.AddOwnedTable(new TrackedTable("t", &freed));
+  published_layer_.EvictTable("t");
+  EXPECT_TRUE(freed);
+  EXPECT_FALSE(HasTable(&published_layer_, "t"));
+  EXPECT_TRUE(HasTable(&schema_layer_, "t"));
+}
+
+TEST_F(LayeredCatalogTest, PathsFindTablesNamedAfterTheWholePath) {
+  schema_layer_.AddOwnedTable(new SimpleTable("Dataset.Table"));
+  const Table *table;
+  EXPECT_TRUE(published_layer_.FindTable({"dataset.table"}, &table).ok());
+  EXPECT_TRUE(published_layer_.FindTable({"dataset", "table"}, &table).ok());
+  EXPECT_FALSE(published_layer_.FindTable({"dataset"}, &table).ok());
+}
+
+// Commits file <i> of <layers>, creating <table_name>.
+void CommitFile(UpstreamLayers *layers, size_t i,
+                const std::string &table_name) {
+  LayeredCatalog file_layer(layers->layer(i));
+  file_layer.AddOwnedTable(new SimpleTable(table_name));
+  file_layer.Commit();
+  layers->Publish(i);
+}
+
+TEST_F(LayeredCatalogTest, FilesOnlySeeTablesOfUpstreamFiles) {
+  // 0 -> 2, 1 -> 3, 2 -> 3
+  UpstreamLayers layers({{}, {}, {0}, {1, 2}}, &schema_layer_);
+  CommitFile(&layers, 0, "t0");
+  CommitFile(&layers, 1, "t1");
+  LayeredCatalog file_layer(layers.layer(2));
+  ASSERT_TRUE(HasTable(&file_layer, "t0"));
+  // File 1 is a sibling, whether it finished or not.
+  ASSERT_FALSE(HasTable(&file_layer, "t1"));
+  CommitFile(&layers, 2, "t2");
+  LayeredCatalog downstream_layer(layers.layer(3));
+  ASSERT_TRUE(HasTable(&downstream_layer, "t0"));
+  ASSERT_TRUE(HasTable(&downstream_layer, "t1"));
+  ASSERT_TRUE(HasTable(&downstream_layer, "t2"));
+  ASSERT_EQ(downstream_layer.table_names(),
+            std::vector<std::string>({"t0", "t1", "t2"}));
+}
+
+TEST_F(LayeredCatalogTest, LatestUpstreamFileWins) {
+  // 0 -> 1 -> 2
+  UpstreamLayers layers({{}, {0}, {1}}, &schema_layer_);
+  CommitFile(&layers, 0, "t");
+  LayeredCatalog second_layer(layers.layer(1));
+  SimpleTable *second = new SimpleTable("t");
+  second_layer.AddOwnedTable(second);
+  second_layer.Commit();
+  layers.Publish(1);
+  LayeredCatalog file_layer(layers.layer(2));
+  const Table *table;
+  ASSERT_TRUE(file_layer.FindTable({"t"}, &table).ok());
+  ASSERT_EQ(table, second);
+}
+
+} // namespace
+} // namespace alphasql
@@ -0,0 +1,650 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/lint.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_join.h"
+#include "absl/strings/str_split.h"
+#include "zetasql/base/status_macros.h"
+#include "zetasql/resolved_ast/resolved_ast_visitor.h"
+
+namespace alphasql {
+
+using namespace zetasql;
+
+namespace {
+
+// Calls <visit> for <node> and all nodes below it, in pre-order. Nodes are
+// kept on an explicit stack, so that deep statements do not exhaust the call
+// stack.
+void VisitAST(const ASTNode *node,
+              const std::function<void(const ASTNode *)> &visit) {
+  std::vector<const ASTNode *> stack = {node};
+  while (!stack.empty()) {
+    node = stack.back();
+    stack.pop_back();
+    if (node == nullptr) {
+      continue;
+    }
+    visit(node);
+    for (int i = node->num_children() - 1; i >= 0; --i) {
+      stack.push_back(node->child(i));
+    }
+  }
+}
+
+ParseLocationPoint Start(const ASTNode *node) {
+  return node->GetParseLocationRange().start();
+}
+
+// The name <table> is referred to by in its query, lowercased.
+std::string TableAlias(const ASTTablePathExpression *table) {
+  return absl::AsciiStrToLower(
+      table->alias() != nullptr
+          ? table->alias()->GetAsString()
+          : table->path_expr()->last_name()->GetAsString());
+}
+
+// The outermost query of a statement, null if it has none.
+const ASTQuery *TopLevelQuery(const ASTStatement &statement) {
+  switch (statement.node_kind()) {
+  case AST_QUERY_STATEMENT:
+    return statement.GetAs<ASTQueryStatement>()->query();
+  case AST_CREATE_TABLE_STATEMENT:
+    return statement.GetAs<ASTCreateTableStatement>()->query();
+  case AST_INSERT_STATEMENT:
+    return statement.GetAs<ASTInsertStatement>()->query();
+  default:
+    return nullptr;
+  }
+}
+
+// Ids of the columns <node> refers to.
+std::set<int> ColumnRefs(const ResolvedNode *node) {
+  class ColumnRefVisitor : public ResolvedASTVisitor {
+  public:
+    absl::Status
+    VisitResolvedColumnRef(const ResolvedColumnRef *node) override {
+      column_ids.insert(node->column().column_id());
+      return DefaultVisit(node);
+    }
+    std::set<int> column_ids;
+  };
+  ColumnRefVisitor visitor;
+  node->Accept(&visitor).IgnoreError();
+  return visitor.column_ids;
+}
+
+// The columns each conjunct of <expr> refers to.
+std::vector<std::set<int>> ConjunctColumnRefs(const ResolvedExpr *expr) {
+  std::vector<std::set<int>> conjuncts;
+  std::vector<const ResolvedExpr *> stack = {expr};
+  while (!stack.empty()) {
+    expr = stack.back();
+    stack.pop_back();
+    if (expr->node_kind() == RESOLVED_FUNCTION_CALL &&
+        expr->GetAs<ResolvedFunctionCall>()->function()->Name() == "$and") {
+      for (const auto &argument :
+           expr->GetAs<ResolvedFunctionCall>()->argument_list()) {
+        stack.push_back(argument.get());
+      }
+      continue;
+    }
+    conjuncts.push_back(ColumnRefs(expr));
+  }
+  return conjuncts;
+}
+
+// Whether any column of <scan> is in <column_ids>.
+bool OutputsAnyOf(const ResolvedScan *scan, const std::set<int> &column_ids) {
+  for (const ResolvedColumn &column : scan->column_list()) {
+    if (column_ids.count(column.column_id()) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Collects the resolved nodes of a statement that rules look at.
+class ResolvedCollector : public ResolvedASTVisitor {
+public:
+  absl::Status VisitResolvedTableScan(const ResolvedTableScan *node) override {
+    table_scans.push_back(node);
+    return DefaultVisit(node);
+  }
+
+  absl::Status
+  VisitResolvedFilterScan(const ResolvedFilterScan *node) override {
+    const size_t num_enclosing = enclosing_conjuncts_.size();
+    for (std::set<int> &conjunct : ConjunctColumnRefs(node->filter_expr())) {
+      filtered_columns.insert(conjunct.begin(), conjunct.end());
+      enclosing_conjuncts_.push_back(std::move(conjunct));
+    }
+    const absl::Status status = DefaultVisit(node);
+    enclosing_conjuncts_.resize(num_enclosing);
+    return status;
+  }
+
+  absl::Status VisitResolvedJoinScan(const ResolvedJoinScan *node) override {
+    // FROM a, b WHERE a.id = b.id joins on a condition of the enclosing
+    // filter instead.
+    if (node->join_expr() == nullptr &&
+        std::none_of(enclosing_conjuncts_.begin(), enclosing_conjuncts_.end(),
+                     [node](const std::set<int> &conjunct) {
+                       return OutputsAnyOf(node->left_scan(), conjunct) &&
+                              OutputsAnyOf(node->right_scan(), conjunct);
+                     })) {
+      unconditioned_joins.push_back(node);
+    }
+    if (node->join_expr() == nullptr) {
+      return DefaultVisit(node);
+    }
+    // The condition filters the inputs as a filter above the join would.
+    const size_t num_enclosing = enclosing_conjuncts_.size();
+    for (std::set<int> &conjunct : ConjunctColumnRefs(node->join_expr())) {
+      filtered_columns.insert(conjunct.begin(), conjunct.end());
+      enclosing_conjuncts_.push_back(std::move(conjunct));
+    }
+    const absl::Status status = DefaultVisit(node);
+    enclosing_conjuncts_.resize(num_enclosing);
+    return status;
+  }
+
+  absl::Status VisitResolvedAggregateFunctionCall(
+      const ResolvedAggregateFunctionCall *node) override {
+    if (node->distinct() &&
+        absl::AsciiStrToLower(node->function()->Name()) == "count") {
+      count_distinct = true;
+    }
+    return DefaultVisit(node);
+  }
+
+  std::vector<const ResolvedTableScan *> table_scans;
+  // Joins without a condition, neither their own nor one of an enclosing
+  // filter.
+  std::vector<const ResolvedJoinScan *> unconditioned_joins;
+  // Columns referred to by filters and join conditions.
+  std::set<int> filtered_columns;
+  bool count_distinct = false;
+
+private:
+  // Columns referred to by each conjunct of the filters above the node
+  // visited.
+  std::vector<std::set<int>> enclosing_conjuncts_;
+};
+
+absl::Status CollectResolved(const ResolvedStatement &statement,
+                             ResolvedCollector *collector) {
+  return statement.Accept(collector);
+}
+
+// Whether <scan> reads any table.
+bool ScansTable(const ResolvedScan *scan) {
+  class TableScanFinder : public ResolvedASTVisitor {
+  public:
+    absl::Status
+    VisitResolvedTableScan(const ResolvedTableScan *node) override {
+      found = true;
+      return absl::OkStatus();
+    }
+    bool found = false;
+  };
+  TableScanFinder finder;
+  scan->Accept(&finder).IgnoreError();
+  return finder.found;
+}
+
+// SELECT * over an external table with many columns, which is billed for
+// every column however few are used downstream.
+class SelectStarOnWideTable : public LintRule {
+public:
+  explicit SelectStarOnWideTable(int wide_table_columns)
+      : wide_table_columns_(wide_table_columns) {}
+
+  std::string name() const override { return "select_star_on_wide_table"; }
+
+  absl::Status Check(const LintInput &input,
+                     std::vector<LintFinding> *findings) const override {
+    const ASTNode *star = nullptr;
+    VisitAST(&input.statement, [&star](const ASTNode *node) {
+      if (star == nullptr && (node->node_kind() == AST_STAR ||
+                              node->node_kind() == AST_DOT_STAR)) {
+        star = node;
+      }
+    });
+    if (star == nullptr) {
+      return absl::OkStatus();
+    }
+    ResolvedCollector collector;
+    ZETASQL_RETURN_IF_ERROR(
+        CollectResolved(input.resolved_statement, &collector));
+    for (const ResolvedTableScan *scan : collector.table_scans) {
+      const Table *table = scan->table();
+      // Unused columns are pruned, so a scan of all columns reads them all.
+      if (table->NumColumns() < wide_table_columns_ ||
+          scan->column_list_size() < table->NumColumns() ||
+          input.engine.IsCreated(table->Name())) {
+        continue;
+      }
+      findings->push_back(
+          {name(),
+           absl::StrCat("SELECT * reads all ", table->NumColumns(),
+                        " columns of ", table->Name(),
+                        ", select only the columns needed"),
+           Start(star)});
+    }
+    return absl::OkStatus();
+  }
+
+private:
+  const int wide_table_columns_;
+};
+
+// A scan of a partitioned table without a filter or a join condition on the
+// partitioning column, which reads every partition.
+class MissingPartitionFilter : public LintRule {
+public:
+  std::string name() const override { return "missing_partition_filter"; }
+
+  absl::Status Check(const LintInput &input,
+                     std::vector<LintFinding> *findings) const override {
+    ResolvedCollector collector;
+    ZETASQL_RETURN_IF_ERROR(
+        CollectResolved(input.resolved_statement, &collector));
+    // Scans are reported where their table is written, found by its alias in
+    // the order the tables are written.
+    std::map<std::string, std::vector<const ASTNode *>> tables;
+    VisitAST(&input.statement, [&tables](const ASTNode *node) {
+      if (node->node_kind() != AST_TABLE_PATH_EXPRESSION) {
+        return;
+      }
+      const auto *table = node->GetAs<ASTTablePathExpression>();
+      if (table->path_expr() != nullptr) {
+        tables[TableAlias(table)].push_back(node);
+      }
+    });
+    std::map<std::string, size_t> next_table;
+    // The table INSERT writes to is not read, nor written in a FROM clause.
+    const ResolvedTableScan *target =
+        input.resolved_statement.node_kind() == RESOLVED_INSERT_STMT
+            ? input.resolved_statement.GetAs<ResolvedInsertStmt>()
+                  ->table_scan()
+            : nullptr;
+    for (const ResolvedTableScan *scan : collector.table_scans) {
+      if (scan == target) {
+        continue;
+      }
+      const std::vector<std::string> partition_columns =
+          input.engine.PartitionColumns(*scan->table());
+      if (partition_columns.empty()) {
+        continue;
+      }
+      const std::string alias = absl::AsciiStrToLower(scan->alias());
+      const std::vector<const ASTNode *> &written = tables[alias];
+      const size_t index = next_table[alias]++;
+      const ASTNode *location =
+          index < written.size() ? written[index] : &input.statement;
+      bool filtered = false;
+      for (int i = 0; i < scan->column_list_size(); ++i) {
+        const std::string column_name =
+            absl::AsciiStrToLower(scan->column_list(i).name());
+        if (std::find(partition_columns.begin(), partition_columns.end(),
+                      column_name) != partition_columns.end() &&
+            collector.filtered_columns.count(
+                scan->column_list(i).column_id()) > 0) {
+          filtered = true;
+        }
+      }
+      if (filtered) {
+        continue;
+      }
+      findings->push_back(
+          {name(),
+           absl::StrCat(scan->table()->Name(), " is partitioned by ",
+                        absl::StrJoin(partition_columns, ", "),
+                        " but is scanned without filtering on it"),
+           Start(location)});
+    }
+    return absl::OkStatus();
+  }
+};
+
+// A join of two tables without a join condition, whose output grows with the
+// product of their sizes. Conditions may also come from a filter above the
+// join, as in FROM a, b WHERE a.id = b.id. Joins with UNNEST are fine.
+class UnboundedCrossJoin : public LintRule {
+public:
+  std::string name() const override { return "unbounded_cross_join"; }
+
+  absl::Status Check(const LintInput &input,
+                     std::vector<LintFinding> *findings) const override {
+    ResolvedCollector collector;
+    ZETASQL_RETURN_IF_ERROR(
+        CollectResolved(input.resolved_statement, &collector));
+    // Joins are reported where they are written, found by the alias of
+    // the table they join, or in order for joins of subqueries.
+    std::multiset<std::string> unbounded_aliases;
+    int unbounded_subquery_joins = 0;
+    for (const ResolvedJoinScan *join : collector.unconditioned_joins) {
+      if (!ScansTable(join->left_scan()) || !ScansTable(join->right_scan())) {
+        continue;
+      }
+      if (join->right_scan()->node_kind() == RESOLVED_TABLE_SCAN) {
+        unbounded_aliases.insert(absl::AsciiStrToLower(
+            join->right_scan()->GetAs<ResolvedTableScan>()->alias()));
+      } else {
+        ++unbounded_subquery_joins;
+      }
+    }
+    if (unbounded_aliases.empty() && unbounded_subquery_joins == 0) {
+      return absl::OkStatus();
+    }
+    VisitAST(&input.statement, [&](const ASTNode *node) {
+      if (node->node_kind() != AST_JOIN) {
+        return;
+      }
+      const ASTJoin *join = node->GetAs<ASTJoin>();
+      if (join->on_clause() != nullptr || join->using_clause() != nullptr) {
+        return;
+      }
+      const auto *rhs = join->rhs();
+      if (rhs->node_kind() == AST_TABLE_PATH_EXPRESSION) {
+        const auto *table = rhs->GetAs<ASTTablePathExpression>();
+        if (table->unnest_expr() != nullptr || table->path_expr() == nullptr) {
+          return;
+        }
+        const auto it = unbounded_aliases.find(TableAlias(table));
+        if (it == unbounded_aliases.end()) {
+          return;
+        }
+        unbounded_aliases.erase(it);
+      } else if (unbounded_subquery_joins > 0) {
+        --unbounded_subquery_joins;
+      } else {
+        return;
+      }
+      findings->push_back({name(),
+                           "CROSS JOIN without a join condition, the output "
+                           "grows with the product of the inputs",
+                           Start(join)});
+    });
+    return absl::OkStatus();
+  }
+};
+
+// ORDER BY in the outermost query without LIMIT, which sorts the whole
+// result on a single worker.
+class OrderByWithoutLimit : public LintRule {
+public:
+  std::string name() const override { return "order_by_without_limit"; }
+
+  absl::Status Check(const LintInput &input,
+                     std::vector<LintFinding> *findings) const override {
+    const ASTQuery *query = TopLevelQuery(input.statement);
+    if (query == nullptr || query->order_by() == nullptr ||
+        query->limit_offset() != nullptr) {
+      return absl::OkStatus();
+    }
+    findings->push_back({name(),
+                         "ORDER BY without LIMIT sorts the whole result on a "
+                         "single worker",
+                         Start(query->order_by())});
+    return absl::OkStatus();
+  }
+};
+
+// COUNT(DISTINCT) over a table with many rows, which has to shuffle all
+// distinct values.
+class CountDistinctOnHugeInput : public LintRule {
+public:
+  explicit CountDistinctOnHugeInput(int64_t huge_table_rows)
+      : huge_table_rows_(huge_table_rows) {}
+
+  std::string name() const override { return "count_distinct_on_huge_input"; }
+
+  absl::Status Check(const LintInput &input,
+                     std::vector<LintFinding> *findings) const override {
+    ResolvedCollector collector;
+    ZETASQL_RETURN_IF_ERROR(
+        CollectResolved(input.resolved_statement, &collector));
+    if (!collector.count_distinct) {
+      return absl::OkStatus();
+    }
+    std::string huge_table;
+    int64_t huge_rows = 0;
+    for (const ResolvedTableScan *scan : collector.table_scans) {
+      int64_t rows;
+      if (input.engine.EstimatedRows(scan->table()->Name(), &rows) &&
+          rows >= huge_table_rows_ && rows > huge_rows) {
+        huge_table = scan->table()->Name();
+        huge_rows = rows;
+      }
+    }
+    if (huge_table.empty()) {
+      return absl::OkStatus();
+    }
+    const ASTNode *count = nullptr;
+    VisitAST(&input.statement, [&count](const ASTNode *node) {
+      if (count != nullptr || node->node_kind() != AST_FUNCTION_CALL) {
+        return;
+      }
+      const auto *call = node->GetAs<ASTFunctionCall>();
+      if (call->distinct() &&
+          absl::AsciiStrToLower(call->function()->ToIdentifierPathString()) ==
+              "count") {
+        count = node;
+      }
+    });
+    findings->push_back(
+        {name(),
+         absl::StrCat("COUNT(DISTINCT) over ", huge_table, " with about ",
+                      huge_rows,
+                      " rows, consider APPROX_COUNT_DISTINCT"),
+         Start(count != nullptr ? count : &input.statement)});
+    return absl::OkStatus();
+  }
+
+private:
+  const int64_t huge_table_rows_;
+};
+
+// The same scalar subquery written more than once in a statement, which is
+// evaluated once for each.
+class RepeatedScalarSubquery : public LintRule {
+public:
+  std::string name() const override { return "repeated_scalar_subquery"; }
+
+  absl::Status Check(const LintInput &input,
+                     std::vector<LintFinding> *findings) const override {
+    std::map<std::string, int> occurrences;
+    VisitAST(&input.statement, [&](const ASTNode *node) {
+      if (node->node_kind() != AST_EXPRESSION_SUBQUERY ||
+          node->GetAs<ASTExpressionSubquery>()->modifier() !=
+              ASTExpressionSubquery::NONE) {
+        return;
+      }
+      const auto range = node->GetParseLocationRange();
+      // Compared ignoring case and whitespace.
+      const std::string text = absl::AsciiStrToLower(absl::StrJoin(
+          absl::StrSplit(input.sql.substr(range.start().GetByteOffset(),
+                                          range.end().GetByteOffset() -
+                                              range.start().GetByteOffset()),
+                         absl::ByAnyChar(" \t\r\n"), absl::SkipEmpty()),
+          " "));
+      if (++occurrences[text] == 2) {
+        findings->push_back({name(),
+                             "Scalar subquery repeated in the statement, "
+                             "compute it once in a WITH clause or a JOIN",
+                             Start(node)});
+      }
+    });
+    return absl::OkStatus();
+  }
+};
+
+constexpr int kWideTableColumns = 50;
+constexpr int64_t kHugeTableRows = 100000000;
+
+std::vector<std::unique_ptr<LintRule>> BuiltinLintRules() {
+  std::vector<std::unique_ptr<LintRule>> rules;
+  rules.push_back(absl::make_unique<SelectStarOnWideTable>(kWideTableColumns));
+  rules.push_back(absl::make_unique<MissingPartitionFilter>());
+  rules.push_back(absl::make_unique<UnboundedCrossJoin>());
+  rules.push_back(absl::make_unique<OrderByWithoutLimit>());
+  rules.push_back(absl::make_unique<CountDistinctOnHugeInput>(kHugeTableRows));
+  rules.push_back(absl::make_unique<RepeatedScalarSubquery>());
+  return rules;
+}
+
+} // namespace
+
+absl::Status LintEngine::Lint(const std::string &sql,
+                              const ASTStatement &statement,
+                              const ResolvedStatement &resolved_statement,
+                              std::vector<LintFinding> *findings) {
+  const LintInput input{sql, statement, resolved_statement, *this};
+  for (const auto &rule : rules_) {
+    ZETASQL_RETURN_IF_ERROR(rule->Check(input, findings));
+  }
+
+  // Recorded after the rules ran, since a statement can read the table it
+  // replaces.
+  if (resolved_statement.node_kind() != RESOLVED_CREATE_TABLE_STMT &&
+      resolved_statement.node_kind() != RESOLVED_CREATE_TABLE_AS_SELECT_STMT) {
+    return absl::OkStatus();
+  }
+  const auto *create_table_stmt =
+      resolved_statement.GetAs<ResolvedCreateTableStmtBase>();
+  const std::string table_name = absl::AsciiStrToLower(
+      absl::StrJoin(create_table_stmt->name_path(), "."));
+  std::vector<std::string> partition_columns;
+  for (const auto &partition_by : create_table_stmt->partition_by_list()) {
+    if (partition_by->node_kind() == RESOLVED_COLUMN_REF) {
+      partition_columns.push_back(absl::AsciiStrToLower(
+          partition_by->GetAs<ResolvedColumnRef>()->column().name()));
+      continue;
+    }
+    // E.g. DATE(timestamp_column), whose partitions filters on the column
+    // prune.
+    class ColumnNames : public ResolvedASTVisitor {
+    public:
+      explicit ColumnNames(std::vector<std::string> *names) : names_(names) {}
+      absl::Status
+      VisitResolvedColumnRef(const ResolvedColumnRef *node) override {
+        names_->push_back(absl::AsciiStrToLower(node->column().name()));
+        return absl::OkStatus();
+      }
+
+    private:
+      std::vector<std::string> *names_;
+    };
+    ColumnNames names(&partition_columns);
+    ZETASQL_RETURN_IF_ERROR(partition_by->Accept(&names));
+  }
+  absl::MutexLock l(&mutex_);
+  created_tables_.insert(table_name);
+  partition_columns_[table_name] = std::move(partition_columns);
+  return absl::OkStatus();
+}
+
+bool LintEngine::IsCreated(const std::string &table_name) const {
+  absl::MutexLock l(&mutex_);
+  return created_tables_.contains(absl::AsciiStrToLower(table_name));
+}
+
+std::vector<std::string>
+LintEngine::PartitionColumns(const Table &table) const {
+  {
+    absl::MutexLock l(&mutex_);
+    const auto it =
+        partition_columns_.find(absl::AsciiStrToLower(table.Name()));
+    if (it != partition_columns_.end()) {
+      return it->second;
+    }
+  }
+  std::vector<std::string> partition_columns;
+  for (const char *pseudo_column : {"_partitiontime", "_partitiondate"}) {
+    if (table.FindColumnByName(pseudo_column) != nullptr) {
+      partition_columns.push_back(pseudo_column);
+    }
+  }
+  return partition_columns;
+}
+
+bool LintEngine::EstimatedRows(const std::string &table_name,
+                               int64_t *rows) const {
+  return estimator_ != nullptr &&
+         estimator_->EstimatedRows(table_name, rows);
+}
+
+absl::Status MakeLintRules(const std::string &rule_names,
+                           std::vector<std::unique_ptr<LintRule>> *rules) {
+  std::vector<std::unique_ptr<LintRule>> builtin_rules = BuiltinLintRules();
+  if (rule_names == "all") {
+    for (auto &rule : builtin_rules) {
+      rules->push_back(std::move(rule));
+    }
+    return absl::OkStatus();
+  }
+  std::set<absl::string_view> named;
+  for (const absl::string_view rule_name :
+       absl::StrSplit(rule_names, ',', absl::SkipEmpty())) {
+    if (!named.insert(rule_name).second) {
+      // Named again, run once.
+      continue;
+    }
+    const auto it =
+        std::find_if(builtin_rules.begin(), builtin_rules.end(),
+                     [rule_name](const std::unique_ptr<LintRule> &rule) {
+                       return rule != nullptr && rule->name() == rule_name;
+                     });
+    if (it == builtin_rules.end()) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Unknown lint rule ", rule_name));
+    }
+    rules->push_back(std::move(*it));
+  }
+  return absl::OkStatus();
+}
+
+std::string FormatLintFinding(const LintFinding &finding,
+                              const std::string &sql,
+                              const std::string &path) {
+  int line = 1;
+  int column = 1;
+  const auto line_and_column =
+      ParseLocationTranslator(sql).GetLineAndColumnAfterTabExpansion(
+          finding.location);
+  if (line_and_column.ok()) {
+    line = line_and_column.value().first;
+    column = line_and_column.value().second;
+  }
+  return absl::StrCat("[", finding.rule, "] ", finding.message, " [at ", path,
+                      ":", line, ":", column, "]");
+}
+
+} // namespace alphasql
@@ -0,0 +1,121 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_LINT_H_
+#define ALPHASQL_LINT_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/synchronization/mutex.h"
+#include "alphasql/cost_estimator.h"
+#include "zetasql/base/status.h"
+#include "zetasql/parser/parser.h"
+#include "zetasql/public/parse_location.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+
+namespace alphasql {
+
+struct LintFinding {
+  std::string rule;
+  std::string message;
+  // Where in the SQL of the statement the finding is.
+  zetasql::ParseLocationPoint location;
+};
+
+class LintEngine;
+
+// What a rule looks at: a statement and its resolved form.
+struct LintInput {
+  const std::string &sql;
+  const zetasql::ASTStatement &statement;
+  const zetasql::ResolvedStatement &resolved_statement;
+  const LintEngine &engine;
+};
+
+// A lint rule for a SQL pattern known to perform badly. Rules are shared by
+// concurrently checked files, so Check must be thread-safe.
+class LintRule {
+public:
+  virtual ~LintRule() = default;
+
+  // Name used to select the rule and to tag its findings.
+  virtual std::string name() const = 0;
+
+  virtual absl::Status Check(const LintInput &input,
+                             std::vector<LintFinding> *findings) const = 0;
+};
+
+// Runs lint rules over the statements of a pipeline, keeping track of what
+// rules need to know about tables across files: which ones the pipeline
+// creates and how they are partitioned. Statements must be added in an order
+// where upstream files come first. This class is thread-safe.
+class LintEngine {
+public:
+  // <estimator> gives the sizes of tables and may be null.
+  explicit LintEngine(const CostEstimator *estimator)
+      : estimator_(estimator) {}
+
+  void AddRule(std::unique_ptr<LintRule> rule) {
+    rules_.push_back(std::move(rule));
+  }
+
+  // Runs all rules over <statement> and its resolved form, appending what
+  // they find to <findings>.
+  absl::Status Lint(const std::string &sql,
+                    const zetasql::ASTStatement &statement,
+                    const zetasql::ResolvedStatement &resolved_statement,
+                    std::vector<LintFinding> *findings);
+
+  // Whether <table_name> is created by a statement added before.
+  bool IsCreated(const std::string &table_name) const;
+  // Lowercased names of the columns <table> is partitioned by, including the
+  // _PARTITIONTIME and _PARTITIONDATE pseudo columns of external tables,
+  // which are declared as columns in the JSON schema like _TABLE_SUFFIX.
+  std::vector<std::string>
+  PartitionColumns(const zetasql::Table &table) const;
+  // See CostEstimator::EstimatedRows. False without an estimator.
+  bool EstimatedRows(const std::string &table_name, int64_t *rows) const;
+
+private:
+  std::vector<std::unique_ptr<LintRule>> rules_;
+  const CostEstimator *estimator_; // Not owned.
+
+  mutable absl::Mutex mutex_;
+  // Lowercased names of created tables.
+  absl::flat_hash_set<std::string> created_tables_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::string, std::vector<std::string>>
+      partition_columns_ ABSL_GUARDED_BY(mutex_);
+};
+
+// Creates the builtin rules named in <rule_names>, comma separated, or all of
+// them for "all". A rule named more than once is created once. Returns an
+// error for unknown names.
+absl::Status
+MakeLintRules(const std::string &rule_names,
+              std::vector<std::unique_ptr<LintRule>> *rules);
+
+// "[<rule>] <message> [at <path>:<line>:<column>]"
+std::string FormatLintFinding(const LintFinding &finding,
+                              const std::string &sql,
+                              const std::string &path);
+
+} // namespace alphasql
+
+#endif // ALPHASQL_LINT_H_
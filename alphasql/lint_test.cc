@@ -0,0 +1,190 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+#include "alphasql/lint.h"
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "alphasql/analysis_test_util.h"
+#include "alphasql/cost_estimator.h"
+#include "gtest/gtest.h"
+#include "zetasql/parser/parser.h"
+
+namespace alphasql {
+namespace {
+
+using namespace zetasql;
+
+class LintTest : public AnalysisTest {
+protected:
+  // Runs the rule <rule_name> over <sql>.
+  std::vector<LintFinding> Lint(const std::string &rule_name,
+                                const std::string &sql) {
+    std::vector<std::unique_ptr<LintRule>> rules;
+    EXPECT_TRUE(MakeLintRules(rule_name, &rules).ok());
+    LintEngine engine(&estimator_);
+    for (auto &rule : rules) {
+      engine.AddRule(std::move(rule));
+    }
+    std::unique_ptr<ParserOutput> parser_output;
+    absl::Status status =
+        ParseStatement(sql, ParserOptions(), &parser_output);
+    EXPECT_TRUE(status.ok()) << status;
+    const auto output = Analyze(sql);
+    std::vector<LintFinding> findings;
+    if (parser_output == nullptr || output == nullptr) {
+      return findings;
+    }
+    status = engine.Lint(sql, *parser_output->statement(),
+                         *output->resolved_statement(), &findings);
+    EXPECT_TRUE(status.ok()) << status;
+    for (const LintFinding &finding : findings) {
+      EXPECT_EQ(finding.rule, rule_name);
+    }
+    return findings;
+  }
+
+  CostEstimator estimator_;
+};
+
+TEST_F(LintTest, UnknownRule) {
+  std::vector<std::unique_ptr<LintRule>> rules;
+  EXPECT_FALSE(MakeLintRules("no_such_rule", &rules).ok());
+  EXPECT_TRUE(MakeLintRules("all", &rules).ok());
+  EXPECT_EQ(rules.size(), 6u);
+}
+
+TEST_F(LintTest, RulesNamedTwiceAreCreatedOnce) {
+  std::vector<std::unique_ptr<LintRule>> rules;
+  EXPECT_TRUE(MakeLintRules("order_by_without_limit,unbounded_cross_join,"
+                            "order_by_without_limit",
+                            &rules)
+                  .ok());
+  ASSERT_EQ(rules.size(), 2u);
+  EXPECT_EQ(rules[0]->name(), "order_by_without_limit");
+  EXPECT_EQ(rules[1]->name(), "unbounded_cross_join");
+}
+
+TEST_F(LintTest, SelectStarOnWideTable) {
+  std::vector<std::string> column_names;
+  for (int i = 0; i < 50; ++i) {
+    column_names.push_back(absl::StrCat("c", i));
+  }
+  AddTable("wide", column_names);
+  const std::string rule = "select_star_on_wide_table";
+  EXPECT_EQ(Lint(rule, "SELECT * FROM wide").size(), 1u);
+  EXPECT_TRUE(Lint(rule, "SELECT c0, c1 FROM wide").empty());
+  EXPECT_TRUE(Lint(rule, "SELECT * FROM a").empty());
+  // Only the columns used outside are read.
+  EXPECT_TRUE(Lint(rule, "SELECT c0 FROM (SELECT * FROM wide)").empty());
+}
+
+TEST_F(LintTest, MissingPartitionFilter) {
+  AddTable("events", {"x", "_PARTITIONTIME"});
+  const std::string rule = "missing_partition_filter";
+  EXPECT_EQ(Lint(rule, "SELECT x FROM events").size(), 1u);
+  EXPECT_EQ(Lint(rule, "SELECT x FROM events WHERE x > 0").size(), 1u);
+  EXPECT_TRUE(
+      Lint(rule, "SELECT x FROM events WHERE _PARTITIONTIME > 0").empty());
+  EXPECT_TRUE(Lint(rule, "SELECT x FROM a").empty());
+  EXPECT_TRUE(Lint(rule, "SELECT a.x FROM a JOIN events "
+                         "ON events._PARTITIONTIME = a.x")
+                  .empty());
+  EXPECT_TRUE(Lint(rule, "INSERT INTO events (x) SELECT x FROM a").empty());
+}
+
+TEST_F(LintTest, MissingPartitionFilterIsReportedAtTheScan) {
+  AddTable("events", {"x", "_PARTITIONTIME"});
+  const std::string sql =
+      "SELECT e.x FROM events AS e JOIN (SELECT x FROM events "
+      "WHERE _PARTITIONTIME > 0) USING (x)";
+  const auto findings = Lint("missing_partition_filter", sql);
+  ASSERT_EQ(findings.size(), 1u);
+  EXPECT_EQ(findings[0].location.GetByteOffset(),
+            static_cast<int>(sql.find("events")));
+}
+
+TEST_F(LintTest, UnboundedCrossJoin) {
+  const std::string rule = "unbounded_cross_join";
+  EXPECT_EQ(Lint(rule, "SELECT a.x FROM a CROSS JOIN b").size(), 1u);
+  EXPECT_EQ(Lint(rule, "SELECT a.x FROM a, b").size(), 1u);
+  // The filter does not relate the joined tables.
+  EXPECT_EQ(Lint(rule, "SELECT a.x FROM a, b WHERE a.x = 1 AND b.y = 2").size(),
+            1u);
+  EXPECT_EQ(Lint(rule, "SELECT a.x FROM a, (SELECT x FROM b) AS c").size(),
+            1u);
+  EXPECT_TRUE(Lint(rule, "SELECT a.x FROM a JOIN b ON a.x = b.x").empty());
+  EXPECT_TRUE(Lint(rule, "SELECT a.x FROM a JOIN b USING (x)").empty());
+  EXPECT_TRUE(Lint(rule, "SELECT a.x FROM a, UNNEST([1, 2]) AS n").empty());
+}
+
+TEST_F(LintTest, CommaJoinsFilteredOnBothTablesAreBounded) {
+  const std::string rule = "unbounded_cross_join";
+  EXPECT_TRUE(Lint(rule, "SELECT a.x FROM a, b WHERE a.x = b.x").empty());
+  EXPECT_TRUE(
+      Lint(rule, "SELECT a.x FROM a, b WHERE a.y > 0 AND a.x = b.x").empty());
+  // Only the join not related by the filter is reported.
+  EXPECT_EQ(
+      Lint(rule, "SELECT a.x FROM a, b, a AS c WHERE a.x = b.x").size(), 1u);
+}
+
+TEST_F(LintTest, OrderByWithoutLimit) {
+  const std::string rule = "order_by_without_limit";
+  EXPECT_EQ(Lint(rule, "SELECT x FROM a ORDER BY x").size(), 1u);
+  EXPECT_TRUE(Lint(rule, "SELECT x FROM a ORDER BY x LIMIT 10").empty());
+  EXPECT_TRUE(Lint(rule, "SELECT x FROM (SELECT x FROM a ORDER BY x)").empty());
+}
+
+TEST_F(LintTest, CountDistinctOnHugeInput) {
+  const std::string stats_path =
+      absl::StrCat(testing::TempDir(), "/lint_test_stats.json");
+  std::ofstream(stats_path)
+      << R"({"a": {"rows": 1000000000}, "b": {"rows": 10}})";
+  ASSERT_TRUE(estimator_.ReadStats(stats_path).ok());
+  const std::string rule = "count_distinct_on_huge_input";
+  EXPECT_EQ(Lint(rule, "SELECT COUNT(DISTINCT x) FROM a").size(), 1u);
+  EXPECT_TRUE(Lint(rule, "SELECT COUNT(DISTINCT x) FROM b").empty());
+  EXPECT_TRUE(Lint(rule, "SELECT COUNT(x) FROM a").empty());
+  EXPECT_TRUE(Lint(rule, "SELECT SUM(DISTINCT x) FROM a").empty());
+
+  // Located at the COUNT, not at other DISTINCT aggregates.
+  const std::string sql = "SELECT SUM(DISTINCT x), COUNT(DISTINCT y) FROM a";
+  const auto findings = Lint(rule, sql);
+  ASSERT_EQ(findings.size(), 1u);
+  EXPECT_EQ(findings[0].location.GetByteOffset(),
+            static_cast<int>(sql.find("COUNT")));
+}
+
+TEST_F(LintTest, RepeatedScalarSubquery) {
+  const std::string rule = "repeated_scalar_subquery";
+  EXPECT_EQ(Lint(rule, "SELECT (SELECT MAX(x) FROM a), "
+                       "(select max(x)\n  FROM a) + 1")
+                .size(),
+            1u);
+  EXPECT_TRUE(
+      Lint(rule, "SELECT (SELECT MAX(x) FROM a), (SELECT MIN(x) FROM a)")
+          .empty());
+  EXPECT_TRUE(
+      Lint(rule, "SELECT x FROM a WHERE EXISTS (SELECT 1 FROM b) "
+                 "AND EXISTS (SELECT 1 FROM b)")
+          .empty());
+}
+
+} // namespace
+} // namespace alphasql
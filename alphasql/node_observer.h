@@ -0,0 +1,40 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_NODE_OBSERVER_H_
+#define ALPHASQL_NODE_OBSERVER_H_
+
+#include "zetasql/parser/parse_tree.h"
+
+namespace alphasql {
+
+// Receives the nodes of a parse tree from a traversal made for another
+// purpose, so that several analyses of a statement share a single pass.
+class NodeObserver {
+public:
+  virtual ~NodeObserver() {}
+
+  // Called before the descendants of <node>. Returning false stops them from
+  // being reported.
+  virtual bool Enter(const zetasql::ASTNode *node) = 0;
+
+  // Called after the descendants of <node> if Enter returned true.
+  virtual void Leave(const zetasql::ASTNode *node) {}
+};
+
+} // namespace alphasql
+
+#endif // ALPHASQL_NODE_OBSERVER_H_
@@ -0,0 +1,55 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/procedure_cache.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "zetasql/base/arena.h"
+#include "zetasql/public/id_string.h"
+
+namespace alphasql {
+
+using namespace zetasql;
+
+absl::Status ProcedureBody::GetScript(const LanguageOptions &language_options,
+                                      ErrorMessageMode error_message_mode,
+                                      const ASTScript **script) const {
+  absl::call_once(parse_once_, [&]() {
+    // The body outlives the file that created it and is read by any file
+    // that calls it, so it gets arenas of its own.
+    ParserOptions parser_options(
+        std::make_shared<IdStringPool>(),
+        std::make_shared<zetasql_base::UnsafeArena>(/*block_size=*/4096),
+        &language_options);
+    parse_status_ = ParseScript(sql_, parser_options, error_message_mode,
+                                &parser_output_);
+  });
+  if (!parse_status_.ok()) {
+    return parse_status_;
+  }
+  *script = parser_output_->script();
+  return absl::OkStatus();
+}
+
+const ProcedureBody *SQLProcedure::BodyOf(const Procedure *procedure) {
+  const auto *sql_procedure = dynamic_cast<const SQLProcedure *>(procedure);
+  return sql_procedure != nullptr ? &sql_procedure->body() : nullptr;
+}
+
+} // namespace alphasql
@@ -0,0 +1,82 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_PROCEDURE_CACHE_H_
+#define ALPHASQL_PROCEDURE_CACHE_H_
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/call_once.h"
+#include "zetasql/base/status.h"
+#include "zetasql/parser/parser.h"
+#include "zetasql/public/error_helpers.h"
+#include "zetasql/public/language_options.h"
+#include "zetasql/public/procedure.h"
+
+namespace alphasql {
+
+// The body of a procedure, parsed once on first use. This class is
+// thread-safe.
+class ProcedureBody {
+public:
+  explicit ProcedureBody(std::string sql) : sql_(std::move(sql)) {}
+  ProcedureBody(const ProcedureBody &) = delete;
+  ProcedureBody &operator=(const ProcedureBody &) = delete;
+
+  // The text parse locations of the script refer to.
+  const std::string &sql() const { return sql_; }
+
+  // Returns the parsed body. Every call returns the result of the first one.
+  absl::Status GetScript(const zetasql::LanguageOptions &language_options,
+                         zetasql::ErrorMessageMode error_message_mode,
+                         const zetasql::ASTScript **script) const;
+
+private:
+  const std::string sql_;
+
+  mutable absl::once_flag parse_once_;
+  mutable absl::Status parse_status_;
+  mutable std::unique_ptr<zetasql::ParserOutput> parser_output_;
+};
+
+// A procedure created by a checked file, which keeps its body so that a CALL
+// only has to analyze the body instead of parsing it again.
+//
+// The body belongs to the Procedure object added to the catalog, so a CALL
+// gets the body of exactly the procedure it resolved to, whichever catalog
+// layer that lives in, and the body is freed along with the procedure once
+// the catalog has replaced it and no layer can find it anymore.
+class SQLProcedure : public zetasql::Procedure {
+public:
+  SQLProcedure(const std::vector<std::string> &name_path,
+               const zetasql::ProcedureSignature &signature, std::string body)
+      : Procedure(name_path, signature), body_(std::move(body)) {}
+
+  const ProcedureBody &body() const { return body_; }
+
+  // Returns null if <procedure> is not a SQLProcedure.
+  static const ProcedureBody *BodyOf(const zetasql::Procedure *procedure);
+
+private:
+  const ProcedureBody body_;
+};
+
+} // namespace alphasql
+
+#endif // ALPHASQL_PROCEDURE_CACHE_H_
@@ -0,0 +1,131 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_SQL_FILE_H_
+#define ALPHASQL_SQL_FILE_H_
+
+#include <cstddef>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+
+#include "absl/strings/ascii.h"
+#include "absl/strings/string_view.h"
+#include "alphasql/common_lib.h"
+#include "zetasql/base/arena.h"
+#include "zetasql/base/status.h"
+#include "zetasql/base/status_macros.h"
+#include "zetasql/parser/parser.h"
+#include "zetasql/public/analyzer.h"
+#include "zetasql/public/error_helpers.h"
+#include "zetasql/public/id_string.h"
+#include "zetasql/public/parse_resume_location.h"
+
+namespace alphasql {
+
+// A SQL file read and parsed at most once, so that extracting the DAG and
+// checking it in the same process share the source buffer and the AST.
+struct SQLFile {
+  std::string path;
+  std::string sql;
+  // Null until parsed. Parse locations refer to <sql>.
+  std::unique_ptr<zetasql::ParserOutput> parser_output;
+};
+
+// Reads the file at <path> without parsing it.
+inline void ReadSQLFile(const std::string &path, SQLFile *file) {
+  std::ifstream stream(path, std::ios::in);
+  file->path = path;
+  file->sql.assign(std::istreambuf_iterator<char>(stream), {});
+  file->parser_output.reset();
+}
+
+// Parses <file> as a script unless it already is.
+inline absl::Status ParseSQLFile(const zetasql::AnalyzerOptions &options,
+                                 SQLFile *file) {
+  if (file->parser_output != nullptr) {
+    return absl::OkStatus();
+  }
+  return zetasql::ParseScript(file->sql, options.GetParserOptions(),
+                              options.error_message_mode(),
+                              &file->parser_output, file->path);
+}
+
+// Whether <sql> holds nothing but whitespace and comments from <position>.
+inline bool IsBlankFrom(absl::string_view sql, size_t position) {
+  while (position < sql.size()) {
+    if (absl::ascii_isspace(sql[position])) {
+      ++position;
+    } else if (sql[position] == '#' || sql.substr(position, 2) == "--") {
+      position = sql.find('\n', position);
+    } else if (sql.substr(position, 2) == "/*") {
+      position = sql.find("*/", position + 2);
+      if (position == absl::string_view::npos) {
+        // Left for the parser to report.
+        return false;
+      }
+      position += 2;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Calls <callback> with each top-level statement of <file>. If <file> is not
+// parsed yet, statements are parsed one at a time, each in its own arenas
+// freed before the next one is parsed, so that memory is bounded by the
+// largest statement instead of the whole file. Parse locations refer to
+// <file.sql> either way.
+inline absl::Status ForEachStatement(
+    const zetasql::AnalyzerOptions &options, const SQLFile &file,
+    const std::function<absl::Status(const zetasql::ASTStatement *)>
+        &callback) {
+  if (file.parser_output != nullptr) {
+    const zetasql::ASTScript *script = file.parser_output->script();
+    for (const zetasql::ASTStatement *statement :
+         script->statement_list_node()->statement_list()) {
+      ZETASQL_RETURN_IF_ERROR(callback(statement));
+    }
+    return absl::OkStatus();
+  }
+  zetasql::ParseResumeLocation location =
+      zetasql::ParseResumeLocation::FromStringView(file.path, file.sql);
+  bool at_end_of_input = false;
+  // Like ParseScript, accepts files and ends of files without statements.
+  while (!at_end_of_input &&
+         !IsBlankFrom(file.sql, location.byte_position())) {
+    const zetasql::ParserOptions parser_options(
+        std::make_shared<zetasql::IdStringPool>(),
+        std::make_shared<zetasql_base::UnsafeArena>(/*block_size=*/4096),
+        &options.language());
+    std::unique_ptr<zetasql::ParserOutput> parser_output;
+    const absl::Status status = zetasql::ParseNextScriptStatement(
+        &location, parser_options, &parser_output, &at_end_of_input);
+    if (!status.ok()) {
+      return zetasql::MaybeUpdateErrorFromPayload(options.error_message_mode(),
+                                                  file.sql, status);
+    }
+    ZETASQL_RETURN_IF_ERROR(callback(parser_output->statement()));
+  }
+  return absl::OkStatus();
+}
+
+} // namespace alphasql
+
+#endif // ALPHASQL_SQL_FILE_H_
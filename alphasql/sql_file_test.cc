@@ -0,0 +1,105 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/sql_file.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "zetasql/public/language_options.h"
+
+namespace alphasql {
+namespace {
+
+using namespace zetasql;
+
+AnalyzerOptions MakeOptions() {
+  LanguageOptions language_options;
+  language_options.EnableMaximumLanguageFeaturesForDevelopment();
+  language_options.SetSupportsAllStatementKinds();
+  AnalyzerOptions options(language_options);
+  options.CreateDefaultArenasIfNotSet();
+  return options;
+}
+
+// Kinds and byte ranges of the statements ForEachStatement calls back with.
+std::vector<std::pair<ASTNodeKind, std::pair<int, int>>>
+Statements(const AnalyzerOptions &options, const SQLFile &file) {
+  std::vector<std::pair<ASTNodeKind, std::pair<int, int>>> statements;
+  const absl::Status status =
+      ForEachStatement(options, file, [&](const ASTStatement *statement) {
+        const auto range = statement->GetParseLocationRange();
+        statements.push_back({statement->node_kind(),
+                              {range.start().GetByteOffset(),
+                               range.end().GetByteOffset()}});
+        return absl::OkStatus();
+      });
+  EXPECT_TRUE(status.ok()) << status;
+  return statements;
+}
+
+TEST(ForEachStatement, StreamingMatchesWholeScript) {
+  const AnalyzerOptions options = MakeOptions();
+  SQLFile file;
+  file.path = "test.sql";
+  file.sql = "CREATE TABLE t AS SELECT 1 AS x;\n"
+             "BEGIN\n  SELECT * FROM t;\nEND;\n"
+             "-- trailing comment\n"
+             "SELECT x FROM t";
+  const auto streamed = Statements(options, file);
+  ASSERT_EQ(streamed.size(), 3u);
+
+  ASSERT_TRUE(ParseSQLFile(options, &file).ok());
+  ASSERT_EQ(Statements(options, file), streamed);
+}
+
+TEST(ForEachStatement, EmptyFile) {
+  const AnalyzerOptions options = MakeOptions();
+  SQLFile file;
+  file.sql = "\n  \n";
+  ASSERT_TRUE(Statements(options, file).empty());
+  file.sql = "-- Nothing yet.\n# TODO\n/* SELECT 1; */\n";
+  ASSERT_TRUE(Statements(options, file).empty());
+}
+
+TEST(ForEachStatement, TrailingComment) {
+  const AnalyzerOptions options = MakeOptions();
+  SQLFile file;
+  file.sql = "SELECT 1;\nSELECT 2;\n-- The end.";
+  ASSERT_EQ(Statements(options, file).size(), 2u);
+  file.sql = "SELECT 1;\n/* The end. */";
+  ASSERT_EQ(Statements(options, file).size(), 1u);
+}
+
+TEST(ForEachStatement, SyntaxError) {
+  const AnalyzerOptions options = MakeOptions();
+  SQLFile file;
+  file.sql = "SELECT 1;\nSELEC 2;\nSELECT 3;";
+  int calls = 0;
+  const absl::Status status =
+      ForEachStatement(options, file, [&calls](const ASTStatement *) {
+        ++calls;
+        return absl::OkStatus();
+      });
+  ASSERT_FALSE(status.ok());
+  // Statements before the error were already processed.
+  ASSERT_EQ(calls, 1);
+}
+
+} // namespace
+} // namespace alphasql
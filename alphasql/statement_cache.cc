@@ -0,0 +1,116 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/statement_cache.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+#include "absl/strings/str_cat.h"
+#include "alphasql/check_cache.h"
+
+namespace alphasql {
+
+namespace {
+
+// Bump when the meaning of entries changes.
+constexpr int kVersion = 4;
+
+// Statements are looked up by a short prefix first, so that a position only
+// costs one fingerprint per distinct prefix length.
+constexpr size_t kPrefixLength = 64;
+
+std::string EntryFileName(const std::string &path) {
+  return absl::StrCat(absl::Hex(Fingerprint(path), absl::kZeroPad16),
+                      ".statements.pb");
+}
+
+} // namespace
+
+StatementCache::StatementCache(const std::string &directory,
+                               const std::string &path)
+    : directory_(directory), path_(path) {
+  std::ifstream file(
+      (std::filesystem::path(directory_) / EntryFileName(path_)).string(),
+      std::ios::in | std::ios::binary);
+  if (!file || !entry_.ParseFromIstream(&file) ||
+      entry_.version() != kVersion || entry_.path() != path_) {
+    entry_.Clear();
+    return;
+  }
+  for (int i = 0; i < entry_.statements_size(); ++i) {
+    const CachedStatement &statement = entry_.statements(i);
+    if (statement.segment_length() <= 0) {
+      continue;
+    }
+    const size_t prefix_length = std::min<size_t>(
+        static_cast<size_t>(statement.segment_length()), kPrefixLength);
+    prefix_lengths_.insert(prefix_length);
+    by_prefix_[{prefix_length, statement.prefix_fingerprint()}].push_back(i);
+  }
+}
+
+void StatementCache::SetSegment(absl::string_view segment, bool terminated,
+                                CachedStatement *statement) {
+  statement->set_segment_length(segment.size());
+  statement->set_terminated(terminated);
+  statement->set_segment_fingerprint(Fingerprint(segment));
+  statement->set_prefix_fingerprint(
+      Fingerprint(segment.substr(0, kPrefixLength)));
+}
+
+std::vector<const CachedStatement *>
+StatementCache::Find(absl::string_view sql, size_t position) const {
+  std::vector<const CachedStatement *> statements;
+  for (const size_t prefix_length : prefix_lengths_) {
+    if (position + prefix_length > sql.size()) {
+      break;
+    }
+    const auto it = by_prefix_.find(
+        {prefix_length, Fingerprint(sql.substr(position, prefix_length))});
+    if (it == by_prefix_.end()) {
+      continue;
+    }
+    for (const int i : it->second) {
+      const CachedStatement &statement = entry_.statements(i);
+      const size_t length = static_cast<size_t>(statement.segment_length());
+      // Text appended to an unterminated statement extends it.
+      if (!statement.terminated() && position + length != sql.size()) {
+        continue;
+      }
+      if (position + length <= sql.size() &&
+          Fingerprint(sql.substr(position, length)) ==
+              statement.segment_fingerprint()) {
+        statements.push_back(&statement);
+      }
+    }
+  }
+  return statements;
+}
+
+absl::Status
+StatementCache::Store(const std::vector<CachedStatement> &statements) const {
+  StatementCacheEntry entry;
+  entry.set_version(kVersion);
+  entry.set_path(path_);
+  for (const CachedStatement &statement : statements) {
+    *entry.add_statements() = statement;
+  }
+  return WriteCacheFile(directory_, EntryFileName(path_), entry);
+}
+
+} // namespace alphasql
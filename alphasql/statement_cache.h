@@ -0,0 +1,75 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_STATEMENT_CACHE_H_
+#define ALPHASQL_STATEMENT_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/strings/string_view.h"
+#include "alphasql/proto/alphasql_service.pb.h"
+#include "zetasql/base/status.h"
+
+namespace alphasql {
+
+// Identifier information of the top-level statements of a SQL file, cached
+// across alphadag runs in one entry per file in a directory.
+//
+// A statement is keyed by its segment, the text from the end of the previous
+// statement to its own end, so it keeps its entry when statements before it
+// are edited, inserted or removed. The last statement of a file may lack its
+// semicolon, so its segment only matches where the text ends with it.
+// Validating what the statement read from earlier statements is up to the
+// caller.
+class StatementCache {
+public:
+  // Loads the entry of the file at <path> in <directory>, if any.
+  StatementCache(const std::string &directory, const std::string &path);
+  StatementCache(const StatementCache &) = delete;
+  StatementCache &operator=(const StatementCache &) = delete;
+
+  // Sets the segment fields of <statement>. <terminated> tells whether the
+  // segment ends with the semicolon of the statement.
+  static void SetSegment(absl::string_view segment, bool terminated,
+                         CachedStatement *statement);
+
+  // Cached statements whose segment starts at <position> of <sql>.
+  std::vector<const CachedStatement *> Find(absl::string_view sql,
+                                            size_t position) const;
+
+  // Replaces the entry of the file with <statements>.
+  absl::Status Store(const std::vector<CachedStatement> &statements) const;
+
+private:
+  const std::string directory_;
+  const std::string path_;
+  StatementCacheEntry entry_;
+  // Lengths of the prefixes statements are indexed by, and the indices of
+  // statements keyed by the length and the fingerprint of their prefix.
+  std::set<size_t> prefix_lengths_;
+  absl::flat_hash_map<std::pair<size_t, uint64_t>, std::vector<int>>
+      by_prefix_;
+};
+
+} // namespace alphasql
+
+#endif // ALPHASQL_STATEMENT_CACHE_H_
@@ -0,0 +1,115 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/statement_cache.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+namespace alphasql {
+namespace {
+
+CachedStatement MakeStatement(absl::string_view segment,
+                              const std::string &created,
+                              bool terminated = true) {
+  CachedStatement statement;
+  StatementCache::SetSegment(segment, terminated, &statement);
+  statement.set_context_fingerprint(0);
+  statement.set_procedure_fingerprint(0);
+  statement.add_created_tables()->add_names(created);
+  return statement;
+}
+
+TEST(StatementCache, FindsStatementsAfterEditedOnes) {
+  const std::string directory =
+      absl::StrCat(testing::TempDir(), "/statement_cache_edit");
+  const std::string first = "CREATE TABLE a AS SELECT 1 AS x;";
+  const std::string second = "\nCREATE TABLE b AS SELECT x FROM a;";
+  {
+    const StatementCache cache(directory, "test.sql");
+    ASSERT_TRUE(cache.Store({MakeStatement(first, "a"),
+                             MakeStatement(second, "b")})
+                    .ok());
+  }
+
+  const StatementCache cache(directory, "test.sql");
+  const std::string edited_first = "CREATE TABLE a AS SELECT 2 AS x;";
+  const std::string sql = edited_first + second;
+  ASSERT_TRUE(cache.Find(sql, 0).empty());
+  const auto statements = cache.Find(sql, edited_first.size());
+  ASSERT_EQ(statements.size(), 1u);
+  ASSERT_EQ(statements[0]->created_tables(0).names(0), "b");
+  ASSERT_EQ(static_cast<size_t>(statements[0]->segment_length()),
+            second.size());
+}
+
+TEST(StatementCache, LongSegmentsNeedTheWholeText) {
+  const std::string directory =
+      absl::StrCat(testing::TempDir(), "/statement_cache_long");
+  const std::string statement =
+      absl::StrCat("SELECT ", std::string(100, 'x'), " FROM t;");
+  {
+    const StatementCache cache(directory, "test.sql");
+    ASSERT_TRUE(cache.Store({MakeStatement(statement, "t")}).ok());
+  }
+
+  const StatementCache cache(directory, "test.sql");
+  ASSERT_EQ(cache.Find(statement, 0).size(), 1u);
+  std::string changed_tail = statement;
+  changed_tail[changed_tail.size() - 2] = 'u';
+  ASSERT_TRUE(cache.Find(changed_tail, 0).empty());
+  ASSERT_TRUE(cache.Find(statement.substr(0, 80), 0).empty());
+}
+
+TEST(StatementCache, UnterminatedStatementsOnlyMatchAtTheEnd) {
+  const std::string directory =
+      absl::StrCat(testing::TempDir(), "/statement_cache_unterminated");
+  const std::string first = "CREATE TABLE a AS SELECT 1 AS x;";
+  const std::string last = "\nSELECT x FROM a";
+  {
+    const StatementCache cache(directory, "test.sql");
+    ASSERT_TRUE(cache.Store({MakeStatement(first, "a"),
+                             MakeStatement(last, "b", /*terminated=*/false)})
+                    .ok());
+  }
+
+  const StatementCache cache(directory, "test.sql");
+  ASSERT_EQ(cache.Find(first + last, first.size()).size(), 1u);
+  // The statement goes on, so its old text is only a prefix of it.
+  ASSERT_TRUE(cache.Find(first + last + " WHERE x > 0", first.size()).empty());
+  ASSERT_TRUE(cache.Find(first + last + ";", first.size()).empty());
+  // Terminated statements still match when statements are appended.
+  ASSERT_EQ(cache.Find(first + last, 0).size(), 1u);
+}
+
+TEST(StatementCache, EntriesArePerFile) {
+  const std::string directory =
+      absl::StrCat(testing::TempDir(), "/statement_cache_files");
+  const std::string statement = "SELECT 1;";
+  {
+    const StatementCache cache(directory, "a.sql");
+    ASSERT_TRUE(cache.Store({MakeStatement(statement, "t")}).ok());
+  }
+
+  ASSERT_EQ(StatementCache(directory, "a.sql").Find(statement, 0).size(), 1u);
+  ASSERT_TRUE(StatementCache(directory, "b.sql").Find(statement, 0).empty());
+}
+
+} // namespace
+} // namespace alphasql
@@ -0,0 +1,134 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/statement_profiler.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <system_error>
+#include <tuple>
+
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_replace.h"
+
+namespace alphasql {
+
+namespace {
+
+std::string CSVField(const std::string &field) {
+  if (field.find_first_of(",\"\n") == std::string::npos) {
+    return field;
+  }
+  return absl::StrCat("\"", absl::StrReplaceAll(field, {{"\"", "\"\""}}),
+                      "\"");
+}
+
+} // namespace
+
+void StatementProfiler::AddStatement(const StatementProfile &profile) {
+  absl::MutexLock l(&mutex_);
+  statements_.push_back(profile);
+}
+
+void StatementProfiler::AddScriptParse(const std::string &path,
+                                       absl::Duration parse_time) {
+  absl::MutexLock l(&mutex_);
+  scripts_.push_back({path, 1, 1, "Script", parse_time, absl::ZeroDuration(),
+                      /*resolved_nodes=*/0, /*arena_bytes=*/0});
+}
+
+std::vector<StatementProfile> StatementProfiler::Slowest(size_t n) const {
+  std::vector<StatementProfile> slowest;
+  {
+    absl::MutexLock l(&mutex_);
+    slowest = statements_;
+  }
+  // Ties are broken by location, since files are checked concurrently.
+  auto is_slower = [](const StatementProfile &a, const StatementProfile &b) {
+    const absl::Duration time_a = a.parse_time + a.analysis_time;
+    const absl::Duration time_b = b.parse_time + b.analysis_time;
+    if (time_a != time_b) {
+      return time_a > time_b;
+    }
+    return std::tie(a.path, a.line, a.column) <
+           std::tie(b.path, b.line, b.column);
+  };
+  n = std::min(n, slowest.size());
+  std::partial_sort(slowest.begin(), slowest.begin() + n, slowest.end(),
+                    is_slower);
+  slowest.resize(n);
+  return slowest;
+}
+
+ProfileSummary StatementProfiler::Summary() const {
+  ProfileSummary summary;
+  absl::MutexLock l(&mutex_);
+  for (const StatementProfile &profile : statements_) {
+    ++summary.statements;
+    summary.parse_time += profile.parse_time;
+    summary.analysis_time += profile.analysis_time;
+  }
+  for (const StatementProfile &profile : scripts_) {
+    summary.parse_time += profile.parse_time;
+  }
+  return summary;
+}
+
+bool StatementProfiler::WriteCSV(const std::string &output_path) const {
+  const std::filesystem::path parent =
+      std::filesystem::path(output_path).parent_path();
+  if (!parent.empty() && !std::filesystem::is_directory(parent)) {
+    std::error_code ec;
+    std::filesystem::create_directories(parent, ec);
+  }
+  std::ofstream out(output_path);
+  if (!out) {
+    return false;
+  }
+  out << "path,line,column,kind,parse_us,analysis_us,resolved_nodes,"
+         "arena_bytes\n";
+  absl::MutexLock l(&mutex_);
+  for (const auto *profiles : {&scripts_, &statements_}) {
+    for (const StatementProfile &profile : *profiles) {
+      out << CSVField(profile.path) << "," << profile.line << ","
+          << profile.column << "," << profile.kind << ","
+          << absl::ToInt64Microseconds(profile.parse_time) << ","
+          << absl::ToInt64Microseconds(profile.analysis_time) << ","
+          << profile.resolved_nodes << "," << profile.arena_bytes << "\n";
+    }
+  }
+  return static_cast<bool>(out);
+}
+
+int64_t
+StatementProfiler::CountResolvedNodes(const zetasql::ResolvedNode *node) {
+  int64_t count = 0;
+  std::vector<const zetasql::ResolvedNode *> stack = {node};
+  std::vector<const zetasql::ResolvedNode *> children;
+  while (!stack.empty()) {
+    const zetasql::ResolvedNode *current = stack.back();
+    stack.pop_back();
+    ++count;
+    children.clear();
+    current->GetChildNodes(&children);
+    stack.insert(stack.end(), children.begin(), children.end());
+  }
+  return count;
+}
+
+} // namespace alphasql
@@ -0,0 +1,85 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_STATEMENT_PROFILER_H_
+#define ALPHASQL_STATEMENT_PROFILER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "absl/time/time.h"
+#include "zetasql/resolved_ast/resolved_node.h"
+
+namespace alphasql {
+
+// What checking one statement took.
+struct StatementProfile {
+  std::string path;
+  int line;
+  int column;
+  // Kind of the statement, such as QueryStatement.
+  std::string kind;
+  // Zero unless the statement was parsed on its own.
+  absl::Duration parse_time;
+  absl::Duration analysis_time;
+  int64_t resolved_nodes;
+  // Growth of the analyzer arena, in whole blocks.
+  int64_t arena_bytes;
+};
+
+// Totals of everything profiled.
+struct ProfileSummary {
+  int64_t statements = 0;
+  absl::Duration parse_time;
+  absl::Duration analysis_time;
+};
+
+// Collects how long each statement took to parse and analyze, to find the
+// ones slowing the check down, such as those calling heavy templated
+// functions. Files parsed at once are profiled as a whole, since their
+// statements can not be timed on their own. This class is thread-safe.
+class StatementProfiler {
+public:
+  void AddStatement(const StatementProfile &profile);
+
+  // Adds the time taken to parse the whole file at <path>.
+  void AddScriptParse(const std::string &path, absl::Duration parse_time);
+
+  // The <n> statements that took longest to parse and analyze, slowest
+  // first.
+  std::vector<StatementProfile> Slowest(size_t n) const;
+
+  ProfileSummary Summary() const;
+
+  // Writes every statement, and every file parsed at once as a row of kind
+  // Script, to <output_path> in CSV with times in microseconds. Returns false
+  // if it can not be written.
+  bool WriteCSV(const std::string &output_path) const;
+
+  // Number of nodes of the tree rooted at <node>.
+  static int64_t CountResolvedNodes(const zetasql::ResolvedNode *node);
+
+private:
+  mutable absl::Mutex mutex_;
+  std::vector<StatementProfile> statements_ ABSL_GUARDED_BY(mutex_);
+  std::vector<StatementProfile> scripts_ ABSL_GUARDED_BY(mutex_);
+};
+
+} // namespace alphasql
+
+#endif // ALPHASQL_STATEMENT_PROFILER_H_
@@ -0,0 +1,88 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/statement_profiler.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include "gtest/gtest.h"
+
+namespace alphasql {
+namespace {
+
+StatementProfile Profile(const std::string &path, int line,
+                         int64_t analysis_ms) {
+  return {path,
+          line,
+          /*column=*/1,
+          "QueryStatement",
+          absl::ZeroDuration(),
+          absl::Milliseconds(analysis_ms),
+          /*resolved_nodes=*/3,
+          /*arena_bytes=*/4096};
+}
+
+TEST(StatementProfiler, SlowestFirst) {
+  StatementProfiler profiler;
+  profiler.AddStatement(Profile("a.sql", 1, 5));
+  profiler.AddStatement(Profile("b.sql", 1, 20));
+  profiler.AddStatement(Profile("a.sql", 3, 10));
+  profiler.AddStatement(Profile("c.sql", 1, 10));
+
+  const auto slowest = profiler.Slowest(3);
+  ASSERT_EQ(slowest.size(), 3);
+  EXPECT_EQ(slowest[0].path, "b.sql");
+  EXPECT_EQ(slowest[1].path, "a.sql");
+  EXPECT_EQ(slowest[1].line, 3);
+  EXPECT_EQ(slowest[2].path, "c.sql");
+  EXPECT_EQ(profiler.Slowest(10).size(), 4);
+}
+
+TEST(StatementProfiler, Summary) {
+  StatementProfiler profiler;
+  profiler.AddScriptParse("a.sql", absl::Milliseconds(2));
+  profiler.AddStatement(Profile("a.sql", 1, 5));
+  profiler.AddStatement(Profile("a.sql", 2, 7));
+
+  const ProfileSummary summary = profiler.Summary();
+  EXPECT_EQ(summary.statements, 2);
+  EXPECT_EQ(summary.parse_time, absl::Milliseconds(2));
+  EXPECT_EQ(summary.analysis_time, absl::Milliseconds(12));
+}
+
+TEST(StatementProfiler, WriteCSV) {
+  StatementProfiler profiler;
+  profiler.AddScriptParse("a,b.sql", absl::Microseconds(30));
+  profiler.AddStatement(Profile("a,b.sql", 2, 1));
+
+  const std::string path =
+      std::string(testing::TempDir()) + "/statement_profile.csv";
+  ASSERT_TRUE(profiler.WriteCSV(path));
+  std::ifstream file(path);
+  std::stringstream csv;
+  csv << file.rdbuf();
+  EXPECT_EQ(csv.str(),
+            "path,line,column,kind,parse_us,analysis_us,resolved_nodes,"
+            "arena_bytes\n"
+            "\"a,b.sql\",1,1,Script,30,0,0,0\n"
+            "\"a,b.sql\",2,1,QueryStatement,0,1000,3,4096\n");
+  std::remove(path.c_str());
+}
+
+} // namespace
+} // namespace alphasql
@@ -0,0 +1,70 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/table_evictor.h"
+
+#include <string>
+#include <vector>
+
+namespace alphasql {
+
+TableEvictor::TableEvictor(const std::vector<std::vector<size_t>> &upstreams,
+                           UpstreamLayers *layers)
+    : upstreams_(upstreams), layers_(layers),
+      pending_downstreams_(upstreams.size(), 0),
+      pinned_(upstreams.size(), false), tables_(upstreams.size()) {
+  for (const std::vector<size_t> &file_upstreams : upstreams) {
+    for (const size_t upstream : file_upstreams) {
+      ++pending_downstreams_[upstream];
+    }
+  }
+}
+
+void TableEvictor::AddFile(size_t i, const LayeredCatalog &file_layer) {
+  absl::MutexLock l(&mutex_);
+  for (const auto &[key, table] : file_layer.layer_tables()) {
+    if (table != nullptr) {
+      tables_[i].push_back(key);
+    }
+  }
+  if (file_layer.layer_has_routines()) {
+    pinned_[i] = true;
+    for (const size_t upstream : upstreams_[i]) {
+      pinned_[upstream] = true;
+    }
+  }
+}
+
+void TableEvictor::FinishFile(size_t i) {
+  absl::MutexLock l(&mutex_);
+  MaybeEvict(i);
+  for (const size_t upstream : upstreams_[i]) {
+    --pending_downstreams_[upstream];
+    MaybeEvict(upstream);
+  }
+}
+
+void TableEvictor::MaybeEvict(size_t i) {
+  if (pending_downstreams_[i] > 0 || pinned_[i]) {
+    return;
+  }
+  for (const std::string &key : tables_[i]) {
+    layers_->layer(i)->EvictTable(key);
+  }
+  tables_[i].clear();
+}
+
+} // namespace alphasql
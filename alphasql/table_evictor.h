@@ -0,0 +1,69 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_TABLE_EVICTOR_H_
+#define ALPHASQL_TABLE_EVICTOR_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/synchronization/mutex.h"
+#include "alphasql/layered_catalog.h"
+
+namespace alphasql {
+
+// Frees the tables created by files once no file left to process can read
+// them, so that the catalog only holds the tables of the files in progress
+// and of their direct upstreams, instead of every table of the pipeline.
+//
+// alphadag links every file reading a table to the file creating it, so the
+// tables of a file are dead once all of its direct downstream files finished.
+// Templated functions, TVFs and procedures are resolved where they are
+// called, possibly by files that do not depend on the tables they read, so
+// the tables of a file creating any and of its direct upstreams are kept
+// until the end. This class is thread-safe.
+class TableEvictor {
+public:
+  // <upstreams> is the DAG as given to RunDAG. Tables are evicted from the
+  // layers of <layers>, which files are committed to and must outlive this.
+  TableEvictor(const std::vector<std::vector<size_t>> &upstreams,
+               UpstreamLayers *layers);
+
+  // Records the tables <file_layer> creates for file <i>. Must be called
+  // right before <file_layer> is committed.
+  void AddFile(size_t i, const LayeredCatalog &file_layer);
+
+  // Evicts the tables that became dead once file <i> finished, whether it
+  // succeeded or not.
+  void FinishFile(size_t i);
+
+private:
+  void MaybeEvict(size_t i) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  const std::vector<std::vector<size_t>> &upstreams_;
+  UpstreamLayers *const layers_; // Not owned.
+
+  absl::Mutex mutex_;
+  // Direct downstream files of each file that did not finish yet.
+  std::vector<int> pending_downstreams_ ABSL_GUARDED_BY(mutex_);
+  std::vector<bool> pinned_ ABSL_GUARDED_BY(mutex_);
+  // Keys of the tables each file committed.
+  std::vector<std::vector<std::string>> tables_ ABSL_GUARDED_BY(mutex_);
+};
+
+} // namespace alphasql
+
+#endif // ALPHASQL_TABLE_EVICTOR_H_
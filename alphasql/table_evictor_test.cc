@@ -0,0 +1,121 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/table_evictor.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "alphasql/layered_catalog.h"
+#include "gtest/gtest.h"
+#include "zetasql/public/function.h"
+#include "zetasql/public/simple_catalog.h"
+#include "zetasql/public/types/type_factory.h"
+
+namespace alphasql {
+namespace {
+
+using namespace zetasql;
+
+class TableEvictorTest : public ::testing::Test {
+protected:
+  TableEvictorTest()
+      : base_("base", &type_factory_),
+        schema_layer_("catalog", &base_, &type_factory_) {}
+
+  // Commits a file creating <table_name>, and a function if
+  // <creates_function>.
+  void RunFile(UpstreamLayers *layers, TableEvictor *evictor, size_t i,
+               const std::string &table_name, bool creates_function = false) {
+    LayeredCatalog file_layer(layers->layer(i));
+    file_layer.AddOwnedTable(new SimpleTable(table_name));
+    if (creates_function) {
+      file_layer.AddOwnedFunction(
+          new Function(absl::StrCat("f", i), "test", Function::SCALAR));
+    }
+    evictor->AddFile(i, file_layer);
+    file_layer.Commit();
+    layers->Publish(i);
+    evictor->FinishFile(i);
+  }
+
+  // Whether file <i> still holds the table it created as <table_name>.
+  bool HasTable(const UpstreamLayers &layers, size_t i,
+                const std::string &table_name) {
+    for (const auto &[key, table] : layers.layer(i)->layer_tables()) {
+      if (key == table_name && table != nullptr) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  TypeFactory type_factory_;
+  SimpleCatalog base_;
+  LayeredCatalog schema_layer_;
+};
+
+// 0 -> 1, 0 -> 2, 1 -> 3
+const std::vector<std::vector<size_t>> kUpstreams = {{}, {0}, {0}, {1}};
+
+TEST_F(TableEvictorTest, EvictsAfterLastDownstream) {
+  UpstreamLayers layers(kUpstreams, &schema_layer_);
+  TableEvictor evictor(kUpstreams, &layers);
+  RunFile(&layers, &evictor, 0, "t0");
+  ASSERT_TRUE(HasTable(layers, 0, "t0"));
+  RunFile(&layers, &evictor, 1, "t1");
+  ASSERT_TRUE(HasTable(layers, 0, "t0"));
+  ASSERT_TRUE(HasTable(layers, 1, "t1"));
+  RunFile(&layers, &evictor, 2, "t2");
+  ASSERT_FALSE(HasTable(layers, 0, "t0"));
+  // Nothing reads tables of files without downstream files.
+  ASSERT_FALSE(HasTable(layers, 2, "t2"));
+  ASSERT_TRUE(HasTable(layers, 1, "t1"));
+  RunFile(&layers, &evictor, 3, "t3");
+  ASSERT_FALSE(HasTable(layers, 1, "t1"));
+  ASSERT_FALSE(HasTable(layers, 3, "t3"));
+}
+
+TEST_F(TableEvictorTest, KeepsTablesRoutinesMayRead) {
+  UpstreamLayers layers(kUpstreams, &schema_layer_);
+  TableEvictor evictor(kUpstreams, &layers);
+  RunFile(&layers, &evictor, 0, "t0");
+  RunFile(&layers, &evictor, 1, "t1", /*creates_function=*/true);
+  RunFile(&layers, &evictor, 2, "t2");
+  RunFile(&layers, &evictor, 3, "t3");
+  ASSERT_TRUE(HasTable(layers, 0, "t0"));
+  ASSERT_TRUE(HasTable(layers, 1, "t1"));
+  ASSERT_FALSE(HasTable(layers, 2, "t2"));
+  ASSERT_FALSE(HasTable(layers, 3, "t3"));
+}
+
+TEST_F(TableEvictorTest, KeepsTablesReplacedDownstream) {
+  // 0 -> 1 -> 2
+  const std::vector<std::vector<size_t>> upstreams = {{}, {0}, {1}};
+  UpstreamLayers layers(upstreams, &schema_layer_);
+  TableEvictor evictor(upstreams, &layers);
+  RunFile(&layers, &evictor, 0, "t");
+  RunFile(&layers, &evictor, 1, "t");
+  // File 0 is done, but file 2 reads the table of file 1.
+  ASSERT_FALSE(HasTable(layers, 0, "t"));
+  ASSERT_TRUE(HasTable(layers, 1, "t"));
+  RunFile(&layers, &evictor, 2, "u");
+  ASSERT_FALSE(HasTable(layers, 1, "t"));
+}
+
+} // namespace
+} // namespace alphasql
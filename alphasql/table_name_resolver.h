@@ -1,11 +1,15 @@
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <initializer_list>
 #include <memory>
 #include <set>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/str_cat.h"
 #include "zetasql/base/case.h"
 #include "zetasql/base/logging.h"
 #include "zetasql/base/map_util.h"
@@ -25,7 +29,10 @@
 #include "zetasql/resolved_ast/resolved_ast.h"
 #include "zetasql/resolved_ast/resolved_node_kind.pb.h"
 
+#include "alphasql/alias_scopes.h"
 #include "alphasql/common_lib.h"
+#include "alphasql/diagnostics.h"
+#include "alphasql/node_observer.h"
 
 // TODO This implementation probably doesn't cover all edge cases for
 // table name extraction.  It should be tested more and tuned for the final
@@ -72,95 +79,160 @@ public:
 
   absl::Status FindInStatement(const ASTStatement *statement);
 
+  // Reports every node of the statements traversed by FindInStatement to
+  // <observer>, once, so that it does not have to traverse them again.
+  // <observer> must outlive the created TableNameResolver.
+  void set_observer(NodeObserver *observer) { observer_ = observer; }
+
 private:
-  typedef std::set<std::string> AliasSet; // Always lowercase.
+  // A step of the traversal. The methods below do not call each other for
+  // the parts of a node left to traverse but append tasks for them to
+  // <then>, in order, which Traverse runs from an explicit stack, so that
+  // machine-generated SQL with thousands of nested subqueries, joins or
+  // expressions can not exhaust the call stack.
+  struct Task {
+    enum Kind {
+      kScriptNode,
+      kStatement,
+      kLeaveStatement,
+      kQuery,
+      kQueryExpression,
+      kTableExpression,
+      kTVF,
+      kExpressionNode,
+      kRestUnder,
+      kLeaveNode,
+      // Add the ASTIdentifier <node> to the top scope.
+      kAddLocalAlias,
+      kAddVisibleAlias,
+      // Close the scope <scope>, which is on top.
+      kCloseLocalScope,
+      kCloseVisibleScope,
+      kMergeVisibleScope,
+      // Unhide the visible scopes from <scope> to <last>.
+      kUnhideVisibleScopes,
+      kClearRecursiveViewName,
+    };
+
+    Kind kind;
+    const ASTNode *node = nullptr;
+    const ASTOrderBy *order_by = nullptr;
+    // The external scope of table expressions, see FindInTableExpression.
+    size_t scope = 0;
+    size_t last = 0;
+  };
+  using Tasks = std::vector<Task>;
+
+  // Runs <root> and the tasks it appends, depth first.
+  absl::Status Traverse(const Task &root);
+  absl::Status RunTask(const Task &task, Tasks *then);
 
   std::map<ResolvedNodeKind, TableNamesSet> _node_kind_to_table_names;
 
   // Consumes either an ASTScript, ASTStatementList, or ASTScriptStatement.
-  absl::Status FindInScriptNode(const ASTNode *node);
+  void FindInScriptNode(const ASTNode *node, Tasks *then);
+
+  absl::Status FindInStatement(const ASTStatement *statement, Tasks *then);
+
+  // Finds table names in the parts of <statement> specific to its kind.
+  absl::Status FindInStatementByKind(const ASTStatement *statement,
+                                     Tasks *then);
 
-  absl::Status FindInQueryStatement(const ASTQueryStatement *statement);
+  absl::Status FindInQueryStatement(const ASTQueryStatement *statement,
+                                    Tasks *then);
 
   absl::Status
-  FindInCreateViewStatement(const ASTCreateViewStatement *statement);
+  FindInCreateViewStatement(const ASTCreateViewStatement *statement,
+                            Tasks *then);
 
   absl::Status FindInCreateMaterializedViewStatement(
-      const ASTCreateMaterializedViewStatement *statement);
+      const ASTCreateMaterializedViewStatement *statement, Tasks *then);
 
   absl::Status FindInCreateTableFunctionStatement(
-      const ASTCreateTableFunctionStatement *statement);
+      const ASTCreateTableFunctionStatement *statement, Tasks *then);
 
   absl::Status
-  FindInExportDataStatement(const ASTExportDataStatement *statement);
+  FindInExportDataStatement(const ASTExportDataStatement *statement,
+                            Tasks *then);
 
-  absl::Status FindInDeleteStatement(const ASTDeleteStatement *statement);
+  absl::Status FindInDeleteStatement(const ASTDeleteStatement *statement,
+                                     Tasks *then);
 
-  absl::Status FindInTruncateStatement(const ASTTruncateStatement *statement);
+  absl::Status FindInTruncateStatement(const ASTTruncateStatement *statement,
+                                       Tasks *then);
 
-  absl::Status FindInInsertStatement(const ASTInsertStatement *statement);
+  absl::Status FindInInsertStatement(const ASTInsertStatement *statement,
+                                     Tasks *then);
 
-  absl::Status FindInUpdateStatement(const ASTUpdateStatement *statement);
+  absl::Status FindInUpdateStatement(const ASTUpdateStatement *statement,
+                                     Tasks *then);
 
-  absl::Status FindInMergeStatement(const ASTMergeStatement *statement);
+  absl::Status FindInMergeStatement(const ASTMergeStatement *statement,
+                                    Tasks *then);
 
-  // 'visible_aliases' includes things like the table name we are inserting
-  // into or deleting from.  It does *not* include WITH table aliases or TVF
-  // table-valued argument names (which are both tracked separately in
-  // 'local_table_aliases_').
-  absl::Status FindInQuery(const ASTQuery *query,
-                           const AliasSet &visible_aliases);
+  // Range variables visible in <visible_aliases_> include things like the
+  // table name we are inserting into or deleting from.  They do *not* include
+  // WITH table aliases or TVF table-valued argument names (which are both
+  // tracked separately in 'local_table_aliases_').
+  absl::Status FindInQuery(const ASTQuery *query, Tasks *then);
 
   absl::Status FindInQueryExpression(const ASTQueryExpression *query_expr,
-                                     const ASTOrderBy *order_by,
-                                     const AliasSet &visible_aliases);
+                                     const ASTOrderBy *order_by, Tasks *then);
 
   absl::Status FindInSelect(const ASTSelect *select, const ASTOrderBy *order_by,
-                            const AliasSet &orig_visible_aliases);
+                            Tasks *then);
 
-  absl::Status FindInSetOperation(const ASTSetOperation *set_operation,
-                                  const AliasSet &visible_aliases);
+  void FindInSetOperation(const ASTSetOperation *set_operation, Tasks *then);
 
-  // When resolving the FROM clause, <external_visible_aliases> is the set
-  // of names visible in the query without any names from the FROM clause
-  // (excluding WITH names and TVF table-valued argument names).
-  // <local_visible_aliases> includes all names visible in
-  // <external_visible_alaises> plus names earlier in the same FROM clause
-  // that are visible.  See corresponding methods in resolver.cc.
+  // When resolving the FROM clause, the names in <visible_aliases_> from
+  // <external_scope> up are the names earlier in the same FROM clause, which
+  // are visible to table paths but not to table subqueries.  Names in the FROM
+  // clause are added to the top scope.  See corresponding methods in
+  // resolver.cc.
   absl::Status FindInTableExpression(const ASTTableExpression *table_expr,
-                                     const AliasSet &external_visible_aliases,
-                                     AliasSet *local_visible_aliases);
+                                     size_t external_scope, Tasks *then);
 
-  absl::Status FindInJoin(const ASTJoin *join,
-                          const AliasSet &external_visible_aliases,
-                          AliasSet *local_visible_aliases);
+  void FindInJoin(const ASTJoin *join, size_t external_scope, Tasks *then);
 
-  absl::Status
-  FindInParenthesizedJoin(const ASTParenthesizedJoin *parenthesized_join,
-                          const AliasSet &external_visible_aliases,
-                          AliasSet *local_visible_aliases);
+  void FindInParenthesizedJoin(const ASTParenthesizedJoin *parenthesized_join,
+                               size_t external_scope, Tasks *then);
 
-  absl::Status FindInTVF(const ASTTVF *tvf,
-                         const AliasSet &external_visible_aliases,
-                         AliasSet *local_visible_aliases);
+  void FindInTVF(const ASTTVF *tvf, size_t external_scope, Tasks *then);
 
   absl::Status FindInTableSubquery(const ASTTableSubquery *table_subquery,
-                                   const AliasSet &external_visible_aliases,
-                                   AliasSet *local_visible_aliases);
+                                   size_t external_scope, Tasks *then);
 
   absl::Status
   FindInTablePathExpression(const ASTTablePathExpression *table_ref,
-                            AliasSet *visible_aliases);
+                            Tasks *then);
 
-  // Traverse all expressions attached as descendants of <root>.
+  // Traverse all expressions attached as descendants of <root>, down to the
+  // outermost queries, which are handed to FindInQuery. TABLE clauses are
+  // left to FindInTVF, so that nested TVFs are not walked again.
   // Unlike other methods above, may be called with NULL.
-  absl::Status FindInExpressionsUnder(const ASTNode *root,
-                                      const AliasSet &visible_aliases);
-
-  // Traverse all options_list node as descendants of <root>.
-  // May be called with NULL.
-  absl::Status FindInOptionsListUnder(const ASTNode *root,
-                                      const AliasSet &visible_aliases);
+  void FindInExpressionsUnder(const ASTNode *root, Tasks *then);
+  absl::Status FindInExpressionNode(const ASTNode *node, Tasks *then);
+
+  // Calls FindInExpressionsUnder on the children of <node> but <handled>,
+  // which covers clauses that can not reference tables but may still hold
+  // nodes for the observer.
+  void FindInOtherChildren(const ASTNode *node,
+                           std::initializer_list<const ASTNode *> handled,
+                           Tasks *then);
+
+  // Traverse the descendants of <root> left untraversed by the methods above.
+  // Options lists are searched for table names, and the rest is only
+  // reported to the observer, so without one only options lists are looked
+  // for, which queries and expressions can not hold.
+  void FindInRestUnder(const ASTNode *root, Tasks *then);
+
+  // Report <node> to <observer_> unless an ancestor was declined by it.
+  void EnterNode(const ASTNode *node);
+  void LeaveNode(const ASTNode *node);
+
+  // Emits a warning for <status>, made at the node that can not be handled,
+  // whose table names may then be missed.
+  void Warn(const absl::Status &status) const;
 
   // Root level SQL statement we are extracting table names or temporal
   // references from.
@@ -187,47 +259,152 @@ private:
   // across recursive calls.
   TableResolutionTimeInfoMap *table_resolution_time_info_map_ = nullptr;
 
+  // The range variables visible at the current point of the statement.
+  AliasScopes visible_aliases_;
+
   // The set of local table aliases, including TVF table-valued argument
   // aliases and in-scope WITH aliases.
-  AliasSet local_table_aliases_;
+  AliasScopes local_table_aliases_;
 
   // When inside a CREATE RECURSIVE VIEW statement, the name of the view; such
   // names should be treated similar to a WITH alias and not be considered an
   // external reference. In all other cases, this field is an empty vector.
   std::vector<std::string> recursive_view_name_;
+
+  NodeObserver *observer_ = nullptr; // Not owned.
+
+  // The number of entered nodes inside a node declined by <observer_>.
+  int unobserved_depth_ = 0;
+
+  // The roots of the subtrees of the current top-level statement already
+  // traversed, so that FindInRestUnder leaves them out.
+  absl::flat_hash_set<const ASTNode *> traversed_;
+  int statement_depth_ = 0;
 };
 
 absl::Status TableNameResolver::FindTableNames(const ASTScript &script) {
-  ZETASQL_RETURN_IF_ERROR(FindInScriptNode(&script));
+  ZETASQL_RETURN_IF_ERROR(Traverse({Task::kScriptNode, &script}));
   // Sanity check - these should get popped.
   ZETASQL_RET_CHECK(local_table_aliases_.empty());
   return absl::OkStatus();
 }
 
-absl::Status TableNameResolver::FindInScriptNode(const ASTNode *node) {
+absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
+  return Traverse({Task::kStatement, statement});
+}
+
+absl::Status TableNameResolver::Traverse(const Task &root) {
+  // Only the tasks left are kept, so the stack grows with the number of
+  // pending siblings rather than with the depth of calls.
+  Tasks tasks = {root};
+  Tasks then;
+  while (!tasks.empty()) {
+    const Task task = tasks.back();
+    tasks.pop_back();
+    then.clear();
+    ZETASQL_RETURN_IF_ERROR(RunTask(task, &then));
+    tasks.insert(tasks.end(), then.rbegin(), then.rend());
+  }
+  return absl::OkStatus();
+}
+
+absl::Status TableNameResolver::RunTask(const Task &task, Tasks *then) {
+  switch (task.kind) {
+  case Task::kScriptNode:
+    FindInScriptNode(task.node, then);
+    return absl::OkStatus();
+  case Task::kStatement:
+    return FindInStatement(task.node->GetAs<ASTStatement>(), then);
+  case Task::kLeaveStatement:
+    LeaveNode(task.node);
+    if (--statement_depth_ == 0) {
+      // Nodes of freed statements may be reallocated at the same addresses.
+      traversed_.clear();
+    }
+    return absl::OkStatus();
+  case Task::kQuery:
+    return FindInQuery(task.node->GetAs<ASTQuery>(), then);
+  case Task::kQueryExpression:
+    return FindInQueryExpression(task.node->GetAs<ASTQueryExpression>(),
+                                 task.order_by, then);
+  case Task::kTableExpression:
+    return FindInTableExpression(task.node->GetAs<ASTTableExpression>(),
+                                 task.scope, then);
+  case Task::kTVF:
+    FindInTVF(task.node->GetAs<ASTTVF>(), task.scope, then);
+    return absl::OkStatus();
+  case Task::kExpressionNode:
+    return FindInExpressionNode(task.node, then);
+  case Task::kRestUnder:
+    FindInRestUnder(task.node, then);
+    return absl::OkStatus();
+  case Task::kLeaveNode:
+    LeaveNode(task.node);
+    return absl::OkStatus();
+  case Task::kAddLocalAlias:
+    local_table_aliases_.Add(task.node->GetAs<ASTIdentifier>()->GetAsString());
+    return absl::OkStatus();
+  case Task::kAddVisibleAlias:
+    visible_aliases_.Add(task.node->GetAs<ASTIdentifier>()->GetAsString());
+    return absl::OkStatus();
+  case Task::kCloseLocalScope:
+    local_table_aliases_.Close(task.scope);
+    return absl::OkStatus();
+  case Task::kCloseVisibleScope:
+    visible_aliases_.Close(task.scope);
+    return absl::OkStatus();
+  case Task::kMergeVisibleScope:
+    visible_aliases_.Close(task.scope, /*merge_into_parent=*/true);
+    return absl::OkStatus();
+  case Task::kUnhideVisibleScopes:
+    visible_aliases_.Unhide(task.scope, task.last);
+    return absl::OkStatus();
+  case Task::kClearRecursiveViewName:
+    recursive_view_name_.clear();
+    return absl::OkStatus();
+  }
+  ZETASQL_RET_CHECK_FAIL() << "Unknown task kind: " << task.kind;
+}
+
+void TableNameResolver::FindInScriptNode(const ASTNode *node, Tasks *then) {
   for (int i = 0; i < node->num_children(); ++i) {
     const ASTNode *child = node->child(i);
+    // Expressions and statements are fully handled here, so only script
+    // control flow is descended into.
     if (child->IsExpression()) {
-      ZETASQL_RETURN_IF_ERROR(
-          FindInExpressionsUnder(child, /*visible_aliases=*/{}));
+      FindInExpressionsUnder(child, then);
     } else if (child->IsSqlStatement()) {
-      ZETASQL_RETURN_IF_ERROR(FindInStatement(child->GetAs<ASTStatement>()));
+      then->push_back({Task::kStatement, child});
+    } else {
+      then->push_back({Task::kScriptNode, child});
     }
-    ZETASQL_RETURN_IF_ERROR(FindInScriptNode(child));
   }
+}
+
+absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement,
+                                                Tasks *then) {
+  traversed_.insert(statement);
+  ++statement_depth_;
+  EnterNode(statement);
+  ZETASQL_RETURN_IF_ERROR(FindInStatementByKind(statement, then));
+  // The rest of the statement, including the OPTIONS (...) clauses any type
+  // of statement may have, once the tasks above are done.
+  for (int i = 0; i < statement->num_children(); ++i) {
+    then->push_back({Task::kRestUnder, statement->child(i)});
+  }
+  then->push_back({Task::kLeaveStatement, statement});
   return absl::OkStatus();
 }
 
-absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
-  // Find table name under OPTIONS (...) clause for any type of statement.
-  ZETASQL_RETURN_IF_ERROR(
-      FindInOptionsListUnder(statement, /*visible_aliases=*/{}));
+absl::Status
+TableNameResolver::FindInStatementByKind(const ASTStatement *statement,
+                                         Tasks *then) {
   switch (statement->node_kind()) {
   case AST_QUERY_STATEMENT:
     if (analyzer_options_->language().SupportsStatementKind(
             RESOLVED_QUERY_STMT)) {
       return FindInQueryStatement(
-          static_cast<const ASTQueryStatement *>(statement));
+          static_cast<const ASTQueryStatement *>(statement), then);
     }
     break;
 
@@ -236,7 +413,8 @@ absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
             RESOLVED_EXPLAIN_STMT)) {
       const ASTExplainStatement *explain =
           static_cast<const ASTExplainStatement *>(statement);
-      return FindInStatement(explain->statement());
+      then->push_back({Task::kStatement, explain->statement()});
+      return absl::OkStatus();
     }
     break;
 
@@ -276,11 +454,11 @@ absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
       if (analyzer_options_->language().SupportsStatementKind(
               RESOLVED_CREATE_TABLE_AS_SELECT_STMT)) {
         if (create_statement->scope() == ASTCreateStatement::TEMPORARY) {
-          return FindInQuery(query, /*visible_aliases=*/{});
+          return FindInQuery(query, then);
         }
         _node_kind_to_table_names[RESOLVED_CREATE_TABLE_AS_SELECT_STMT].insert(
             create_statement->name()->ToIdentifierVector());
-        return FindInQuery(query, /*visible_aliases=*/{});
+        return FindInQuery(query, then);
       }
     }
     break;
@@ -293,21 +471,21 @@ absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
       if (query == nullptr) {
         return absl::OkStatus();
       }
-      return FindInQuery(query, /*visible_aliases=*/{});
+      return FindInQuery(query, then);
     }
     break;
   case AST_CREATE_VIEW_STATEMENT:
     if (analyzer_options_->language().SupportsStatementKind(
             RESOLVED_CREATE_VIEW_STMT)) {
       return FindInCreateViewStatement(
-          statement->GetAs<ASTCreateViewStatement>());
+          statement->GetAs<ASTCreateViewStatement>(), then);
     }
     break;
   case AST_CREATE_MATERIALIZED_VIEW_STATEMENT:
     if (analyzer_options_->language().SupportsStatementKind(
             RESOLVED_CREATE_MATERIALIZED_VIEW_STMT)) {
       return FindInCreateMaterializedViewStatement(
-          statement->GetAs<ASTCreateMaterializedViewStatement>());
+          statement->GetAs<ASTCreateMaterializedViewStatement>(), then);
     }
     break;
 
@@ -325,17 +503,17 @@ absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
           statement->GetAsOrDie<ASTCreateRowAccessPolicyStatement>();
       zetasql_base::InsertIfNotPresent(
           table_names_, stmt->target_path()->ToIdentifierVector());
-      return FindInExpressionsUnder(stmt->filter_using()->predicate(),
-                                    /*visible_aliases=*/{});
+      FindInExpressionsUnder(stmt->filter_using()->predicate(), then);
+      return absl::OkStatus();
     }
     break;
 
   case AST_CREATE_CONSTANT_STATEMENT:
     if (analyzer_options_->language().SupportsStatementKind(
             RESOLVED_CREATE_CONSTANT_STMT)) {
-      ZETASQL_RETURN_IF_ERROR(FindInExpressionsUnder(
+      FindInExpressionsUnder(
           static_cast<const ASTCreateConstantStatement *>(statement)->expr(),
-          /*visible_aliases=*/{}));
+          then);
       return absl::OkStatus();
     }
     break;
@@ -343,10 +521,10 @@ absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
   case AST_CREATE_FUNCTION_STATEMENT:
     if (analyzer_options_->language().SupportsStatementKind(
             RESOLVED_CREATE_FUNCTION_STMT)) {
-      ZETASQL_RETURN_IF_ERROR(FindInExpressionsUnder(
+      FindInExpressionsUnder(
           static_cast<const ASTCreateFunctionStatement *>(statement)
               ->sql_function_body(),
-          /*visible_aliases=*/{}));
+          then);
       return absl::OkStatus();
     }
     break;
@@ -355,7 +533,7 @@ absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
     if (analyzer_options_->language().SupportsStatementKind(
             RESOLVED_CREATE_TABLE_FUNCTION_STMT)) {
       return FindInCreateTableFunctionStatement(
-          statement->GetAs<ASTCreateTableFunctionStatement>());
+          statement->GetAs<ASTCreateTableFunctionStatement>(), then);
     }
     break;
 
@@ -370,7 +548,7 @@ absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
     if (analyzer_options_->language().SupportsStatementKind(
             RESOLVED_EXPORT_DATA_STMT)) {
       return FindInExportDataStatement(
-          statement->GetAs<ASTExportDataStatement>());
+          statement->GetAs<ASTExportDataStatement>(), then);
     }
     break;
 
@@ -457,7 +635,7 @@ absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
   case AST_DELETE_STATEMENT:
     if (analyzer_options_->language().SupportsStatementKind(
             RESOLVED_DELETE_STMT)) {
-      return FindInDeleteStatement(statement->GetAs<ASTDeleteStatement>());
+      return FindInDeleteStatement(statement->GetAs<ASTDeleteStatement>(), then);
     }
     break;
 
@@ -476,7 +654,7 @@ absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
     if (analyzer_options_->language().SupportsStatementKind(
             RESOLVED_TRUNCATE_STMT)) {
       return FindInTruncateStatement(
-          statement->GetAsOrDie<ASTTruncateStatement>());
+          statement->GetAsOrDie<ASTTruncateStatement>(), then);
     }
     break;
 
@@ -519,21 +697,21 @@ absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
   case AST_INSERT_STATEMENT:
     if (analyzer_options_->language().SupportsStatementKind(
             RESOLVED_INSERT_STMT)) {
-      return FindInInsertStatement(statement->GetAs<ASTInsertStatement>());
+      return FindInInsertStatement(statement->GetAs<ASTInsertStatement>(), then);
     }
     break;
 
   case AST_UPDATE_STATEMENT:
     if (analyzer_options_->language().SupportsStatementKind(
             RESOLVED_UPDATE_STMT)) {
-      return FindInUpdateStatement(statement->GetAs<ASTUpdateStatement>());
+      return FindInUpdateStatement(statement->GetAs<ASTUpdateStatement>(), then);
     }
     break;
 
   case AST_MERGE_STATEMENT:
     if (analyzer_options_->language().SupportsStatementKind(
             RESOLVED_MERGE_STMT)) {
-      return FindInMergeStatement(statement->GetAs<ASTMergeStatement>());
+      return FindInMergeStatement(statement->GetAs<ASTMergeStatement>(), then);
     }
     break;
 
@@ -613,7 +791,9 @@ absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
     }
     break;
   case AST_HINTED_STATEMENT:
-    return FindInStatement(statement->GetAs<ASTHintedStatement>()->statement());
+    then->push_back(
+        {Task::kStatement, statement->GetAs<ASTHintedStatement>()->statement()});
+    return absl::OkStatus();
   case AST_IMPORT_STATEMENT:
     if (analyzer_options_->language().SupportsStatementKind(
             RESOLVED_IMPORT_STMT)) {
@@ -631,9 +811,9 @@ absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
   case AST_ASSERT_STATEMENT:
     if (analyzer_options_->language().SupportsStatementKind(
             RESOLVED_ASSERT_STMT)) {
-      return FindInExpressionsUnder(
-          statement->GetAs<ASTAssertStatement>()->expr(),
-          /*visible_aliases=*/{});
+      FindInExpressionsUnder(statement->GetAs<ASTAssertStatement>()->expr(),
+                             then);
+      return absl::OkStatus();
     }
     break;
   case AST_SYSTEM_VARIABLE_ASSIGNMENT:
@@ -641,9 +821,9 @@ absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
             RESOLVED_ASSIGNMENT_STMT)) {
       // The LHS, a system variable, cannot reference any tables.  But, the
       // RHS expression can.
-      return FindInExpressionsUnder(
-          statement->GetAs<ASTSystemVariableAssignment>()->expression(),
-          /*visible_aliases=*/{});
+      FindInExpressionsUnder(
+          statement->GetAs<ASTSystemVariableAssignment>()->expression(), then);
+      return absl::OkStatus();
     }
     break;
   case AST_EXECUTE_IMMEDIATE_STATEMENT:
@@ -651,9 +831,9 @@ absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
             RESOLVED_EXECUTE_IMMEDIATE_STMT)) {
       const ASTExecuteImmediateStatement *stmt =
           statement->GetAs<ASTExecuteImmediateStatement>();
-      ZETASQL_RETURN_IF_ERROR(FindInExpressionsUnder(stmt->using_clause(),
-                                                     /*visible_aliases=*/{}));
-      return FindInExpressionsUnder(stmt->sql(), /*visible_aliases=*/{});
+      FindInExpressionsUnder(stmt->using_clause(), then);
+      FindInExpressionsUnder(stmt->sql(), then);
+      return absl::OkStatus();
     }
     break;
 
@@ -662,14 +842,14 @@ absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
     const ASTBeginEndBlock *stmt = statement->GetAs<ASTBeginEndBlock>();
     for (const ASTStatement *statement :
          stmt->statement_list_node()->statement_list()) {
-      ZETASQL_RETURN_IF_ERROR(FindInStatement(statement));
+      then->push_back({Task::kStatement, statement});
     }
     if (stmt->handler_list() != nullptr) {
       for (const ASTExceptionHandler *handler :
            stmt->handler_list()->exception_handler_list()) {
         for (const ASTStatement *statement :
              handler->statement_list()->statement_list()) {
-          ZETASQL_RETURN_IF_ERROR(FindInStatement(statement));
+          then->push_back({Task::kStatement, statement});
         }
       }
     }
@@ -679,43 +859,43 @@ absl::Status TableNameResolver::FindInStatement(const ASTStatement *statement) {
 
   const auto status = MakeSqlErrorAt(statement)
        << "Statement not supported: " << statement->GetNodeKindString();
-  std::cout << "WARNING: table name resolver may ignore some table names with the error: " << status << std::endl;
+  Warn(status);
   return absl::OkStatus();
 }
 
 absl::Status
-TableNameResolver::FindInQueryStatement(const ASTQueryStatement *statement) {
-  return FindInQuery(statement->query(), /*visible_aliases=*/{});
+TableNameResolver::FindInQueryStatement(const ASTQueryStatement *statement,
+                                        Tasks *then) {
+  return FindInQuery(statement->query(), then);
 }
 
 absl::Status TableNameResolver::FindInCreateViewStatement(
-    const ASTCreateViewStatement *statement) {
+    const ASTCreateViewStatement *statement, Tasks *then) {
   if (statement->recursive()) {
     recursive_view_name_ = statement->name()->ToIdentifierVector();
   }
-  ZETASQL_RETURN_IF_ERROR(
-      FindInQuery(statement->query(), /*visible_aliases=*/{}));
-  recursive_view_name_.clear();
+  ZETASQL_RETURN_IF_ERROR(FindInQuery(statement->query(), then));
+  then->push_back({Task::kClearRecursiveViewName});
   return absl::OkStatus();
 }
 
 absl::Status TableNameResolver::FindInCreateMaterializedViewStatement(
-    const ASTCreateMaterializedViewStatement *statement) {
+    const ASTCreateMaterializedViewStatement *statement, Tasks *then) {
   if (statement->recursive()) {
     recursive_view_name_ = statement->name()->ToIdentifierVector();
   }
-  ZETASQL_RETURN_IF_ERROR(
-      FindInQuery(statement->query(), /*visible_aliases=*/{}));
-  recursive_view_name_.clear();
+  ZETASQL_RETURN_IF_ERROR(FindInQuery(statement->query(), then));
+  then->push_back({Task::kClearRecursiveViewName});
   return absl::OkStatus();
 }
 
 absl::Status TableNameResolver::FindInCreateTableFunctionStatement(
-    const ASTCreateTableFunctionStatement *statement) {
+    const ASTCreateTableFunctionStatement *statement, Tasks *then) {
   if (statement->query() == nullptr) {
     return absl::OkStatus();
   }
   ZETASQL_RET_CHECK(local_table_aliases_.empty());
+  const size_t parameters = local_table_aliases_.Open();
   for (const ASTFunctionParameter *const parameter :
        statement->function_declaration()->parameters()->parameter_entries()) {
     if (parameter->name() == nullptr) {
@@ -727,304 +907,271 @@ absl::Status TableNameResolver::FindInCreateTableFunctionStatement(
         (parameter->IsTemplated() &&
          parameter->templated_parameter_type()->kind() ==
              ASTTemplatedParameterType::ANY_TABLE)) {
-      zetasql_base::InsertIfNotPresent(&local_table_aliases_,
-                                       parameter->name()->GetAsString());
+      local_table_aliases_.Add(parameter->name()->GetAsString());
     }
   }
-  ZETASQL_RETURN_IF_ERROR(
-      FindInQuery(statement->query(), /*visible_aliases=*/{}));
-  local_table_aliases_.clear();
+  ZETASQL_RETURN_IF_ERROR(FindInQuery(statement->query(), then));
+  then->push_back({Task::kCloseLocalScope, nullptr, nullptr, parameters});
   return absl::OkStatus();
 }
 
 absl::Status TableNameResolver::FindInExportDataStatement(
-    const ASTExportDataStatement *statement) {
-  return FindInQuery(statement->query(), /*visible_aliases=*/{});
+    const ASTExportDataStatement *statement, Tasks *then) {
+  return FindInQuery(statement->query(), then);
 }
 
 absl::Status
-TableNameResolver::FindInDeleteStatement(const ASTDeleteStatement *statement) {
+TableNameResolver::FindInDeleteStatement(const ASTDeleteStatement *statement,
+                                         Tasks *then) {
   ZETASQL_ASSIGN_OR_RETURN(const ASTPathExpression *path_expr,
                            statement->GetTargetPathForNonNested());
   std::vector<std::string> path = path_expr->ToIdentifierVector();
   zetasql_base::InsertIfNotPresent(table_names_, path);
 
-  AliasSet visible_aliases;
-  zetasql_base::InsertIfNotPresent(table_names_, path);
+  const size_t scope = visible_aliases_.Open();
   const std::string alias = statement->alias() == nullptr
                                 ? path.back()
                                 : statement->alias()->GetAsString();
-  zetasql_base::InsertIfNotPresent(&visible_aliases,
-                                   absl::AsciiStrToLower(alias));
+  visible_aliases_.Add(alias);
 
-  ZETASQL_RETURN_IF_ERROR(
-      FindInExpressionsUnder(statement->where(), visible_aliases));
+  FindInExpressionsUnder(statement->where(), then);
+  then->push_back({Task::kCloseVisibleScope, nullptr, nullptr, scope});
   return absl::OkStatus();
 }
 
-absl::Status TableNameResolver::FindInTruncateStatement(
-    const ASTTruncateStatement *statement) {
-  AliasSet visible_aliases;
-
+absl::Status
+TableNameResolver::FindInTruncateStatement(const ASTTruncateStatement *statement,
+                                           Tasks *then) {
   ZETASQL_ASSIGN_OR_RETURN(const ASTPathExpression *path_expr,
                            statement->GetTargetPathForNonNested());
   std::vector<std::string> path = path_expr->ToIdentifierVector();
   zetasql_base::InsertIfNotPresent(table_names_, path);
-  zetasql_base::InsertIfNotPresent(&visible_aliases,
-                                   absl::AsciiStrToLower(path.back()));
 
-  return FindInExpressionsUnder(statement->where(), visible_aliases);
+  const size_t scope = visible_aliases_.Open();
+  visible_aliases_.Add(path.back());
+
+  FindInExpressionsUnder(statement->where(), then);
+  then->push_back({Task::kCloseVisibleScope, nullptr, nullptr, scope});
+  return absl::OkStatus();
 }
 
 absl::Status
-TableNameResolver::FindInInsertStatement(const ASTInsertStatement *statement) {
-  AliasSet visible_aliases;
-
+TableNameResolver::FindInInsertStatement(const ASTInsertStatement *statement,
+                                         Tasks *then) {
   ZETASQL_ASSIGN_OR_RETURN(const ASTPathExpression *path_expr,
                            statement->GetTargetPathForNonNested());
   std::vector<std::string> path = path_expr->ToIdentifierVector();
   zetasql_base::InsertIfNotPresent(table_names_, path);
   _node_kind_to_table_names[RESOLVED_INSERT_STMT].insert(path);
-  zetasql_base::InsertIfNotPresent(&visible_aliases,
-                                   absl::AsciiStrToLower(path.back()));
 
-  if (statement->rows() != nullptr) {
-    ZETASQL_RETURN_IF_ERROR(
-        FindInExpressionsUnder(statement->rows(), visible_aliases));
-  }
+  const size_t scope = visible_aliases_.Open();
+  visible_aliases_.Add(path.back());
 
+  FindInExpressionsUnder(statement->rows(), then);
   if (statement->query() != nullptr) {
-    ZETASQL_RETURN_IF_ERROR(FindInQuery(statement->query(), visible_aliases));
+    then->push_back({Task::kQuery, statement->query()});
   }
+  then->push_back({Task::kCloseVisibleScope, nullptr, nullptr, scope});
   return absl::OkStatus();
 }
 
 absl::Status
-TableNameResolver::FindInUpdateStatement(const ASTUpdateStatement *statement) {
-  AliasSet visible_aliases;
-
+TableNameResolver::FindInUpdateStatement(const ASTUpdateStatement *statement,
+                                         Tasks *then) {
   ZETASQL_ASSIGN_OR_RETURN(const ASTPathExpression *path_expr,
                            statement->GetTargetPathForNonNested());
   const std::vector<std::string> path = path_expr->ToIdentifierVector();
 
   zetasql_base::InsertIfNotPresent(table_names_, path);
   _node_kind_to_table_names[RESOLVED_UPDATE_STMT].insert(path);
+
+  const size_t scope = visible_aliases_.Open();
   const std::string alias = statement->alias() == nullptr
                                 ? path.back()
                                 : statement->alias()->GetAsString();
-  zetasql_base::InsertIfNotPresent(&visible_aliases,
-                                   absl::AsciiStrToLower(alias));
+  visible_aliases_.Add(alias);
 
   if (statement->from_clause() != nullptr) {
     ZETASQL_RET_CHECK(statement->from_clause()->table_expression() != nullptr);
-    ZETASQL_RETURN_IF_ERROR(FindInTableExpression(
-        statement->from_clause()->table_expression(),
-        /*external_visible_aliases=*/{}, &visible_aliases));
+    // Subqueries in the FROM clause do not see the target either.
+    then->push_back({Task::kTableExpression,
+                     statement->from_clause()->table_expression(), nullptr,
+                     /*external_scope=*/scope});
   }
 
-  ZETASQL_RETURN_IF_ERROR(
-      FindInExpressionsUnder(statement->where(), visible_aliases));
-  ZETASQL_RETURN_IF_ERROR(
-      FindInExpressionsUnder(statement->update_item_list(), visible_aliases));
+  FindInExpressionsUnder(statement->where(), then);
+  FindInExpressionsUnder(statement->update_item_list(), then);
+  then->push_back({Task::kCloseVisibleScope, nullptr, nullptr, scope});
   return absl::OkStatus();
 }
 
 absl::Status
-TableNameResolver::FindInMergeStatement(const ASTMergeStatement *statement) {
-  AliasSet visible_aliases;
-
+TableNameResolver::FindInMergeStatement(const ASTMergeStatement *statement,
+                                        Tasks *then) {
   const ASTPathExpression *path_expr = statement->target_path();
   std::vector<std::string> path = path_expr->ToIdentifierVector();
   zetasql_base::InsertIfNotPresent(table_names_, path);
-  zetasql_base::InsertIfNotPresent(&visible_aliases,
-                                   absl::AsciiStrToLower(path.back()));
 
-  ZETASQL_RETURN_IF_ERROR(FindInTableExpression(statement->table_expression(),
-                                                /*external_visible_aliases=*/{},
-                                                &visible_aliases));
-  ZETASQL_RETURN_IF_ERROR(
-      FindInExpressionsUnder(statement->merge_condition(), visible_aliases));
-  ZETASQL_RETURN_IF_ERROR(
-      FindInExpressionsUnder(statement->when_clauses(), visible_aliases));
+  const size_t scope = visible_aliases_.Open();
+  visible_aliases_.Add(path.back());
 
+  then->push_back({Task::kTableExpression, statement->table_expression(),
+                   nullptr, /*external_scope=*/scope});
+  FindInExpressionsUnder(statement->merge_condition(), then);
+  FindInExpressionsUnder(statement->when_clauses(), then);
+  then->push_back({Task::kCloseVisibleScope, nullptr, nullptr, scope});
   return absl::OkStatus();
 }
 
 absl::Status TableNameResolver::FindInQuery(const ASTQuery *query,
-                                            const AliasSet &visible_aliases) {
-  AliasSet old_local_table_aliases;
+                                            Tasks *then) {
+  traversed_.insert(query);
+  // WITH aliases are only visible in the query they are defined in.
+  const size_t with_scope = local_table_aliases_.Open();
   if (query->with_clause() != nullptr) {
-    // Record the set of local table aliases visible in the outer scope so we
-    // can restore that after processing the local query.
-    old_local_table_aliases = local_table_aliases_;
-
     if (query->with_clause()->recursive()) {
       // In WITH RECURSIVE, any entry can access an alias defined in any other
       // entry, regardless of declaration order.
       for (const ASTWithClauseEntry *with_entry :
            query->with_clause()->with()) {
-        const std::string with_alias =
-            absl::AsciiStrToLower(with_entry->alias()->GetAsString());
-        zetasql_base::InsertIfNotPresent(&local_table_aliases_, with_alias);
+        local_table_aliases_.Add(with_entry->alias()->GetAsString());
       }
       for (const ASTWithClauseEntry *with_entry :
            query->with_clause()->with()) {
-        ZETASQL_RETURN_IF_ERROR(
-            FindInQuery(with_entry->query(), visible_aliases));
-        const std::string with_alias =
-            absl::AsciiStrToLower(with_entry->alias()->GetAsString());
+        then->push_back({Task::kQuery, with_entry->query()});
       }
     } else {
       // In WITH without RECURSIVE, entries can only access with aliases
       // defined in prior entries.
       for (const ASTWithClauseEntry *with_entry :
            query->with_clause()->with()) {
-        ZETASQL_RETURN_IF_ERROR(
-            FindInQuery(with_entry->query(), visible_aliases));
-        const std::string with_alias =
-            absl::AsciiStrToLower(with_entry->alias()->GetAsString());
-        zetasql_base::InsertIfNotPresent(&local_table_aliases_, with_alias);
+        then->push_back({Task::kQuery, with_entry->query()});
+        then->push_back({Task::kAddLocalAlias, with_entry->alias()});
       }
     }
   }
 
-  ZETASQL_RETURN_IF_ERROR(FindInQueryExpression(
-      query->query_expr(), query->order_by(), visible_aliases));
-
-  // Restore local table alias set if we modified it.
-  if (query->with_clause() != nullptr) {
-    local_table_aliases_ = old_local_table_aliases;
-  }
+  then->push_back(
+      {Task::kQueryExpression, query->query_expr(), query->order_by()});
+  FindInOtherChildren(
+      query, {query->with_clause(), query->query_expr(), query->order_by()},
+      then);
+  then->push_back({Task::kCloseLocalScope, nullptr, nullptr, with_scope});
   return absl::OkStatus();
 }
 
 absl::Status
 TableNameResolver::FindInQueryExpression(const ASTQueryExpression *query_expr,
                                          const ASTOrderBy *order_by,
-                                         const AliasSet &visible_aliases) {
+                                         Tasks *then) {
   switch (query_expr->node_kind()) {
   case AST_SELECT:
-    ZETASQL_RETURN_IF_ERROR(FindInSelect(query_expr->GetAs<ASTSelect>(),
-                                         order_by, visible_aliases));
+    ZETASQL_RETURN_IF_ERROR(
+        FindInSelect(query_expr->GetAs<ASTSelect>(), order_by, then));
     break;
   case AST_SET_OPERATION:
-    ZETASQL_RETURN_IF_ERROR(FindInSetOperation(
-        query_expr->GetAs<ASTSetOperation>(), visible_aliases));
+    FindInSetOperation(query_expr->GetAs<ASTSetOperation>(), then);
     break;
   case AST_QUERY:
-    ZETASQL_RETURN_IF_ERROR(
-        FindInQuery(query_expr->GetAs<ASTQuery>(), visible_aliases));
+    ZETASQL_RETURN_IF_ERROR(FindInQuery(query_expr->GetAs<ASTQuery>(), then));
     break;
   default:
     const auto status = MakeSqlErrorAt(query_expr) << "Unhandled query_expr:\n"
       << query_expr->DebugString();
-    std::cout << "WARNING: table name resolver may ignore some table names with the error: " << status << std::endl;
+    Warn(status);
     return absl::OkStatus();
   }
 
   if (query_expr->node_kind() != AST_SELECT) {
-    ZETASQL_RETURN_IF_ERROR(FindInExpressionsUnder(order_by, visible_aliases));
+    FindInExpressionsUnder(order_by, then);
   }
   return absl::OkStatus();
 }
 
-absl::Status
-TableNameResolver::FindInSelect(const ASTSelect *select,
-                                const ASTOrderBy *order_by,
-                                const AliasSet &orig_visible_aliases) {
-  AliasSet visible_aliases = orig_visible_aliases;
+absl::Status TableNameResolver::FindInSelect(const ASTSelect *select,
+                                             const ASTOrderBy *order_by,
+                                             Tasks *then) {
+  // Names in the FROM clause are visible in the rest of the SELECT only.
+  const size_t scope = visible_aliases_.Open();
   if (select->from_clause() != nullptr) {
     ZETASQL_RET_CHECK(select->from_clause()->table_expression() != nullptr);
-    ZETASQL_RETURN_IF_ERROR(
-        FindInTableExpression(select->from_clause()->table_expression(),
-                              orig_visible_aliases, &visible_aliases));
+    then->push_back({Task::kTableExpression,
+                     select->from_clause()->table_expression(), nullptr,
+                     /*external_scope=*/scope});
   }
-  ZETASQL_RETURN_IF_ERROR(
-      FindInExpressionsUnder(select->select_list(), visible_aliases));
-  ZETASQL_RETURN_IF_ERROR(
-      FindInExpressionsUnder(select->where_clause(), visible_aliases));
-  ZETASQL_RETURN_IF_ERROR(
-      FindInExpressionsUnder(select->group_by(), visible_aliases));
-  ZETASQL_RETURN_IF_ERROR(
-      FindInExpressionsUnder(select->having(), visible_aliases));
-  ZETASQL_RETURN_IF_ERROR(FindInExpressionsUnder(order_by, visible_aliases));
+  // The SELECT list, WHERE, GROUP BY, HAVING, WINDOW and so on.
+  FindInOtherChildren(select, {select->from_clause()}, then);
+  FindInExpressionsUnder(order_by, then);
+  then->push_back({Task::kCloseVisibleScope, nullptr, nullptr, scope});
   return absl::OkStatus();
 }
 
-absl::Status
-TableNameResolver::FindInSetOperation(const ASTSetOperation *set_operation,
-                                      const AliasSet &visible_aliases) {
+void TableNameResolver::FindInSetOperation(const ASTSetOperation *set_operation,
+                                           Tasks *then) {
   for (const ASTQueryExpression *input : set_operation->inputs()) {
-    ZETASQL_RETURN_IF_ERROR(
-        FindInQueryExpression(input, nullptr /* order_by */, visible_aliases));
+    then->push_back({Task::kQueryExpression, input, nullptr /* order_by */});
   }
-  return absl::OkStatus();
 }
 
-absl::Status TableNameResolver::FindInTableExpression(
-    const ASTTableExpression *table_expr,
-    const AliasSet &external_visible_aliases, AliasSet *local_visible_aliases) {
+absl::Status
+TableNameResolver::FindInTableExpression(const ASTTableExpression *table_expr,
+                                         size_t external_scope, Tasks *then) {
+  traversed_.insert(table_expr);
   switch (table_expr->node_kind()) {
   case AST_TABLE_PATH_EXPRESSION:
     return FindInTablePathExpression(
-        table_expr->GetAs<ASTTablePathExpression>(), local_visible_aliases);
+        table_expr->GetAs<ASTTablePathExpression>(), then);
 
   case AST_TABLE_SUBQUERY:
     return FindInTableSubquery(table_expr->GetAs<ASTTableSubquery>(),
-                               external_visible_aliases, local_visible_aliases);
+                               external_scope, then);
 
   case AST_JOIN:
-    return FindInJoin(table_expr->GetAs<ASTJoin>(), external_visible_aliases,
-                      local_visible_aliases);
+    FindInJoin(table_expr->GetAs<ASTJoin>(), external_scope, then);
+    return absl::OkStatus();
 
   case AST_PARENTHESIZED_JOIN:
-    return FindInParenthesizedJoin(table_expr->GetAs<ASTParenthesizedJoin>(),
-                                   external_visible_aliases,
-                                   local_visible_aliases);
+    FindInParenthesizedJoin(table_expr->GetAs<ASTParenthesizedJoin>(),
+                            external_scope, then);
+    return absl::OkStatus();
 
   case AST_TVF:
-    return FindInTVF(table_expr->GetAs<ASTTVF>(), external_visible_aliases,
-                     local_visible_aliases);
+    FindInTVF(table_expr->GetAs<ASTTVF>(), external_scope, then);
+    return absl::OkStatus();
   default:
     const auto status = MakeSqlErrorAt(table_expr) << "Unhandled node type in from clause: "
                                       << table_expr->GetNodeKindString();
-    std::cout << "WARNING: table name resolver may ignore some table names with the error: " << status << std::endl;
+    Warn(status);
     return absl::OkStatus();
   }
 }
 
-absl::Status
-TableNameResolver::FindInJoin(const ASTJoin *join,
-                              const AliasSet &external_visible_aliases,
-                              AliasSet *local_visible_aliases) {
-  ZETASQL_RETURN_IF_ERROR(FindInTableExpression(
-      join->lhs(), external_visible_aliases, local_visible_aliases));
-  ZETASQL_RETURN_IF_ERROR(FindInTableExpression(
-      join->rhs(), external_visible_aliases, local_visible_aliases));
-  ZETASQL_RETURN_IF_ERROR(
-      FindInExpressionsUnder(join->on_clause(), *local_visible_aliases));
-  return absl::OkStatus();
+void TableNameResolver::FindInJoin(const ASTJoin *join, size_t external_scope,
+                                   Tasks *then) {
+  then->push_back({Task::kTableExpression, join->lhs(), nullptr,
+                   external_scope});
+  then->push_back({Task::kTableExpression, join->rhs(), nullptr,
+                   external_scope});
+  // The ON or USING clause.
+  FindInOtherChildren(join, {join->lhs(), join->rhs()}, then);
 }
 
-absl::Status TableNameResolver::FindInParenthesizedJoin(
-    const ASTParenthesizedJoin *parenthesized_join,
-    const AliasSet &external_visible_aliases, AliasSet *local_visible_aliases) {
-  const ASTJoin *join = parenthesized_join->join();
-  // In parenthesized joins, we can't see names from outside the parentheses.
-  std::unique_ptr<AliasSet> join_visible_aliases(
-      new AliasSet(external_visible_aliases));
-  ZETASQL_RETURN_IF_ERROR(
-      FindInJoin(join, external_visible_aliases, join_visible_aliases.get()));
-  for (const std::string &alias : *join_visible_aliases) {
-    zetasql_base::InsertIfNotPresent(local_visible_aliases, alias);
-  }
-  return absl::OkStatus();
+void TableNameResolver::FindInParenthesizedJoin(
+    const ASTParenthesizedJoin *parenthesized_join, size_t external_scope,
+    Tasks *then) {
+  // In parenthesized joins, we can't see names from outside the parentheses,
+  // but names inside them are visible outside.
+  const size_t last_hidden = visible_aliases_.Hide(external_scope);
+  const size_t scope = visible_aliases_.Open();
+  FindInJoin(parenthesized_join->join(), /*external_scope=*/scope, then);
+  FindInOtherChildren(parenthesized_join, {parenthesized_join->join()}, then);
+  then->push_back({Task::kMergeVisibleScope, nullptr, nullptr, scope});
+  then->push_back({Task::kUnhideVisibleScopes, nullptr, nullptr,
+                   external_scope, last_hidden});
 }
 
-absl::Status
-TableNameResolver::FindInTVF(const ASTTVF *tvf,
-                             const AliasSet &external_visible_aliases,
-                             AliasSet *local_visible_aliases) {
+void TableNameResolver::FindInTVF(const ASTTVF *tvf, size_t external_scope,
+                                  Tasks *then) {
   // The 'tvf' here is the TVF parse node. Each TVF argument may be a scalar,
   // a relation, or a TABLE clause. We've parsed all of the TVF arguments as
   // expressions by this point, so the FindInExpressionsUnder call will
@@ -1033,18 +1180,19 @@ TableNameResolver::FindInTVF(const ASTTVF *tvf,
   // names in a separate step.
   //
   // Note about correlation: if a TVF argument is a scalar, it should resolve
-  // like a correlated subquery and be able to see 'local_visible_aliases'. On
-  // the other hand, if the argument is a relation, it should be uncorrelated,
-  // and so those aliases should not be visible. Because we don't know whether
-  // the argument should be a scalar or a relation yet, we allow correlation
-  // here and examine the arguments again during resolving.
-  ZETASQL_RETURN_IF_ERROR(FindInExpressionsUnder(tvf, *local_visible_aliases));
+  // like a correlated subquery and be able to see the names earlier in the
+  // FROM clause. On the other hand, if the argument is a relation, it should
+  // be uncorrelated, and so those aliases should not be visible. Because we
+  // don't know whether the argument should be a scalar or a relation yet, we
+  // allow correlation here and examine the arguments again during resolving.
+  FindInExpressionsUnder(tvf, then);
   for (const ASTTVFArgument *arg : tvf->argument_entries()) {
     if (arg->table_clause() != nullptr) {
       // Single path names are table references, to either WITH clause
       // tables or table-typed arguments to the TVF.  Multi-path names
       // cannot be related to WITH clause tables or TVF arguments, so those
-      // must be table references.
+      // must be table references. The aliases visible here are the same as
+      // after the arguments are traversed.
       if (arg->table_clause()->table_path() != nullptr &&
           arg->table_clause()->table_path()->ToIdentifierVector() !=
               recursive_view_name_) {
@@ -1054,9 +1202,10 @@ TableNameResolver::FindInTVF(const ASTTVF *tvf,
               arg->table_clause()->table_path()->ToIdentifierVector());
         } else {
           // This is a single-part name.
-          const std::string lower_name = absl::AsciiStrToLower(
-              arg->table_clause()->table_path()->first_name()->GetAsString());
-          if (!zetasql_base::ContainsKey(local_table_aliases_, lower_name)) {
+          if (!local_table_aliases_.Contains(arg->table_clause()
+                                                 ->table_path()
+                                                 ->first_name()
+                                                 ->GetAsString())) {
             zetasql_base::InsertIfNotPresent(
                 table_names_,
                 arg->table_clause()->table_path()->ToIdentifierVector());
@@ -1064,37 +1213,35 @@ TableNameResolver::FindInTVF(const ASTTVF *tvf,
         }
       }
       if (arg->table_clause()->tvf() != nullptr) {
-        ZETASQL_RETURN_IF_ERROR(FindInTVF(arg->table_clause()->tvf(),
-                                          external_visible_aliases,
-                                          local_visible_aliases));
+        then->push_back({Task::kTVF, arg->table_clause()->tvf(), nullptr,
+                         external_scope});
       }
     }
   }
-  return absl::OkStatus();
 }
 
 absl::Status
 TableNameResolver::FindInTableSubquery(const ASTTableSubquery *table_subquery,
-                                       const AliasSet &external_visible_aliases,
-                                       AliasSet *local_visible_aliases) {
-
-  ZETASQL_RETURN_IF_ERROR(
-      FindInQuery(table_subquery->subquery(), external_visible_aliases));
+                                       size_t external_scope, Tasks *then) {
+  const size_t last_hidden = visible_aliases_.Hide(external_scope);
+  ZETASQL_RETURN_IF_ERROR(FindInQuery(table_subquery->subquery(), then));
+  then->push_back({Task::kUnhideVisibleScopes, nullptr, nullptr,
+                   external_scope, last_hidden});
+  FindInOtherChildren(table_subquery, {table_subquery->subquery()}, then);
 
   if (table_subquery->alias() != nullptr) {
-    zetasql_base::InsertIfNotPresent(
-        local_visible_aliases,
-        absl::AsciiStrToLower(table_subquery->alias()->GetAsString()));
+    then->push_back(
+        {Task::kAddVisibleAlias, table_subquery->alias()->identifier()});
   }
   return absl::OkStatus();
 }
 
 absl::Status TableNameResolver::FindInTablePathExpression(
-    const ASTTablePathExpression *table_ref, AliasSet *visible_aliases) {
+    const ASTTablePathExpression *table_ref, Tasks *then) {
 
-  std::string alias;
+  const ASTIdentifier *alias = nullptr;
   if (table_ref->alias() != nullptr) {
-    alias = table_ref->alias()->GetAsString();
+    alias = table_ref->alias()->identifier();
   }
 
   if (table_ref->path_expr() != nullptr) {
@@ -1113,13 +1260,9 @@ absl::Status TableNameResolver::FindInTablePathExpression(
     // a WITH alias or TVF argument name, since multi-part table names never
     // resolve to either of these (so the full multi-part name is a reference
     // to an actual table).
-    const std::string first_identifier = absl::AsciiStrToLower(path[0]);
-
     if ((path != recursive_view_name_) &&
-        (path.size() == 1 ? (!zetasql_base::ContainsKey(local_table_aliases_,
-                                                        first_identifier))
-                          : (!zetasql_base::ContainsKey(*visible_aliases,
-                                                        first_identifier)))) {
+        (path.size() == 1 ? !local_table_aliases_.Contains(path[0])
+                          : !visible_aliases_.Contains(path[0]))) {
       zetasql_base::InsertIfNotPresent(table_names_, path);
       if (table_resolution_time_info_map_ != nullptr) {
         // Lookup for or insert a set of temporal expressions for 'path'.
@@ -1131,7 +1274,7 @@ absl::Status TableNameResolver::FindInTablePathExpression(
           if (!for_system_time_as_of_feature_enabled_) {
             const auto status = MakeSqlErrorAt(for_system_time)
                    << "FOR SYSTEM_TIME AS OF is not supported";
-            std::cout << "WARNING: table name resolver may ignore some table names with the error: " << status << std::endl;
+            Warn(status);
             return absl::OkStatus();
           }
 
@@ -1151,55 +1294,111 @@ absl::Status TableNameResolver::FindInTablePathExpression(
       }
     }
 
-    if (alias.empty()) {
-      alias = path.back();
+    if (alias == nullptr) {
+      alias = path_expr->last_name();
     }
   }
 
-  ZETASQL_RETURN_IF_ERROR(
-      FindInExpressionsUnder(table_ref->unnest_expr(), *visible_aliases));
+  // UNNEST, FOR SYSTEM_TIME AS OF and so on.
+  FindInOtherChildren(table_ref, {table_ref->path_expr()}, then);
 
-  if (!alias.empty()) {
-    visible_aliases->insert(absl::AsciiStrToLower(alias));
+  if (alias != nullptr) {
+    then->push_back({Task::kAddVisibleAlias, alias});
   }
 
   return absl::OkStatus();
 }
 
-absl::Status
-TableNameResolver::FindInExpressionsUnder(const ASTNode *root,
-                                          const AliasSet &visible_aliases) {
+void TableNameResolver::FindInExpressionsUnder(const ASTNode *root,
+                                               Tasks *then) {
   if (root == nullptr)
-    return absl::OkStatus();
+    return;
+  traversed_.insert(root);
+  then->push_back({Task::kExpressionNode, root});
+}
 
+absl::Status TableNameResolver::FindInExpressionNode(const ASTNode *node,
+                                                     Tasks *then) {
   // The only thing that matters inside expressions are expression subqueries,
   // which can be either ASTExpressionSubquery or ASTIn, both of which have
   // the subquery in an ASTQuery child.
-  std::vector<const ASTNode *> subquery_nodes;
-  root->GetDescendantSubtreesWithKinds({AST_QUERY}, &subquery_nodes);
-
-  for (const ASTNode *subquery_node : subquery_nodes) {
-    ZETASQL_RETURN_IF_ERROR(
-        FindInQuery(subquery_node->GetAs<ASTQuery>(), visible_aliases));
+  switch (node->node_kind()) {
+  case AST_QUERY:
+    return FindInQuery(node->GetAs<ASTQuery>(), then);
+  case AST_TABLE_CLAUSE:
+    return absl::OkStatus();
+  default:
+    break;
   }
-
+  EnterNode(node);
+  for (int i = 0; i < node->num_children(); ++i) {
+    then->push_back({Task::kExpressionNode, node->child(i)});
+  }
+  then->push_back({Task::kLeaveNode, node});
   return absl::OkStatus();
 }
 
-absl::Status
-TableNameResolver::FindInOptionsListUnder(const ASTNode *root,
-                                          const AliasSet &visible_aliases) {
-  if (root == nullptr)
-    return absl::OkStatus();
+void TableNameResolver::FindInOtherChildren(
+    const ASTNode *node, std::initializer_list<const ASTNode *> handled,
+    Tasks *then) {
+  for (int i = 0; i < node->num_children(); ++i) {
+    const ASTNode *child = node->child(i);
+    if (std::find(handled.begin(), handled.end(), child) == handled.end()) {
+      FindInExpressionsUnder(child, then);
+    }
+  }
+}
+
+void TableNameResolver::FindInRestUnder(const ASTNode *root, Tasks *then) {
+  if (traversed_.contains(root)) {
+    return;
+  }
+  if (root->node_kind() == AST_OPTIONS_LIST) {
+    FindInExpressionsUnder(root, then);
+    return;
+  }
+  if (observer_ == nullptr &&
+      (root->node_kind() == AST_QUERY || root->IsExpression())) {
+    return;
+  }
+  EnterNode(root);
+  for (int i = 0; i < root->num_children(); ++i) {
+    then->push_back({Task::kRestUnder, root->child(i)});
+  }
+  then->push_back({Task::kLeaveNode, root});
+}
 
-  std::vector<const ASTNode *> options_list_nodes;
-  root->GetDescendantSubtreesWithKinds({AST_OPTIONS_LIST}, &options_list_nodes);
+void TableNameResolver::EnterNode(const ASTNode *node) {
+  if (observer_ == nullptr) {
+    return;
+  }
+  if (unobserved_depth_ > 0 || !observer_->Enter(node)) {
+    ++unobserved_depth_;
+  }
+}
 
-  for (const ASTNode *options_list : options_list_nodes) {
-    ZETASQL_RETURN_IF_ERROR(
-        FindInExpressionsUnder(options_list, visible_aliases));
+void TableNameResolver::LeaveNode(const ASTNode *node) {
+  if (observer_ == nullptr) {
+    return;
   }
-  return absl::OkStatus();
+  if (unobserved_depth_ > 0) {
+    --unobserved_depth_;
+    return;
+  }
+  observer_->Leave(node);
+}
+
+void TableNameResolver::Warn(const absl::Status &status) const {
+  Report(MakeDiagnostic(
+             Severity::kWarning,
+             absl::StrCat("table name resolver may ignore some table names "
+                          "with the error: ",
+                          status.message()),
+             ConvertInternalErrorLocationToExternal(status, sql_)),
+         absl::StrCat("WARNING: table name resolver may ignore some table "
+                      "names with the error: ",
+                      status.ToString()),
+         std::cout);
 }
 } // namespace
 
@@ -1214,6 +1413,20 @@ absl::Status FindTableNamesInScript(absl::string_view sql,
       .FindTableNames(script);
 }
 
+absl::Status GetTables(absl::string_view sql, const ASTScript &script,
+                       const AnalyzerOptions &analyzer_options,
+                       TableNamesSet *table_names) {
+  auto resolver = alphasql::table_name_resolver::TableNameResolver(
+      sql, &analyzer_options, nullptr, nullptr, table_names, nullptr);
+
+  auto statements = script.statement_list_node();
+  for (const ASTStatement *statement : statements->statement_list()) {
+    ZETASQL_RETURN_IF_ERROR(resolver.FindInStatement(statement));
+  }
+
+  return absl::OkStatus();
+}
+
 absl::Status GetTables(const std::string &sql_file_path,
                        const AnalyzerOptions &analyzer_options,
                        TableNamesSet *table_names) {
@@ -1225,15 +1438,8 @@ absl::Status GetTables(const std::string &sql_file_path,
       sql, analyzer_options.GetParserOptions(),
       analyzer_options.error_message_mode(), &parser_output, file_path));
 
-  auto resolver = alphasql::table_name_resolver::TableNameResolver(
-      sql, &analyzer_options, nullptr, nullptr, table_names, nullptr);
-
-  auto statements = parser_output->script()->statement_list_node();
-  for (const ASTStatement *statement : statements->statement_list()) {
-    ZETASQL_RETURN_IF_ERROR(resolver.FindInStatement(statement));
-  }
-
-  return absl::OkStatus();
+  return GetTables(sql, *parser_output->script(), analyzer_options,
+                   table_names);
 }
 
 } // namespace table_name_resolver
@@ -0,0 +1,130 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+// Measures table name extraction on deeply nested generated queries. Time
+// per run should roughly double with the depth, as every AST node is visited
+// a bounded number of times.
+//
+//   bazel run //alphasql:table_name_resolver_benchmark
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "alphasql/table_name_resolver.h"
+#include "zetasql/public/analyzer.h"
+#include "zetasql/public/language_options.h"
+
+namespace {
+
+using namespace zetasql;
+
+constexpr int kRuns = 20;
+
+AnalyzerOptions MakeOptions() {
+  LanguageOptions language_options;
+  language_options.EnableMaximumLanguageFeaturesForDevelopment();
+  language_options.SetSupportsAllStatementKinds();
+  AnalyzerOptions options(language_options);
+  options.CreateDefaultArenasIfNotSet();
+  return options;
+}
+
+// SELECT (SELECT (... FROM t2) FROM t1) FROM t0
+std::string ScalarSubqueries(int depth) {
+  std::string sql = "1";
+  for (int i = depth; i >= 0; --i) {
+    sql = absl::StrCat("(SELECT ", sql, " FROM t", i, ")");
+  }
+  return absl::StrCat("SELECT ", sql);
+}
+
+// SELECT x FROM t0 WHERE x IN (SELECT x FROM t1 WHERE x IN (...))
+std::string InSubqueries(int depth) {
+  std::string sql = absl::StrCat("SELECT x FROM t", depth);
+  for (int i = depth - 1; i >= 0; --i) {
+    sql = absl::StrCat("SELECT x FROM t", i, " WHERE x IN (", sql, ")");
+  }
+  return sql;
+}
+
+// SELECT * FROM f0(TABLE f1(TABLE ... f<depth>((SELECT 1 FROM t))))
+std::string NestedTVFs(int depth) {
+  std::string sql = absl::StrCat("f", depth, "((SELECT 1 FROM t))");
+  for (int i = depth - 1; i >= 0; --i) {
+    sql = absl::StrCat("f", i, "(TABLE ", sql, ")");
+  }
+  return absl::StrCat("SELECT * FROM ", sql);
+}
+
+// BEGIN BEGIN ... SELECT 1 FROM t; ... END; END
+std::string NestedBlocks(int depth) {
+  std::string sql = "SELECT 1 FROM t;";
+  for (int i = 0; i < depth; ++i) {
+    sql = absl::StrCat("BEGIN ", sql, " END;");
+  }
+  return sql;
+}
+
+void Run(const std::string &name, const std::function<std::string(int)> &make,
+         const AnalyzerOptions &options) {
+  for (const int depth : {50, 100, 200, 400}) {
+    const std::string sql = make(depth);
+    std::unique_ptr<ParserOutput> parser_output;
+    const absl::Status parse_status =
+        ParseScript(sql, options.GetParserOptions(),
+                    options.error_message_mode(), &parser_output);
+    if (!parse_status.ok()) {
+      std::cerr << name << " at depth " << depth << ": " << parse_status
+                << std::endl;
+      return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    for (int run = 0; run < kRuns; ++run) {
+      TableNamesSet table_names;
+      const absl::Status status = alphasql::table_name_resolver::GetTables(
+          sql, *parser_output->script(), options, &table_names);
+      if (!status.ok()) {
+        std::cerr << name << " at depth " << depth << ": " << status
+                  << std::endl;
+        return;
+      }
+    }
+    const std::chrono::duration<double, std::micro> elapsed =
+        std::chrono::steady_clock::now() - start;
+    std::cout << std::left << std::setw(20) << name << std::right
+              << std::setw(6) << depth << std::setw(12) << std::fixed
+              << std::setprecision(1) << elapsed.count() / kRuns << " us"
+              << std::endl;
+  }
+}
+
+} // namespace
+
+int main() {
+  const AnalyzerOptions options = MakeOptions();
+  Run("scalar subqueries", ScalarSubqueries, options);
+  Run("IN subqueries", InSubqueries, options);
+  Run("nested TVFs", NestedTVFs, options);
+  Run("nested blocks", NestedBlocks, options);
+  return 0;
+}
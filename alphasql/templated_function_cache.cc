@@ -0,0 +1,296 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/templated_function_cache.h"
+
+#include <algorithm>
+
+#include "absl/strings/str_cat.h"
+#include "zetasql/base/status_macros.h"
+#include "zetasql/common/status_payload_utils.h"
+#include "zetasql/public/cycle_detector.h"
+#include "zetasql/public/error_location.pb.h"
+#include "zetasql/public/procedure.h"
+
+namespace alphasql {
+
+using namespace zetasql;
+
+namespace {
+
+std::atomic<uint64_t> next_id{1};
+
+// Ids of the functions whose bodies this thread is resolving, since a body
+// calling its own function would be resolved forever.
+thread_local std::vector<uint64_t> resolving_ids;
+
+std::string Describe(const Table *table) {
+  std::string description = table->FullName();
+  for (int i = 0; i < table->NumColumns(); ++i) {
+    const Column *column = table->GetColumn(i);
+    absl::StrAppend(&description, ",", column->Name(), " ",
+                    column->GetType()->DebugString());
+  }
+  return description;
+}
+
+std::string Describe(const Function *function) {
+  // Builtins live in the base catalog, which is never freed.
+  if (function->IsZetaSQLBuiltin()) {
+    return "";
+  }
+  if (const auto *templated =
+          dynamic_cast<const CachingTemplatedSQLFunction *>(function)) {
+    return absl::StrCat("#", templated->id());
+  }
+  return function->DebugString(/*verbose=*/true);
+}
+
+std::string Describe(const TableValuedFunction *function) {
+  if (const auto *templated =
+          dynamic_cast<const CachingTemplatedSQLTVF *>(function)) {
+    return absl::StrCat("#", templated->id());
+  }
+  return function->DebugString();
+}
+
+std::string Describe(const Procedure *procedure) {
+  return procedure->signature().DebugString(procedure->FullName());
+}
+
+// Types are owned by the type factory, which outlives the check.
+std::string Describe(const Type *) { return ""; }
+
+template <class T>
+bool Matches(const RecordingCatalog::Lookup &lookup, const absl::Status &status,
+             const T *object) {
+  if (!status.ok()) {
+    return lookup.object == nullptr;
+  }
+  return lookup.object == object && lookup.description == Describe(object);
+}
+
+} // namespace
+
+template <class T>
+void RecordingCatalog::Record(Kind kind,
+                              const absl::Span<const std::string> &path,
+                              const absl::Status &status,
+                              const T *const *object) {
+  Lookup lookup{kind, std::vector<std::string>(path.begin(), path.end()),
+                nullptr, ""};
+  if (status.ok()) {
+    lookup.object = *object;
+    lookup.description = Describe(*object);
+  }
+  lookups_.push_back(std::move(lookup));
+}
+
+absl::Status RecordingCatalog::FindTable(
+    const absl::Span<const std::string> &path, const Table **table,
+    const FindOptions &options) {
+  const absl::Status status = catalog_->FindTable(path, table, options);
+  Record(Kind::kTable, path, status, table);
+  return status;
+}
+
+absl::Status RecordingCatalog::FindFunction(
+    const absl::Span<const std::string> &path, const Function **function,
+    const FindOptions &options) {
+  const absl::Status status = catalog_->FindFunction(path, function, options);
+  Record(Kind::kFunction, path, status, function);
+  return status;
+}
+
+absl::Status RecordingCatalog::FindTableValuedFunction(
+    const absl::Span<const std::string> &path,
+    const TableValuedFunction **function, const FindOptions &options) {
+  const absl::Status status =
+      catalog_->FindTableValuedFunction(path, function, options);
+  Record(Kind::kTableValuedFunction, path, status, function);
+  return status;
+}
+
+absl::Status RecordingCatalog::FindProcedure(
+    const absl::Span<const std::string> &path, const Procedure **procedure,
+    const FindOptions &options) {
+  const absl::Status status = catalog_->FindProcedure(path, procedure, options);
+  Record(Kind::kProcedure, path, status, procedure);
+  return status;
+}
+
+absl::Status RecordingCatalog::FindType(
+    const absl::Span<const std::string> &path, const Type **type,
+    const FindOptions &options) {
+  const absl::Status status = catalog_->FindType(path, type, options);
+  Record(Kind::kType, path, status, type);
+  return status;
+}
+
+bool RecordingCatalog::Replay(const std::vector<Lookup> &lookups,
+                              Catalog *catalog) {
+  for (const Lookup &lookup : lookups) {
+    bool matches = false;
+    switch (lookup.kind) {
+    case Kind::kTable: {
+      const Table *table = nullptr;
+      matches = Matches(lookup, catalog->FindTable(lookup.path, &table), table);
+      break;
+    }
+    case Kind::kFunction: {
+      const Function *function = nullptr;
+      matches = Matches(lookup, catalog->FindFunction(lookup.path, &function),
+                        function);
+      break;
+    }
+    case Kind::kTableValuedFunction: {
+      const TableValuedFunction *function = nullptr;
+      matches = Matches(
+          lookup, catalog->FindTableValuedFunction(lookup.path, &function),
+          function);
+      break;
+    }
+    case Kind::kProcedure: {
+      const Procedure *procedure = nullptr;
+      matches = Matches(
+          lookup, catalog->FindProcedure(lookup.path, &procedure), procedure);
+      break;
+    }
+    case Kind::kType: {
+      const Type *type = nullptr;
+      matches = Matches(lookup, catalog->FindType(lookup.path, &type), type);
+      break;
+    }
+    }
+    if (!matches) {
+      return false;
+    }
+  }
+  return true;
+}
+
+CachingTemplatedSQLFunction::CachingTemplatedSQLFunction(
+    const std::string &name, const FunctionSignature &signature,
+    const std::vector<std::string> &argument_names, const std::string &body)
+    : Function(name, "group", Function::SCALAR, {signature},
+               FunctionOptions().set_compute_result_type_callback(
+                   [this](Catalog *catalog, TypeFactory *type_factory,
+                          CycleDetector *, const FunctionSignature &,
+                          const std::vector<InputArgumentType> &arguments,
+                          const AnalyzerOptions &analyzer_options) {
+                     return ComputeResultType(catalog, type_factory, arguments,
+                                              analyzer_options);
+                   })),
+      argument_names_(argument_names), body_(body), id_(next_id++) {}
+
+zetasql_base::StatusOr<const Type *>
+CachingTemplatedSQLFunction::ComputeResultType(
+    Catalog *catalog, TypeFactory *type_factory,
+    const std::vector<InputArgumentType> &arguments,
+    const AnalyzerOptions &analyzer_options) const {
+  if (arguments.size() != argument_names_.size()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Function ", Name(), " expects ", argument_names_.size(),
+                     " arguments, got ", arguments.size()));
+  }
+  std::string key;
+  for (const InputArgumentType &argument : arguments) {
+    absl::StrAppend(&key,
+                    argument.type() != nullptr ? argument.type()->DebugString()
+                                               : argument.DebugString(),
+                    ",");
+  }
+  const Type *result_type;
+  if (cache_.Lookup(key, catalog, &result_type)) {
+    return result_type;
+  }
+  if (std::find(resolving_ids.begin(), resolving_ids.end(), id_) !=
+      resolving_ids.end()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Function ", Name(), " calls itself"));
+  }
+
+  AnalyzerOptions options = analyzer_options;
+  // Errors are located by their payload, which is moved into the message.
+  options.set_error_message_mode(ERROR_MESSAGE_WITH_PAYLOAD);
+  for (size_t i = 0; i < arguments.size(); ++i) {
+    ZETASQL_RETURN_IF_ERROR(
+        options.AddExpressionColumn(argument_names_[i], arguments[i].type()));
+  }
+  // The declared result type, if any, is the one of the signature this
+  // function was created with, not of the matched one.
+  const FunctionArgumentType &declared = GetSignature(0)->result_type();
+  RecordingCatalog recording(catalog);
+  std::unique_ptr<const AnalyzerOutput> output;
+  resolving_ids.push_back(id_);
+  const absl::Status status =
+      declared.IsTemplated()
+          ? AnalyzeExpression(body_, options, &recording, type_factory,
+                              &output)
+          : AnalyzeExpressionForAssignmentToType(body_, options, &recording,
+                                                 type_factory, declared.type(),
+                                                 &output);
+  resolving_ids.pop_back();
+  if (!status.ok()) {
+    // The location is in the body, not in the file being checked, so it is
+    // reported in the message and the error is located at the call.
+    std::string message =
+        absl::StrCat("Invalid function ", Name(), ": ", status.message());
+    if (zetasql::internal::HasPayloadWithType<ErrorLocation>(status)) {
+      const auto location =
+          zetasql::internal::GetPayload<ErrorLocation>(status);
+      absl::StrAppend(&message, " [in body of ", Name(), " at ",
+                      location.line(), ":", location.column(), "]");
+    }
+    return absl::Status(status.code(), message);
+  }
+  result_type =
+      declared.IsTemplated() ? output->resolved_expr()->type() : declared.type();
+  cache_.Insert(key, recording.ReleaseLookups(), result_type);
+  return result_type;
+}
+
+CachingTemplatedSQLTVF::CachingTemplatedSQLTVF(
+    const std::vector<std::string> &function_name_path,
+    const FunctionSignature &signature,
+    const std::vector<std::string> &argument_names,
+    const ParseResumeLocation &body)
+    : TemplatedSQLTVF(function_name_path, signature, argument_names, body),
+      id_(next_id++) {}
+
+absl::Status CachingTemplatedSQLTVF::Resolve(
+    const AnalyzerOptions *analyzer_options,
+    const std::vector<TVFInputArgumentType> &actual_arguments,
+    const FunctionSignature &concrete_signature, Catalog *catalog,
+    TypeFactory *type_factory,
+    std::shared_ptr<TVFSignature> *output_tvf_signature) const {
+  // Table arguments are described with their schemas.
+  std::string key = concrete_signature.DebugString();
+  for (const TVFInputArgumentType &argument : actual_arguments) {
+    absl::StrAppend(&key, "|", argument.DebugString());
+  }
+  if (cache_.Lookup(key, catalog, output_tvf_signature)) {
+    return absl::OkStatus();
+  }
+  RecordingCatalog recording(catalog);
+  ZETASQL_RETURN_IF_ERROR(TemplatedSQLTVF::Resolve(
+      analyzer_options, actual_arguments, concrete_signature, &recording,
+      type_factory, output_tvf_signature));
+  cache_.Insert(key, recording.ReleaseLookups(), *output_tvf_signature);
+  return absl::OkStatus();
+}
+
+} // namespace alphasql
@@ -0,0 +1,219 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#ifndef ALPHASQL_TEMPLATED_FUNCTION_CACHE_H_
+#define ALPHASQL_TEMPLATED_FUNCTION_CACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "zetasql/base/status.h"
+#include "zetasql/base/statusor.h"
+#include "zetasql/public/analyzer.h"
+#include "zetasql/public/catalog.h"
+#include "zetasql/public/function.h"
+#include "zetasql/public/parse_resume_location.h"
+#include "zetasql/public/table_valued_function.h"
+#include "zetasql/public/templated_sql_tvf.h"
+#include "zetasql/public/types/type_factory.h"
+
+namespace alphasql {
+
+// A catalog forwarding lookups to another one and recording what each of them
+// resolved to. Whatever was resolved against it can be reused in any catalog
+// where the recorded lookups resolve to the same objects.
+class RecordingCatalog : public zetasql::Catalog {
+public:
+  enum class Kind { kTable, kFunction, kTableValuedFunction, kProcedure, kType };
+  struct Lookup {
+    Kind kind;
+    std::vector<std::string> path;
+    // Null if nothing was found.
+    const void *object;
+    // Tells apart objects allocated at the address of a freed one.
+    std::string description;
+  };
+
+  // <catalog> must outlive this catalog.
+  explicit RecordingCatalog(zetasql::Catalog *catalog) : catalog_(catalog) {}
+
+  std::string FullName() const override { return catalog_->FullName(); }
+
+  absl::Status FindTable(const absl::Span<const std::string> &path,
+                         const zetasql::Table **table,
+                         const FindOptions &options = FindOptions()) override;
+  absl::Status
+  FindFunction(const absl::Span<const std::string> &path,
+               const zetasql::Function **function,
+               const FindOptions &options = FindOptions()) override;
+  absl::Status FindTableValuedFunction(
+      const absl::Span<const std::string> &path,
+      const zetasql::TableValuedFunction **function,
+      const FindOptions &options = FindOptions()) override;
+  absl::Status
+  FindProcedure(const absl::Span<const std::string> &path,
+                const zetasql::Procedure **procedure,
+                const FindOptions &options = FindOptions()) override;
+  absl::Status FindType(const absl::Span<const std::string> &path,
+                        const zetasql::Type **type,
+                        const FindOptions &options = FindOptions()) override;
+
+  std::vector<Lookup> ReleaseLookups() { return std::move(lookups_); }
+
+  // Whether every one of <lookups> resolves to the same object in <catalog>.
+  static bool Replay(const std::vector<Lookup> &lookups,
+                     zetasql::Catalog *catalog);
+
+private:
+  template <class T>
+  void Record(Kind kind, const absl::Span<const std::string> &path,
+              const absl::Status &status, const T *const *object);
+
+  zetasql::Catalog *const catalog_; // Not owned.
+  std::vector<Lookup> lookups_;
+};
+
+// Resolutions of a templated body keyed by the concrete argument types they
+// were made for. An entry is only reused where the lookups made to resolve it
+// resolve to the same objects, so that redefining a table or a function the
+// body uses invalidates it. This class is thread-safe.
+template <class Result> class ResolutionCache {
+public:
+  // Returns true and sets <result> if an entry stored under <key> is valid in
+  // <catalog>.
+  bool Lookup(const std::string &key, zetasql::Catalog *catalog,
+              Result *result) const {
+    std::vector<std::shared_ptr<const Entry>> candidates;
+    {
+      absl::MutexLock l(&mutex_);
+      const auto it = entries_.find(key);
+      if (it != entries_.end()) {
+        candidates = it->second;
+      }
+    }
+    // Replayed without the lock, since lookups may resolve other bodies.
+    for (const auto &entry : candidates) {
+      if (RecordingCatalog::Replay(entry->lookups, catalog)) {
+        *result = entry->result;
+        ++hits_;
+        return true;
+      }
+    }
+    ++misses_;
+    return false;
+  }
+
+  void Insert(const std::string &key,
+              std::vector<RecordingCatalog::Lookup> lookups, Result result) {
+    auto entry = std::make_shared<const Entry>(
+        Entry{std::move(lookups), std::move(result)});
+    absl::MutexLock l(&mutex_);
+    auto &entries = entries_[key];
+    if (entries.size() >= kMaxEntriesPerKey) {
+      entries.erase(entries.begin());
+    }
+    entries.push_back(std::move(entry));
+  }
+
+  int64_t hits() const { return hits_; }
+  int64_t misses() const { return misses_; }
+
+private:
+  struct Entry {
+    std::vector<RecordingCatalog::Lookup> lookups;
+    Result result;
+  };
+  // Bounds the entries of bodies resolving differently in many files.
+  static constexpr size_t kMaxEntriesPerKey = 8;
+
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, std::vector<std::shared_ptr<const Entry>>>
+      entries_ ABSL_GUARDED_BY(mutex_);
+  mutable std::atomic<int64_t> hits_{0};
+  mutable std::atomic<int64_t> misses_{0};
+};
+
+// A scalar SQL function with templated arguments, like the TemplatedSQLFunction
+// CREATE FUNCTION makes, whose body is resolved once per combination of
+// concrete argument types instead of at every call.
+//
+// The body is resolved as an expression over columns named after the
+// arguments, and calls resolve to a plain function call of the resulting type.
+// Errors in the body are reported at the call, with their line and column in
+// the body in the message.
+class CachingTemplatedSQLFunction : public zetasql::Function {
+public:
+  CachingTemplatedSQLFunction(const std::string &name,
+                              const zetasql::FunctionSignature &signature,
+                              const std::vector<std::string> &argument_names,
+                              const std::string &body);
+
+  const ResolutionCache<const zetasql::Type *> &cache() const {
+    return cache_;
+  }
+  // Unique across the functions and TVFs of the process.
+  uint64_t id() const { return id_; }
+
+private:
+  zetasql_base::StatusOr<const zetasql::Type *> ComputeResultType(
+      zetasql::Catalog *catalog, zetasql::TypeFactory *type_factory,
+      const std::vector<zetasql::InputArgumentType> &arguments,
+      const zetasql::AnalyzerOptions &analyzer_options) const;
+
+  const std::vector<std::string> argument_names_;
+  const std::string body_;
+  const uint64_t id_;
+  mutable ResolutionCache<const zetasql::Type *> cache_;
+};
+
+// A TemplatedSQLTVF reusing the output signature of its body, which holds the
+// resolved query, for calls with the same argument types and table schemas.
+class CachingTemplatedSQLTVF : public zetasql::TemplatedSQLTVF {
+public:
+  CachingTemplatedSQLTVF(const std::vector<std::string> &function_name_path,
+                         const zetasql::FunctionSignature &signature,
+                         const std::vector<std::string> &argument_names,
+                         const zetasql::ParseResumeLocation &body);
+
+  absl::Status
+  Resolve(const zetasql::AnalyzerOptions *analyzer_options,
+          const std::vector<zetasql::TVFInputArgumentType> &actual_arguments,
+          const zetasql::FunctionSignature &concrete_signature,
+          zetasql::Catalog *catalog, zetasql::TypeFactory *type_factory,
+          std::shared_ptr<zetasql::TVFSignature> *output_tvf_signature)
+      const override;
+
+  const ResolutionCache<std::shared_ptr<zetasql::TVFSignature>> &
+  cache() const {
+    return cache_;
+  }
+  uint64_t id() const { return id_; }
+
+private:
+  const uint64_t id_;
+  mutable ResolutionCache<std::shared_ptr<zetasql::TVFSignature>> cache_;
+};
+
+} // namespace alphasql
+
+#endif // ALPHASQL_TEMPLATED_FUNCTION_CACHE_H_
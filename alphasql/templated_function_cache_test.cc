@@ -0,0 +1,135 @@
+//
+// Copyright 2020 Matts966
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//
+
+#include "alphasql/templated_function_cache.h"
+
+#include <memory>
+#include <string>
+
+#include "alphasql/layered_catalog.h"
+#include "gtest/gtest.h"
+#include "zetasql/base/status_macros.h"
+#include "zetasql/public/analyzer.h"
+#include "zetasql/public/language_options.h"
+#include "zetasql/public/simple_catalog.h"
+#include "zetasql/public/types/type_factory.h"
+#include "zetasql/resolved_ast/resolved_ast.h"
+
+namespace alphasql {
+namespace {
+
+using namespace zetasql;
+
+class TemplatedFunctionCacheTest : public ::testing::Test {
+protected:
+  TemplatedFunctionCacheTest()
+      : base_("base", &type_factory_), layer_("catalog", &base_, &type_factory_) {
+    base_.AddZetaSQLFunctions();
+    options_.mutable_language()->EnableMaximumLanguageFeaturesForDevelopment();
+    options_.mutable_language()->SetSupportsAllStatementKinds();
+  }
+
+  // Adds the function created by <create_function> to <catalog>.
+  const CachingTemplatedSQLFunction *
+  AddFunction(const std::string &create_function, LayeredCatalog *catalog) {
+    std::unique_ptr<const AnalyzerOutput> output;
+    const absl::Status status = AnalyzeStatement(
+        create_function, options_, catalog, &type_factory_, &output);
+    EXPECT_TRUE(status.ok()) << status;
+    const auto *statement =
+        output->resolved_statement()->GetAs<ResolvedCreateFunctionStmt>();
+    auto *function = new CachingTemplatedSQLFunction(
+        statement->name_path(0), statement->signature(),
+        statement->argument_name_list(), statement->code());
+    catalog->AddOwnedFunction(function);
+    return function;
+  }
+
+  absl::Status Analyze(const std::string &expression, Catalog *catalog,
+                       const Type **type) {
+    std::unique_ptr<const AnalyzerOutput> output;
+    ZETASQL_RETURN_IF_ERROR(AnalyzeExpression(expression, options_, catalog,
+                                              &type_factory_, &output));
+    *type = output->resolved_expr()->type();
+    return absl::OkStatus();
+  }
+
+  TypeFactory type_factory_;
+  SimpleCatalog base_;
+  LayeredCatalog layer_;
+  AnalyzerOptions options_;
+};
+
+TEST_F(TemplatedFunctionCacheTest, ResolvesOncePerArgumentTypes) {
+  const auto *function =
+      AddFunction("CREATE FUNCTION add_one(x ANY TYPE) AS (x + 1)", &layer_);
+
+  const Type *type;
+  ASSERT_TRUE(Analyze("add_one(1) + add_one(2)", &layer_, &type).ok());
+  EXPECT_TRUE(type->IsInt64());
+  EXPECT_EQ(function->cache().misses(), 1);
+  EXPECT_EQ(function->cache().hits(), 1);
+
+  ASSERT_TRUE(Analyze("add_one(1.5)", &layer_, &type).ok());
+  EXPECT_TRUE(type->IsDouble());
+  EXPECT_EQ(function->cache().misses(), 2);
+}
+
+TEST_F(TemplatedFunctionCacheTest, DeclaredResultType) {
+  AddFunction("CREATE FUNCTION to_double(x ANY TYPE) RETURNS DOUBLE AS (x)",
+              &layer_);
+
+  const Type *type;
+  ASSERT_TRUE(Analyze("to_double(1)", &layer_, &type).ok());
+  EXPECT_TRUE(type->IsDouble());
+  EXPECT_FALSE(Analyze("to_double('a')", &layer_, &type).ok());
+}
+
+TEST_F(TemplatedFunctionCacheTest, BodyErrorsAreLocatedInTheBody) {
+  AddFunction("CREATE FUNCTION add_z(x ANY TYPE) AS (x +\n    z)", &layer_);
+
+  const Type *type;
+  const absl::Status status = Analyze("add_z(1)", &layer_, &type);
+  ASSERT_FALSE(status.ok());
+  EXPECT_NE(status.message().find("Unrecognized name: z"), std::string::npos)
+      << status;
+  EXPECT_NE(status.message().find("[in body of add_z at 2:5]"),
+            std::string::npos)
+      << status;
+}
+
+TEST_F(TemplatedFunctionCacheTest, ResolvesAgainWhereTablesDiffer) {
+  const auto *function = AddFunction(
+      "CREATE FUNCTION count_t(x ANY TYPE) AS ((SELECT COUNT(*) FROM t) + x)",
+      &layer_);
+  const Type *type;
+  {
+    LayeredCatalog file_layer(&layer_);
+    file_layer.AddOwnedTable(
+        new SimpleTable("t", {{"a", type_factory_.get_int64()}}));
+    ASSERT_TRUE(Analyze("count_t(1)", &file_layer, &type).ok());
+    ASSERT_TRUE(Analyze("count_t(2)", &file_layer, &type).ok());
+  }
+  EXPECT_EQ(function->cache().misses(), 1);
+  EXPECT_EQ(function->cache().hits(), 1);
+
+  // The table of the cached resolution is gone.
+  EXPECT_FALSE(Analyze("count_t(1)", &layer_, &type).ok());
+  EXPECT_EQ(function->cache().hits(), 1);
+}
+
+} // namespace
+} // namespace alphasql